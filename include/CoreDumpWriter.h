@@ -74,13 +74,16 @@ enum ECoreDumpType {
     TIME,                   // trigger on time interval
     EXCEPTION,              // trigger on exception
     MANUAL,                 // manual trigger
-    PERFCOUNTER             // trigger on .NET perf counter
+    PERFCOUNTER,            // trigger on .NET perf counter
+    CRASH,                  // core piped in by the kernel (--core-handler)
+    THREADCPU               // trigger on the CPU usage of a single thread
 };
 
 struct CoreDumpWriter {
     struct ProcDumpConfiguration *Config;
     enum ECoreDumpType Type;
     char *ErrorMessage;     // Set to a descriptive, caller-owned string when dump generation fails (else NULL)
+    pid_t FirstThreadId;    // Thread to list first in the dump (selected by debuggers), or 0
 };
 
 struct CoreDumpWriter *NewCoreDumpWriter(enum ECoreDumpType type, struct ProcDumpConfiguration *config);
@@ -88,5 +91,10 @@ char* WriteCoreDumpInternal(struct CoreDumpWriter *self, char* socketName);
 char* WriteCoreDump(struct CoreDumpWriter *self);
 char* GetCoreDumpPrefixName(pid_t pid, char* procName, char* dumpPath, char* dumpName, enum ECoreDumpType type);
 char* GetCoreDumpName(ProcDumpConfiguration* config, ECoreDumpType type);
+#ifdef __linux__
+int OpenDumpStream(const char* target);
+int RebuildCoreDump(struct ProcDumpConfiguration *config);
+int HandleCoreDump(struct ProcDumpConfiguration *config);
+#endif
 
 #endif // CORE_DUMP_WRITER_H
\ No newline at end of file
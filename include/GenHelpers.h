@@ -133,6 +133,7 @@ char* GetSocketPath(char* prefix, pid_t pid, pid_t targetPid);
 int send_all(int socket, void *buffer, size_t length);
 int recv_all(int socket, void* buffer, size_t length);
 pid_t gettid() noexcept;
+uint64_t GetMonotonicTime();
 unsigned long GetCoreDumpFilter(int pid);
 bool SetCoreDumpFilter(int pid, unsigned long filter);
 
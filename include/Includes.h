@@ -5,6 +5,7 @@
 #include "Handle.h"
 #include "Logging.h"
 #include "Monitor.h"
+#include "TriggerScheduler.h"
 #include "Procdump.h"
 #include "ProcDumpConfiguration.h"
 #include "Process.h"
@@ -14,6 +14,8 @@
 #include <sys/ptrace.h>
 #include <stdlib.h>
 
+#include <vector>
+
 #include "ProcDumpConfiguration.h"
 
 #define MAX_PROFILER_CONNECTIONS    50
@@ -37,14 +39,10 @@ char* GetThresholds(struct ProcDumpConfiguration *self);
 char* GetClientData(struct ProcDumpConfiguration *self, char* fullDumpPath);
 char* GetClientDataHelper(enum TriggerType triggerType, char* path, const char* format, ...);
 bool ExitProcessMonitor(struct ProcDumpConfiguration* config, pthread_t processMonitor);
+void WaitThreads(std::vector<pthread_t>& threads);
 
 // Monitor worker threads
-void *CommitMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
-void *CpuMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
-void *ThreadCountMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
-void *FileDescriptorCountMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *SignalMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
-void *TimerThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *DotNetMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *RestrackManualTriggerThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *RestrackThread(void *thread_args /* struct ProcDumpConfiguration* */);
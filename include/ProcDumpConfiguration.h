@@ -46,7 +46,8 @@
 #define NO_PID INT_MAX
 #define EMPTY_PROC_NAME "(null)"
 
-#define MIN_POLLING_INTERVAL 1000   // default trigger polling interval (ms)
+#define DEFAULT_POLLING_INTERVAL 1000   // default trigger polling interval (ms)
+#define MIN_POLLING_INTERVAL 50         // shortest trigger polling interval (ms)
 #define MAX_DUMP_COUNT 100          // maximum number of dumps that can be requested to be collected
 
 // -------------------
@@ -115,6 +116,8 @@ struct ProcDumpConfiguration
     // Options
     int CpuThreshold;               // -c
     bool bCpuTriggerBelowValue;     // -cl
+    int ThreadCpuThreshold;         // -ct
+    int ThreadCpuSamples;           // -ct
     int* MemoryThreshold;           // -m
     int MemoryThresholdCount;
     int MemoryCurrentThreshold;
@@ -143,6 +146,22 @@ struct ProcDumpConfiguration
     int SampleRate;                 // Record every X resource allocation in restrack
     int CoreDumpMask;               // -mc (core dump mask)
     bool bUseGcore;                 // -usegcore (undocumented: use gcore instead of built-in corex)
+    int DumpThreads;                // -dt (number of threads writing the core dump)
+    bool bDirectIO;                 // -dio (write the core dump with O_DIRECT)
+    bool bLiveDump;                 // -live (pre-copy memory while the target runs)
+    bool bForkDump;                 // -fork (dump a copy-on-write fork of the target)
+    bool bDiffDump;                 // -diff (write later dumps of a series as differences to the first)
+    char *DiffBaseDump;             // -diff (first core dump of the series)
+    bool bFreezeDump;               // -freeze (stop the target by freezing its cgroup)
+    bool bCompressDump;             // -compress (write a seekable compressed core dump)
+    char *StreamTarget;             // -stream (FIFO or Unix socket the dumps are written to)
+    int MaxDumpSizeMB;              // -maxsize (largest core dump to write, most useful memory first; -1 for no limit)
+    bool bStacksDump;               // -stacks (only thread stacks, image data and ELF headers)
+    bool bDumpStats;                // -stats (log where dump time went and write it next to the dump)
+    int CoreHandlerSignal;          // --core-handler (signal the crashed process died of; -1 when not a core_pattern handler)
+    int MinFreeDiskMB;              // -minfree (disk space left free by --core-handler; -1 for 10% of the file system)
+    char *RebuildDumpPath;          // -rebuild (differential core dump to turn into a full one)
+    char *RebuildOutputPath;        // -rebuild (where to write the full core dump)
 
     // .NET Performance counter triggers
     struct PerfCounterTrigger PerfCounterTriggers[MAX_PERF_COUNTER_TRIGGERS];
@@ -23,6 +23,7 @@
 #define DEFAULT_NUMBER_OF_DUMPS 1           // default number of core dumps taken
 #define DEFAULT_DELTA_TIME 10               // default delta time in seconds between core dumps
 #define DEFAULT_SAMPLE_RATE 1               // default sample rate is 1
+#define DEFAULT_DUMP_THREADS 1              // default number of threads writing a core dump
 
 void termination_handler(int sig_num);
 
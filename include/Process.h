@@ -12,6 +12,7 @@
 
 #ifdef __linux__
 #include <linux/version.h>
+#include <dirent.h>
 #endif
 
 #include <unistd.h>
@@ -25,6 +26,12 @@
 #define MAX_CMDLINE_LEN 4096+1
 #define PID_MAX_KERNEL_CONFIG "/proc/sys/kernel/pid_max"
 
+// Sources read by GetProcessStatEx
+#define PROCESS_STAT_STAT       0x1     // /proc/[pid]/stat
+#define PROCESS_STAT_UIDS       0x2     // /proc/[pid]/status (real_uid ... fs_uid)
+#define PROCESS_STAT_FDS        0x4     // /proc/[pid]/fd (num_filedescriptors)
+#define PROCESS_STAT_ALL        (PROCESS_STAT_STAT | PROCESS_STAT_UIDS | PROCESS_STAT_FDS)
+
 // -----------------------------------------------------------
 // a series of structs for containing infromation from /procfs
 // -----------------------------------------------------------
@@ -280,11 +287,42 @@ struct ProcessStatus {
     int nonvoluntary_ctxt_switches;    //Number of involuntary context switches.
 };
 
+#ifdef __linux__
+//
+// /proc/[pid] files of a monitored process, kept open between samples so
+// that each source costs one pread (see ReadProcessStat)
+//
+struct ProcessReader {
+    pid_t pid;
+    unsigned long long starttime;   // from the first sample, to detect pid reuse
+    int statFd;                     // /proc/[pid]/stat
+    int statusFd;                   // /proc/[pid]/status
+    int fdDirFd;                    // /proc/[pid]/fd
+    DIR *taskDir;                   // /proc/[pid]/task
+};
+
+//
+// CPU time of one thread, from /proc/[pid]/task/[tid]/stat
+//
+struct ThreadCpuTime {
+    pid_t tid;
+    unsigned long long ticks;       // utime + stime, in clock ticks
+    char comm[16];                  // thread name
+};
+#endif
+
 // -----------------------------------------------------------
 // a series of functions for collecting information from /procfs
 // -----------------------------------------------------------
 
 bool GetProcessStat(pid_t pid, struct ProcessStat *proc);
+bool GetProcessStatEx(pid_t pid, struct ProcessStat *proc, int sources);
+#ifdef __linux__
+void InitProcessReader(struct ProcessReader *reader, pid_t pid);
+bool ReadProcessStat(struct ProcessReader *reader, struct ProcessStat *proc, int sources);
+void CloseProcessReader(struct ProcessReader *reader);
+int ReadThreadCpuTimes(struct ProcessReader *reader, struct ThreadCpuTime *threads, int count);
+#endif
 char* GetProcessName(pid_t pid);
 char* GetProcessNameFromCmdLine(char* cmdLine);
 pid_t GetProcessPgid(pid_t pid);
@@ -294,7 +332,6 @@ bool LookupProcessByName(const char* procName);
 pid_t LookupProcessPidByName(const char* name);
 int GetMaximumPID();
 int FilterForPid(const struct dirent *entry);
-int GetCpuUsage(pid_t pid);
 int GetRunningPids(pid_t** pids);
 
 #endif // PROCFSLIB_PROCESS_H
\ No newline at end of file
@@ -26,6 +26,7 @@ enum TriggerType
     Restrack,
     RestrackManual,
     PerfCounter,
+    ThreadCpu,
 };
 
 #endif // PROFILERCOMMON_H
\ No newline at end of file
@@ -0,0 +1,24 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// Trigger scheduler
+//
+// The polled triggers (CPU, thread CPU, commit, thread count, file
+// descriptor count and timer) of all monitored processes are evaluated by one
+// scheduler thread rather than by a thread per trigger and process.
+// Triggers that fire hand their dump to a separate executor thread.
+//
+//--------------------------------------------------------------------
+
+#ifndef TRIGGERSCHEDULER_H
+#define TRIGGERSCHEDULER_H
+
+#include "ProcDumpConfiguration.h"
+
+int ScheduleTrigger(struct ProcDumpConfiguration *self, enum TriggerType triggerType);
+void WaitForScheduledTriggers(struct ProcDumpConfiguration *self);
+void WakeTriggerScheduler();
+
+#endif // TRIGGERSCHEDULER_H
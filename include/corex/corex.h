@@ -7,6 +7,7 @@
 #ifndef COREX_H
 #define COREX_H
 
+#include <stdint.h>
 #include <sys/types.h>
 
 #ifdef __cplusplus
@@ -16,6 +17,18 @@ extern "C" {
 /* Flags for corex_options_t.flags */
 #define COREX_FLAG_NONE                0
 #define COREX_FLAG_IGNORE_COREDUMP_FILTER (1 << 1)  /* Dump all mappings, ignoring coredump_filter */
+#define COREX_FLAG_SPARSE              (1 << 2)  /* Leave untouched and all-zero pages as file holes */
+#define COREX_FLAG_IO_URING            (1 << 3)  /* Copy memory with io_uring when the kernel supports it */
+#define COREX_FLAG_DIRECT_IO           (1 << 4)  /* Write with O_DIRECT, bypassing the page cache */
+#define COREX_FLAG_LIVE                (1 << 5)  /* Pre-copy memory while the target runs (needs soft-dirty) */
+#define COREX_FLAG_FORK                (1 << 6)  /* Dump a forked copy-on-write child; the target resumes at once.
+                                                    MADV_DONTFORK/WIPEONFORK mappings are omitted */
+#define COREX_FLAG_DIFF                (1 << 7)  /* Differential series: index full dumps, diff against base_path */
+#define COREX_FLAG_FREEZE              (1 << 8)  /* Stop the target by freezing its cgroup v2 (falls back to ptrace) */
+#define COREX_FLAG_MAPS_QUERY          (1 << 9)  /* Read mappings with the PROCMAP_QUERY ioctl when the kernel has it */
+#define COREX_FLAG_COMPRESS            (1 << 10) /* Write a seekable compressed container (see corex_cxz_open) */
+#define COREX_FLAG_OUTPUT_FD           (1 << 11) /* Write to output_fd instead of creating output_path */
+#define COREX_FLAG_STACKS              (1 << 12) /* Only stacks, image data and ELF headers (see max_size) */
 
 /* Return codes */
 #define COREX_OK                  0
@@ -29,10 +42,86 @@ extern "C" {
 #define COREX_ERR_NO_THREADS     -8
 #define COREX_ERR_ALLOC          -9
 
+/* COREX_FLAG_DIFF: page hash index written next to a full dump */
+#define COREX_DIFF_INDEX_SUFFIX  ".pgidx"
+
+/* COREX_FLAG_COMPRESS: customary file name suffix of compressed cores */
+#define COREX_COMPRESS_SUFFIX    ".cxz"
+
+/* Upper bound for corex_options_t.num_writers */
+#define COREX_MAX_WRITERS        64
+
+/*
+ * What a dump spent its time on (corex_options_t.stats). Times are in
+ * nanoseconds; steps that do not apply to a dump stay 0.
+ */
+typedef struct {
+    uint64_t precopy_ns;        /* COREX_FLAG_LIVE: copying memory while the
+                                   target runs                           */
+    uint64_t attach_ns;         /* Stopping the threads (freezer, ptrace) */
+    uint64_t proc_info_ns;      /* Reading mappings and process state     */
+    uint64_t filter_ns;         /* coredump_filter, max_size, stacks only */
+    uint64_t regs_ns;           /* Reading the registers of all threads   */
+    uint64_t fork_ns;           /* COREX_FLAG_FORK: forking the target    */
+    uint64_t notes_ns;          /* Building the notes                     */
+    uint64_t write_ns;          /* Copying memory and writing the core    */
+    uint64_t stopped_ns;        /* From stopping the target to resuming it */
+    uint64_t total_ns;
+
+    uint64_t bytes_read;        /* Memory read from the target, or core
+                                   read from the input                   */
+    uint64_t bytes_skipped;     /* Dumped memory left as file holes:
+                                   untouched and all-zero pages           */
+    uint64_t bytes_written;     /* Written to the output (compressed size
+                                   with COREX_FLAG_COMPRESS)             */
+    uint64_t syscalls;          /* Reads and writes of memory and output
+                                   (io_uring_enter calls with io_uring)  */
+    uint64_t minor_faults;      /* Page faults of the calling process     */
+    uint64_t major_faults;      /*   during the dump                      */
+    uint64_t throughput;        /* bytes_read per second of copying
+                                   (precopy_ns + write_ns)               */
+} corex_stats_t;
+
 /* Options for controlling core dump generation */
+/*
+ * The core may be written to a pipe, FIFO or socket (COREX_FLAG_OUTPUT_FD,
+ * or a FIFO at output_path). It is then written sequentially by one
+ * thread, with zeros in place of file holes. Live and differential
+ * dumps need a regular file.
+ *
+ * With max_size set, mappings are chosen by value until the limit is
+ * reached: the used part of each thread's stack, the writable data of the
+ * executable and libraries, ELF headers, the heap, then the rest. The
+ * limit counts the uncompressed core, file holes included; mappings left
+ * out are listed in an NT_COREX_OMITTED note ("COREX"). A differential
+ * dump may exceed it by the size of its page bitmap.
+ *
+ * A COREX_FLAG_FORK dump leaves out MADV_DONTFORK and MADV_WIPEONFORK
+ * mappings, whose contents the fork lacks, and lists them in the same note.
+ *
+ * COREX_FLAG_STACKS keeps only the first three of those, whatever their
+ * size: enough for a debugger to show every thread's backtrace, locals
+ * and globals. Neither can be used for live dumps.
+ */
 typedef struct {
-    const char *output_path;    /* Path to write the core file (required) */
+    const char *output_path;    /* Path to write the core file (required
+                                   unless COREX_FLAG_OUTPUT_FD)          */
     int         flags;          /* Bitwise OR of COREX_FLAG_* constants   */
+    int         num_writers;    /* Threads copying memory to the file
+                                   (0 or 1 = single-threaded)            */
+    const char *base_path;      /* COREX_FLAG_DIFF: earlier full dump of
+                                   the same process to diff against, or
+                                   NULL to write a new full dump         */
+    int         output_fd;      /* COREX_FLAG_OUTPUT_FD: open descriptor
+                                   to write to, left open; a seekable one
+                                   is written from offset 0              */
+    uint64_t    max_size;       /* Limit on the core's size in bytes, or 0
+                                   for none; see below                   */
+    corex_stats_t *stats;       /* Filled in when the dump ends, even if
+                                   it failed, unless NULL                */
+    pid_t       first_tid;      /* Thread whose notes come first, so that
+                                   debuggers select it, or 0 for the
+                                   order of /proc/[pid]/task             */
 } corex_options_t;
 
 /*
@@ -59,6 +148,61 @@ int corex_dump_self(const corex_options_t *opts);
  */
 int corex_dump_pid(pid_t pid, const corex_options_t *opts);
 
+/*
+ * Copy an ELF core read sequentially from input_fd, such as the one the
+ * kernel writes to a core_pattern pipe handler ("|/path/to/handler"),
+ * to output_path or output_fd. Only the memory passes through a buffer,
+ * however large the core. COREX_FLAG_SPARSE leaves zero pages as holes,
+ * COREX_FLAG_COMPRESS writes a compressed container, and max_size drops
+ * the least useful segments as for a dump (stacks are kept whole); the
+ * flags that act on a live process cannot be used. Input after the last
+ * segment is not read.
+ *
+ * Returns COREX_OK on success, or a negative COREX_ERR_* code.
+ */
+int corex_copy_core(int input_fd, const corex_options_t *opts);
+
+/*
+ * Turn a differential core dump (COREX_FLAG_DIFF with a base_path) back
+ * into a standalone ELF core by filling in the unchanged pages from its
+ * base dump, which must still exist. A compressed core
+ * (COREX_FLAG_COMPRESS) is expanded into a plain, sparse ELF core.
+ *
+ * Returns COREX_OK on success, or a negative COREX_ERR_* code.
+ */
+int corex_rebuild(const char *delta_path, const char *output_path);
+
+/*
+ * Random access to a compressed core (COREX_FLAG_COMPRESS) without
+ * expanding it. The container is cut into independently compressed
+ * chunks, so a read only decompresses the chunks it touches.
+ */
+typedef struct corex_cxz corex_cxz_t;
+
+/* Open a compressed core. Returns NULL on failure (see corex_strerror). */
+corex_cxz_t *corex_cxz_open(const char *path);
+
+/* Size of the ELF core held in the container */
+uint64_t corex_cxz_size(const corex_cxz_t *cxz);
+
+/*
+ * Read size bytes of the ELF core at offset. Returns the number of
+ * bytes read (less at the end of the core), or a negative COREX_ERR_*
+ * code.
+ */
+ssize_t corex_cxz_read(corex_cxz_t *cxz, uint64_t offset, void *buf, size_t size);
+
+/*
+ * Read size bytes of the dumped process's memory at vaddr, using the
+ * core's PT_LOAD segments. Pages that were not dumped read as zeros.
+ * Stops at the first address outside all segments; returns the number
+ * of bytes read, or a negative COREX_ERR_* code if vaddr itself is not
+ * in the core.
+ */
+ssize_t corex_cxz_read_vaddr(corex_cxz_t *cxz, uint64_t vaddr, void *buf, size_t size);
+
+void corex_cxz_close(corex_cxz_t *cxz);
+
 /*
  * Return a human-readable error description for the most recent
  * failure on the calling thread.
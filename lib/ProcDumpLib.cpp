@@ -27,6 +27,23 @@ extern "C" int pdWriteDump(
     int         dumpMask,
     bool        bOverwrite,
     char**      error)
+{
+    return pdWriteDumpEx(processId, dumpPath, dumpMask, bOverwrite, PD_DUMP_FLAG_NONE, error);
+}
+
+//--------------------------------------------------------------------
+//
+// pdWriteDumpEx - Immediately generate a core dump of the target
+// process, of the kind selected by flags.
+//
+//--------------------------------------------------------------------
+extern "C" int pdWriteDumpEx(
+    pid_t       processId,
+    const char* dumpPath,
+    int         dumpMask,
+    bool        bOverwrite,
+    int         flags,
+    char**      error)
 {
     if(error != NULL)
     {
@@ -42,6 +59,15 @@ extern "C" int pdWriteDump(
         return -1;
     }
 
+    if((flags & ~PD_DUMP_FLAG_STACKS_ONLY) != 0)
+    {
+        if(error != NULL)
+        {
+            *error = strdup("Invalid argument: unknown flags.");
+        }
+        return -1;
+    }
+
     //
     // The existing writer constructs the final dump name from a directory
     // (CoreDumpPath) plus a file name prefix (CoreDumpName). Split the caller
@@ -87,6 +113,22 @@ extern "C" int pdWriteDump(
     config.bOverwriteExisting = bOverwrite;
     config.CoreDumpMask = dumpMask;
     config.bUseGcore = false;
+    config.DumpThreads = DEFAULT_DUMP_THREADS;
+    config.bDirectIO = false;
+    config.bLiveDump = false;
+    config.bForkDump = false;
+    config.bDiffDump = false;
+    config.DiffBaseDump = NULL;
+    config.bFreezeDump = false;
+    config.bCompressDump = false;
+    config.StreamTarget = NULL;
+    config.MaxDumpSizeMB = -1;
+    config.bStacksDump = (flags & PD_DUMP_FLAG_STACKS_ONLY) != 0;
+    config.CoreHandlerSignal = -1;
+    config.MinFreeDiskMB = -1;
+    config.bDumpStats = false;
+    config.RebuildDumpPath = NULL;
+    config.RebuildOutputPath = NULL;
     config.nQuit = 0;
     config.bTerminated = false;
 
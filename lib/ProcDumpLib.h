@@ -26,6 +26,12 @@ extern "C" {
 //
 #define PD_DUMP_MASK_DEFAULT (-1)
 
+//
+// Flags for pdWriteDumpEx.
+//
+#define PD_DUMP_FLAG_NONE           0
+#define PD_DUMP_FLAG_STACKS_ONLY    0x1     // Only thread stacks, registers, global data and ELF headers
+
 //---------------------------------------------------------------------------------------------------------
 // pdWriteDump
 //
@@ -51,6 +57,25 @@ int pdWriteDump(
     bool        bOverwrite,
     char**      error);
 
+//---------------------------------------------------------------------------------------------------------
+// pdWriteDumpEx
+//
+// Same as pdWriteDump, with flags selecting the kind of dump.
+//
+//  flags       - Bitwise OR of PD_DUMP_FLAG_* values. PD_DUMP_FLAG_STACKS_ONLY writes a small dump with
+//                what a debugger needs for the backtraces of all threads; it takes milliseconds even
+//                for very large processes, and is meant for hang investigations.
+//
+//  Returns 0 on success, non-zero on failure (including unknown flags).
+//---------------------------------------------------------------------------------------------------------
+int pdWriteDumpEx(
+    pid_t       processId,
+    const char* dumpPath,
+    int         dumpMask,
+    bool        bOverwrite,
+    int         flags,
+    char**      error);
+
 //---------------------------------------------------------------------------------------------------------
 // pdFreeError
 //
@@ -9,12 +9,14 @@
 #include "Includes.h"
 #ifdef __linux__
 #include "corex/corex.h"
+#include <sys/file.h>
+#include <sys/statvfs.h>
 #endif
 
 #include <memory>
 #include <stdarg.h>
 
-static const char *CoreDumpTypeStrings[] = { "commit", "cpu", "thread", "filedesc", "signal", "time", "exception", "manual", "perfcounter" };
+static const char *CoreDumpTypeStrings[] = { "commit", "cpu", "thread", "filedesc", "signal", "time", "exception", "manual", "perfcounter", "crash", "threadcpu" };
 
 //--------------------------------------------------------------------
 //
@@ -46,6 +48,96 @@ static void SetWriterError(struct CoreDumpWriter *self, const char *fmt, ...)
     va_end(args);
 }
 
+#ifdef __linux__
+//--------------------------------------------------------------------
+//
+// ReportDumpStats - Log where the time of a dump went (-stats) and, for
+// a dump written to a file, store the figures next to it as
+// <dump>.stats.json.
+//
+//--------------------------------------------------------------------
+static void ReportDumpStats(const char *coreDumpFileName, bool sidecar, const corex_stats_t *stats)
+{
+    const double ms = 1e6;
+    const double mb = 1 << 20;
+
+    Log(info, "Dump statistics: %.1f ms total, target stopped %.1f ms "
+              "(attach %.1f, proc %.1f, filter %.1f, regs %.1f, fork %.1f, notes %.1f, write %.1f, pre-copy %.1f ms), "
+              "%.1f MB read at %.1f MB/s, %.1f MB skipped, %.1f MB written, %llu syscalls, %llu minor / %llu major page faults",
+        stats->total_ns / ms, stats->stopped_ns / ms,
+        stats->attach_ns / ms, stats->proc_info_ns / ms, stats->filter_ns / ms, stats->regs_ns / ms,
+        stats->fork_ns / ms, stats->notes_ns / ms, stats->write_ns / ms, stats->precopy_ns / ms,
+        stats->bytes_read / mb, stats->throughput / mb, stats->bytes_skipped / mb, stats->bytes_written / mb,
+        (unsigned long long)stats->syscalls, (unsigned long long)stats->minor_faults, (unsigned long long)stats->major_faults);
+
+    if(!sidecar)
+    {
+        return;
+    }
+
+    char statsFileName[PATH_MAX+1];
+    if(snprintf(statsFileName, sizeof(statsFileName), "%s.stats.json", coreDumpFileName) >= (int) sizeof(statsFileName))
+    {
+        Log(warn, "Dump statistics not written: path too long.");
+        return;
+    }
+
+    auto_free_file FILE *statsFile = fopen(statsFileName, "w");
+    if(statsFile == NULL)
+    {
+        Log(warn, "Failed to write dump statistics to %s [%d].", statsFileName, errno);
+        return;
+    }
+
+    // The dump's file name, as a JSON string
+    const char *dumpName = strrchr(coreDumpFileName, '/');
+    fputs("{\n  \"dump\": \"", statsFile);
+    for(const char *c = dumpName ? dumpName + 1 : coreDumpFileName; *c; c++)
+    {
+        if(*c == '"' || *c == '\\')
+        {
+            fputc('\\', statsFile);
+        }
+        if((unsigned char) *c >= ' ')
+        {
+            fputc(*c, statsFile);
+        }
+    }
+
+    fprintf(statsFile,
+            "\",\n"
+            "  \"total_ns\": %llu,\n"
+            "  \"stopped_ns\": %llu,\n"
+            "  \"phases_ns\": {\n"
+            "    \"precopy\": %llu,\n"
+            "    \"attach\": %llu,\n"
+            "    \"proc_info\": %llu,\n"
+            "    \"filter\": %llu,\n"
+            "    \"regs\": %llu,\n"
+            "    \"fork\": %llu,\n"
+            "    \"notes\": %llu,\n"
+            "    \"write\": %llu\n"
+            "  },\n"
+            "  \"bytes_read\": %llu,\n"
+            "  \"bytes_skipped\": %llu,\n"
+            "  \"bytes_written\": %llu,\n"
+            "  \"syscalls\": %llu,\n"
+            "  \"minor_faults\": %llu,\n"
+            "  \"major_faults\": %llu,\n"
+            "  \"throughput_bytes_per_sec\": %llu\n"
+            "}\n",
+            (unsigned long long)stats->total_ns, (unsigned long long)stats->stopped_ns,
+            (unsigned long long)stats->precopy_ns, (unsigned long long)stats->attach_ns,
+            (unsigned long long)stats->proc_info_ns, (unsigned long long)stats->filter_ns,
+            (unsigned long long)stats->regs_ns, (unsigned long long)stats->fork_ns,
+            (unsigned long long)stats->notes_ns, (unsigned long long)stats->write_ns,
+            (unsigned long long)stats->bytes_read, (unsigned long long)stats->bytes_skipped,
+            (unsigned long long)stats->bytes_written, (unsigned long long)stats->syscalls,
+            (unsigned long long)stats->minor_faults, (unsigned long long)stats->major_faults,
+            (unsigned long long)stats->throughput);
+}
+#endif
+
 //--------------------------------------------------------------------
 //
 // NewCoreDumpWriter - Helper function for newing a struct CoreDumpWriter
@@ -65,6 +157,7 @@ struct CoreDumpWriter *NewCoreDumpWriter(enum ECoreDumpType type, struct ProcDum
     writer->Config = config;
     writer->Type = type;
     writer->ErrorMessage = NULL;
+    writer->FirstThreadId = 0;
 
     return writer;
 }
@@ -290,11 +383,12 @@ char* WriteCoreDumpInternal(struct CoreDumpWriter *self, char* socketName)
     {
 #ifdef __linux__
         char checkFileName[PATH_MAX+1];
-        snprintf(checkFileName, PATH_MAX, "%s.%d", gcorePrefixName, pid);
+        snprintf(checkFileName, PATH_MAX, "%s.%d%s", gcorePrefixName, pid,
+                 self->Config->bCompressDump && !self->Config->bUseGcore ? COREX_COMPRESS_SUFFIX : "");
 #else
         const char *checkFileName = coreDumpFileName;
 #endif
-        if(access(checkFileName, F_OK)==0 && !self->Config->bOverwriteExisting)
+        if(self->Config->StreamTarget == NULL && access(checkFileName, F_OK)==0 && !self->Config->bOverwriteExisting)
         {
             Log(info, "Dump file %s already exists and was not overwritten (use -o to overwrite)", checkFileName);
             return NULL;
@@ -490,11 +584,70 @@ char* WriteCoreDumpInternal(struct CoreDumpWriter *self, char* socketName)
         {
 #ifdef __linux__
             // Default on Linux: use corex for core dump generation
-            snprintf(coreDumpFileName, PATH_MAX, "%s.%d", gcorePrefixName, pid);
+            snprintf(coreDumpFileName, PATH_MAX, "%s.%d%s", gcorePrefixName, pid,
+                     self->Config->bCompressDump ? COREX_COMPRESS_SUFFIX : "");
 
             corex_options_t corexOpts;
+            memset(&corexOpts, 0, sizeof(corexOpts));
             corexOpts.output_path = coreDumpFileName;
-            corexOpts.flags = COREX_FLAG_NONE;
+            corexOpts.flags = COREX_FLAG_SPARSE       // untouched/zero pages become file holes
+                            | COREX_FLAG_IO_URING;   // async copy engine, falls back if unsupported
+            if(self->Config->bDirectIO)
+            {
+                corexOpts.flags |= COREX_FLAG_DIRECT_IO; // keep the dump out of the page cache
+            }
+            if(self->Config->bLiveDump)
+            {
+                corexOpts.flags |= COREX_FLAG_LIVE;      // pre-copy, pause only for the final delta
+            }
+            if(self->Config->bForkDump)
+            {
+                corexOpts.flags |= COREX_FLAG_FORK;      // dump a COW child, pause only for the fork
+            }
+            if(self->Config->bDiffDump)
+            {
+                corexOpts.flags |= COREX_FLAG_DIFF;      // only pages changed since the series' first dump
+                corexOpts.base_path = self->Config->DiffBaseDump;
+            }
+            if(self->Config->bFreezeDump)
+            {
+                corexOpts.flags |= COREX_FLAG_FREEZE;    // stop all threads at once via the cgroup freezer
+            }
+            if(self->Config->bCompressDump)
+            {
+                corexOpts.flags |= COREX_FLAG_COMPRESS;  // chunked zlib container, compressed while writing
+            }
+            if(self->Config->bStacksDump)
+            {
+                corexOpts.flags |= COREX_FLAG_STACKS;    // stacks, globals and ELF headers only
+            }
+            if(self->Config->MaxDumpSizeMB != -1)
+            {
+                corexOpts.max_size = (uint64_t)self->Config->MaxDumpSizeMB << 20; // most useful mappings first
+            }
+            corexOpts.num_writers = self->Config->DumpThreads;
+            corexOpts.first_tid = self->FirstThreadId;   // e.g. the hot thread of a -ct trigger
+
+            corex_stats_t corexStats;
+            if(self->Config->bDumpStats)
+            {
+                corexOpts.stats = &corexStats;           // phase times, bytes and throughput
+            }
+
+            auto_free_fd int streamFd = 0;
+            if(self->Config->StreamTarget)
+            {
+                streamFd = OpenDumpStream(self->Config->StreamTarget);
+                if(streamFd < 0)
+                {
+                    Log(error, "Failed to open %s to stream the core dump [%d].", self->Config->StreamTarget, errno);
+                    SetWriterError(self, "Failed to open %s to stream the core dump [%d]", self->Config->StreamTarget, errno);
+                    free(name);
+                    return NULL;
+                }
+                corexOpts.flags |= COREX_FLAG_OUTPUT_FD; // written in order; coreDumpFileName only names it
+                corexOpts.output_fd = streamFd;
+            }
 
             int corexRet = corex_dump_pid(pid, &corexOpts);
             if(corexRet != COREX_OK)
@@ -508,16 +661,40 @@ char* WriteCoreDumpInternal(struct CoreDumpWriter *self, char* socketName)
             {
                 if(self->Config->nQuit)
                 {
-                    int ret = unlink(coreDumpFileName);
+                    int ret = self->Config->StreamTarget ? 0 : unlink(coreDumpFileName);
                     if (ret < 0 && errno != ENOENT)
                     {
                         Trace("WriteCoreDumpInternal: Failed to remove partial core dump");
                         exit(-1);
                     }
+                    if(self->Config->bDiffDump && self->Config->DiffBaseDump == NULL)
+                    {
+                        char indexFileName[PATH_MAX+sizeof(COREX_DIFF_INDEX_SUFFIX)];
+                        snprintf(indexFileName, sizeof(indexFileName), "%s%s", coreDumpFileName, COREX_DIFF_INDEX_SUFFIX);
+                        unlink(indexFileName);
+                    }
                 }
                 else
                 {
-                    Log(info, "Core dump %d generated: %s", self->Config->NumberOfDumpsCollected, coreDumpFileName);
+                    if(self->Config->bDiffDump && self->Config->DiffBaseDump == NULL)
+                    {
+                        // The rest of the series is written as differences to this dump
+                        self->Config->DiffBaseDump = strdup(coreDumpFileName);
+                    }
+
+                    if(self->Config->StreamTarget)
+                    {
+                        Log(info, "Core dump %d streamed to %s: %s", self->Config->NumberOfDumpsCollected, self->Config->StreamTarget, coreDumpFileName);
+                    }
+                    else
+                    {
+                        Log(info, "Core dump %d generated: %s", self->Config->NumberOfDumpsCollected, coreDumpFileName);
+                    }
+
+                    if(self->Config->bDumpStats)
+                    {
+                        ReportDumpStats(coreDumpFileName, self->Config->StreamTarget == NULL, &corexStats);
+                    }
 
                     self->Config->NumberOfDumpsCollected++;
                     if (self->Config->NumberOfDumpsCollected >= self->Config->NumberOfDumpsToCollect)
@@ -541,3 +718,303 @@ char* WriteCoreDumpInternal(struct CoreDumpWriter *self, char* socketName)
     return strdup(coreDumpFileName);
 }
 
+#ifdef __linux__
+//--------------------------------------------------------------------
+//
+// OpenDumpStream - Connect to the Unix socket, or open the FIFO, that a
+// core dump is streamed to (-stream). Opening a FIFO waits for a reader.
+//
+// Returns: file descriptor, or -1 with errno set
+//
+//--------------------------------------------------------------------
+int OpenDumpStream(const char* target)
+{
+    struct stat st;
+    if(stat(target, &st) != 0)
+    {
+        return -1;
+    }
+
+    if(!S_ISSOCK(st.st_mode))
+    {
+        return open(target, O_WRONLY | O_CLOEXEC);
+    }
+
+    struct sockaddr_un addr;
+    if(strlen(target) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, target, sizeof(addr.sun_path)-1);
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    // Nothing is read back from the collector
+    shutdown(fd, SHUT_RD);
+    return fd;
+}
+
+//--------------------------------------------------------------------
+//
+// RebuildCoreDump - Turn a core dump written with -diff or -compress
+// back into a standalone core dump (-rebuild).
+//
+// Returns: 0   - Success
+//          -1  - Failure
+//
+//--------------------------------------------------------------------
+int RebuildCoreDump(struct ProcDumpConfiguration *config)
+{
+    if(corex_rebuild(config->RebuildDumpPath, config->RebuildOutputPath) != COREX_OK)
+    {
+        Log(error, "Failed to rebuild %s: %s", config->RebuildDumpPath, corex_strerror());
+        return -1;
+    }
+
+    Log(info, "Core dump rebuilt: %s", config->RebuildOutputPath);
+    return 0;
+}
+
+//--------------------------------------------------------------------
+//
+// HandlerLog - Log a --core-handler message. The kernel runs the
+// handler with nothing but the core on its standard input, so messages
+// also go to the syslog.
+//
+//--------------------------------------------------------------------
+static void HandlerLog(enum LogLevel logLevel, const char *fmt, ...)
+{
+    char message[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+
+    Log(logLevel, "%s", message);
+    syslog(logLevel == error ? LOG_ERR : logLevel == warn ? LOG_WARNING : LOG_INFO, "%s", message);
+}
+
+//--------------------------------------------------------------------
+//
+// CountHandlerDumps - Number of dumps in the directory open as dirFd
+// whose name starts with prefix: <prefix>...<pid>, or <pid>.cxz when
+// compressed. The statistics written next to them (-stats) do not count.
+//
+//--------------------------------------------------------------------
+static int CountHandlerDumps(int dirFd, const char *prefix)
+{
+    int dupFd = dup(dirFd);
+    if(dupFd < 0)
+    {
+        return -1;
+    }
+
+    auto_free_dir DIR *dir = fdopendir(dupFd);
+    if(dir == NULL)
+    {
+        close(dupFd);
+        return -1;
+    }
+
+    int count = 0;
+    size_t prefixLen = strlen(prefix);
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        if(strncmp(entry->d_name, prefix, prefixLen) != 0)
+        {
+            continue;
+        }
+
+        size_t len = strlen(entry->d_name);
+        size_t suffixLen = strlen(COREX_COMPRESS_SUFFIX);
+        if(len > suffixLen && strcmp(entry->d_name + len - suffixLen, COREX_COMPRESS_SUFFIX) == 0)
+        {
+            len -= suffixLen;
+        }
+
+        // The name ends in .<pid>
+        size_t digits = 0;
+        while(digits < len && isdigit((unsigned char) entry->d_name[len - digits - 1]))
+        {
+            digits++;
+        }
+        if(digits > 0 && digits < len && entry->d_name[len - digits - 1] == '.')
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+//--------------------------------------------------------------------
+//
+// HandleCoreDump - Run as the kernel's core_pattern pipe handler
+// (--core-handler): copy the core of a crashed process from standard
+// input to the dump folder, compressed or sparse as it streams through.
+// At most -n dumps per process name are kept, and a dump never eats into
+// the free space reserved by -minfree (10% of the file system by
+// default); one that does not fit whole keeps its most useful memory.
+//
+// Returns: 0   - Success, or dump skipped because of a limit
+//          -1  - Failure
+//
+//--------------------------------------------------------------------
+int HandleCoreDump(struct ProcDumpConfiguration *config)
+{
+    pid_t pid = config->ProcessId;
+    int sig = config->CoreHandlerSignal;
+
+    auto_free char *procName = GetProcessName(pid);
+    auto_free char *prefixName = GetCoreDumpPrefixName(pid, procName ? procName : (char*) "process",
+                                                       config->CoreDumpPath, config->CoreDumpName, CRASH);
+
+    char coreDumpFileName[PATH_MAX+1];
+    if(snprintf(coreDumpFileName, sizeof(coreDumpFileName), "%s.%d%s", prefixName, pid,
+                config->bCompressDump ? COREX_COMPRESS_SUFFIX : "") >= (int) sizeof(coreDumpFileName))
+    {
+        HandlerLog(error, "Core dump path too long for process %d.", pid);
+        return -1;
+    }
+
+    corex_options_t corexOpts;
+    memset(&corexOpts, 0, sizeof(corexOpts));
+    corexOpts.flags = COREX_FLAG_SPARSE | COREX_FLAG_OUTPUT_FD;
+    if(config->bDirectIO)
+    {
+        corexOpts.flags |= COREX_FLAG_DIRECT_IO;
+    }
+    if(config->bCompressDump)
+    {
+        corexOpts.flags |= COREX_FLAG_COMPRESS;
+    }
+    if(config->MaxDumpSizeMB != -1)
+    {
+        corexOpts.max_size = (uint64_t)config->MaxDumpSizeMB << 20;
+    }
+    corexOpts.num_writers = config->DumpThreads;
+
+    corex_stats_t corexStats;
+    if(config->bDumpStats)
+    {
+        corexOpts.stats = &corexStats;
+    }
+
+    auto_free_fd int dirFd = -1;
+    auto_free_fd int outputFd = -1;
+    if(config->StreamTarget)
+    {
+        // The collector on the other end keeps its own limits
+        outputFd = OpenDumpStream(config->StreamTarget);
+        if(outputFd < 0)
+        {
+            HandlerLog(error, "Failed to open %s to stream the core dump of process %d [%d].", config->StreamTarget, pid, errno);
+            return -1;
+        }
+    }
+    else
+    {
+        // Crashes can come in bursts: count, size and write under one lock,
+        // held until we return, so that the next dump sees this one's size
+        dirFd = open(config->CoreDumpPath, O_RDONLY | O_DIRECTORY);
+        if(dirFd < 0 || flock(dirFd, LOCK_EX) != 0)
+        {
+            HandlerLog(error, "Failed to open dump folder %s [%d].", config->CoreDumpPath, errno);
+            return -1;
+        }
+
+        // The series: the dump name given, or this process name's crash dumps
+        char seriesPrefix[PATH_MAX+1];
+        if(config->CoreDumpName != NULL)
+        {
+            snprintf(seriesPrefix, sizeof(seriesPrefix), "%s.", config->CoreDumpName);
+        }
+        else
+        {
+            auto_free char *name = sanitize(procName ? procName : (char*) "process");
+            snprintf(seriesPrefix, sizeof(seriesPrefix), "%s_%s_", name ? name : "", CoreDumpTypeStrings[CRASH]);
+        }
+
+        int count = CountHandlerDumps(dirFd, seriesPrefix);
+        if(count >= config->NumberOfDumpsToCollect)
+        {
+            HandlerLog(warn, "Process %d died of signal %d, core dump not written: %d dumps of %s* already in %s.",
+                       pid, sig, count, seriesPrefix, config->CoreDumpPath);
+            return 0;
+        }
+
+        struct statvfs fs;
+        if(fstatvfs(dirFd, &fs) != 0)
+        {
+            HandlerLog(error, "Failed to get the free space of %s [%d].", config->CoreDumpPath, errno);
+            return -1;
+        }
+
+        uint64_t available = (uint64_t)fs.f_bavail * fs.f_frsize;
+        uint64_t reserve = config->MinFreeDiskMB != -1 ? (uint64_t)config->MinFreeDiskMB << 20
+                                                       : (uint64_t)fs.f_blocks * fs.f_frsize / 10;
+        uint64_t budget = available > reserve ? available - reserve : 0;
+        if(corexOpts.max_size == 0 || corexOpts.max_size > budget)
+        {
+            corexOpts.max_size = budget;
+        }
+
+        if(corexOpts.max_size < (1 << 20))
+        {
+            HandlerLog(warn, "Process %d died of signal %d, core dump not written: less than 1 MB above the free space to keep on %s.",
+                       pid, sig, config->CoreDumpPath);
+            return 0;
+        }
+
+        outputFd = open(coreDumpFileName, O_WRONLY | O_CREAT | O_CLOEXEC | (config->bOverwriteExisting ? O_TRUNC : O_EXCL), 0600);
+        if(outputFd < 0)
+        {
+            HandlerLog(error, "Failed to create %s [%d].", coreDumpFileName, errno);
+            return -1;
+        }
+    }
+    corexOpts.output_fd = outputFd;
+
+    if(corex_copy_core(STDIN_FILENO, &corexOpts) != COREX_OK)
+    {
+        HandlerLog(error, "Failed to write the core dump of process %d: %s", pid, corex_strerror());
+        if(config->StreamTarget == NULL)
+        {
+            unlink(coreDumpFileName);
+        }
+        return -1;
+    }
+
+    if(config->StreamTarget)
+    {
+        HandlerLog(info, "Process %d died of signal %d, core dump streamed to %s: %s", pid, sig, config->StreamTarget, coreDumpFileName);
+    }
+    else
+    {
+        HandlerLog(info, "Process %d died of signal %d, core dump generated: %s", pid, sig, coreDumpFileName);
+    }
+
+    if(config->bDumpStats)
+    {
+        ReportDumpStats(coreDumpFileName, config->StreamTarget == NULL, &corexStats);
+    }
+
+    return 0;
+}
+#endif
@@ -702,6 +702,22 @@ pid_t gettid() noexcept
     return 0;
 }
 
+//--------------------------------------------------------------------
+//
+// GetMonotonicTime
+//
+// Returns CLOCK_MONOTONIC in milliseconds. Unlike the wall clock it
+// does not jump, so deadlines computed from it do not drift.
+//
+//--------------------------------------------------------------------
+uint64_t GetMonotonicTime()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 //--------------------------------------------------------------------
 //
 // GetCoreDumpFilter
@@ -302,6 +302,8 @@ void MonitorProcesses(struct ProcDumpConfiguration *self)
         // print config here
         PrintConfiguration(self);
 
+        uint64_t nextScan = GetMonotonicTime();
+
         do
         {
             // Multi process monitoring
@@ -340,7 +342,7 @@ void MonitorProcesses(struct ProcDumpConfiguration *self)
                     if(pgid != NO_PID && pgid == self->ProcessGroup)
                     {
                         struct ProcessStat procStat;
-                        bool ret = GetProcessStat(procPid, &procStat);
+                        bool ret = GetProcessStatEx(procPid, &procStat, PROCESS_STAT_STAT);
 
                         // Note: To solve the PID reuse case, we uniquely identify an entry via {PID}{starttime}
                         if(ret && (monitoredProcessMap[procPid].active == false || monitoredProcessMap[procPid].starttime != procStat.starttime))
@@ -373,7 +375,7 @@ void MonitorProcesses(struct ProcDumpConfiguration *self)
                     if (nameForPid && strcmp(nameForPid, self->ProcessName) == 0)
                     {
                         struct ProcessStat procStat;
-                        bool ret = GetProcessStat(procPid, &procStat);
+                        bool ret = GetProcessStatEx(procPid, &procStat, PROCESS_STAT_STAT);
 
                         // Note: To solve the PID reuse case, we uniquely identify an entry via {PID}{starttime}
                         if(ret && (monitoredProcessMap[procPid].active == false || monitoredProcessMap[procPid].starttime != procStat.starttime))
@@ -442,8 +444,17 @@ void MonitorProcesses(struct ProcDumpConfiguration *self)
                 break;
             }
 
-            // Wait for the polling interval the user specified before we check again
-            sleep(g_config.PollingInterval / 1000);
+            // Wait for the polling interval the user specified before we check again. The scans
+            // are a fixed interval apart on CLOCK_MONOTONIC, however long a scan took, and a
+            // scan that overran skips the intervals it missed rather than scanning back to back.
+            uint64_t now = GetMonotonicTime();
+            nextScan += g_config.PollingInterval;
+            if (nextScan <= now)
+            {
+                nextScan += ((now - nextScan) / g_config.PollingInterval + 1) * g_config.PollingInterval;
+            }
+
+            WaitForSingleObject(&g_config.evtQuit, (int)(nextScan - now));
 
         // We keep iterating while we have processes to monitor (in case of -g <pgid>) or if process name has
         // been specified (-w) in which case we keep monitoring until CTRL-C or finally if we have a quit signal.
@@ -525,6 +536,9 @@ int CreateMonitorThread(struct ProcDumpConfiguration *self, enum TriggerType tri
 //
 // CreateMonitorThreads - Create each of the threads that will be running as a trigger
 //
+// Polled triggers (CPU, commit, thread count, file descriptor count and
+// timer) do not get a thread; they are added to the trigger scheduler.
+//
 //--------------------------------------------------------------------
 int CreateMonitorThreads(struct ProcDumpConfiguration *self)
 {
@@ -543,36 +557,47 @@ int CreateMonitorThreads(struct ProcDumpConfiguration *self)
 
     if (self->CpuThreshold != -1)
     {
-        if ((rc = CreateMonitorThread(self, Processor, CpuMonitoringThread, (void *)self)) != 0 )
+        if ((rc = ScheduleTrigger(self, Processor)) != 0 )
         {
-            Trace("CreateMonitorThreads: failed to create CpuThread.");
+            Trace("CreateMonitorThreads: failed to schedule the CPU trigger.");
             return rc;
         }
     }
 
+#ifdef __linux__
+    if (self->ThreadCpuThreshold != -1)
+    {
+        if ((rc = ScheduleTrigger(self, ThreadCpu)) != 0 )
+        {
+            Trace("CreateMonitorThreads: failed to schedule the thread CPU trigger.");
+            return rc;
+        }
+    }
+#endif
+
     if (self->MemoryThreshold != NULL && self->bMonitoringGCMemory == false)
     {
-        if ((rc = CreateMonitorThread(self, Commit, CommitMonitoringThread, (void *)self)) != 0 )
+        if ((rc = ScheduleTrigger(self, Commit)) != 0 )
         {
-            Trace("CreateMonitorThreads: failed to create CommitThread.");
+            Trace("CreateMonitorThreads: failed to schedule the commit trigger.");
             return rc;
         }
     }
 
     if (self->ThreadThreshold != -1)
     {
-        if ((rc = CreateMonitorThread(self, ThreadCount, ThreadCountMonitoringThread, (void *)self)) != 0 )
+        if ((rc = ScheduleTrigger(self, ThreadCount)) != 0 )
         {
-            Trace("CreateMonitorThreads: failed to create ThreadThread.");
+            Trace("CreateMonitorThreads: failed to schedule the thread count trigger.");
             return rc;
         }
     }
 
     if (self->FileDescriptorThreshold != -1)
     {
-        if ((rc = CreateMonitorThread(self, FileDescriptorCount, FileDescriptorCountMonitoringThread, (void *)self)) != 0 )
+        if ((rc = ScheduleTrigger(self, FileDescriptorCount)) != 0 )
         {
-            Trace("CreateMonitorThreads: failed to create FileDescriptorThread.");
+            Trace("CreateMonitorThreads: failed to schedule the file descriptor count trigger.");
             return rc;
         }
     }
@@ -588,9 +613,9 @@ int CreateMonitorThreads(struct ProcDumpConfiguration *self)
 
     if (self->bTimerThreshold)
     {
-        if ((rc = CreateMonitorThread(self, Timer, TimerThread, (void *)self)) != 0 )
+        if ((rc = ScheduleTrigger(self, Timer)) != 0 )
         {
-            Trace("CreateMonitorThreads: failed to create TimerThread.");
+            Trace("CreateMonitorThreads: failed to schedule the timer trigger.");
             return rc;
         }
     }
@@ -606,6 +631,7 @@ int CreateMonitorThreads(struct ProcDumpConfiguration *self)
         // if '-restrack' was enabled without triggers, we wait a manual user input to be the trigger for a restrack snapshot
         if ((self->bTimerThreshold == false) &&
             (self->CpuThreshold == -1) &&
+            (self->ThreadCpuThreshold == -1) &&
             (self->MemoryThreshold == NULL) &&
             (self->ThreadThreshold == -1) &&
             (self->FileDescriptorThreshold == -1) &&
@@ -781,6 +807,8 @@ int WaitForAllMonitorsToTerminate(struct ProcDumpConfiguration *self)
     int rc = 0;
     pthread_t restrackThread = 0;
 
+    WaitForScheduledTriggers(self);
+
     // Wait for the other monitoring threads. We exclude restrack
     // since we want that thread to exit last
     for (int i = 0; i < self->nThreads; i++)
@@ -858,6 +886,7 @@ int SetQuit(struct ProcDumpConfiguration *self, int quit)
 {
     self->nQuit = quit;
     SetEvent(&self->evtQuit.event);
+    WakeTriggerScheduler();
 
     return self->nQuit;
 }
@@ -921,7 +950,10 @@ bool ContinueMonitoring(struct ProcDumpConfiguration *self)
 //--------------------------------------------------------------------
 bool BeginMonitoring(struct ProcDumpConfiguration *self)
 {
-    return SetEvent(&(self->evtStartMonitoring.event));
+    bool ret = SetEvent(&(self->evtStartMonitoring.event));
+    WakeTriggerScheduler();
+
+    return ret;
 }
 
 extern long HZ;                                // clock ticks per second
@@ -948,259 +980,6 @@ void WaitThreads(std::vector<pthread_t>& threads)
     }
 }
 
-//--------------------------------------------------------------------
-//
-// CommitMonitoringThread - Thread monitoring for memory consumption
-//
-//--------------------------------------------------------------------
-void *CommitMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
-{
-    Trace("CommitMonitoringThread: Enter [id=%d]", gettid());
-    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
-
-    long pageSize_kb;
-    unsigned long memUsage = 0;
-    struct ProcessStat proc = {0};
-    int rc = 0;
-    auto_free struct CoreDumpWriter *writer = NULL;
-    auto_free char* dumpFileName = NULL;
-    std::vector<pthread_t> leakReportThreads;
-
-    writer = NewCoreDumpWriter(COMMIT, config);
-
-    pageSize_kb = sysconf(_SC_PAGESIZE) >> 10; // convert bytes to kilobytes (2^10)
-
-    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
-    {
-        while ((rc = WaitForQuit(config, config->PollingInterval)) == WAIT_TIMEOUT)
-        {
-            if (GetProcessStat(config->ProcessId, &proc))
-            {
-#ifdef __linux__                
-                // Calc Commit
-                memUsage = (proc.rss * pageSize_kb) >> 10;    // get Resident Set Size
-                memUsage += (proc.nswap * pageSize_kb) >> 10; // get Swap size
-#elif __APPLE__
-                memUsage = proc.rss / (1024.0 * 1024.0);       // get Resident Set Size
-#endif
-
-                // Commit Trigger
-                if ((config->bMemoryTriggerBelowValue && (memUsage < config->MemoryThreshold[config->MemoryCurrentThreshold])) ||
-                    (!config->bMemoryTriggerBelowValue && (memUsage >= config->MemoryThreshold[config->MemoryCurrentThreshold])))
-                {
-                    Log(info, "Trigger: Commit usage:%ldMB on process ID: %d", memUsage, config->ProcessId);
-
-                    if(config->bRestrackGenerateDump == true)
-                    {
-                        // Only generate core dump if user did not specify the "nodump" restrack option
-                        dumpFileName = WriteCoreDump(writer);
-                        if(dumpFileName == NULL)
-                        {
-                            SetQuit(config, 1);
-                        }
-                    }
-
-                    //
-                    // Check to see if restrack is specified, if so, save current resource usage to file.
-                    //
-#ifdef __linux__                    
-                    if(config->bRestrackEnabled == true)
-                    {
-                        pthread_t id = WriteRestrackSnapshot(config, writer->Type);
-                        if (id == 0)
-                        {
-                            SetQuit(config, 1);
-                        }
-                        else
-                        {
-                            leakReportThreads.push_back(id);
-                        }
-                    }
-#endif                    
-
-
-                    config->MemoryCurrentThreshold++;
-
-                    if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
-                    {
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                Log(error, "An error occurred while fetching memory info\n");
-                exit(-1);
-            }
-        }
-    }
-
-    //
-    // Wait for the leak reporting threads to finish
-    //
-    WaitThreads(leakReportThreads);
-
-    Trace("CommitMonitoringThread: Exit [id=%d]", gettid());
-    return NULL;
-}
-
-//--------------------------------------------------------------------
-//
-// ThreadCountMonitoringThread - Thread monitoring for thread count
-//
-//--------------------------------------------------------------------
-void* ThreadCountMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
-{
-    Trace("ThreadCountMonitoringThread: Enter [id=%d]", gettid());
-    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
-
-    struct ProcessStat proc = {0};
-    int rc = 0;
-    auto_free struct CoreDumpWriter *writer = NULL;
-    auto_free char* dumpFileName = NULL;
-    std::vector<pthread_t> leakReportThreads;
-
-    writer = NewCoreDumpWriter(THREAD, config);
-
-    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
-    {
-        while ((rc = WaitForQuit(config, config->PollingInterval)) == WAIT_TIMEOUT)
-        {
-            if (GetProcessStat(config->ProcessId, &proc))
-            {
-                if (proc.num_threads >= config->ThreadThreshold)
-                {
-                    Log(info, "Trigger: Thread count:%ld on process ID: %d", proc.num_threads, config->ProcessId);
-
-                    if(config->bRestrackGenerateDump == true)
-                    {
-                        // Only generate core dump if user did not specify the "nodump" restrack option
-                        dumpFileName = WriteCoreDump(writer);
-                        if(dumpFileName == NULL)
-                        {
-                            SetQuit(config, 1);
-                        }
-                    }
-
-                    //
-                    // Check to see if restrack is specified, if so, save current resource usage to file.
-                    //
-#ifdef __linux__                    
-                    if(config->bRestrackEnabled == true)
-                    {
-                        pthread_t id = WriteRestrackSnapshot(config, writer->Type);
-                        if (id == 0)
-                        {
-                            SetQuit(config, 1);
-                        }
-                        else
-                        {
-                            leakReportThreads.push_back(id);
-                        }
-                    }
-#endif                    
-
-                    if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
-                    {
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                Log(error, "An error occurred while parsing procfs\n");
-                exit(-1);
-            }
-        }
-    }
-
-    //
-    // Wait for the leak reporting threads to finish
-    //
-    WaitThreads(leakReportThreads);
-
-    Trace("ThreadCountMonitoringThread: Exit [id=%d]", gettid());
-    return NULL;
-}
-
-
-//--------------------------------------------------------------------
-//
-// FileDescriptorCountMonitoringThread - Thread monitoring for file
-// descriptor count
-//
-//--------------------------------------------------------------------
-void* FileDescriptorCountMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
-{
-    Trace("FileDescriptorCountMonitoringThread: Enter [id=%d]", gettid());
-    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
-
-    struct ProcessStat proc = {0};
-    int rc = 0;
-    auto_free struct CoreDumpWriter *writer = NULL;
-    auto_free char* dumpFileName = NULL;
-    std::vector<pthread_t> leakReportThreads;
-
-    writer = NewCoreDumpWriter(FILEDESC, config);
-
-    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
-    {
-        while ((rc = WaitForQuit(config, config->PollingInterval)) == WAIT_TIMEOUT)
-        {
-            if (GetProcessStat(config->ProcessId, &proc))
-            {
-                if (proc.num_filedescriptors >= config->FileDescriptorThreshold)
-                {
-                    if(config->bRestrackGenerateDump == true)
-                    {
-                        // Only generate core dump if user did not specify the "nodump" restrack option
-                        dumpFileName = WriteCoreDump(writer);
-                        if(dumpFileName == NULL)
-                        {
-                            SetQuit(config, 1);
-                        }
-                    }
-
-                    //
-                    // Check to see if restrack is specified, if so, save current resource usage to file.
-                    //
-#ifdef __linux__                    
-                    if(config->bRestrackEnabled == true)
-                    {
-                        pthread_t id = WriteRestrackSnapshot(config, writer->Type);
-                        if (id == 0)
-                        {
-                            SetQuit(config, 1);
-                        }
-                        else
-                        {
-                            leakReportThreads.push_back(id);
-                        }
-                    }
-#endif                    
-
-                    if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
-                    {
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                Log(error, "An error occurred while parsing procfs\n");
-                exit(-1);
-            }
-        }
-    }
-
-    //
-    // Wait for the leak reporting threads to finish
-    //
-    WaitThreads(leakReportThreads);
-    Trace("FileDescriptorCountMonitoringThread: Exit [id=%d]", gettid());
-    return NULL;
-}
-
 //
 // This thread monitors for a specific signal to be sent to target process.
 // It uses ptrace (PTRACE_SEIZE) and once the signal with the corresponding
@@ -1335,162 +1114,6 @@ void* SignalMonitoringThread(void *thread_args /* struct ProcDumpConfiguration*
     return NULL;
 }
 
-//--------------------------------------------------------------------
-//
-// CpuMonitoringThread - Thread monitoring for CPU usage.
-//
-//--------------------------------------------------------------------
-void *CpuMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
-{
-    Trace("CpuMonitoringThread: Enter [id=%d]", gettid());
-    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
-
-    int cpuUsage;
-    auto_free struct CoreDumpWriter *writer = NULL;
-    auto_free char* dumpFileName = NULL;
-#ifdef __linux__
-    std::vector<pthread_t> leakReportThreads;
-#endif
-
-    writer = NewCoreDumpWriter(CPU, config);
-
-    int rc = 0;
-    struct ProcessStat proc = {0};
-
-    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
-    {
-        while ((rc = WaitForQuit(config, config->PollingInterval)) == WAIT_TIMEOUT)
-        {
-            if (GetProcessStat(config->ProcessId, &proc))
-            {
-                cpuUsage = GetCpuUsage(config->ProcessId);
-                Trace("CpuMonitoringThread: CPU usage:%d%% on process ID: %d", cpuUsage, config->ProcessId);
-
-                // CPU Trigger
-                if ((config->bCpuTriggerBelowValue && (cpuUsage < config->CpuThreshold)) ||
-                    (!config->bCpuTriggerBelowValue && (cpuUsage >= config->CpuThreshold)))
-                {
-                    Log(info, "Trigger: CPU usage:%d%% on process ID: %d", cpuUsage, config->ProcessId);
-                    if(config->bRestrackGenerateDump == true)
-                    {
-                        // Only generate core dump if user did not specify the "nodump" restrack option
-                        dumpFileName = WriteCoreDump(writer);
-                        if(dumpFileName == NULL)
-                        {
-                            SetQuit(config, 1);
-                        }
-                    }
-
-                    //
-                    // Check to see if restrack is specified, if so, save current resource usage to file.
-                    //
-#ifdef __linux__                    
-                    if(config->bRestrackEnabled == true)
-                    {
-                        pthread_t id = WriteRestrackSnapshot(config, writer->Type);
-                        if (id == 0)
-                        {
-                            SetQuit(config, 1);
-                        }
-                        else
-                        {
-                            leakReportThreads.push_back(id);
-                        }
-                    }
-#endif                    
-
-                    if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
-                    {
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                Log(error, "An error occurred while parsing procfs\n");
-                exit(-1);
-            }
-        }
-    }
-
-    //
-    // Wait for the leak reporting threads to finish
-    //
-#ifdef __linux__    
-    WaitThreads(leakReportThreads);
-#endif
-
-    Trace("CpuMonitoringThread: Exit [id=%d]", gettid());
-    return NULL;
-}
-
-//--------------------------------------------------------------------
-//
-// TimerThread - Thread that creates dumps based on specified timer
-// interval.
-//
-//--------------------------------------------------------------------
-void *TimerThread(void *thread_args /* struct ProcDumpConfiguration* */)
-{
-    Trace("TimerThread: Enter [id=%d]", gettid());
-
-    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
-    auto_free struct CoreDumpWriter *writer = NULL;
-    auto_free char* dumpFileName = NULL;
-    std::vector<pthread_t> leakReportThreads;
-
-    writer = NewCoreDumpWriter(TIME, config);
-
-    int rc = 0;
-
-    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
-    {
-        while ((rc = WaitForQuit(config, 0)) == WAIT_TIMEOUT)
-        {
-            Log(info, "Trigger: Timer:%ld(s) on process ID: %d", config->PollingInterval/1000, config->ProcessId);
-            if(config->bRestrackGenerateDump == true)
-            {
-                // Only generate core dump if user did not specify the "nodump" restrack option
-                dumpFileName = WriteCoreDump(writer);
-                if(dumpFileName == NULL)
-                {
-                    SetQuit(config, 1);
-                }
-            }
-
-            //
-            // Check to see if restrack is specified, if so, save current resource usage to file.
-            //
-#ifdef __linux__            
-            if(config->bRestrackEnabled == true)
-            {
-                pthread_t id = WriteRestrackSnapshot(config, writer->Type);
-                if (id == 0)
-                {
-                    SetQuit(config, 1);
-                }
-                else
-                {
-                    leakReportThreads.push_back(id);
-                }
-            }
-#endif            
-
-            if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT) {
-                break;
-            }
-        }
-    }
-
-    //
-    // Wait for the leak reporting threads to finish
-    //
-    WaitThreads(leakReportThreads);
-
-    Trace("TimerThread: Exit [id=%d]", gettid());
-    return NULL;
-}
-
 //--------------------------------------------------------------------
 //
 // DotNetMonitoringThread - Thread that creates dumps based on
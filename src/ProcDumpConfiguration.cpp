@@ -7,6 +7,9 @@
 //
 //--------------------------------------------------------------------
 #include "Includes.h"
+#ifdef __linux__
+#include "corex/corex.h"
+#endif
 
 #include <math.h>
 
@@ -38,13 +41,18 @@ void ApplyDefaults(struct ProcDumpConfiguration *self)
 
     if(self->PollingInterval == -1)
     {
-        self->PollingInterval = MIN_POLLING_INTERVAL;
+        self->PollingInterval = DEFAULT_POLLING_INTERVAL;
     }
 
     if(self->SampleRate == 0)
     {
         self->SampleRate = DEFAULT_SAMPLE_RATE;
     }
+
+    if(self->DumpThreads == -1)
+    {
+        self->DumpThreads = DEFAULT_DUMP_THREADS;
+    }
 }
 
 //--------------------------------------------------------------------
@@ -171,6 +179,8 @@ void InitProcDumpConfiguration(struct ProcDumpConfiguration *self)
     self->NumberOfDumpsToCollect =      -1;
     self->CpuThreshold =                -1;
     self->bCpuTriggerBelowValue =       false;
+    self->ThreadCpuThreshold =          -1;
+    self->ThreadCpuSamples =            1;
     self->MemoryThreshold =             NULL;
     self->MemoryThresholdCount =        -1;
     self->MemoryCurrentThreshold =      0;
@@ -199,6 +209,22 @@ void InitProcDumpConfiguration(struct ProcDumpConfiguration *self)
     self->bLeakReportInProgress =       false;
     self->SampleRate =                  0;
     self->CoreDumpMask =                -1;
+    self->DumpThreads =                 -1;
+    self->bDirectIO =                   false;
+    self->bLiveDump =                   false;
+    self->bForkDump =                   false;
+    self->bDiffDump =                   false;
+    self->bFreezeDump =                 false;
+    self->bCompressDump =               false;
+    self->StreamTarget =                NULL;
+    self->MaxDumpSizeMB =               -1;
+    self->bStacksDump =                 false;
+    self->bDumpStats =                  false;
+    self->CoreHandlerSignal =           -1;
+    self->MinFreeDiskMB =               -1;
+    self->DiffBaseDump =                NULL;
+    self->RebuildDumpPath =             NULL;
+    self->RebuildOutputPath =           NULL;
 #ifdef __linux__
     self->bUseGcore =                   false;
 #else
@@ -287,6 +313,30 @@ void FreeProcDumpConfiguration(struct ProcDumpConfiguration *self)
         self->ExcludeFilter = NULL;
     }
 
+    if(self->DiffBaseDump)
+    {
+        free(self->DiffBaseDump);
+        self->DiffBaseDump = NULL;
+    }
+
+    if(self->StreamTarget)
+    {
+        free(self->StreamTarget);
+        self->StreamTarget = NULL;
+    }
+
+    if(self->RebuildDumpPath)
+    {
+        free(self->RebuildDumpPath);
+        self->RebuildDumpPath = NULL;
+    }
+
+    if(self->RebuildOutputPath)
+    {
+        free(self->RebuildOutputPath);
+        self->RebuildOutputPath = NULL;
+    }
+
     if(self->CoreDumpPath)
     {
         free(self->CoreDumpPath);
@@ -377,6 +427,8 @@ struct ProcDumpConfiguration * CopyProcDumpConfiguration(struct ProcDumpConfigur
         // copy options from original config
         copy->CpuThreshold = self->CpuThreshold;
         copy->bCpuTriggerBelowValue = self->bCpuTriggerBelowValue;
+        copy->ThreadCpuThreshold = self->ThreadCpuThreshold;
+        copy->ThreadCpuSamples = self->ThreadCpuSamples;
         if(self->MemoryThreshold != NULL)
         {
             copy->NumberOfDumpsToCollect = self->NumberOfDumpsToCollect;
@@ -402,6 +454,22 @@ struct ProcDumpConfiguration * CopyProcDumpConfiguration(struct ProcDumpConfigur
         copy->SampleRate = self->SampleRate;
         copy->CoreDumpMask = self->CoreDumpMask;
         copy->bUseGcore = self->bUseGcore;
+        copy->DumpThreads = self->DumpThreads;
+        copy->bDirectIO = self->bDirectIO;
+        copy->bLiveDump = self->bLiveDump;
+        copy->bForkDump = self->bForkDump;
+        copy->bDiffDump = self->bDiffDump;
+        copy->bFreezeDump = self->bFreezeDump;
+        copy->bCompressDump = self->bCompressDump;
+        copy->StreamTarget = self->StreamTarget == NULL ? NULL : strdup(self->StreamTarget);
+        copy->MaxDumpSizeMB = self->MaxDumpSizeMB;
+        copy->bStacksDump = self->bStacksDump;
+        copy->bDumpStats = self->bDumpStats;
+        copy->CoreHandlerSignal = self->CoreHandlerSignal;
+        copy->MinFreeDiskMB = self->MinFreeDiskMB;
+        copy->DiffBaseDump = NULL;      // each process gets its own series
+        copy->RebuildDumpPath = NULL;
+        copy->RebuildOutputPath = NULL;
         copy->bOverwriteExisting = self->bOverwriteExisting;
         copy->bMemoryTriggerBelowValue = self->bMemoryTriggerBelowValue;
         copy->MemoryThresholdCount = self->MemoryThresholdCount;
@@ -540,6 +608,30 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
             i++;
         }
 #ifdef __linux__
+        else if( 0 == strcasecmp( argv[i], "/ct" ) ||
+                    0 == strcasecmp( argv[i], "-ct" ))
+        {
+            int count = 0;
+
+            if( i+1 >= argc || self->ThreadCpuThreshold != -1 ) return PrintUsage();
+            auto_free int* values = GetSeparatedValues(argv[i+1], const_cast<char*>(","), &count);
+            if(values == NULL || count > 2) return PrintUsage();
+
+            self->ThreadCpuThreshold = values[0];
+            if(count == 2)
+            {
+                self->ThreadCpuSamples = values[1];
+            }
+
+            // A thread cannot use more than one CPU
+            if(self->ThreadCpuThreshold < 1 || self->ThreadCpuThreshold > 100 || self->ThreadCpuSamples < 1)
+            {
+                Log(error, "Invalid thread CPU threshold or sample count specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
         else if( 0 == strcasecmp( argv[i], "/gcm" ) ||
                     0 == strcasecmp( argv[i], "-gcm" ))
         {
@@ -703,6 +795,138 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
 
             i++;
         }
+        else if( 0 == strcasecmp( argv[i], "/dt" ) ||
+                    0 == strcasecmp( argv[i], "-dt" ))
+        {
+            if( i+1 >= argc || self->DumpThreads != -1 ) return PrintUsage();
+            if(!ConvertToInt(argv[i+1], &self->DumpThreads)) return PrintUsage();
+            if(self->DumpThreads < 1 || self->DumpThreads > COREX_MAX_WRITERS)
+            {
+                Log(error, "Invalid number of dump threads specified (1-%d).", COREX_MAX_WRITERS);
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/dio" ) ||
+                    0 == strcasecmp( argv[i], "-dio" ))
+        {
+            self->bDirectIO = true;
+        }
+        else if( 0 == strcasecmp( argv[i], "/live" ) ||
+                    0 == strcasecmp( argv[i], "-live" ))
+        {
+            self->bLiveDump = true;
+        }
+        else if( 0 == strcasecmp( argv[i], "/fork" ) ||
+                    0 == strcasecmp( argv[i], "-fork" ))
+        {
+            self->bForkDump = true;
+        }
+        else if( 0 == strcasecmp( argv[i], "/diff" ) ||
+                    0 == strcasecmp( argv[i], "-diff" ))
+        {
+            self->bDiffDump = true;
+        }
+        else if( 0 == strcasecmp( argv[i], "/freeze" ) ||
+                    0 == strcasecmp( argv[i], "-freeze" ))
+        {
+            self->bFreezeDump = true;
+        }
+        else if( 0 == strcasecmp( argv[i], "/compress" ) ||
+                    0 == strcasecmp( argv[i], "-compress" ))
+        {
+            self->bCompressDump = true;
+        }
+        else if( 0 == strcasecmp( argv[i], "/stream" ) ||
+                    0 == strcasecmp( argv[i], "-stream" ))
+        {
+            if( i+1 >= argc || self->StreamTarget ) return PrintUsage();
+
+            // Dumps are written to a reader at the other end, never to a file
+            struct stat streamStat;
+            if(stat(argv[i+1], &streamStat) != 0 || !(S_ISFIFO(streamStat.st_mode) || S_ISSOCK(streamStat.st_mode)))
+            {
+                Log(error, "The -stream target %s is not a FIFO or Unix socket.", argv[i+1]);
+                return PrintUsage();
+            }
+
+            self->StreamTarget = strdup(argv[i+1]);
+            if(self->StreamTarget == NULL)
+            {
+                Log(error, INTERNAL_ERROR);
+                Trace("GetOptions: failed to strdup StreamTarget");
+                return -1;
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/maxsize" ) ||
+                    0 == strcasecmp( argv[i], "-maxsize" ))
+        {
+            if( i+1 >= argc || self->MaxDumpSizeMB != -1 ) return PrintUsage();
+            if(!ConvertToInt(argv[i+1], &self->MaxDumpSizeMB)) return PrintUsage();
+            if(self->MaxDumpSizeMB < 1)
+            {
+                Log(error, "Invalid maximum dump size specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/stacks" ) ||
+                    0 == strcasecmp( argv[i], "-stacks" ))
+        {
+            self->bStacksDump = true;
+        }
+        else if( 0 == strcasecmp( argv[i], "/stats" ) ||
+                    0 == strcasecmp( argv[i], "-stats" ))
+        {
+            self->bDumpStats = true;
+        }
+        else if( 0 == strcasecmp( argv[i], "/core-handler" ) ||
+                    0 == strcasecmp( argv[i], "-core-handler" ) ||
+                    0 == strcasecmp( argv[i], "--core-handler" ))
+        {
+            // Run by the kernel as a core_pattern pipe handler: PID and signal
+            // come first, options and the dump folder or name follow
+            if( i != 1 || i+2 >= argc ) return PrintUsage();
+            if( !sscanf( argv[i+1], "%d", &self->ProcessId ) || self->ProcessId <= 0 ) return PrintUsage();
+            if(!ConvertToInt(argv[i+2], &self->CoreHandlerSignal) || self->CoreHandlerSignal < 0) return PrintUsage();
+
+            bProcessSpecified = true;
+            i += 2;
+        }
+        else if( 0 == strcasecmp( argv[i], "/minfree" ) ||
+                    0 == strcasecmp( argv[i], "-minfree" ))
+        {
+            if( i+1 >= argc || self->MinFreeDiskMB != -1 ) return PrintUsage();
+            if(!ConvertToInt(argv[i+1], &self->MinFreeDiskMB)) return PrintUsage();
+            if(self->MinFreeDiskMB < 0)
+            {
+                Log(error, "Invalid minimum free disk space specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/rebuild" ) ||
+                    0 == strcasecmp( argv[i], "-rebuild" ))
+        {
+            // Standalone operation, no process is monitored
+            if( i != 1 || argc != 4 ) return PrintUsage();
+
+            self->RebuildDumpPath = strdup(argv[2]);
+            self->RebuildOutputPath = strdup(argv[3]);
+            if(self->RebuildDumpPath == NULL || self->RebuildOutputPath == NULL)
+            {
+                Log(error, INTERNAL_ERROR);
+                Trace("GetOptions: failed to strdup rebuild paths");
+                return -1;
+            }
+
+            return 0;
+        }
         else if( 0 == strcasecmp( argv[i], "/pc" ) ||
                     0 == strcasecmp( argv[i], "-pc" ) ||
                     0 == strcasecmp( argv[i], "/pcl" ) ||
@@ -821,9 +1045,9 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
         {
             if( i+1 >= argc || self->PollingInterval != -1 ) return PrintUsage();
             if(!ConvertToInt(argv[i+1], &self->PollingInterval)) return PrintUsage();
-            if(self->PollingInterval < 0)
+            if(self->PollingInterval < MIN_POLLING_INTERVAL)
             {
-                Log(error, "Invalid polling inverval specified.");
+                Log(error, "Invalid polling interval specified (minimum is %d ms).", MIN_POLLING_INTERVAL);
                 return PrintUsage();
             }
 
@@ -1084,6 +1308,49 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
         Log(error, "Only one .NET trigger can be specified.");
         return PrintUsage();
     }
+
+    // Live dumps write the core their own way
+    if(self->bLiveDump && (self->bForkDump || self->bDiffDump))
+    {
+        Log(error, "The -live switch cannot be combined with -fork or -diff.");
+        return PrintUsage();
+    }
+
+    // Compressed dumps are written in one pass of their own
+    if(self->bCompressDump && (self->bLiveDump || self->bDiffDump))
+    {
+        Log(error, "The -compress switch cannot be combined with -live or -diff.");
+        return PrintUsage();
+    }
+
+    // Live and differential dumps need a regular file
+    if(self->StreamTarget && (self->bLiveDump || self->bDiffDump))
+    {
+        Log(error, "The -stream switch cannot be combined with -live or -diff.");
+        return PrintUsage();
+    }
+
+    // Live dumps copy memory before the mappings to keep are chosen
+    if((self->MaxDumpSizeMB != -1 || self->bStacksDump) && self->bLiveDump)
+    {
+        Log(error, "The -maxsize and -stacks switches cannot be combined with -live.");
+        return PrintUsage();
+    }
+
+    // A crashed process is gone, only the core the kernel pipes in is left
+    if(self->CoreHandlerSignal != -1 &&
+        (self->bLiveDump || self->bForkDump || self->bDiffDump || self->bFreezeDump || self->bStacksDump ||
+         self->bProcessGroup || self->WaitingForProcessName || self->bUseGcore))
+    {
+        Log(error, "The --core-handler switch cannot be combined with -live, -fork, -diff, -freeze, -stacks, -pgid or -w.");
+        return PrintUsage();
+    }
+
+    if(self->MinFreeDiskMB != -1 && self->CoreHandlerSignal == -1)
+    {
+        Log(error, "Please use the --core-handler switch when specifying a minimum of free disk space (-minfree)");
+        return PrintUsage();
+    }
 #endif
 
     // Ensure consistency between number of thresholds specified and the -n switch
@@ -1149,6 +1416,7 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
     // If number of dumps to collect is set, but there is no other criteria, enable Timer here...
     if ((self->bTimerThreshold == false) &&
         (self->CpuThreshold == -1) &&
+        (self->ThreadCpuThreshold == -1) &&
         (self->MemoryThreshold == NULL) &&
         (self->ThreadThreshold == -1) &&
         (self->FileDescriptorThreshold == -1) &&
@@ -1164,7 +1432,7 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
     // Signal trigger can only be specified alone
     if(self->SignalCount > 0 || self->bDumpOnException)
     {
-        if(self->CpuThreshold != -1 || self->ThreadThreshold != -1 || self->FileDescriptorThreshold != -1 || self->MemoryThreshold != NULL || self->PerfCounterTriggerCount > 0)
+        if(self->CpuThreshold != -1 || self->ThreadCpuThreshold != -1 || self->ThreadThreshold != -1 || self->FileDescriptorThreshold != -1 || self->MemoryThreshold != NULL || self->PerfCounterTriggerCount > 0)
         {
             Log(error, "Signal/Exception trigger must be the only trigger specified.");
             return PrintUsage();
@@ -1188,7 +1456,7 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
     }
 
     // Except for .NET triggers, Perf counter triggers and Restrack with 'nodump' option, all other triggers use gdb/gcore
-    if(dotnetTriggerCount == 0 && self->PerfCounterTriggerCount == 0 && !(self->bRestrackEnabled && !self->bRestrackGenerateDump)){
+    if(self->CoreHandlerSignal == -1 && dotnetTriggerCount == 0 && self->PerfCounterTriggerCount == 0 && !(self->bRestrackEnabled && !self->bRestrackGenerateDump)){
         if(!isBinaryOnPath("gcore")){
             Log(error, "failed to locate gcore binary in $PATH. Check that gdb/gcore is installed and configured on your system.");
             return -1;
@@ -1246,6 +1514,18 @@ bool PrintConfiguration(struct ProcDumpConfiguration *self)
             printf("%-40s%s\n", "CPU Threshold:", "n/a");
         }
 
+#ifdef __linux__
+        // Thread CPU
+        if (self->ThreadCpuThreshold != -1)
+        {
+            printf("%-40s>= %d%% for %d sample(s)\n", "Thread CPU Threshold:", self->ThreadCpuThreshold, self->ThreadCpuSamples);
+        }
+        else
+        {
+            printf("%-40s%s\n", "Thread CPU Threshold:", "n/a");
+        }
+#endif
+
         // Memory
         if (self->MemoryThreshold != NULL)
         {
@@ -1403,6 +1683,28 @@ bool PrintConfiguration(struct ProcDumpConfiguration *self)
         {
             printf("%-40s%s\n", "Exclude filter:", self->ExcludeFilter);
         }
+        // Dump writer threads
+        if (!self->bUseGcore)
+        {
+            printf("%-40s%d\n", "Dump threads:", self->DumpThreads);
+            printf("%-40s%s\n", "Direct I/O:", self->bDirectIO ? "On" : "n/a");
+            printf("%-40s%s\n", "Live dump:", self->bLiveDump ? "On" : "n/a");
+            printf("%-40s%s\n", "Fork dump:", self->bForkDump ? "On" : "n/a");
+            printf("%-40s%s\n", "Differential dumps:", self->bDiffDump ? "On" : "n/a");
+            printf("%-40s%s\n", "Cgroup freeze:", self->bFreezeDump ? "On" : "n/a");
+            printf("%-40s%s\n", "Compressed dump:", self->bCompressDump ? "On" : "n/a");
+            printf("%-40s%s\n", "Stream to:", self->StreamTarget ? self->StreamTarget : "n/a");
+            if (self->MaxDumpSizeMB != -1)
+            {
+                printf("%-40s%d\n", "Maximum dump size (MB):", self->MaxDumpSizeMB);
+            }
+            else
+            {
+                printf("%-40s%s\n", "Maximum dump size (MB):", "n/a");
+            }
+            printf("%-40s%s\n", "Stacks only:", self->bStacksDump ? "On" : "n/a");
+            printf("%-40s%s\n", "Dump statistics:", self->bDumpStats ? "On" : "n/a");
+        }
 #endif
 
         // Polling inverval
@@ -1456,6 +1758,9 @@ int PrintUsage()
     printf("   procdump [-n Count]\n");
     printf("            [-s Seconds]\n");
     printf("            [-c|-cl CPU_Usage]\n");
+#ifdef __linux__
+    printf("            [-ct Thread_CPU_Usage[,Samples]]\n");
+#endif
     printf("            [-m|-ml Commit_Usage1[,Commit_Usage2...]]\n");
     printf("            [-tc Thread_Threshold]\n");
     printf("            [-fc FileDescriptor_Threshold]\n");
@@ -1470,6 +1775,17 @@ int PrintUsage()
     printf("            [-f Include_Filter,...]\n");
     printf("            [-fx Exclude_Filter]\n");
     printf("            [-mc Custom_Dump_Mask]\n");
+    printf("            [-dt Dump_Threads]\n");
+    printf("            [-dio]\n");
+    printf("            [-live]\n");
+    printf("            [-fork]\n");
+    printf("            [-diff]\n");
+    printf("            [-freeze]\n");
+    printf("            [-compress]\n");
+    printf("            [-stream FIFO_or_Socket]\n");
+    printf("            [-maxsize Max_Dump_Size_MB]\n");
+    printf("            [-stacks]\n");
+    printf("            [-stats]\n");
 #endif
     printf("            [-pf Polling_Frequency]\n");
     printf("            [-o]\n");
@@ -1481,12 +1797,21 @@ int PrintUsage()
     printf("             {{[-w] Process_Name | PID} [Dump_File | Dump_Folder]}\n");
 #endif
     printf("            }\n");
+#ifdef __linux__
+    printf("\nRebuild Usage: \n");
+    printf("   procdump -rebuild Differential_Dump_File Output_File\n");
+    printf("\nCore Handler Usage: \n");
+    printf("   procdump --core-handler PID Signal [-n Dumps_To_Keep] [-minfree Min_Free_MB] [-maxsize Max_Dump_Size_MB] [-compress] [-stream FIFO_or_Socket] [-stats] [-o] [Dump_File | Dump_Folder]\n");
+#endif
     printf("\n");
     printf("Options:\n");
     printf("   -n      Number of dumps to write before exiting.\n");
     printf("   -s      Consecutive seconds before dump is written (default is 10).\n");
     printf("   -c      CPU threshold above which to create a dump of the process.\n");
     printf("   -cl     CPU threshold below which to create a dump of the process.\n");
+#ifdef __linux__
+    printf("   -ct     CPU threshold (1 to 100) above which a single thread has to stay for the given number of samples (default is 1) to create a dump of the process. The hot thread is the first thread of the dump.\n");
+#endif
     printf("   -tc     Thread count threshold above which to create a dump of the process.\n");
     printf("   -fc     File descriptor count threshold above which to create a dump of the process.\n");
 #ifdef __linux__
@@ -1505,9 +1830,23 @@ int PrintUsage()
     printf("   -f      Filter (include) on the content of .NET exceptions (comma separated). Wildcards (*) are supported.\n");
     printf("   -fx     Filter (exclude) on the content of -restrack call stacks. Wildcards (*) are supported.\n");
     printf("   -mc     Custom core dump mask (in hex) indicating what memory should be included in the core dump. Please see 'man core' (/proc/[pid]/coredump_filter) for available options.\n");
+    printf("   -dt     Number of threads used to write the core dump in parallel (default is 1, max %d).\n", COREX_MAX_WRITERS);
+    printf("   -dio    Write the core dump with direct I/O, bypassing the page cache.\n");
+    printf("   -live   Copy memory while the process keeps running and only pause it for the final changes (requires soft-dirty page tracking).\n");
+    printf("   -fork   Dump a copy-on-write fork of the process so it is only paused for the fork itself. Mappings a fork does not copy (MADV_DONTFORK, MADV_WIPEONFORK) are left out of the dump.\n");
+    printf("   -diff   Write every dump after the first as the pages changed since the first one (see -rebuild).\n");
+    printf("   -freeze Stop the process by freezing its cgroup (v2), pausing all its threads at once (and any other process in the cgroup).\n");
+    printf("   -compress Write the dump as a seekable compressed core (.cxz), readable in place or expanded with -rebuild.\n");
+    printf("   -stream Write dumps to a FIFO or Unix socket (e.g. a collector) instead of a file, connecting anew for each dump.\n");
+    printf("   -maxsize Largest core dump to write (MB). Thread stacks, global data and ELF headers are kept before the heap and other memory; what does not fit is left out and listed in the dump.\n");
+    printf("   -stacks Only dump thread stacks, registers, global data and ELF headers: enough for the backtraces of all threads, at a fraction of the size and time.\n");
+    printf("   -stats  Log how long each step of a dump took, the bytes read, skipped and written and the throughput, and write them to <dump>.stats.json.\n");
+    printf("   --core-handler Run as the kernel's core_pattern pipe handler: copy the core of the crashed process from standard input, keeping at most -n dumps per process (default is 1).\n");
+    printf("   -minfree Free disk space (MB) that --core-handler leaves on the dump folder's file system (default is 10%% of it).\n");
+    printf("   -rebuild Turn a dump written with -diff or -compress back into a standalone core dump (for -diff, the first dump must still exist).\n");
     printf("   -pgid   Process ID specified refers to a process group ID.\n");
 #endif
-    printf("   -pf     Polling frequency.\n");
+    printf("   -pf     Polling frequency in milliseconds (default is %d, minimum is %d).\n", DEFAULT_POLLING_INTERVAL, MIN_POLLING_INTERVAL);
     printf("   -o      Overwrite existing dump file.\n");
     printf("   -log    Writes extended ProcDump tracing to the specified output stream (syslog or stdout).\n");
     printf("   -w      Wait for the specified process to launch if it's not running.\n");
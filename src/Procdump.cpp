@@ -33,6 +33,15 @@ void OnExit()
 //--------------------------------------------------------------------
 int main(int argc, char *argv[])
 {
+    // A core_pattern handler starts with only its standard input open;
+    // keep the dump file from being opened as standard output
+    int fd;
+    while ((fd = open("/dev/null", O_RDWR)) >= 0 && fd <= STDERR_FILENO);
+    if (fd > STDERR_FILENO)
+    {
+        close(fd);
+    }
+
     // print banner and begin initialization
     PrintBanner();
     InitProcDump();
@@ -43,6 +52,20 @@ int main(int argc, char *argv[])
         exit(-1);
     }
 
+#ifdef __linux__
+    // -rebuild converts a -diff core dump and does not monitor anything
+    if (g_config.RebuildDumpPath != NULL)
+    {
+        exit(RebuildCoreDump(&g_config));
+    }
+
+    // --core-handler copies the core the kernel pipes in and exits
+    if (g_config.CoreHandlerSignal != -1)
+    {
+        exit(HandleCoreDump(&g_config));
+    }
+#endif
+
     // Register exit handler
     atexit(OnExit);
 
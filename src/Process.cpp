@@ -22,53 +22,31 @@ extern long HZ;
 
 //--------------------------------------------------------------------
 //
-// GetUids - Gets the process uids for the given pid
+// GetNumFileDescriptors - Gets the number of open file descriptors for
+// the given pid
 //
 //--------------------------------------------------------------------
-bool GetUids(pid_t pid, struct ProcessStat* proc)
+bool GetNumFileDescriptors(pid_t pid, struct ProcessStat* proc)
 {
+#ifdef __linux__
+    auto_free_dir DIR* fddir = NULL;
+    struct dirent* entry = NULL;
+    struct stat fdStat;
+    char procFilePath[32];
 
-    std::ostringstream path;
-    path << "/proc/" << pid << "/status";
-
-    std::ifstream statusFile(path.str());
-    if (!statusFile.is_open())
+    // Since Linux 6.2 the size of /proc/[pid]/fd is the number of open file
+    // descriptors, which saves walking the directory. Older kernels report 0.
+    if(sprintf(procFilePath, "/proc/%d/fd", pid) < 0)
     {
-        Log(error, "Failed to open status file for pid: %d", pid);
         return false;
     }
 
-    std::string line;
-    while (std::getline(statusFile, line))
+    if(stat(procFilePath, &fdStat) == 0 && fdStat.st_size > 0)
     {
-        if (line.find("Uid:") == 0)
-        {
-            std::istringstream iss(line);
-            std::string uidTag, realUid, effectiveUid, savedUid, fsUid;
-            iss >> uidTag >> realUid >> effectiveUid >> savedUid >> fsUid;
-            proc->real_uid = std::stoi(realUid);
-            proc->effective_uid = std::stoi(effectiveUid);
-            proc->saved_uid = std::stoi(savedUid);
-            proc->fs_uid = std::stoi(fsUid);
-            return true;
-        }
+        proc->num_filedescriptors = (int)fdStat.st_size;
+        return true;
     }
 
-    return false;
-}
-
-//--------------------------------------------------------------------
-//
-// GetNumFileDescriptors - Gets the process stats for the given pid
-//
-//--------------------------------------------------------------------
-bool GetNumFileDescriptors(pid_t pid, struct ProcessStat* proc)
-{
-#ifdef __linux__
-    auto_free_dir DIR* fddir = NULL;
-    struct dirent* entry = NULL;
-    char procFilePath[32];
-
     if(sprintf(procFilePath, "/proc/%d/fdinfo", pid) < 0)
     {
         return false;
@@ -140,521 +118,415 @@ bool GetTaskInfo(struct proc_taskallinfo* taskInfo, pid_t pid)
 // GetProcessStat - Gets the process stats for the given pid
 //
 //--------------------------------------------------------------------
-bool GetProcessStat(pid_t pid, struct ProcessStat *proc) {
+bool GetProcessStat(pid_t pid, struct ProcessStat *proc)
+{
+    return GetProcessStatEx(pid, proc, PROCESS_STAT_ALL);
+}
+
 #ifdef __linux__
-    char procFilePath[32];
-    char fileBuffer[1024];
-    char *token;
-    char *savePtr = NULL;
+//--------------------------------------------------------------------
+//
+// InitProcessReader - Prepares a reader for the given pid. The /proc
+// files are opened on first use and stay open until CloseProcessReader.
+//
+//--------------------------------------------------------------------
+void InitProcessReader(struct ProcessReader *reader, pid_t pid)
+{
+    reader->pid = pid;
+    reader->starttime = 0;
+    reader->statFd = -1;
+    reader->statusFd = -1;
+    reader->fdDirFd = -1;
+    reader->taskDir = NULL;
+}
 
-    auto_free_file FILE *procFile = NULL;
+//--------------------------------------------------------------------
+//
+// CloseProcessReader - Closes the /proc files held by the reader
+//
+//--------------------------------------------------------------------
+void CloseProcessReader(struct ProcessReader *reader)
+{
+    if(reader->statFd != -1) close(reader->statFd);
+    if(reader->statusFd != -1) close(reader->statusFd);
+    if(reader->fdDirFd != -1) close(reader->fdDirFd);
+    if(reader->taskDir != NULL) closedir(reader->taskDir);
+
+    reader->statFd = -1;
+    reader->statusFd = -1;
+    reader->fdDirFd = -1;
+    reader->taskDir = NULL;
+}
 
-    // Get UID's in /proc/%d/status
-    if(GetUids(pid, proc) == false)
-    {
-        Log(error, "Failed to get UID's");
-        return false;
-    }
-#endif
+//--------------------------------------------------------------------
+//
+// OpenProcFile - Opens /proc/[pid]/[name] into *fd unless it is open.
+// A process that does not exist fails with ESRCH.
+//
+//--------------------------------------------------------------------
+static bool OpenProcFile(int *fd, pid_t pid, const char *name, int flags)
+{
+    char path[64];
 
-#ifdef __APPLE__
-    struct proc_taskallinfo taskInfo;
-    if(GetTaskInfo(&taskInfo, pid) == false)
+    if(*fd != -1)
     {
-        return false;
+        return true;
     }
-#endif
 
-    // Get number of file descriptors in /proc/%d/fdinfo. This directory only contains sub directories for each file descriptor.
-    if(GetNumFileDescriptors(pid, proc) == false)
+    snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+    if((*fd = open(path, flags | O_CLOEXEC)) == -1)
     {
-        Log(error, "Failed to get number of file descriptors");
-        return false;
-    }
-
-#ifdef __linux__
-    // Read /proc/[pid]/stat
-    if(sprintf(procFilePath, "/proc/%d/stat", pid) < 0){
-        return false;
-    }
-    procFile = fopen(procFilePath, "r");
-
-    if(procFile != NULL){
-        if(fgets(fileBuffer, sizeof(fileBuffer), procFile) == NULL) {
-            Log(error, "Failed to read from %s. Exiting...", procFilePath);
-            return false;
-        }
-    }
-    else{
-        Log(error, "Failed to open %s.", procFilePath);
+        if(errno == ENOENT) errno = ESRCH;
+        Trace("OpenProcFile: failed to open %s [%s]", path, strerror(errno));
         return false;
     }
 
-    // (1) process ID
-    proc->pid = (pid_t)atoi(fileBuffer);
+    return true;
+}
 
-    // (3) process state
-    if((savePtr = strrchr(fileBuffer, ')')) != NULL){
-        savePtr += 2;     // iterate past ')' and ' ' in /proc/[pid]/stat
-        proc->state = strtok_r(savePtr, " ", &savePtr)[0];
-    }
+//--------------------------------------------------------------------
+//
+// ReadProcFile - Reads an open /proc file from offset 0 into buffer and
+// NUL terminates it. Once the process has exited this fails with ESRCH.
+//
+//--------------------------------------------------------------------
+static bool ReadProcFile(int fd, char *buffer, size_t size)
+{
+    ssize_t len = pread(fd, buffer, size - 1, 0);
 
-    // (4) parent process ID
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - Parent PID.");
+    if(len < 0)
+    {
         return false;
     }
 
-    proc->ppid = (pid_t)strtol(token, NULL, 10);
-
-    // (5) process group ID
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - Process group ID.");
-        return false;
-    }
+    buffer[len] = '\0';
+    return true;
+}
 
-    proc->pgrp = (pid_t)strtol(token, NULL, 10);
+//--------------------------------------------------------------------
+//
+// ParseStat - Parses the text of /proc/[pid]/stat. Everything after the
+// command name (which may contain spaces and parentheses) is a decimal
+// number, so all fields are converted in one pass.
+//
+//--------------------------------------------------------------------
+static bool ParseStat(const char *buffer, struct ProcessStat *proc)
+{
+    long long fields[53] = {0};     // fields[n] is field (n) in proc(5)
+    const char *p = strrchr(buffer, ')');
+    int n;
 
-    // (6) session ID
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - Session ID.");
+    if(p == NULL || p[1] != ' ' || p[2] == '\0')
+    {
+        Trace("ParseStat: malformed /proc/[pid]/stat.");
         return false;
     }
 
-    proc->session = (int)strtol(token, NULL, 10);
+    // (1) process ID
+    proc->pid = (pid_t)atoi(buffer);
 
-    // (7) controlling terminal
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - Controlling terminal.");
-        return false;
-    }
+    // (3) process state
+    proc->state = p[2];
 
-    proc->tty_nr = (int)strtol(token, NULL, 10);
+    p += 3;
+    for(n = 4; n < 53 && *p != '\0' && *p != '\n'; n++)
+    {
+        unsigned long long value = 0;
+        bool negative;
 
-    // (8) Foreground group ID of controlling terminal
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - Foreground group ID.");
-        return false;
-    }
+        while(*p == ' ') p++;
 
-    proc->tpgid = (pid_t)strtol(token, NULL, 10);
+        negative = (*p == '-');
+        p += negative;
 
-    // (9) Kernel flags
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - Kernel flags.");
-        return false;
-    }
+        while((unsigned)(*p - '0') < 10)
+        {
+            value = value * 10 + (*p - '0');
+            p++;
+        }
 
-    proc->flags = (unsigned int)strtoul(token, NULL, 10);
+        fields[n] = negative ? -(long long)value : (long long)value;
+    }
+
+    if(n < 53)
+    {
+        Trace("ParseStat: /proc/[pid]/stat has %d fields, expected 52.", n - 1);
+        return false;
+    }
+
+    proc->ppid = (pid_t)fields[4];
+    proc->pgrp = (pid_t)fields[5];
+    proc->session = (int)fields[6];
+    proc->tty_nr = (int)fields[7];
+    proc->tpgid = (pid_t)fields[8];
+    proc->flags = (unsigned int)fields[9];
+    proc->minflt = fields[10];
+    proc->cminflt = fields[11];
+    proc->majflt = fields[12];
+    proc->cmajflt = fields[13];
+    proc->utime = fields[14];
+    proc->stime = fields[15];
+    proc->cutime = fields[16];
+    proc->cstime = fields[17];
+    proc->priority = fields[18];
+    proc->nice = fields[19];
+    proc->num_threads = fields[20];
+    proc->itrealvalue = fields[21];
+    proc->starttime = fields[22];
+    proc->vsize = fields[23];
+    proc->rss = fields[24];
+    proc->rsslim = fields[25];
+    proc->startcode = fields[26];
+    proc->endcode = fields[27];
+    proc->startstack = fields[28];
+    proc->kstkesp = fields[29];
+    proc->kstkeip = fields[30];
+    proc->signal = fields[31];
+    proc->blocked = fields[32];
+    proc->sigignore = fields[33];
+    proc->sigcatch = fields[34];
+    proc->wchan = fields[35];
+    proc->nswap = fields[36];
+    proc->cnswap = fields[37];
+    proc->exit_signal = (int)fields[38];
+    proc->processor = (int)fields[39];
+    proc->rt_priority = (unsigned int)fields[40];
+    proc->policy = (unsigned int)fields[41];
+    proc->delayacct_blkio_ticks = fields[42];
+    proc->guest_time = fields[43];
+    proc->cguest_time = fields[44];
+    proc->start_data = fields[45];
+    proc->end_data = fields[46];
+    proc->start_brk = fields[47];
+    proc->arg_start = fields[48];
+    proc->arg_end = fields[49];
+    proc->env_start = fields[50];
+    proc->env_end = fields[51];
+    proc->exit_code = (int)fields[52];
 
-    // (10) minflt
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - Minflt.");
-        return false;
-    }
+    return true;
+}
 
-    proc->minflt = strtoul(token, NULL, 10);
+//--------------------------------------------------------------------
+//
+// ParseUids - Parses the Uid: line of /proc/[pid]/status
+//
+//--------------------------------------------------------------------
+static bool ParseUids(const char *buffer, struct ProcessStat *proc)
+{
+    const char *line = strstr(buffer, "\nUid:");
+    char *end;
 
-    // (11) cminflt
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - cminflt.");
+    if(line == NULL)
+    {
+        Trace("ParseUids: no Uid line in /proc/[pid]/status.");
         return false;
     }
 
-    proc->cminflt = strtoul(token, NULL, 10);
+    proc->real_uid = (uid_t)strtoul(line + 5, &end, 10);
+    proc->effective_uid = (uid_t)strtoul(end, &end, 10);
+    proc->saved_uid = (uid_t)strtoul(end, &end, 10);
+    proc->fs_uid = (uid_t)strtoul(end, &end, 10);
 
-    // (12) majflt
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - majflt.");
-        return false;
-    }
+    return true;
+}
 
-    proc->majflt = strtoul(token, NULL, 10);
+//--------------------------------------------------------------------
+//
+// ReadProcessStat - Samples the sources (PROCESS_STAT_*) of the reader's
+// process with one pread (or fstat) each. Fields of other sources are
+// left untouched. Fails with ESRCH once the process has exited or its
+// pid has been reused (its starttime changed).
+//
+//--------------------------------------------------------------------
+bool ReadProcessStat(struct ProcessReader *reader, struct ProcessStat *proc, int sources)
+{
+    char buffer[4096];
 
-    // (13) cmajflt
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - cmajflt.");
-        return false;
-    }
+    if(sources & PROCESS_STAT_STAT)
+    {
+        if(!OpenProcFile(&reader->statFd, reader->pid, "stat", O_RDONLY) ||
+           !ReadProcFile(reader->statFd, buffer, sizeof(buffer)))
+        {
+            return false;
+        }
 
-    proc->cmajflt = strtoul(token, NULL, 10);
+        if(!ParseStat(buffer, proc))
+        {
+            errno = EINVAL;
+            return false;
+        }
 
-    // (14) utime
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - utime.");
-        return false;
+        if(reader->starttime == 0)
+        {
+            reader->starttime = proc->starttime;
+        }
+        else if(reader->starttime != proc->starttime)
+        {
+            Trace("ReadProcessStat: pid %d has been reused.", reader->pid);
+            errno = ESRCH;
+            return false;
+        }
     }
 
-    proc->utime = strtoul(token, NULL, 10);
+    if(sources & PROCESS_STAT_UIDS)
+    {
+        if(!OpenProcFile(&reader->statusFd, reader->pid, "status", O_RDONLY) ||
+           !ReadProcFile(reader->statusFd, buffer, sizeof(buffer)))
+        {
+            return false;
+        }
 
-    // (15) stime
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - stime.");
-        return false;
+        if(!ParseUids(buffer, proc))
+        {
+            errno = EINVAL;
+            return false;
+        }
     }
 
-    proc->stime = strtoul(token, NULL, 10);
-
-    // (16) cutime
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - cutime.");
-        return false;
-    }
+    if(sources & PROCESS_STAT_FDS)
+    {
+        struct stat fdStat;
 
-    proc->cutime = strtoul(token, NULL, 10);
+        // Since Linux 6.2 the size of /proc/[pid]/fd is the number of open
+        // file descriptors. Older kernels report 0, so walk the directory.
+        if(!OpenProcFile(&reader->fdDirFd, reader->pid, "fd", O_RDONLY | O_DIRECTORY) ||
+           fstat(reader->fdDirFd, &fdStat) == -1)
+        {
+            return false;
+        }
 
-    // (17) cstime
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - cstime.");
-        return false;
+        if(fdStat.st_size > 0)
+        {
+            proc->num_filedescriptors = (int)fdStat.st_size;
+        }
+        else if(GetNumFileDescriptors(reader->pid, proc) == false)
+        {
+            errno = ESRCH;
+            return false;
+        }
     }
 
-    proc->cstime = strtoul(token, NULL, 10);
+    return true;
+}
 
-    // (18) priority
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - priority.");
-        return false;
-    }
+//--------------------------------------------------------------------
+//
+// ReadThreadCpuTimes - Reads the CPU time of each thread of the reader's
+// process from /proc/[pid]/task/[tid]/stat into threads (at most count).
+//
+// Returns: the number of threads, which may exceed count, or -1 (errno
+// set) on failure
+//
+//--------------------------------------------------------------------
+int ReadThreadCpuTimes(struct ProcessReader *reader, struct ThreadCpuTime *threads, int count)
+{
+    struct dirent *entry;
+    int numThreads = 0;
 
-    proc->priority = strtol(token, NULL, 10);
+    if(reader->taskDir == NULL)
+    {
+        char path[64];
 
-    // (19) nice
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - nice.");
-        return false;
+        snprintf(path, sizeof(path), "/proc/%d/task", reader->pid);
+        if((reader->taskDir = opendir(path)) == NULL)
+        {
+            if(errno == ENOENT) errno = ESRCH;
+            Trace("ReadThreadCpuTimes: failed to open %s [%s]", path, strerror(errno));
+            return -1;
+        }
     }
-
-    proc->nice = strtol(token, NULL, 10);
-
-    // (20) num_threads
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - num_threads.");
-        return false;
+    else
+    {
+        rewinddir(reader->taskDir);
     }
 
-    proc->num_threads = strtol(token, NULL, 10);
-#endif    
-
-#ifdef __APPLE__
-    proc->num_threads = taskInfo.ptinfo.pti_threadnum;
-#endif
-
-#ifdef __linux__
-    // (21) itrealvalue
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - itrealvalue.");
-        return false;
-    }
+    while((entry = readdir(reader->taskDir)) != NULL)
+    {
+        char path[64];
+        char buffer[1024];
+        struct ProcessStat threadStat;
+        const char *comm;
+        const char *commEnd;
+        auto_free_fd int fd = -1;
 
-    proc->itrealvalue = strtol(token, NULL, 10);
+        if(entry->d_name[0] < '0' || entry->d_name[0] > '9')
+        {
+            continue;
+        }
 
-    // (22) starttime
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - starttime.");
-        return false;
-    }
-    proc->starttime = strtoull(token, NULL, 10);
-#else
-    proc->starttime = taskInfo.pbsd.pbi_start_tvsec;
-#endif
+        // A thread that exits while the list is read is skipped
+        snprintf(path, sizeof(path), "%s/stat", entry->d_name);
+        fd = openat(dirfd(reader->taskDir), path, O_RDONLY | O_CLOEXEC);
+        if(fd == -1 || !ReadProcFile(fd, buffer, sizeof(buffer)) || !ParseStat(buffer, &threadStat))
+        {
+            continue;
+        }
 
-#ifdef __linux__
-    // (23) vsize
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - vsize.");
-        return false;
-    }
+        if(numThreads < count)
+        {
+            threads[numThreads].tid = threadStat.pid;
+            threads[numThreads].ticks = threadStat.utime + threadStat.stime;
 
-    proc->vsize = strtoul(token, NULL, 10);
+            comm = strchr(buffer, '(');
+            commEnd = strrchr(buffer, ')');
+            snprintf(threads[numThreads].comm, sizeof(threads[numThreads].comm), "%.*s",
+                     comm != NULL ? (int)(commEnd - comm - 1) : 0, comm != NULL ? comm + 1 : "");
+        }
 
-    // (24) rss
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - rss.");
-        return false;
+        numThreads++;
     }
 
-    proc->rss = strtol(token, NULL, 10);    
-#endif
-#ifdef __APPLE__
-    proc->rss = taskInfo.ptinfo.pti_resident_size; 
+    return numThreads;
+}
 #endif
 
+//--------------------------------------------------------------------
+//
+// GetProcessStatEx - Gets the process stats for the given pid, reading
+// only the sources (PROCESS_STAT_*) asked for. Fields of other sources
+// are left untouched.
+//
+//--------------------------------------------------------------------
+bool GetProcessStatEx(pid_t pid, struct ProcessStat *proc, int sources)
+{
 #ifdef __linux__
-    // (25) rsslim
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - rsslim.");
-        return false;
-    }
-
-    proc->rsslim = strtoul(token, NULL, 10);
-
-    // (26) startcode
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - startcode.");
-        return false;
-    }
-
-    proc->startcode = strtoul(token, NULL, 10);
-
-    // (27) endcode
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - endcode.");
-        return false;
-    }
-
-    proc->endcode = strtoul(token, NULL, 10);
-
-    // (28) startstack
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - startstack.");
-        return false;
-    }
-
-    proc->startstack = strtoul(token, NULL, 10);
-
-    // (29) kstkesp
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - kstkesp.");
-        return false;
-    }
-
-    proc->kstkesp = strtoul(token, NULL, 10);
-
-    // (30) kstkeip
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - kstkeip.");
-        return false;
-    }
-
-    proc->kstkeip = strtoul(token, NULL, 10);
-
-    // (31) signal
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - signal.");
-        return false;
-    }
-
-    proc->signal = strtoul(token, NULL, 10);
-
-    // (32) blocked
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - blocked.");
-        return false;
-    }
-
-    proc->blocked = strtoul(token, NULL, 10);
-
-    // (33) sigignore
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - sigignore.");
-        return false;
-    }
+    struct ProcessReader reader;
+    bool ret;
 
-    proc->sigignore = strtoul(token, NULL, 10);
+    InitProcessReader(&reader, pid);
+    ret = ReadProcessStat(&reader, proc, sources);
+    CloseProcessReader(&reader);
 
-    // (34) sigcatch
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - sigcatch.");
-        return false;
-    }
-
-    proc->sigcatch = strtoul(token, NULL, 10);
-
-    // (35) wchan
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - wchan.");
-        return false;
-    }
-
-    proc->wchan = strtoul(token, NULL, 10);
-
-    // (36) nswap
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - nswap.");
-        return false;
-    }
-
-    proc->nswap = strtoul(token, NULL, 10);
-
-    // (37) cnswap
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - cnswap.");
-        return false;
-    }
-
-    proc->cnswap = strtoul(token, NULL, 10);
-
-    // (38) exit_signal
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - exit_signal.");
-        return false;
-    }
-
-    proc->exit_signal = (int)strtol(token, NULL, 10);
-
-    // (39) processor
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - processor.");
-        return false;
-    }
-
-    proc->processor = (int)strtol(token, NULL, 10);
-
-    // (40) rt_priority
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - rt_priority.");
-        return false;
-    }
-
-    proc->rt_priority = (unsigned int)strtoul(token, NULL, 10);
-
-    // (41) policy
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - policy.");
-        return false;
-    }
-
-    proc->policy = (unsigned int)strtoul(token, NULL, 10);
-
-    // (42) delayacct_blkio_ticks
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - delayacct_blkio_ticks.");
-        return false;
-    }
-
-    proc->delayacct_blkio_ticks = strtoull(token, NULL, 10);
-
-    // (43) guest_time
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - guest_time.");
-        return false;
-    }
-
-    proc->guest_time = strtoul(token, NULL, 10);
-
-    // (44) cguest_time
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - cguest_time.");
-        return false;
-    }
-
-    proc->cguest_time = strtol(token, NULL, 10);
-
-    // (45) start_data
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - start_data.");
-        return false;
-    }
-
-    proc->start_data = strtoul(token, NULL, 10);
-
-    // (46) end_data
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - end_data.");
-        return false;
-    }
-
-    proc->end_data = strtoul(token, NULL, 10);
-
-    // (47) start_brk
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - start_brk.");
-        return false;
-    }
-
-    proc->start_brk = strtoul(token, NULL, 10);
-
-    // (48) arg_start
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - arg_start.");
-        return false;
-    }
-
-    proc->arg_start = strtoul(token, NULL, 10);
-
-    // (49) arg_end
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - arg_end.");
-        return false;
-    }
-
-    proc->arg_end = strtoul(token, NULL, 10);
-
-    // (50) env_start
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - env_start.");
+    return ret;
+#elif __APPLE__
+    struct proc_taskallinfo taskInfo;
+    if((sources & PROCESS_STAT_STAT) && GetTaskInfo(&taskInfo, pid) == false)
+    {
         return false;
     }
 
-    proc->env_start = strtoul(token, NULL, 10);
-
-    // (52) env_end
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - env_end.");
+    if((sources & PROCESS_STAT_FDS) && GetNumFileDescriptors(pid, proc) == false)
+    {
+        Log(error, "Failed to get number of file descriptors");
         return false;
     }
 
-    proc->env_end = strtoul(token, NULL, 10);
+    if(sources & PROCESS_STAT_STAT)
+    {
+        proc->num_threads = taskInfo.ptinfo.pti_threadnum;
+        proc->starttime = taskInfo.pbsd.pbi_start_tvsec;
+        proc->rss = taskInfo.ptinfo.pti_resident_size;
 
-    // (53) exit_code
-    token = strtok_r(NULL, " ", &savePtr);
-    if(token == NULL){
-        Trace("GetProcessStat: failed to get token from proc/[pid]/stat - exit_code.");
-        return false;
+        // CPU times are in mach absolute time units, convert them to clock ticks
+        mach_timebase_info_data_t timebaseInfo;
+        mach_timebase_info(&timebaseInfo);
+        proc->utime = (unsigned long)((double)taskInfo.ptinfo.pti_total_user * timebaseInfo.numer / timebaseInfo.denom * HZ / 1000000000);
+        proc->stime = (unsigned long)((double)taskInfo.ptinfo.pti_total_system * timebaseInfo.numer / timebaseInfo.denom * HZ / 1000000000);
     }
 
-    proc->exit_code = (int)strtol(token, NULL, 10);
-#endif    
     return true;
+#endif
 }
 
 //--------------------------------------------------------------------
@@ -1061,66 +933,7 @@ int FilterForPid(const struct dirent *entry)
 }
 
 
-//--------------------------------------------------------------------
-//
-// GetCpuUsage - Gets the CPU usage of a process.
-//
-//--------------------------------------------------------------------
-#ifdef __linux__
-int GetCpuUsage(pid_t pid)
-{
-    int cpuUsage = 0;
-    struct sysinfo sysInfo;
-    unsigned long totalTime;
-    unsigned long elapsedTime;
-    struct ProcessStat procStat = {0};    
-
-    sysinfo(&sysInfo);
-    GetProcessStat(pid, &procStat);    
-
-    // Calc CPU
-    totalTime = (unsigned long)((procStat.utime + procStat.stime) / HZ);   
-    elapsedTime = (unsigned long)(sysInfo.uptime - (long)(procStat.starttime / HZ)); 
-    cpuUsage = (int)(100 * ((double)totalTime / elapsedTime));
-
-    return cpuUsage;
-}
-#elif __APPLE__
-int GetCpuUsage(pid_t pid)
-{
-    int cpuUsage = 0;
-    pid_t* pids = NULL;
-    int ret = 0;
-    struct timeval boottime;
-    size_t size = sizeof(boottime);
-    int mib[2] = {CTL_KERN, KERN_BOOTTIME};    
-
-    if (sysctl(mib, 2, &boottime, &size, NULL, 0) != 0) 
-    {
-        return -1;
-    }    
-
-    mach_timebase_info_data_t timebaseInfo;
-    kern_return_t kr = mach_timebase_info(&timebaseInfo);
-
-    struct proc_taskallinfo taskInfo;
-    ret = proc_pidinfo(pid, PROC_PIDTASKALLINFO, 0, &taskInfo, sizeof(taskInfo));
-    if (ret <= 0) 
-    {
-        Trace("[GetCpuUsage] Failed to get process information for pid: %d", pid);
-        free(pids);
-        return -1;
-    } 
-    else
-    {
-        unsigned long totalTime = ((taskInfo.ptinfo.pti_total_user * timebaseInfo.numer / timebaseInfo.denom)  + (taskInfo.ptinfo.pti_total_system * timebaseInfo.numer / timebaseInfo.denom)) / 1000000000;
-        unsigned long elapsedTime = ((time(NULL) - boottime.tv_sec)) - (taskInfo.pbsd.pbi_start_tvsec - boottime.tv_sec);
-        cpuUsage = (int)(100 * ((double)totalTime / elapsedTime));
-    }           
-
-    return cpuUsage;
-}
-
+#ifdef __APPLE__
 //--------------------------------------------------------------------
 //
 // GetRunningPids - Returns the running PIDS on the system.
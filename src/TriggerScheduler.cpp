@@ -0,0 +1,957 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// Trigger scheduler
+//
+// Every polled trigger of every monitored process is a task owned by a
+// single scheduler thread. The scheduler sleeps until the earliest task
+// is due (timerfd + epoll on Linux, poll on macOS), evaluates all due
+// tasks and goes back to sleep. Deadlines are absolute CLOCK_MONOTONIC
+// times, so the polling interval (down to MIN_POLLING_INTERVAL) does not
+// drift by the time the evaluations take.
+//
+// Poll times are multiples of the polling interval plus a phase per
+// process. The phases spread the processes over SCHEDULER_SLOT ms slots
+// of the interval, so that hundreds of monitored processes are not all
+// sampled in the same millisecond, while the triggers of one process
+// (and the processes sharing a slot) are still evaluated in one wakeup.
+//
+// A trigger that fires is handed to the dump executor of its process, a
+// thread that runs while the process has dumps queued. The dumps of one
+// process are serialized by its semAvailableDumpSlots anyway, and a long
+// dump neither delays the evaluation of other triggers nor the dumps of
+// other processes.
+//
+//--------------------------------------------------------------------
+#include "Includes.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#else
+#include <poll.h>
+#endif
+#include <sys/resource.h>
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <unordered_map>
+
+#define NO_DEADLINE UINT64_MAX
+#define SCHEDULER_SLOT 10           // granularity (ms) of the process phases
+
+extern long HZ;                     // clock ticks per second
+
+//
+// The /proc sample of a monitored process shared by all of its triggers.
+// Each source (PROCESS_STAT_*) is read at most once per scheduler wakeup,
+// and only when a trigger that is due needs it. The sample also holds the
+// triggers of the process that fired and wait for its dump executor.
+//
+struct ScheduledTrigger;
+
+struct ProcessSample
+{
+    int refs;                       // triggers sharing the sample
+    uint64_t wakeup;                // scheduler wakeup the sources were read in
+    uint64_t time;                  // CLOCK_MONOTONIC time (ms) of that wakeup
+    int sources;                    // PROCESS_STAT_* read in that wakeup
+    int phase;                      // offset (ms) of the poll times within the interval
+    struct ProcessStat stat;
+#ifdef __linux__
+    struct ProcessReader reader;    // /proc files of the process, open while it is monitored
+#endif
+    std::deque<struct ScheduledTrigger*> dumpQueue;    // fired triggers waiting for the executor
+    bool dumping;                   // a DumpExecutorThread is running for the process
+};
+
+#ifdef __linux__
+struct ThreadCpuState
+{
+    unsigned long long ticks;       // utime + stime of the thread
+    int hotSamples;                 // consecutive samples at or above the threshold
+};
+#endif
+
+struct ScheduledTrigger
+{
+    struct ProcDumpConfiguration *config;
+    enum TriggerType trigger;
+    bool (*evaluate)(struct ScheduledTrigger *task);
+    int sources;                    // PROCESS_STAT_* the evaluation needs
+    struct ProcessSample *sample;
+    struct CoreDumpWriter *writer;
+    int interval;                   // ms between evaluations (0 for the timer, which always fires)
+    bool started;                   // evtStartMonitoring of config has been seen
+    uint64_t due;                   // CLOCK_MONOTONIC time (ms) of the next evaluation
+    bool busy;                      // queued for or running in the dump executor of its process
+    std::vector<pthread_t> leakReportThreads;
+
+    // CPU usage is measured between two evaluations of the task, so the
+    // first evaluation (and the first after a dump) only takes a baseline
+    uint64_t cpuTime;               // sample time (ms) of the baseline, 0 for none
+    unsigned long long cpuTicks;    // utime + stime of the process at cpuTime
+#ifdef __linux__
+    std::unordered_map<pid_t, struct ThreadCpuState> threadCpu;    // per thread at cpuTime
+    std::vector<struct ThreadCpuTime> threadTimes;                  // ReadThreadCpuTimes buffer
+#endif
+};
+
+//
+// All scheduled and retired tasks. A task that is not busy belongs to the
+// scheduler thread, a busy one to the dump executor until it clears busy.
+// The lists, the dump queues and the busy flags must be protected by
+// schedulerMutex.
+//
+static std::vector<struct ScheduledTrigger*> scheduledTriggers;
+static std::vector<struct ScheduledTrigger*> retiredTriggers;
+static pthread_mutex_t schedulerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t retiredCond = PTHREAD_COND_INITIALIZER;
+
+static pthread_once_t schedulerOnce = PTHREAD_ONCE_INIT;
+static int schedulerStatus = -1;
+#ifdef __linux__
+static int epollFd = -1;
+static int timerFd = -1;
+static int wakeFd = -1;
+#else
+static int wakePipe[2] = { -1, -1 };
+#endif
+
+//--------------------------------------------------------------------
+//
+// NextPollTime - First multiple of interval plus phase after time
+//
+//--------------------------------------------------------------------
+static uint64_t NextPollTime(uint64_t time, int interval, int phase)
+{
+    if (interval <= 0)
+    {
+        return time;
+    }
+
+    if (time < (uint64_t)phase)
+    {
+        return phase;
+    }
+
+    return ((time - phase) / interval + 1) * interval + phase;
+}
+
+//--------------------------------------------------------------------
+//
+// GetPollPhase - Phase of a process within the polling interval. The
+// pid is hashed (multiplicatively, as consecutive pids are common) onto
+// one of the SCHEDULER_SLOT ms slots of the interval.
+//
+//--------------------------------------------------------------------
+static int GetPollPhase(pid_t pid, int interval)
+{
+    uint32_t slots = interval / SCHEDULER_SLOT;
+
+    if (slots <= 1)
+    {
+        return 0;
+    }
+
+    return (int)(((uint32_t)pid * 2654435761u) % slots) * SCHEDULER_SLOT;
+}
+
+//--------------------------------------------------------------------
+//
+// CpuPercent - CPU usage of ticks used in elapsed ms (100 is one core)
+//
+//--------------------------------------------------------------------
+static int CpuPercent(unsigned long long ticks, uint64_t elapsed)
+{
+    return (int)(ticks * 100000 / ((uint64_t)HZ * elapsed));
+}
+
+//--------------------------------------------------------------------
+//
+// EvaluateCpuTrigger - Has the CPU usage since the last evaluation
+// crossed the threshold?
+//
+//--------------------------------------------------------------------
+static bool EvaluateCpuTrigger(struct ScheduledTrigger *task)
+{
+    struct ProcDumpConfiguration *config = task->config;
+    struct ProcessSample *sample = task->sample;
+    unsigned long long ticks = sample->stat.utime + sample->stat.stime;
+    uint64_t baseline = task->cpuTime;
+    unsigned long long baselineTicks = task->cpuTicks;
+    int cpuUsage;
+
+    task->cpuTime = sample->time;
+    task->cpuTicks = ticks;
+    if (baseline == 0 || sample->time <= baseline || ticks < baselineTicks)
+    {
+        return false;
+    }
+
+    cpuUsage = CpuPercent(ticks - baselineTicks, sample->time - baseline);
+    Trace("EvaluateCpuTrigger: CPU usage:%d%% on process ID: %d", cpuUsage, config->ProcessId);
+
+    if ((config->bCpuTriggerBelowValue && (cpuUsage < config->CpuThreshold)) ||
+        (!config->bCpuTriggerBelowValue && (cpuUsage >= config->CpuThreshold)))
+    {
+        Log(info, "Trigger: CPU usage:%d%% on process ID: %d", cpuUsage, config->ProcessId);
+        return true;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------
+//
+// EvaluateCommitTrigger - Has the memory usage crossed the current
+// threshold?
+//
+//--------------------------------------------------------------------
+static bool EvaluateCommitTrigger(struct ScheduledTrigger *task)
+{
+    struct ProcDumpConfiguration *config = task->config;
+    struct ProcessStat *proc = &task->sample->stat;
+    unsigned long memUsage = 0;
+
+#ifdef __linux__
+    long pageSize_kb = sysconf(_SC_PAGESIZE) >> 10; // convert bytes to kilobytes (2^10)
+
+    // Calc Commit
+    memUsage = (proc->rss * pageSize_kb) >> 10;    // get Resident Set Size
+    memUsage += (proc->nswap * pageSize_kb) >> 10; // get Swap size
+#elif __APPLE__
+    memUsage = proc->rss / (1024.0 * 1024.0);       // get Resident Set Size
+#endif
+
+    if ((config->bMemoryTriggerBelowValue && (memUsage < config->MemoryThreshold[config->MemoryCurrentThreshold])) ||
+        (!config->bMemoryTriggerBelowValue && (memUsage >= config->MemoryThreshold[config->MemoryCurrentThreshold])))
+    {
+        Log(info, "Trigger: Commit usage:%ldMB on process ID: %d", memUsage, config->ProcessId);
+        return true;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------
+//
+// EvaluateThreadCountTrigger - Has the thread count crossed the threshold?
+//
+//--------------------------------------------------------------------
+static bool EvaluateThreadCountTrigger(struct ScheduledTrigger *task)
+{
+    struct ProcDumpConfiguration *config = task->config;
+    struct ProcessStat *proc = &task->sample->stat;
+
+    if (proc->num_threads >= config->ThreadThreshold)
+    {
+        Log(info, "Trigger: Thread count:%ld on process ID: %d", proc->num_threads, config->ProcessId);
+        return true;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------
+//
+// EvaluateFileDescriptorCountTrigger - Has the file descriptor count
+// crossed the threshold?
+//
+//--------------------------------------------------------------------
+static bool EvaluateFileDescriptorCountTrigger(struct ScheduledTrigger *task)
+{
+    return task->sample->stat.num_filedescriptors >= task->config->FileDescriptorThreshold;
+}
+
+//--------------------------------------------------------------------
+//
+// EvaluateTimerTrigger - The timer fires whenever it is due
+//
+//--------------------------------------------------------------------
+static bool EvaluateTimerTrigger(struct ScheduledTrigger *task)
+{
+    struct ProcDumpConfiguration *config = task->config;
+
+    Log(info, "Trigger: Timer:%d(s) on process ID: %d", config->ThresholdSeconds, config->ProcessId);
+    return true;
+}
+
+#ifdef __linux__
+//--------------------------------------------------------------------
+//
+// EvaluateThreadCpuTrigger - Has a single thread stayed at or above the
+// CPU threshold since the last evaluation for the required number of
+// consecutive samples? The hottest such thread is listed first in the
+// dump, so debuggers select it.
+//
+//--------------------------------------------------------------------
+static bool EvaluateThreadCpuTrigger(struct ScheduledTrigger *task)
+{
+    struct ProcDumpConfiguration *config = task->config;
+    struct ProcessSample *sample = task->sample;
+    std::unordered_map<pid_t, struct ThreadCpuState> threadCpu;
+    const struct ThreadCpuTime *hotThread = NULL;
+    int hotUsage = -1;
+    int numThreads;
+
+    // Leave room for threads created since the process was sampled
+    if (task->threadTimes.size() < (size_t)sample->stat.num_threads + 16)
+    {
+        task->threadTimes.resize(sample->stat.num_threads + 16);
+    }
+
+    while ((numThreads = ReadThreadCpuTimes(&sample->reader, task->threadTimes.data(), (int)task->threadTimes.size())) > (int)task->threadTimes.size())
+    {
+        task->threadTimes.resize(numThreads + 16);
+    }
+
+    if (numThreads < 0)
+    {
+        // An exited process is noticed by the next sample
+        return false;
+    }
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        const struct ThreadCpuTime *thread = &task->threadTimes[i];
+        struct ThreadCpuState state = { thread->ticks, 0 };
+        auto last = task->threadCpu.find(thread->tid);
+
+        if (task->cpuTime != 0 && sample->time > task->cpuTime &&
+            last != task->threadCpu.end() && thread->ticks >= last->second.ticks)
+        {
+            int cpuUsage = CpuPercent(thread->ticks - last->second.ticks, sample->time - task->cpuTime);
+
+            if (cpuUsage >= config->ThreadCpuThreshold)
+            {
+                state.hotSamples = last->second.hotSamples + 1;
+                if (state.hotSamples >= config->ThreadCpuSamples && cpuUsage > hotUsage)
+                {
+                    hotThread = thread;
+                    hotUsage = cpuUsage;
+                }
+            }
+        }
+
+        threadCpu[thread->tid] = state;
+    }
+
+    // Threads that exited are dropped from the baseline
+    task->threadCpu.swap(threadCpu);
+    task->cpuTime = sample->time;
+
+    if (hotThread == NULL)
+    {
+        return false;
+    }
+
+    Log(info, "Trigger: Thread %d (%s) CPU usage:%d%% for %d sample(s) on process ID: %d", hotThread->tid, hotThread->comm, hotUsage, config->ThreadCpuSamples, config->ProcessId);
+    task->writer->FirstThreadId = hotThread->tid;
+    return true;
+}
+#endif
+
+//--------------------------------------------------------------------
+//
+// SampleProcess - Bring the shared sample of the task's process up to
+// date for this wakeup, reading the sources the task needs that no other
+// trigger of the process has read yet.
+//
+//--------------------------------------------------------------------
+static bool SampleProcess(struct ScheduledTrigger *task, uint64_t wakeup, uint64_t now)
+{
+    struct ProcessSample *sample = task->sample;
+    int missing;
+
+    if (sample->wakeup != wakeup)
+    {
+        sample->wakeup = wakeup;
+        sample->time = now;
+        sample->sources = 0;
+    }
+
+    missing = task->sources & ~sample->sources;
+    if (missing != 0)
+    {
+#ifdef __linux__
+        if (!ReadProcessStat(&sample->reader, &sample->stat, missing))
+#else
+        if (!GetProcessStatEx(task->config->ProcessId, &sample->stat, missing))
+#endif
+        {
+            return false;
+        }
+
+        sample->sources |= missing;
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------
+//
+// WakeTriggerScheduler - Make the scheduler re-examine its tasks, e.g.
+// because a monitor was started or asked to quit.
+//
+//--------------------------------------------------------------------
+void WakeTriggerScheduler()
+{
+#ifdef __linux__
+    uint64_t one = 1;
+
+    if (wakeFd != -1 && write(wakeFd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+    {
+        Trace("WakeTriggerScheduler: failed to signal the scheduler (%d).", errno);
+    }
+#else
+    char one = 1;
+
+    if (wakePipe[1] != -1 && write(wakePipe[1], &one, sizeof(one)) == -1 && errno != EAGAIN)
+    {
+        Trace("WakeTriggerScheduler: failed to signal the scheduler (%d).", errno);
+    }
+#endif
+}
+
+//--------------------------------------------------------------------
+//
+// DrainWakeups - Consume the pending expirations/wakeups of a
+// non-blocking timerfd, eventfd or pipe.
+//
+//--------------------------------------------------------------------
+static void DrainWakeups(int fd)
+{
+    uint64_t count;
+
+    while (read(fd, &count, sizeof(count)) > 0)
+    {
+    }
+}
+
+//--------------------------------------------------------------------
+//
+// WaitForDeadline - Sleep until the deadline (CLOCK_MONOTONIC ms) has
+// passed or WakeTriggerScheduler is called.
+//
+//--------------------------------------------------------------------
+static void WaitForDeadline(uint64_t deadline)
+{
+#ifdef __linux__
+    struct itimerspec its = {};
+    struct epoll_event events[2];
+    int n;
+
+    // A zero it_value disarms the timer
+    if (deadline != NO_DEADLINE)
+    {
+        its.it_value.tv_sec = deadline / 1000;
+        its.it_value.tv_nsec = (deadline % 1000) * 1000000;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+        {
+            its.it_value.tv_nsec = 1;
+        }
+    }
+
+    if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &its, NULL) == -1)
+    {
+        Trace("WaitForDeadline: failed to arm the timer (%d).", errno);
+    }
+
+    n = epoll_wait(epollFd, events, 2, -1);
+    for (int i = 0; i < n; i++)
+    {
+        DrainWakeups(events[i].data.fd);
+    }
+#else
+    struct pollfd pfd = { wakePipe[0], POLLIN, 0 };
+    int timeout = -1;
+
+    if (deadline != NO_DEADLINE)
+    {
+        uint64_t now = GetMonotonicTime();
+        timeout = deadline <= now ? 0 : (int)std::min<uint64_t>(deadline - now, INT_MAX);
+    }
+
+    if (poll(&pfd, 1, timeout) > 0)
+    {
+        DrainWakeups(wakePipe[0]);
+    }
+#endif
+}
+
+//--------------------------------------------------------------------
+//
+// IsMonitoringStarted - Has BeginMonitoring been called for the config?
+//
+//--------------------------------------------------------------------
+static bool IsMonitoringStarted(struct ProcDumpConfiguration *config)
+{
+    return WaitForSingleObject(&config->evtStartMonitoring, 0) == 0;
+}
+
+//--------------------------------------------------------------------
+//
+// RetireTrigger - Stop scheduling a task. It is released by
+// WaitForScheduledTriggers.
+//
+//--------------------------------------------------------------------
+static void RetireTrigger(struct ScheduledTrigger *task)
+{
+    pthread_mutex_lock(&schedulerMutex);
+    scheduledTriggers.erase(std::find(scheduledTriggers.begin(), scheduledTriggers.end(), task));
+    retiredTriggers.push_back(task);
+    pthread_cond_broadcast(&retiredCond);
+    pthread_mutex_unlock(&schedulerMutex);
+}
+
+//--------------------------------------------------------------------
+//
+// WriteTriggerDump - Collect the dump and/or restrack snapshot of a
+// trigger that fired.
+//
+//--------------------------------------------------------------------
+static void WriteTriggerDump(struct ScheduledTrigger *task)
+{
+    struct ProcDumpConfiguration *config = task->config;
+
+    // The monitor may have been stopped while the dump was queued
+    if (IsQuit(config))
+    {
+        return;
+    }
+
+    if(config->bRestrackGenerateDump == true)
+    {
+        // Only generate core dump if user did not specify the "nodump" restrack option
+        auto_free char* dumpFileName = WriteCoreDump(task->writer);
+        if(dumpFileName == NULL)
+        {
+            SetQuit(config, 1);
+        }
+    }
+
+    //
+    // Check to see if restrack is specified, if so, save current resource usage to file.
+    //
+#ifdef __linux__
+    if(config->bRestrackEnabled == true)
+    {
+        pthread_t id = WriteRestrackSnapshot(config, task->writer->Type);
+        if (id == 0)
+        {
+            SetQuit(config, 1);
+        }
+        else
+        {
+            task->leakReportThreads.push_back(id);
+        }
+    }
+#endif
+
+    if (task->trigger == Commit)
+    {
+        config->MemoryCurrentThreshold++;
+    }
+}
+
+//--------------------------------------------------------------------
+//
+// DumpExecutorThread - Writes the dumps of the triggers of a process that
+// fired, one at a time, and puts each trigger back on the schedule after
+// its threshold (-s) has passed. Exits once the queue of the process is
+// empty.
+//
+//--------------------------------------------------------------------
+static void *DumpExecutorThread(void *thread_args)
+{
+    struct ProcessSample *sample = (struct ProcessSample *)thread_args;
+    bool done = false;
+
+    Trace("DumpExecutorThread: Enter [id=%d]", gettid());
+
+    while (!done)
+    {
+        struct ScheduledTrigger *task;
+        uint64_t due;
+
+        pthread_mutex_lock(&schedulerMutex);
+        task = sample->dumpQueue.front();
+        sample->dumpQueue.pop_front();
+        pthread_mutex_unlock(&schedulerMutex);
+
+        WriteTriggerDump(task);
+
+        // Retire right away once the dump limit is reached
+        if (ContinueMonitoring(task->config))
+        {
+            due = NextPollTime(GetMonotonicTime() + (uint64_t)task->config->ThresholdSeconds * 1000, task->interval, task->sample->phase);
+        }
+        else
+        {
+            due = 0;
+        }
+
+        // The target was stopped for the dump, so start measuring CPU afresh
+        task->cpuTime = 0;
+
+        // Once the last task is no longer busy it can be retired and the
+        // sample released, so it must not be touched after this
+        pthread_mutex_lock(&schedulerMutex);
+        task->due = due;
+        task->busy = false;
+        if (sample->dumpQueue.empty())
+        {
+            sample->dumping = false;
+            done = true;
+        }
+        pthread_mutex_unlock(&schedulerMutex);
+
+        WakeTriggerScheduler();
+    }
+
+    Trace("DumpExecutorThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// QueueTriggerDump - Hand a trigger that fired to the dump executor of
+// its process, starting the executor if it is not running.
+//
+// Returns: true on success, false if the executor could not be started
+//
+//--------------------------------------------------------------------
+static bool QueueTriggerDump(struct ScheduledTrigger *task)
+{
+    struct ProcessSample *sample = task->sample;
+    pthread_t thread;
+    int rc;
+
+    pthread_mutex_lock(&schedulerMutex);
+    task->busy = true;
+    sample->dumpQueue.push_back(task);
+    if (!sample->dumping)
+    {
+        if ((rc = pthread_create(&thread, NULL, DumpExecutorThread, sample)) != 0)
+        {
+            Log(error, "Failed to start the dump executor for process %d (%d).", task->config->ProcessId, rc);
+            sample->dumpQueue.pop_back();
+            task->busy = false;
+            pthread_mutex_unlock(&schedulerMutex);
+            return false;
+        }
+
+        pthread_detach(thread);
+        sample->dumping = true;
+    }
+    pthread_mutex_unlock(&schedulerMutex);
+
+    return true;
+}
+
+//--------------------------------------------------------------------
+//
+// TriggerSchedulerThread - Evaluates the triggers that are due
+//
+//--------------------------------------------------------------------
+static void *TriggerSchedulerThread(void *thread_args)
+{
+    std::vector<struct ScheduledTrigger*> idle;
+    uint64_t wakeup = 0;
+
+    Trace("TriggerSchedulerThread: Enter [id=%d]", gettid());
+
+    while (true)
+    {
+        uint64_t now;
+        uint64_t next = NO_DEADLINE;
+
+        pthread_mutex_lock(&schedulerMutex);
+        idle.clear();
+        for (auto task : scheduledTriggers)
+        {
+            if (!task->busy)
+            {
+                idle.push_back(task);
+            }
+        }
+        pthread_mutex_unlock(&schedulerMutex);
+
+        now = GetMonotonicTime();
+        wakeup++;
+        for (auto task : idle)
+        {
+            struct ProcDumpConfiguration *config = task->config;
+
+            if (IsQuit(config) || (task->due <= now && !ContinueMonitoring(config)))
+            {
+                RetireTrigger(task);
+                continue;
+            }
+
+            if (!task->started)
+            {
+                if (!IsMonitoringStarted(config))
+                {
+                    continue;
+                }
+
+                task->started = true;
+                task->due = NextPollTime(now, task->interval, task->sample->phase);
+            }
+
+            if (task->due <= now)
+            {
+                if (!SampleProcess(task, wakeup, now))
+                {
+                    // The process exited (or its pid was reused) since it was last checked
+                    if (errno == ESRCH || !ContinueMonitoring(config))
+                    {
+                        if (!config->bTerminated)
+                        {
+                            config->bTerminated = true;
+                            Log(warn, "Target process %d is no longer alive", config->ProcessId);
+                        }
+
+                        RetireTrigger(task);
+                        continue;
+                    }
+
+                    Log(error, "An error occurred while parsing procfs\n");
+                    exit(-1);
+                }
+
+                if (task->evaluate(task))
+                {
+                    if (QueueTriggerDump(task))
+                    {
+                        continue;
+                    }
+
+                    SetQuit(config, 1);
+                    RetireTrigger(task);
+                    continue;
+                }
+
+                task->due = NextPollTime(now, task->interval, task->sample->phase);
+            }
+
+            next = std::min(next, task->due);
+        }
+
+        WaitForDeadline(next);
+    }
+
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// StartTriggerScheduler - Create the scheduler thread (once, on first
+// use). Sets schedulerStatus.
+//
+//--------------------------------------------------------------------
+static void StartTriggerScheduler()
+{
+    pthread_t thread;
+    struct rlimit limit;
+    int rc;
+
+    // The /proc files of every monitored process stay open (ProcessReader)
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+#ifdef __linux__
+    struct epoll_event ev = {};
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd == -1 || timerFd == -1 || wakeFd == -1)
+    {
+        Trace("StartTriggerScheduler: failed to create the scheduler descriptors (%d).", errno);
+        return;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.fd = timerFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev) == -1)
+    {
+        Trace("StartTriggerScheduler: failed to add the timer (%d).", errno);
+        return;
+    }
+
+    ev.data.fd = wakeFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) == -1)
+    {
+        Trace("StartTriggerScheduler: failed to add the wakeup event (%d).", errno);
+        return;
+    }
+#else
+    if (pipe(wakePipe) == -1 ||
+        fcntl(wakePipe[0], F_SETFL, O_NONBLOCK) == -1 ||
+        fcntl(wakePipe[1], F_SETFL, O_NONBLOCK) == -1)
+    {
+        Trace("StartTriggerScheduler: failed to create the wakeup pipe (%d).", errno);
+        return;
+    }
+#endif
+
+    if ((rc = pthread_create(&thread, NULL, TriggerSchedulerThread, NULL)) != 0)
+    {
+        Trace("StartTriggerScheduler: failed to create TriggerSchedulerThread.");
+        schedulerStatus = rc;
+        return;
+    }
+    pthread_detach(thread);
+
+    schedulerStatus = 0;
+}
+
+//--------------------------------------------------------------------
+//
+// ScheduleTrigger - Add a polled trigger (Processor, ThreadCpu, Commit,
+// ThreadCount, FileDescriptorCount or Timer) of a monitor to the
+// scheduler. It is first evaluated once BeginMonitoring has been called.
+//
+// Returns: 0 on success, non-zero on failure
+//
+//--------------------------------------------------------------------
+int ScheduleTrigger(struct ProcDumpConfiguration *self, enum TriggerType triggerType)
+{
+    struct ScheduledTrigger *task;
+
+    pthread_once(&schedulerOnce, StartTriggerScheduler);
+    if (schedulerStatus != 0)
+    {
+        Trace("ScheduleTrigger: the trigger scheduler is not running.");
+        return schedulerStatus;
+    }
+
+    task = new ScheduledTrigger();
+    task->config = self;
+    task->trigger = triggerType;
+    task->interval = self->PollingInterval;
+
+    switch (triggerType)
+    {
+        case Processor:
+            task->evaluate = EvaluateCpuTrigger;
+            task->sources = PROCESS_STAT_STAT;
+            task->writer = NewCoreDumpWriter(CPU, self);
+            break;
+#ifdef __linux__
+        case ThreadCpu:
+            task->evaluate = EvaluateThreadCpuTrigger;
+            task->sources = PROCESS_STAT_STAT;
+            task->writer = NewCoreDumpWriter(THREADCPU, self);
+            break;
+#endif
+        case Commit:
+            task->evaluate = EvaluateCommitTrigger;
+            task->sources = PROCESS_STAT_STAT;
+            task->writer = NewCoreDumpWriter(COMMIT, self);
+            break;
+        case ThreadCount:
+            task->evaluate = EvaluateThreadCountTrigger;
+            task->sources = PROCESS_STAT_STAT;
+            task->writer = NewCoreDumpWriter(THREAD, self);
+            break;
+        case FileDescriptorCount:
+            task->evaluate = EvaluateFileDescriptorCountTrigger;
+            task->sources = PROCESS_STAT_FDS;
+            task->writer = NewCoreDumpWriter(FILEDESC, self);
+            break;
+        case Timer:
+            task->evaluate = EvaluateTimerTrigger;
+            task->sources = 0;
+            task->writer = NewCoreDumpWriter(TIME, self);
+            task->interval = 0;
+            break;
+        default:
+            Trace("ScheduleTrigger: trigger %d is not a polled trigger.", triggerType);
+            delete task;
+            return -1;
+    }
+
+    pthread_mutex_lock(&schedulerMutex);
+
+    // Share the sample of the monitor's other triggers
+    for (auto other : scheduledTriggers)
+    {
+        if (other->config == self)
+        {
+            task->sample = other->sample;
+            break;
+        }
+    }
+
+    if (task->sample == NULL)
+    {
+        task->sample = new ProcessSample();
+        task->sample->phase = GetPollPhase(self->ProcessId, self->PollingInterval);
+#ifdef __linux__
+        InitProcessReader(&task->sample->reader, self->ProcessId);
+#endif
+    }
+
+    task->sample->refs++;
+    scheduledTriggers.push_back(task);
+    pthread_mutex_unlock(&schedulerMutex);
+
+    WakeTriggerScheduler();
+
+    return 0;
+}
+
+//--------------------------------------------------------------------
+//
+// WaitForScheduledTriggers - Wait until the scheduled triggers of a
+// monitor have stopped, then wait for their leak reports and release
+// them.
+//
+//--------------------------------------------------------------------
+void WaitForScheduledTriggers(struct ProcDumpConfiguration *self)
+{
+    std::vector<struct ScheduledTrigger*> done;
+
+    auto ownedBySelf = [self](struct ScheduledTrigger *task) { return task->config == self; };
+
+    pthread_mutex_lock(&schedulerMutex);
+    while (std::any_of(scheduledTriggers.begin(), scheduledTriggers.end(), ownedBySelf))
+    {
+        pthread_cond_wait(&retiredCond, &schedulerMutex);
+    }
+
+    auto it = std::stable_partition(retiredTriggers.begin(), retiredTriggers.end(), [self](struct ScheduledTrigger *task) { return task->config != self; });
+    done.assign(it, retiredTriggers.end());
+    retiredTriggers.erase(it, retiredTriggers.end());
+    pthread_mutex_unlock(&schedulerMutex);
+
+    for (auto task : done)
+    {
+        //
+        // Wait for the leak reporting threads to finish
+        //
+        WaitThreads(task->leakReportThreads);
+
+        if (--task->sample->refs == 0)
+        {
+#ifdef __linux__
+            CloseProcessReader(&task->sample->reader);
+#endif
+            delete task->sample;
+        }
+
+        free(task->writer);
+        delete task;
+    }
+}
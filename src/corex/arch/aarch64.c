@@ -88,3 +88,50 @@ size_t arch_fp_regset_size(void)
 {
     return sizeof(corex_fp_regs_t);
 }
+
+int arch_write_gp_regs(pid_t tid, const corex_gp_regs_t *regs)
+{
+    struct iovec iov;
+    iov.iov_base = (void *)regs;
+    iov.iov_len = sizeof(*regs);
+
+    if (ptrace(PTRACE_SETREGSET, tid, (void *)(uintptr_t)NT_PRSTATUS, &iov) < 0)
+        return -1;
+
+    return 0;
+}
+
+size_t arch_syscall_insn(uint8_t *insn, size_t *align)
+{
+    /* svc #0 (0xd4000001), little endian */
+    insn[0] = 0x01;
+    insn[1] = 0x00;
+    insn[2] = 0x00;
+    insn[3] = 0xd4;
+    *align = 4;
+    return 4;
+}
+
+void arch_setup_syscall(corex_gp_regs_t *regs, uint64_t addr, long nr,
+                        const uint64_t args[6])
+{
+    /*
+     * A stopped thread's pending restart has already been applied to
+     * pc/x0 by the time a tracer sees it, and moving pc away from the
+     * restart address cancels any further restart handling.
+     */
+    regs->pc = addr;
+    regs->regs[8] = (uint64_t)nr;
+    for (int i = 0; i < 6; i++)
+        regs->regs[i] = args[i];
+}
+
+int64_t arch_syscall_result(const corex_gp_regs_t *regs)
+{
+    return (int64_t)regs->regs[0];
+}
+
+uint64_t arch_stack_pointer(const corex_gp_regs_t *regs)
+{
+    return regs->sp;
+}
@@ -8,6 +8,8 @@
  *   - arch_read_fp_regs()
  *   - arch_fill_prstatus()
  *   - arch_get_elf_machine()
+ *   - arch_write_gp_regs() and the syscall injection helpers
+ *   - arch_stack_pointer()
  */
 #ifndef ARCH_H
 #define ARCH_H
@@ -66,4 +68,23 @@ uint16_t arch_get_elf_machine(void);
 /* Return the size of the FP register note data. */
 size_t arch_fp_regset_size(void);
 
+/* Write general-purpose registers of a stopped thread via ptrace.
+ * Returns 0 on success. */
+int arch_write_gp_regs(pid_t tid, const corex_gp_regs_t *regs);
+
+/* Store the machine code of the system call instruction in insn (at
+ * least 4 bytes) and its required alignment in *align. Returns its length. */
+size_t arch_syscall_insn(uint8_t *insn, size_t *align);
+
+/* Point regs at the system call instruction at addr, set up to perform
+ * system call nr with args[0..5]. Syscall restart is suppressed. */
+void arch_setup_syscall(corex_gp_regs_t *regs, uint64_t addr, long nr,
+                        const uint64_t args[6]);
+
+/* Return value (or -errno) of a system call that has just completed. */
+int64_t arch_syscall_result(const corex_gp_regs_t *regs);
+
+/* Stack pointer of a thread. */
+uint64_t arch_stack_pointer(const corex_gp_regs_t *regs);
+
 #endif /* ARCH_H */
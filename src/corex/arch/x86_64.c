@@ -76,3 +76,49 @@ size_t arch_fp_regset_size(void)
 {
     return sizeof(corex_fp_regs_t);
 }
+
+int arch_write_gp_regs(pid_t tid, const corex_gp_regs_t *regs)
+{
+    struct iovec iov;
+    iov.iov_base = (void *)regs;
+    iov.iov_len = sizeof(*regs);
+
+    if (ptrace(PTRACE_SETREGSET, tid, (void *)(uintptr_t)NT_PRSTATUS, &iov) < 0)
+        return -1;
+
+    return 0;
+}
+
+size_t arch_syscall_insn(uint8_t *insn, size_t *align)
+{
+    /* syscall */
+    insn[0] = 0x0f;
+    insn[1] = 0x05;
+    *align = 1;
+    return 2;
+}
+
+void arch_setup_syscall(corex_gp_regs_t *regs, uint64_t addr, long nr,
+                        const uint64_t args[6])
+{
+    regs->rip = addr;
+    regs->rax = (uint64_t)nr;
+    /* Not inside a system call: keeps the kernel from restarting one */
+    regs->orig_rax = (uint64_t)-1;
+    regs->rdi = args[0];
+    regs->rsi = args[1];
+    regs->rdx = args[2];
+    regs->r10 = args[3];
+    regs->r8 = args[4];
+    regs->r9 = args[5];
+}
+
+int64_t arch_syscall_result(const corex_gp_regs_t *regs)
+{
+    return (int64_t)regs->rax;
+}
+
+uint64_t arch_stack_pointer(const corex_gp_regs_t *regs)
+{
+    return regs->rsp;
+}
@@ -0,0 +1,380 @@
+/*
+ * budget.c - Fit a dump into a size limit (corex_options_t.max_size)
+ *
+ * When the process maps far more memory than may be written, the dump
+ * keeps what a debugger needs most: the stacks of all threads, then the
+ * writable data of the executable and its libraries (globals, GOT, the
+ * dynamic linker's state), then the ELF headers that let a debugger
+ * match libraries to their files, then the heap, then everything else.
+ * Mappings are included in that order as long as they fit, and the
+ * ones left out are listed in an NT_COREX_OMITTED note so that a reader
+ * can tell memory that was not dumped from memory that did not exist.
+ *
+ * The stacks-only mode (COREX_FLAG_STACKS) is the same selection cut off
+ * after the ELF headers, whatever their size.
+ *
+ * The same note lists the mappings a fork snapshot (COREX_FLAG_FORK)
+ * does not hold, see proc_info_omit_unforked().
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <elf.h>
+
+#include "corex_internal.h"
+#include "budget.h"
+#include "elf_writer.h"
+#include "corex/corex.h"
+
+#define COREX_PAGE_SIZE 4096
+
+/*
+ * Stack kept below the lowest stack pointer: the x86-64 red zone and
+ * anything a signal handler may have pushed since.
+ */
+#define STACK_SLACK COREX_PAGE_SIZE
+
+typedef struct {
+    int      index;     /* Into proc->mappings */
+    int      rank;      /* COREX_RANK_* */
+    uint64_t size;
+} candidate_t;
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_candidate(const void *a, const void *b)
+{
+    const candidate_t *x = a, *y = b;
+    if (x->rank != y->rank)
+        return x->rank - y->rank;
+    if (x->size != y->size)
+        return x->size < y->size ? -1 : 1;
+    return x->index - y->index;
+}
+
+/* Index of the mapping containing addr, or -1 */
+static int find_mapping(const corex_proc_info_t *proc, uint64_t addr)
+{
+    int lo = 0, hi = proc->num_mappings;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        const corex_mapping_t *m = &proc->mappings[mid];
+        if (addr < m->start)
+            hi = mid;
+        else if (addr >= m->end)
+            lo = mid + 1;
+        else
+            return mid;
+    }
+    return -1;
+}
+
+/*
+ * Split every dumped stack below the lowest stack pointer of the
+ * threads running on it; the part below is never dumped. The split
+ * addresses are stored, sorted, in *cuts.
+ */
+static int trim_stacks(corex_proc_info_t *proc,
+                       const corex_thread_state_t *threads, int num_threads,
+                       uint64_t **cuts, int *num_cuts)
+{
+    *cuts = NULL;
+    *num_cuts = 0;
+
+    uint64_t *low = malloc((size_t)proc->num_mappings * sizeof(*low) + 1);
+    uint64_t *out = malloc((size_t)num_threads * sizeof(*out) + 1);
+    if (!low || !out) {
+        corex_set_error("Failed to allocate stack table");
+        free(low);
+        free(out);
+        return COREX_ERR_ALLOC;
+    }
+    for (int i = 0; i < proc->num_mappings; i++)
+        low[i] = UINT64_MAX;
+
+    for (int t = 0; t < num_threads; t++) {
+        uint64_t sp = arch_stack_pointer(&threads[t].gp_regs);
+        int i = find_mapping(proc, sp);
+        if (i >= 0 && proc->mappings[i].should_dump && sp < low[i])
+            low[i] = sp;
+    }
+
+    /* From the top, so that splitting does not move the mappings still to visit */
+    int n = 0;
+    for (int i = proc->num_mappings - 1; i >= 0; i--) {
+        if (low[i] == UINT64_MAX)
+            continue;
+        uint64_t cut = (low[i] & ~(uint64_t)(COREX_PAGE_SIZE - 1)) - STACK_SLACK;
+        if (cut <= proc->mappings[i].start || cut >= low[i])
+            continue;
+
+        int rc = proc_info_split_mapping(proc, i, cut);
+        if (rc != 0) {
+            free(low);
+            free(out);
+            return rc;
+        }
+        proc->mappings[i].should_dump = 0;
+        out[n++] = cut;
+    }
+
+    free(low);
+    qsort(out, (size_t)n, sizeof(*out), cmp_u64);
+    *cuts = out;
+    *num_cuts = n;
+    return 0;
+}
+
+/* Non-zero if the mapping starts with an ELF header in the target's memory */
+static int has_elf_header(int mem_fd, const corex_mapping_t *m)
+{
+    unsigned char magic[SELFMAG];
+    return mem_fd >= 0 && m->is_file_backed && m->offset == 0 &&
+           pread(mem_fd, magic, sizeof(magic), (off_t)m->start) == (ssize_t)sizeof(magic) &&
+           memcmp(magic, ELFMAG, SELFMAG) == 0;
+}
+
+/*
+ * A debugger only needs the first page of a mapping starting with an
+ * ELF header (the program headers and build ID note); split it off so
+ * that the rest of the text is ranked on its own, as the kernel does.
+ */
+static int split_elf_headers(corex_proc_info_t *proc, int mem_fd)
+{
+    for (int i = 0; i < proc->num_mappings; i++) {
+        corex_mapping_t *m = &proc->mappings[i];
+        if (!m->should_dump || m->end - m->start <= COREX_PAGE_SIZE ||
+            !has_elf_header(mem_fd, m))
+            continue;
+
+        int rc = proc_info_split_mapping(proc, i, m->start + COREX_PAGE_SIZE);
+        if (rc != 0)
+            return rc;
+        i++;
+    }
+    return 0;
+}
+
+static int rank_mapping(const corex_proc_info_t *proc, int i, int mem_fd,
+                        const corex_thread_state_t *threads, int num_threads)
+{
+    const corex_mapping_t *m = &proc->mappings[i];
+    const corex_mapping_t *prev = i > 0 ? &proc->mappings[i - 1] : NULL;
+    const corex_mapping_t *next = i + 1 < proc->num_mappings ? &proc->mappings[i + 1] : NULL;
+
+    if (strcmp(m->path, "[stack]") == 0)
+        return COREX_RANK_STACK;
+    for (int t = 0; t < num_threads; t++) {
+        uint64_t sp = arch_stack_pointer(&threads[t].gp_regs);
+        if (sp >= m->start && sp < m->end)
+            return COREX_RANK_STACK;
+    }
+
+    /* .data and the .bss the loader maps anonymously right after it */
+    if ((m->flags & PF_W) && !m->is_shared) {
+        if (m->is_file_backed)
+            return COREX_RANK_IMAGE_DATA;
+        if (prev && prev->end == m->start && prev->is_file_backed &&
+            (prev->flags & PF_W) && m->path[0] == '\0')
+            return COREX_RANK_IMAGE_DATA;
+    }
+
+    /*
+     * The RELRO part just below the data, made read-only after relocation:
+     * the executable's .dynamic in it leads the debugger to the libraries.
+     */
+    if (next && m->is_file_backed && !(m->flags & (PF_W | PF_X)) &&
+        next->start == m->end && (next->flags & PF_W) && strcmp(next->path, m->path) == 0)
+        return COREX_RANK_IMAGE_DATA;
+
+    if (strcmp(m->path, "[vdso]") == 0 || has_elf_header(mem_fd, m))
+        return COREX_RANK_ELF_HEADER;
+
+    if (!m->is_file_backed && !m->is_shared)
+        return COREX_RANK_HEAP;
+
+    return COREX_RANK_OTHER;
+}
+
+static size_t omitted_note_size(int num_regions)
+{
+    /* Header, "COREX\0" padded to 8, descriptor */
+    return sizeof(Elf64_Nhdr) + 8 + sizeof(corex_omitted_note_t) +
+           (size_t)num_regions * sizeof(corex_omitted_region_t);
+}
+
+/*
+ * Add the NT_COREX_OMITTED note listing the mappings i with was_dumped[i]
+ * set and should_dump cleared, with their rank_of[i].
+ */
+static int add_omitted_note(const corex_proc_info_t *proc, const uint8_t *was_dumped,
+                            const uint32_t *rank_of, uint64_t max_size,
+                            corex_note_buf_t *notes)
+{
+    int num_omitted = 0;
+    for (int i = 0; i < proc->num_mappings; i++) {
+        if (was_dumped[i] && !proc->mappings[i].should_dump)
+            num_omitted++;
+    }
+
+    uint8_t *desc = note_reserve(notes, COREX_NOTE_NAME, NT_COREX_OMITTED,
+                                 sizeof(corex_omitted_note_t) +
+                                 (size_t)num_omitted * sizeof(corex_omitted_region_t));
+    if (!desc)
+        return COREX_ERR_ALLOC;
+
+    corex_omitted_note_t hdr = {
+        .version = COREX_OMITTED_VERSION,
+        .num_regions = (uint32_t)num_omitted,
+        .max_size = max_size,
+    };
+    memcpy(desc, &hdr, sizeof(hdr));
+
+    /* Ranks by mapping, for the note */
+    corex_omitted_region_t *region = (corex_omitted_region_t *)(desc + sizeof(hdr));
+    for (int i = 0, c = 0; i < proc->num_mappings; i++) {
+        const corex_mapping_t *m = &proc->mappings[i];
+        if (!was_dumped[i] || m->should_dump)
+            continue;
+
+        corex_omitted_region_t r = { m->start, m->end, m->flags, rank_of[i] };
+        memcpy(region + c++, &r, sizeof(r));
+    }
+    return 0;
+}
+
+int budget_select(pid_t pid, corex_proc_info_t *proc,
+                  const corex_thread_state_t *threads, int num_threads,
+                  uint64_t max_size, int max_rank, corex_note_buf_t *notes)
+{
+    candidate_t *cand = NULL;
+    uint8_t *was_dumped = NULL;
+    uint32_t *rank_of = NULL;
+    uint64_t *cuts = NULL;
+    int num_cuts = 0;
+
+    char mem_path[64];
+    snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
+    int mem_fd = open(mem_path, O_RDONLY);
+
+    int rc = trim_stacks(proc, threads, num_threads, &cuts, &num_cuts);
+    if (rc == 0)
+        rc = split_elf_headers(proc, mem_fd);
+    if (rc != 0)
+        goto out;
+
+    cand = malloc((size_t)proc->num_mappings * sizeof(*cand) + 1);
+    was_dumped = calloc((size_t)proc->num_mappings + 1, 1);
+    rank_of = malloc((size_t)proc->num_mappings * sizeof(*rank_of) + 1);
+    if (!cand || !was_dumped || !rank_of) {
+        corex_set_error("Failed to allocate mapping ranks");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+
+    int num_cand = 0, num_candidates_total = 0;
+    for (int i = 0; i < proc->num_mappings; i++) {
+        corex_mapping_t *m = &proc->mappings[i];
+
+        /* The lower part of a trimmed stack */
+        if (!m->should_dump &&
+            bsearch(&m->end, cuts, (size_t)num_cuts, sizeof(*cuts), cmp_u64)) {
+            was_dumped[i] = 1;
+            rank_of[i] = COREX_RANK_STACK;
+            num_candidates_total++;
+            continue;
+        }
+        /* Not in the fork snapshot, whatever the limit */
+        if (m->not_forked) {
+            was_dumped[i] = 1;
+            rank_of[i] = COREX_RANK_NOT_FORKED;
+            num_candidates_total++;
+            continue;
+        }
+        if (!m->should_dump)
+            continue;
+
+        was_dumped[i] = 1;
+        num_candidates_total++;
+        cand[num_cand].index = i;
+        cand[num_cand].rank = rank_mapping(proc, i, mem_fd, threads, num_threads);
+        cand[num_cand].size = m->end - m->start;
+        rank_of[i] = (uint32_t)cand[num_cand].rank;
+        num_cand++;
+    }
+
+    /*
+     * Bound the headers by assuming every candidate gets a PT_LOAD and
+     * every one is listed in the note as well; both are small next to
+     * the memory itself.
+     */
+    corex_note_buf_t bound = *notes;
+    bound.len += omitted_note_size(num_candidates_total);
+    uint64_t used = elf_headers_size(proc, &bound);
+    if (used > max_size) {
+        corex_set_error("Size limit of %llu bytes is below the %llu bytes of headers and notes",
+                        (unsigned long long)max_size, (unsigned long long)used);
+        rc = COREX_ERR_INVALID_ARG;
+        goto out;
+    }
+
+    /* Best first; a mapping that does not fit makes room for smaller ones */
+    qsort(cand, (size_t)num_cand, sizeof(*cand), cmp_candidate);
+    for (int c = 0; c < num_cand; c++) {
+        corex_mapping_t *m = &proc->mappings[cand[c].index];
+        if (cand[c].rank <= max_rank && cand[c].size <= max_size - used)
+            used += cand[c].size;
+        else
+            m->should_dump = 0;
+    }
+
+    rc = add_omitted_note(proc, was_dumped, rank_of, max_size, notes);
+
+out:
+    if (mem_fd >= 0)
+        close(mem_fd);
+    free(cand);
+    free(was_dumped);
+    free(rank_of);
+    free(cuts);
+    return rc;
+}
+
+int budget_note_unforked(const corex_proc_info_t *proc, corex_note_buf_t *notes)
+{
+    int num_unforked = 0;
+    for (int i = 0; i < proc->num_mappings; i++)
+        num_unforked += proc->mappings[i].not_forked;
+    if (num_unforked == 0)
+        return 0;
+
+    uint8_t *was_dumped = malloc((size_t)proc->num_mappings);
+    uint32_t *rank_of = malloc((size_t)proc->num_mappings * sizeof(*rank_of));
+    int rc = 0;
+    if (!was_dumped || !rank_of) {
+        corex_set_error("Failed to allocate mapping ranks");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+
+    for (int i = 0; i < proc->num_mappings; i++) {
+        was_dumped[i] = proc->mappings[i].not_forked;
+        rank_of[i] = COREX_RANK_NOT_FORKED;
+    }
+    rc = add_omitted_note(proc, was_dumped, rank_of, 0, notes);
+
+out:
+    free(was_dumped);
+    free(rank_of);
+    return rc;
+}
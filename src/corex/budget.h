@@ -0,0 +1,65 @@
+/*
+ * budget.h - Fit a dump into a size limit (corex_options_t.max_size)
+ */
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include "corex_internal.h"
+#include "proc_info.h"
+#include "note_builder.h"
+#include "ptrace_utils.h"
+
+#define COREX_OMITTED_VERSION 1
+
+/* Mapping ranks, most valuable first */
+#define COREX_RANK_STACK      0   /* Used part of a thread stack */
+#define COREX_RANK_IMAGE_DATA 1   /* Writable and RELRO data of the executable and libraries, .bss */
+#define COREX_RANK_ELF_HEADER 2   /* First page of a mapping starting with an ELF header, the vDSO */
+#define COREX_RANK_HEAP       3   /* Private anonymous memory */
+#define COREX_RANK_OTHER      4   /* Everything else coredump_filter allows */
+#define COREX_RANK_NOT_FORKED 5   /* Missing or wiped in a fork snapshot (MADV_DONTFORK, MADV_WIPEONFORK) */
+
+/*
+ * NT_COREX_OMITTED descriptor, followed by num_regions entries in
+ * address order.
+ */
+typedef struct {
+    uint32_t version;       /* COREX_OMITTED_VERSION */
+    uint32_t num_regions;
+    uint64_t max_size;      /* The limit the dump was fitted into, or 0 */
+} corex_omitted_note_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint32_t flags;         /* PF_R, PF_W, PF_X */
+    uint32_t rank;          /* COREX_RANK_* */
+} corex_omitted_region_t;
+
+/*
+ * Choose the mappings to dump so that the core file is at most max_size
+ * bytes: mappings are taken by rank, and smallest first within a rank,
+ * as long as they fit. Thread stacks are trimmed to the part below
+ * which the thread's stack pointer has not gone. Mappings left out get
+ * should_dump cleared and are listed in an NT_COREX_OMITTED note added
+ * to notes. Mappings ranked below max_rank are left out whatever the
+ * size; max_size may be UINT64_MAX. Mappings starting with an ELF header
+ * are cut to their first page. pid is the process whose memory is read.
+ * Mappings with not_forked set are listed in the note as well.
+ *
+ * Returns 0 on success, COREX_ERR_INVALID_ARG if not even the headers
+ * and notes fit.
+ */
+int budget_select(pid_t pid, corex_proc_info_t *proc,
+                  const corex_thread_state_t *threads, int num_threads,
+                  uint64_t max_size, int max_rank, corex_note_buf_t *notes);
+
+/*
+ * Without a size limit: list the mappings with not_forked set (see
+ * proc_info_omit_unforked()) in an NT_COREX_OMITTED note with a
+ * max_size of 0. Adds no note if there are none.
+ * Returns 0 on success.
+ */
+int budget_note_unforked(const corex_proc_info_t *proc, corex_note_buf_t *notes);
+
+#endif /* BUDGET_H */
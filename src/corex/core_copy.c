@@ -0,0 +1,564 @@
+/*
+ * core_copy.c - Copy a core written by the kernel (corex_copy_core)
+ *
+ * The kernel writes a core to a core_pattern pipe in file order: the
+ * ELF header, the program headers, the notes, then the PT_LOAD data,
+ * with zeros in place of what it would have left as holes in a file.
+ * The headers and notes are held in memory; the memory is streamed
+ * through, so a core of any size needs only a chunk of buffer.
+ *
+ * With a size limit, the least useful segments are dropped before the
+ * headers are written out, ranked as in budget.c with what the core
+ * itself tells: the threads' stack pointers from NT_PRSTATUS, and which
+ * segments are file-backed from NT_FILE. The remaining segments are
+ * moved up, and the dropped ones are listed in an NT_COREX_OMITTED note
+ * appended to the notes.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <elf.h>
+#include <sys/procfs.h>
+
+#include "corex_internal.h"
+#include "core_copy.h"
+#include "budget.h"
+#include "cxz.h"
+#include "elf_writer.h"
+#include "io_util.h"
+#include "note_builder.h"
+#include "stats.h"
+#include "arch/arch.h"
+#include "corex/corex.h"
+
+/* Most header and note bytes held in memory; larger cores are copied as they are */
+#define PREFIX_MAX ((uint64_t)256 << 20)
+
+#ifndef NT_FILE
+#define NT_FILE 0x46494c45
+#endif
+
+typedef struct {
+    int           fd;
+    int           stream;   /* Written in order, see io_is_stream() */
+    int           sparse;   /* Leave zero blocks as holes */
+    cxz_writer_t *cxz;      /* COREX_FLAG_COMPRESS, or NULL */
+    uint64_t      pos;      /* End of what has been written */
+} sink_t;
+
+typedef struct {
+    int      fd;
+    uint64_t pos;           /* Bytes consumed */
+} source_t;
+
+typedef struct {
+    int      index;         /* Into the program headers */
+    int      rank;          /* COREX_RANK_* */
+    uint64_t size;
+} segment_t;
+
+static uint64_t align_up(uint64_t val, uint64_t align)
+{
+    return (val + align - 1) & ~(align - 1);
+}
+
+/* Read exactly len bytes; running out of input is an error */
+static int source_read(source_t *in, void *buf, size_t len)
+{
+    ssize_t n = io_read_full(in->fd, buf, len);
+    if (n < 0)
+        return (int)n;
+    in->pos += (uint64_t)n;
+    if ((size_t)n < len) {
+        corex_set_error("Core ended early, at offset %llu", (unsigned long long)in->pos);
+        return COREX_ERR_PROC_READ;
+    }
+    return 0;
+}
+
+/* Read and discard input up to offset to */
+static int source_skip(source_t *in, uint64_t to, uint8_t *scratch)
+{
+    while (in->pos < to) {
+        uint64_t n = to - in->pos;
+        int rc = source_read(in, scratch, n > COREX_MEM_CHUNK_SIZE ? COREX_MEM_CHUNK_SIZE : (size_t)n);
+        if (rc != 0)
+            return rc;
+    }
+    return 0;
+}
+
+/* Write len bytes at offset off, at or after everything written so far */
+static int sink_write(sink_t *s, const uint8_t *buf, size_t len, uint64_t off)
+{
+    int rc = 0;
+    if (off > s->pos) {
+        if (s->cxz)
+            rc = cxz_writer_append(s->cxz, NULL, off - s->pos);
+        else if (s->stream)
+            rc = io_write_zeros(s->fd, off - s->pos);
+        if (rc != 0)
+            return rc;
+    }
+    s->pos = off + len;
+
+    if (s->cxz)
+        return cxz_writer_append(s->cxz, buf, len);
+    if (s->stream)
+        return io_write_full(s->fd, buf, len);
+    if (!s->sparse)
+        return io_pwrite_full(s->fd, buf, len, off);
+
+    size_t data = 0;
+    for (size_t pos = 0, end; pos < len && rc == 0; pos = end) {
+        pos = io_next_data_run(buf, len, pos, &end);
+        if (pos < len)
+            rc = io_pwrite_full(s->fd, buf + pos, end - pos, off + pos);
+        data += end - pos;
+    }
+    COREX_COUNT(bytes_skipped, len - data);
+    return rc;
+}
+
+/* Pad the output to size bytes and complete it */
+static int sink_finish(sink_t *s, uint64_t size, const corex_options_t *opts)
+{
+    int rc = 0;
+    if (size > s->pos && (s->cxz || s->stream)) {
+        rc = s->cxz ? cxz_writer_append(s->cxz, NULL, size - s->pos)
+                    : io_write_zeros(s->fd, size - s->pos);
+    }
+    if (rc != 0)
+        return rc;
+
+    if (s->cxz) {
+        rc = cxz_writer_finish(s->cxz, &size);
+        if (rc != 0)
+            return rc;
+    }
+    return elf_finish_output(s->fd, size, opts);
+}
+
+/*
+ * Copy the input as it is, up to limit bytes (0 for no limit), after
+ * the len bytes already read into buf.
+ */
+static int copy_raw(source_t *in, sink_t *out, const uint8_t *buf, size_t len,
+                    uint8_t *chunk, uint64_t limit, const corex_options_t *opts)
+{
+    if (limit && len > limit)
+        len = (size_t)limit;
+    int rc = sink_write(out, buf, len, 0);
+
+    uint64_t size = len;
+    while (rc == 0 && (!limit || size < limit)) {
+        size_t want = COREX_MEM_CHUNK_SIZE;
+        if (limit && limit - size < want)
+            want = (size_t)(limit - size);
+
+        ssize_t n = io_read_full(in->fd, chunk, want);
+        if (n <= 0) {
+            rc = (int)n;
+            break;
+        }
+        rc = sink_write(out, chunk, (size_t)n, size);
+        size += (uint64_t)n;
+    }
+    return rc == 0 ? sink_finish(out, size, opts) : rc;
+}
+
+/* Stack pointers from the NT_PRSTATUS notes, and the NT_FILE table */
+static int scan_notes(const uint8_t *prefix, const Elf64_Phdr *note,
+                      uint64_t **sps, int *num_sps,
+                      const uint64_t **files, uint64_t *num_files)
+{
+    *sps = NULL;
+    *num_sps = 0;
+    *files = NULL;
+    *num_files = 0;
+
+    int cap = 0;
+    const uint8_t *p = prefix + note->p_offset;
+    const uint8_t *end = p + note->p_filesz;
+    while ((size_t)(end - p) >= sizeof(Elf64_Nhdr)) {
+        const Elf64_Nhdr *nh = (const Elf64_Nhdr *)p;
+        const uint8_t *desc = p + sizeof(*nh) + align_up(nh->n_namesz, 4);
+        if (desc > end || (size_t)(end - desc) < nh->n_descsz)
+            break;
+
+        if (nh->n_type == NT_PRSTATUS && nh->n_descsz >= sizeof(struct elf_prstatus)) {
+            if (*num_sps == cap) {
+                cap = cap ? cap * 2 : 64;
+                uint64_t *grown = realloc(*sps, (size_t)cap * sizeof(**sps));
+                if (!grown) {
+                    corex_set_error("Failed to allocate stack pointer table");
+                    return COREX_ERR_ALLOC;
+                }
+                *sps = grown;
+            }
+            struct elf_prstatus prs;
+            corex_gp_regs_t regs;
+            memcpy(&prs, desc, sizeof(prs));
+            memcpy(&regs, &prs.pr_reg, sizeof(regs) < sizeof(prs.pr_reg) ? sizeof(regs) : sizeof(prs.pr_reg));
+            (*sps)[(*num_sps)++] = arch_stack_pointer(&regs);
+        } else if (nh->n_type == NT_FILE && nh->n_descsz >= 2 * sizeof(uint64_t)) {
+            /* count, page size, then count (start, end, page offset) triples */
+            uint64_t count;
+            memcpy(&count, desc, sizeof(count));
+            if (count <= (nh->n_descsz - 2 * sizeof(uint64_t)) / (3 * sizeof(uint64_t))) {
+                *files = (const uint64_t *)(desc + 2 * sizeof(uint64_t));
+                *num_files = count;
+            }
+        }
+        size_t skip = align_up(nh->n_descsz, 4);
+        if ((size_t)(end - desc) <= skip)
+            break;
+        p = desc + skip;
+    }
+    return 0;
+}
+
+/* NT_FILE entry containing addr, or NULL */
+static const uint64_t *find_file(const uint64_t *files, uint64_t num_files, uint64_t addr)
+{
+    uint64_t lo = 0, hi = num_files;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        const uint64_t *f = files + 3 * mid;
+        if (addr < f[0])
+            hi = mid;
+        else if (addr >= f[1])
+            lo = mid + 1;
+        else
+            return f;
+    }
+    return NULL;
+}
+
+static int rank_segment(const Elf64_Phdr *ph, const Elf64_Phdr *prev,
+                        const uint64_t *sps, int num_sps,
+                        const uint64_t *files, uint64_t num_files)
+{
+    for (int t = 0; t < num_sps; t++) {
+        if (sps[t] >= ph->p_vaddr && sps[t] < ph->p_vaddr + ph->p_memsz)
+            return COREX_RANK_STACK;
+    }
+
+    const uint64_t *file = find_file(files, num_files, ph->p_vaddr);
+    if (file) {
+        if (ph->p_flags & PF_W)
+            return COREX_RANK_IMAGE_DATA;
+        /* Read-only file mappings are only dumped for their ELF header */
+        return file[2] == 0 ? COREX_RANK_ELF_HEADER : COREX_RANK_OTHER;
+    }
+
+    if (ph->p_flags & PF_W) {
+        /* .bss, right after the data of the same image */
+        if (prev && prev->p_vaddr + prev->p_memsz == ph->p_vaddr && (prev->p_flags & PF_W) &&
+            find_file(files, num_files, prev->p_vaddr))
+            return COREX_RANK_IMAGE_DATA;
+        return COREX_RANK_HEAP;
+    }
+    return COREX_RANK_OTHER;
+}
+
+static int cmp_segment(const void *a, const void *b)
+{
+    const segment_t *x = a, *y = b;
+    if (x->rank != y->rank)
+        return x->rank - y->rank;
+    if (x->size != y->size)
+        return x->size < y->size ? -1 : 1;
+    return x->index - y->index;
+}
+
+/*
+ * Drop the segments that do not fit in max_size: clear keep[i] and add
+ * them to an NT_COREX_OMITTED note in notes. head_size is the size of
+ * everything before the PT_LOAD data, without that note.
+ */
+static int select_segments(const uint8_t *prefix, const Elf64_Phdr *phdrs, int phnum,
+                           const Elf64_Phdr *note, uint64_t head_size, uint64_t page,
+                           uint64_t max_size, uint8_t *keep, corex_note_buf_t *notes)
+{
+    uint64_t *sps = NULL;
+    int num_sps = 0;
+    const uint64_t *files = NULL;
+    uint64_t num_files = 0;
+    segment_t *seg = malloc((size_t)phnum * sizeof(*seg) + 1);
+    uint32_t *rank_of = malloc((size_t)phnum * sizeof(*rank_of) + 1);
+    if (!seg || !rank_of) {
+        free(seg);
+        free(rank_of);
+        corex_set_error("Failed to allocate segment ranks");
+        return COREX_ERR_ALLOC;
+    }
+
+    int rc = scan_notes(prefix, note, &sps, &num_sps, &files, &num_files);
+    if (rc != 0)
+        goto out;
+
+    int num_seg = 0;
+    const Elf64_Phdr *prev = NULL;
+    for (int i = 0; i < phnum; i++) {
+        if (phdrs[i].p_type != PT_LOAD)
+            continue;
+        seg[num_seg].index = i;
+        seg[num_seg].rank = rank_segment(&phdrs[i], prev, sps, num_sps, files, num_files);
+        seg[num_seg].size = phdrs[i].p_filesz;
+        rank_of[i] = (uint32_t)seg[num_seg].rank;
+        num_seg++;
+        prev = &phdrs[i];
+    }
+
+    /* As in budget_select(), assume the worst case for the note */
+    uint64_t used = align_up(head_size + sizeof(Elf64_Nhdr) + 8 + sizeof(corex_omitted_note_t) +
+                             (uint64_t)num_seg * sizeof(corex_omitted_region_t), page);
+    if (used > max_size) {
+        corex_set_error("Size limit of %llu bytes is below the %llu bytes of headers and notes",
+                        (unsigned long long)max_size, (unsigned long long)used);
+        rc = COREX_ERR_INVALID_ARG;
+        goto out;
+    }
+
+    qsort(seg, (size_t)num_seg, sizeof(*seg), cmp_segment);
+    int num_omitted = 0;
+    for (int s = 0; s < num_seg; s++) {
+        uint64_t size = align_up(seg[s].size, page);
+        if (size <= max_size - used) {
+            used += size;
+        } else {
+            keep[seg[s].index] = 0;
+            num_omitted++;
+        }
+    }
+
+    uint8_t *desc = note_reserve(notes, COREX_NOTE_NAME, NT_COREX_OMITTED,
+                                 sizeof(corex_omitted_note_t) +
+                                 (size_t)num_omitted * sizeof(corex_omitted_region_t));
+    if (!desc) {
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+
+    corex_omitted_note_t hdr = {
+        .version = COREX_OMITTED_VERSION,
+        .num_regions = (uint32_t)num_omitted,
+        .max_size = max_size,
+    };
+    memcpy(desc, &hdr, sizeof(hdr));
+
+    /* In address order, which is program header order */
+    corex_omitted_region_t *region = (corex_omitted_region_t *)(desc + sizeof(hdr));
+    for (int i = 0, c = 0; i < phnum; i++) {
+        if (phdrs[i].p_type != PT_LOAD || keep[i])
+            continue;
+
+        corex_omitted_region_t r = { phdrs[i].p_vaddr, phdrs[i].p_vaddr + phdrs[i].p_memsz,
+                                     phdrs[i].p_flags, rank_of[i] };
+        memcpy(region + c++, &r, sizeof(r));
+    }
+
+out:
+    free(sps);
+    free(seg);
+    free(rank_of);
+    return rc;
+}
+
+int core_copy(int input_fd, const corex_options_t *opts)
+{
+    source_t in = { input_fd, 0 };
+    sink_t out;
+    memset(&out, 0, sizeof(out));
+
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint8_t *prefix = NULL, *head = NULL, *keep = NULL;
+    corex_note_buf_t notes = { 0 };
+    cxz_writer_t cxz;
+    int cxz_ready = 0;
+
+    uint8_t *chunk = io_alloc_buffer(COREX_MEM_CHUNK_SIZE);
+    if (!chunk) {
+        corex_set_error("Failed to allocate copy buffer");
+        return COREX_ERR_ALLOC;
+    }
+
+    int fd = elf_open_output(opts->output_path, opts);
+    if (fd < 0) {
+        free(chunk);
+        return fd;
+    }
+    out.fd = fd;
+    out.stream = io_is_stream(fd);
+    out.sparse = (opts->flags & COREX_FLAG_SPARSE) != 0;
+
+    int rc = 0;
+    if (opts->flags & COREX_FLAG_COMPRESS) {
+        rc = cxz_writer_init(&cxz, fd, opts->num_writers > 1 ? opts->num_writers : 1);
+        if (rc != 0)
+            goto out;
+        cxz_ready = 1;
+        out.cxz = &cxz;
+    }
+
+    Elf64_Ehdr eh;
+    rc = source_read(&in, &eh, sizeof(eh));
+    if (rc != 0)
+        goto out;
+    if (memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0 || eh.e_ident[EI_CLASS] != ELFCLASS64 ||
+        eh.e_type != ET_CORE || eh.e_phentsize != sizeof(Elf64_Phdr) || eh.e_phoff < sizeof(eh)) {
+        corex_set_error("Input is not a 64-bit ELF core");
+        rc = COREX_ERR_INVALID_ARG;
+        goto out;
+    }
+
+    /*
+     * More than PN_XNUM segments are counted in a section header the
+     * kernel writes at the very end; such cores are copied as they are.
+     */
+    int phnum = eh.e_phnum;
+    uint64_t phdr_end = eh.e_phoff + (uint64_t)phnum * sizeof(Elf64_Phdr);
+    if (phnum == 0 || phnum == PN_XNUM || phdr_end > PREFIX_MAX) {
+        rc = copy_raw(&in, &out, (const uint8_t *)&eh, sizeof(eh), chunk, opts->max_size, opts);
+        goto out;
+    }
+
+    prefix = malloc(phdr_end);
+    if (!prefix) {
+        corex_set_error("Failed to allocate core headers");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+    memcpy(prefix, &eh, sizeof(eh));
+    rc = source_read(&in, prefix + sizeof(eh), phdr_end - sizeof(eh));
+    if (rc != 0)
+        goto out;
+
+    /*
+     * Everything but the PT_LOAD data comes first, and the data follows
+     * in order; the note segment must end the headers for a note to be
+     * added to it.
+     */
+    Elf64_Phdr *phdrs = (Elf64_Phdr *)(prefix + eh.e_phoff);
+    uint64_t head_size = phdr_end, data_end = 0;
+    int note = -1, in_order = 1;
+    for (int i = 0; i < phnum; i++) {
+        uint64_t end = phdrs[i].p_offset + phdrs[i].p_filesz;
+        if (phdrs[i].p_type != PT_LOAD) {
+            if (end > head_size)
+                head_size = end;
+            if (phdrs[i].p_type == PT_NOTE)
+                note = i;
+        } else if (phdrs[i].p_filesz) {
+            in_order &= phdrs[i].p_offset >= data_end;
+            data_end = end;
+        }
+    }
+    for (int i = 0; i < phnum; i++) {
+        if (phdrs[i].p_type == PT_LOAD && phdrs[i].p_filesz && phdrs[i].p_offset < head_size)
+            in_order = 0;
+    }
+    if (!in_order || head_size > PREFIX_MAX ||
+        (opts->max_size && (note < 0 || phdrs[note].p_offset + phdrs[note].p_filesz != head_size))) {
+        rc = copy_raw(&in, &out, prefix, phdr_end, chunk, opts->max_size, opts);
+        goto out;
+    }
+
+    uint8_t *grown = realloc(prefix, head_size);
+    if (!grown) {
+        corex_set_error("Failed to allocate core notes");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+    prefix = grown;
+    phdrs = (Elf64_Phdr *)(prefix + eh.e_phoff);
+    rc = source_read(&in, prefix + phdr_end, head_size - phdr_end);
+    if (rc != 0)
+        goto out;
+
+    keep = malloc((size_t)phnum);
+    if (!keep) {
+        corex_set_error("Failed to allocate segment table");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+    memset(keep, 1, (size_t)phnum);
+
+    /* Without a limit, the layout is the kernel's */
+    uint64_t core_size = head_size > data_end ? head_size : data_end;
+    if (opts->max_size) {
+        rc = note_buf_init(&notes);
+        if (rc == 0)
+            rc = select_segments(prefix, phdrs, phnum, &phdrs[note], head_size, page,
+                                 opts->max_size, keep, &notes);
+        if (rc != 0)
+            goto out;
+
+        head = malloc(head_size + notes.len);
+        if (!head) {
+            corex_set_error("Failed to allocate core headers");
+            rc = COREX_ERR_ALLOC;
+            goto out;
+        }
+        memcpy(head, prefix, head_size);
+        memcpy(head + head_size, notes.data, notes.len);
+
+        Elf64_Phdr *out_phdrs = (Elf64_Phdr *)(head + eh.e_phoff);
+        out_phdrs[note].p_filesz += notes.len;
+        uint64_t off = align_up(head_size + notes.len, page);
+        for (int i = 0; i < phnum; i++) {
+            if (out_phdrs[i].p_type != PT_LOAD)
+                continue;
+            if (!keep[i])
+                out_phdrs[i].p_filesz = 0;
+            out_phdrs[i].p_offset = off;
+            off += align_up(out_phdrs[i].p_filesz, page);
+        }
+        core_size = off;
+        rc = sink_write(&out, head, head_size + notes.len, 0);
+    } else {
+        rc = sink_write(&out, prefix, head_size, 0);
+    }
+    if (rc != 0)
+        goto out;
+
+    /* phdrs keeps the input layout, out_phdrs has the output's */
+    const Elf64_Phdr *out_phdrs = (const Elf64_Phdr *)((head ? head : prefix) + eh.e_phoff);
+    for (int i = 0; i < phnum && rc == 0; i++) {
+        if (phdrs[i].p_type != PT_LOAD || phdrs[i].p_filesz == 0)
+            continue;
+
+        rc = source_skip(&in, phdrs[i].p_offset, chunk);
+        for (uint64_t done = 0; rc == 0 && done < phdrs[i].p_filesz; ) {
+            uint64_t n = phdrs[i].p_filesz - done;
+            if (n > COREX_MEM_CHUNK_SIZE)
+                n = COREX_MEM_CHUNK_SIZE;
+            rc = source_read(&in, chunk, (size_t)n);
+            if (rc == 0 && keep[i])
+                rc = sink_write(&out, chunk, (size_t)n, out_phdrs[i].p_offset + done);
+            done += n;
+        }
+    }
+
+    /* Whatever the kernel writes after the last segment is not needed */
+    if (rc == 0)
+        rc = sink_finish(&out, core_size, opts);
+
+out:
+    if (cxz_ready)
+        cxz_writer_free(&cxz);
+    elf_close_output(fd, opts->output_path, rc != 0, opts);
+    if (notes.data)
+        note_buf_free(&notes);
+    free(keep);
+    free(head);
+    free(prefix);
+    free(chunk);
+    return rc;
+}
@@ -0,0 +1,17 @@
+/*
+ * core_copy.h - Copy a core written by the kernel (corex_copy_core)
+ */
+#ifndef CORE_COPY_H
+#define CORE_COPY_H
+
+#include "corex_internal.h"
+#include "corex/corex.h"
+
+/*
+ * See corex_copy_core(). opts has been checked by the caller.
+ *
+ * Returns 0 on success.
+ */
+int core_copy(int input_fd, const corex_options_t *opts);
+
+#endif /* CORE_COPY_H */
@@ -12,6 +12,7 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
 #include <errno.h>
 
 #include "corex_internal.h"
@@ -19,6 +20,14 @@
 #include "ptrace_utils.h"
 #include "note_builder.h"
 #include "elf_writer.h"
+#include "precopy.h"
+#include "inject.h"
+#include "delta.h"
+#include "freezer.h"
+#include "cxz.h"
+#include "budget.h"
+#include "core_copy.h"
+#include "stats.h"
 #include <sys/prctl.h>
 #include "corex/corex.h"
 
@@ -38,6 +47,129 @@ const char *corex_strerror(void)
     return corex_errbuf[0] ? corex_errbuf : "No error";
 }
 
+/*
+ * Apply /proc/[pid]/coredump_filter to decide which mappings to dump
+ * (sets should_dump on every mapping of proc).
+ */
+static void apply_dump_filter(pid_t pid, corex_proc_info_t *proc,
+                              const corex_options_t *opts)
+{
+    if (opts->flags & COREX_FLAG_IGNORE_COREDUMP_FILTER)
+        return;
+
+    uint32_t filter = proc->coredump_filter;
+
+    /*
+     * Open /proc/[pid]/mem for reading ELF magic when checking
+     * the ELF-header-pages override (bit 4 of coredump_filter).
+     */
+    char mem_path[64];
+    int mem_fd = -1;
+    if (filter & (1U << 4)) {
+        snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
+        mem_fd = open(mem_path, O_RDONLY);
+    }
+
+    for (int i = 0; i < proc->num_mappings; i++) {
+        corex_mapping_t *m = &proc->mappings[i];
+        /*
+         * coredump_filter bits (from kernel docs):
+         *   bit 0: anonymous private
+         *   bit 1: anonymous shared
+         *   bit 2: file-backed private
+         *   bit 3: file-backed shared
+         *   bit 4: ELF header pages
+         *   bit 5: hugetlb private
+         *   bit 6: hugetlb shared
+         *   bit 7: DAX private
+         *   bit 8: DAX shared
+         *
+         * DAX mappings cannot be told from /proc and go by bits 2 and 3.
+         * hugetlb mappings go by bits 5 and 6 alone, like in the kernel.
+         */
+        if (m->hugetlb_page_size) {
+            m->should_dump = (filter & (1U << (m->is_shared ? 6 : 5))) ? 1 : 0;
+            continue;
+        }
+
+        int bit;
+        if (m->is_file_backed) {
+            bit = m->is_shared ? 3 : 2;
+        } else {
+            bit = m->is_shared ? 1 : 0;
+        }
+        m->should_dump = (filter & (1U << bit)) ? 1 : 0;
+
+        if (m->should_dump)
+            continue;
+
+        /*
+         * Always dump writable segments even when filtered by
+         * coredump_filter. These contain modified program state
+         * (GOT/PLT, .data, .bss, dynamic linker r_debug) that
+         * GDB needs to discover shared libraries and resolve
+         * symbols. The kernel similarly dumps these pages.
+         */
+        if (m->flags & PF_W) {
+            m->should_dump = 1;
+            continue;
+        }
+
+        /*
+         * Always dump all main executable mappings. The
+         * .dynamic section (typically in a read-only page) is
+         * written to at runtime by the dynamic linker (DT_DEBUG),
+         * so the kernel COWs the page. COW'd pages are effectively
+         * anonymous and must come from the core. Without .dynamic,
+         * GDB cannot discover shared libraries.
+         */
+        if (m->path[0] != '\0' &&
+            strcmp(m->path, proc->exe) == 0) {
+            m->should_dump = 1;
+            continue;
+        }
+
+        /*
+         * Bit 4: ELF header pages. Dump file-backed mappings at
+         * file offset 0 that actually contain an ELF header.
+         * Only the first page is needed for GDB shared-library
+         * discovery, but since corex works at mapping granularity,
+         * we verify that the mapping genuinely starts with the
+         * ELF magic bytes to avoid pulling in large non-ELF
+         * file-backed mappings (e.g. locale-archive).
+         */
+        if ((filter & (1U << 4)) && m->is_file_backed &&
+            m->offset == 0 && mem_fd >= 0) {
+            unsigned char magic[4] = {0};
+            if (pread(mem_fd, magic, 4, (off_t)m->start) == 4 &&
+                magic[0] == 0x7f && magic[1] == 'E' &&
+                magic[2] == 'L'  && magic[3] == 'F') {
+                m->should_dump = 1;
+            }
+        }
+    }
+
+    if (mem_fd >= 0)
+        close(mem_fd);
+}
+
+/*
+ * Move the state of thread tid to the front of threads, keeping the
+ * order of the others. Nothing happens if tid is not one of them.
+ */
+static void move_thread_first(corex_thread_state_t *threads, int num_threads,
+                              pid_t tid)
+{
+    for (int i = 1; i < num_threads; i++) {
+        if (threads[i].tid == tid) {
+            corex_thread_state_t first = threads[i];
+            memmove(&threads[1], &threads[0], (size_t)i * sizeof(*threads));
+            threads[0] = first;
+            return;
+        }
+    }
+}
+
 /*
  * Core dump implementation for an external process.
  * Attaches to all threads via ptrace, captures state, writes the core,
@@ -49,7 +181,18 @@ static int do_dump_pid(pid_t pid, const corex_options_t *opts)
     corex_proc_info_t *proc = NULL;
     corex_thread_state_t *threads = NULL;
     corex_note_buf_t notes = {0};
+    corex_precopy_t *precopy = NULL;
     int attached = 0;
+    pid_t mem_pid = pid;
+    pid_t child = 0;
+    uint64_t insn_addr = 0;
+    corex_freezer_t freezer = {0};
+    corex_stats_t st = {0};
+    corex_stats_scope_t scope;
+    uint64_t t, stop_ns = 0;
+
+    stats_begin(&scope);
+    t = scope.start_ns;
 
     proc = calloc(1, sizeof(*proc));
     if (!proc) {
@@ -58,158 +201,46 @@ static int do_dump_pid(pid_t pid, const corex_options_t *opts)
         goto cleanup;
     }
 
-    /* Step 1: Attach to all threads (stops them) */
-    /*
-     * We need to read thread list before attaching. To read /proc/[pid]/task
-     * we first do a partial proc_info_read just for threads. But since the
-     * process may be running, we first attach to the main thread, then
-     * enumerate threads, then attach to the rest.
-     */
-
-    /* First, enumerate threads while process is running.
-     * Some threads may appear/disappear, but that's a race we accept. */
-    {
-        /* Quick thread enumeration */
-        char task_path[64];
-        snprintf(task_path, sizeof(task_path), "/proc/%d/task", (int)pid);
-        /* We'll use the full proc_info_read after attaching for everything else,
-         * but we need TIDs now for attaching. */
-        proc->pid = pid;
-
-        /* Read just the thread list */
-        DIR *d = opendir(task_path);
-        if (!d) {
-            corex_set_error("Failed to open %s: %s", task_path, strerror(errno));
-            rc = COREX_ERR_PROC_READ;
+    /* Step 0 (live mode): copy most of the memory while the process runs */
+    if (opts->flags & COREX_FLAG_LIVE) {
+        rc = proc_info_read(pid, proc, opts->flags);
+        if (rc != 0)
             goto cleanup;
-        }
-        proc->num_threads = 0;
-        struct dirent *ent;
-        while ((ent = readdir(d))) {
-            if (ent->d_name[0] == '.') continue;
-            if (proc->num_threads >= COREX_MAX_THREADS) break;
-            pid_t tid = (pid_t)atoi(ent->d_name);
-            if (tid > 0)
-                proc->tids[proc->num_threads++] = tid;
-        }
-        closedir(d);
+        apply_dump_filter(pid, proc, opts);
 
-        if (proc->num_threads == 0) {
-            corex_set_error("No threads found for PID %d", (int)pid);
-            rc = COREX_ERR_NO_THREADS;
+        rc = precopy_start(pid, proc, opts, &precopy);
+        stats_phase(&t, &st.precopy_ns);
+        if (rc < 0)
             goto cleanup;
-        }
     }
 
-    /* Attach to all threads */
-    rc = ptrace_attach_all(proc);
+    /* Step 1a (freeze mode): stop all threads at once by freezing the
+     * process's cgroup. If that is not possible, ptrace stops them. */
+    stop_ns = stats_now_ns();
+    if (opts->flags & COREX_FLAG_FREEZE)
+        freezer_freeze(pid, &freezer);
+
+    /* Step 1: Attach to all threads (stops them). Threads are seized and
+     * interrupted in batches until the task list stops changing. */
+    proc->pid = pid;
+    rc = ptrace_attach_all(pid, proc);
+    stats_phase(&t, &st.attach_ns);
     if (rc != 0)
         goto cleanup;
     attached = 1;
 
-    /* Step 2: Read full process info (now that the process is stopped)
-     * Save the TID list first — proc_info_read() does memset(info, 0, ...)
-     * which would wipe the TIDs we already attached to. If a /proc read
-     * fails partway through, we need the original TIDs for ptrace detach. */
-    int saved_num_threads = proc->num_threads;
-    pid_t saved_tids[COREX_MAX_THREADS];
-    memcpy(saved_tids, proc->tids, sizeof(pid_t) * (size_t)saved_num_threads);
-
-    rc = proc_info_read(pid, proc);
-    if (rc != 0) {
-        /* Restore TIDs so cleanup can detach properly */
-        proc->num_threads = saved_num_threads;
-        memcpy(proc->tids, saved_tids, sizeof(pid_t) * (size_t)saved_num_threads);
+    /* Step 2: Read full process info (now that the process is stopped).
+     * The thread list is the one we attached to: threads that could not
+     * be stopped must not come back. On failure proc_info_read() leaves
+     * proc, and so those TIDs, untouched for the detach in cleanup. */
+    rc = proc_info_read(pid, proc, opts->flags | COREX_PROC_KEEP_THREADS);
+    stats_phase(&t, &st.proc_info_ns);
+    if (rc != 0)
         goto cleanup;
-    }
 
     /* Step 2b: Apply coredump_filter to decide which mappings to dump */
-    if (!(opts->flags & COREX_FLAG_IGNORE_COREDUMP_FILTER)) {
-        uint32_t filter = proc->coredump_filter;
-
-        /*
-         * Open /proc/[pid]/mem for reading ELF magic when checking
-         * the ELF-header-pages override (bit 4 of coredump_filter).
-         */
-        char mem_path[64];
-        int mem_fd = -1;
-        if (filter & (1U << 4)) {
-            snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
-            mem_fd = open(mem_path, O_RDONLY);
-        }
-
-        for (int i = 0; i < proc->num_mappings; i++) {
-            corex_mapping_t *m = &proc->mappings[i];
-            /*
-             * coredump_filter bits (from kernel docs):
-             *   bit 0: anonymous private
-             *   bit 1: anonymous shared
-             *   bit 2: file-backed private
-             *   bit 3: file-backed shared
-             *   bit 4: ELF header pages
-             *   bit 5: DAX private
-             *   bit 6: DAX shared
-             */
-            int bit;
-            if (m->is_file_backed) {
-                bit = m->is_shared ? 3 : 2;
-            } else {
-                bit = m->is_shared ? 1 : 0;
-            }
-            m->should_dump = (filter & (1U << bit)) ? 1 : 0;
-
-            if (m->should_dump)
-                continue;
-
-            /*
-             * Always dump writable segments even when filtered by
-             * coredump_filter. These contain modified program state
-             * (GOT/PLT, .data, .bss, dynamic linker r_debug) that
-             * GDB needs to discover shared libraries and resolve
-             * symbols. The kernel similarly dumps these pages.
-             */
-            if (m->flags & PF_W) {
-                m->should_dump = 1;
-                continue;
-            }
-
-            /*
-             * Always dump all main executable mappings. The
-             * .dynamic section (typically in a read-only page) is
-             * written to at runtime by the dynamic linker (DT_DEBUG),
-             * so the kernel COWs the page. COW'd pages are effectively
-             * anonymous and must come from the core. Without .dynamic,
-             * GDB cannot discover shared libraries.
-             */
-            if (m->path[0] != '\0' &&
-                strcmp(m->path, proc->exe) == 0) {
-                m->should_dump = 1;
-                continue;
-            }
-
-            /*
-             * Bit 4: ELF header pages. Dump file-backed mappings at
-             * file offset 0 that actually contain an ELF header.
-             * Only the first page is needed for GDB shared-library
-             * discovery, but since corex works at mapping granularity,
-             * we verify that the mapping genuinely starts with the
-             * ELF magic bytes to avoid pulling in large non-ELF
-             * file-backed mappings (e.g. locale-archive).
-             */
-            if ((filter & (1U << 4)) && m->is_file_backed &&
-                m->offset == 0 && mem_fd >= 0) {
-                unsigned char magic[4] = {0};
-                if (pread(mem_fd, magic, 4, (off_t)m->start) == 4 &&
-                    magic[0] == 0x7f && magic[1] == 'E' &&
-                    magic[2] == 'L'  && magic[3] == 'F') {
-                    m->should_dump = 1;
-                }
-            }
-        }
-
-        if (mem_fd >= 0)
-            close(mem_fd);
-    }
+    apply_dump_filter(pid, proc, opts);
+    stats_phase(&t, &st.filter_ns);
 
     /* Step 3: Read registers for all threads */
     threads = calloc((size_t)proc->num_threads, sizeof(*threads));
@@ -220,39 +251,165 @@ static int do_dump_pid(pid_t pid, const corex_options_t *opts)
     }
 
     rc = ptrace_read_all_regs(proc, threads);
+    stats_phase(&t, &st.regs_ns);
     if (rc != 0)
         goto cleanup;
 
-    /* Step 4: Build note segment */
+    /*
+     * Step 3b (fork mode): make the process fork a copy-on-write image of
+     * itself and let it run on. Memory is read from the stopped child;
+     * registers and notes come from the parent's threads. If the fork
+     * cannot be injected, the process stays stopped for a regular dump.
+     * The fork has to run, so a frozen cgroup is thawed first; the
+     * threads stay stopped by ptrace.
+     */
+    if (opts->flags & COREX_FLAG_FORK)
+        freezer_thaw(&freezer);
+    if ((opts->flags & COREX_FLAG_FORK) &&
+        inject_find_syscall_insn(pid, proc, &insn_addr) == 0 &&
+        inject_fork(proc->tids[0], insn_addr, &proc->stop_sigs[0], &child) == 0) {
+        ptrace_detach_all(proc);
+        attached = 0;
+        mem_pid = child;
+        st.stopped_ns = stats_now_ns() - stop_ns;
+
+        /* The child lacks MADV_DONTFORK mappings and has MADV_WIPEONFORK
+         * ones zeroed: those are left out and listed as omitted. Found in
+         * the child's smaps, so the process need not stay stopped. */
+        rc = proc_info_omit_unforked(child, proc);
+        if (rc != 0)
+            goto cleanup;
+    }
+    if (opts->flags & COREX_FLAG_FORK)
+        stats_phase(&t, &st.fork_ns);
+
+    /* Step 4: Build note segment. Debuggers select the thread of the
+     * first NT_PRSTATUS, so opts->first_tid is moved to the front. */
+    if (opts->first_tid > 0)
+        move_thread_first(threads, proc->num_threads, opts->first_tid);
+
     rc = note_buf_init(&notes);
     if (rc != 0)
         goto cleanup;
 
     rc = note_build_all(&notes, proc, threads, proc->num_threads);
+    stats_phase(&t, &st.notes_ns);
     if (rc != 0)
         goto cleanup;
 
-    /* Step 5: Write ELF core file */
-    rc = elf_write_core(opts->output_path, pid, proc, &notes);
+    /* Step 4b (size limit, stacks only): keep the most useful mappings */
+    if (opts->max_size || (opts->flags & COREX_FLAG_STACKS)) {
+        rc = budget_select(mem_pid, proc, threads, proc->num_threads,
+                           opts->max_size ? opts->max_size : UINT64_MAX,
+                           (opts->flags & COREX_FLAG_STACKS) ? COREX_RANK_ELF_HEADER
+                                                             : COREX_RANK_OTHER,
+                           &notes);
+        stats_phase(&t, &st.filter_ns);
+        if (rc != 0)
+            goto cleanup;
+    } else if (mem_pid != pid) {
+        rc = budget_note_unforked(proc, &notes);
+        if (rc != 0)
+            goto cleanup;
+    }
+
+    /* Step 5: Write ELF core file (live mode: only what is left) */
+    rc = COREX_PRECOPY_UNAVAILABLE;
+    if (precopy) {
+        rc = precopy_finish(precopy, proc, &notes, opts);
+        precopy_free(precopy);
+        precopy = NULL;
+    }
+    if (rc == COREX_PRECOPY_UNAVAILABLE) {
+        if (opts->flags & COREX_FLAG_DIFF)
+            rc = delta_write_core(opts->output_path, mem_pid, proc, &notes, opts);
+        else if (opts->flags & COREX_FLAG_COMPRESS)
+            rc = cxz_write_core(opts->output_path, mem_pid, proc, &notes, opts);
+        else
+            rc = elf_write_core(opts->output_path, mem_pid, proc, &notes, opts);
+    }
+    stats_phase(&t, &st.write_ns);
 
 cleanup:
     if (attached)
         ptrace_detach_all(proc);
+    freezer_thaw(&freezer);
+    if (stop_ns && !st.stopped_ns)
+        st.stopped_ns = stats_now_ns() - stop_ns;
+    if (child > 0)
+        inject_release_child(proc->tids[0], insn_addr, child);
 
+    precopy_free(precopy);
     note_buf_free(&notes);
     free(threads);
+    if (proc)
+        proc_info_free(proc);
     free(proc);
 
+    stats_end(&scope, &st);
+    if (opts->stats)
+        *opts->stats = st;
     return rc;
 }
 
-int corex_dump_pid(pid_t pid, const corex_options_t *opts)
+/*
+ * Validate caller-supplied options shared by both entry points.
+ */
+static int check_options(const corex_options_t *opts)
 {
-    if (!opts || !opts->output_path) {
+    if (!opts || (!opts->output_path && !(opts->flags & COREX_FLAG_OUTPUT_FD))) {
         corex_set_error("Invalid arguments: opts and output_path are required");
         return COREX_ERR_INVALID_ARG;
     }
 
+    if ((opts->flags & COREX_FLAG_OUTPUT_FD) && opts->output_fd < 0) {
+        corex_set_error("Invalid output descriptor: %d", opts->output_fd);
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    if (opts->num_writers < 0 || opts->num_writers > COREX_MAX_WRITERS) {
+        corex_set_error("Invalid writer thread count: %d (max %d)",
+                        opts->num_writers, COREX_MAX_WRITERS);
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    if ((opts->flags & COREX_FLAG_LIVE) &&
+        (opts->flags & (COREX_FLAG_FORK | COREX_FLAG_DIFF))) {
+        corex_set_error("Live dumps cannot be combined with fork or differential dumps");
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    if ((opts->flags & COREX_FLAG_COMPRESS) &&
+        (opts->flags & (COREX_FLAG_LIVE | COREX_FLAG_DIFF))) {
+        corex_set_error("Compressed dumps cannot be combined with live or differential dumps");
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    if ((opts->max_size || (opts->flags & COREX_FLAG_STACKS)) &&
+        (opts->flags & COREX_FLAG_LIVE)) {
+        corex_set_error("Live dumps cannot be limited in size or to stacks");
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    /* Live and differential dumps go back to earlier parts of a named file */
+    if (opts->flags & (COREX_FLAG_LIVE | COREX_FLAG_DIFF)) {
+        struct stat st;
+        if ((opts->flags & COREX_FLAG_OUTPUT_FD) ||
+            (stat(opts->output_path, &st) == 0 && !S_ISREG(st.st_mode))) {
+            corex_set_error("Live and differential dumps must be written to a regular file");
+            return COREX_ERR_INVALID_ARG;
+        }
+    }
+
+    return 0;
+}
+
+int corex_dump_pid(pid_t pid, const corex_options_t *opts)
+{
+    int rc = check_options(opts);
+    if (rc != 0)
+        return rc;
+
     if (pid <= 0) {
         corex_set_error("Invalid PID: %d", (int)pid);
         return COREX_ERR_INVALID_ARG;
@@ -261,13 +418,44 @@ int corex_dump_pid(pid_t pid, const corex_options_t *opts)
     return do_dump_pid(pid, opts);
 }
 
-int corex_dump_self(const corex_options_t *opts)
+int corex_copy_core(int input_fd, const corex_options_t *opts)
 {
-    if (!opts || !opts->output_path) {
-        corex_set_error("Invalid arguments: opts and output_path are required");
+    int rc = check_options(opts);
+    if (rc != 0)
+        return rc;
+
+    if (input_fd < 0) {
+        corex_set_error("Invalid input descriptor: %d", input_fd);
         return COREX_ERR_INVALID_ARG;
     }
 
+    /* The process is gone; only what is done to its core applies */
+    if (opts->flags & (COREX_FLAG_LIVE | COREX_FLAG_FORK | COREX_FLAG_DIFF |
+                       COREX_FLAG_FREEZE | COREX_FLAG_STACKS)) {
+        corex_set_error("Live, fork, differential, freeze and stacks-only modes do not apply to a copied core");
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    corex_stats_t st = {0};
+    corex_stats_scope_t scope;
+    stats_begin(&scope);
+    uint64_t t = scope.start_ns;
+
+    rc = core_copy(input_fd, opts);
+
+    stats_phase(&t, &st.write_ns);
+    stats_end(&scope, &st);
+    if (opts->stats)
+        *opts->stats = st;
+    return rc;
+}
+
+int corex_dump_self(const corex_options_t *opts)
+{
+    int rc = check_options(opts);
+    if (rc != 0)
+        return rc;
+
     pid_t parent = getpid();
 
     /*
@@ -295,7 +483,7 @@ int corex_dump_self(const corex_options_t *opts)
         /* Child: dump the parent */
         close(pipefd[0]);
 
-        int rc = do_dump_pid(parent, opts);
+        rc = do_dump_pid(parent, opts);
 
         /* Write the result code back to the parent */
         ssize_t w;
@@ -315,6 +503,13 @@ int corex_dump_self(const corex_options_t *opts)
             } while (w < 0 && errno == EINTR);
         }
 
+        /* And the statistics, which were filled in in the child's memory */
+        if (opts->stats) {
+            do {
+                w = write(pipefd[1], opts->stats, sizeof(*opts->stats));
+            } while (w < 0 && errno == EINTR);
+        }
+
         close(pipefd[1]);
         _exit(rc == 0 ? 0 : 1);
     }
@@ -349,6 +544,14 @@ int corex_dump_self(const corex_options_t *opts)
             corex_set_error("%s", errbuf);
         }
     }
+    if (opts->stats) {
+        corex_stats_t st;
+        do {
+            r = read(pipefd[0], &st, sizeof(st));
+        } while (r < 0 && errno == EINTR);
+        if (r == (ssize_t)sizeof(st))
+            *opts->stats = st;
+    }
     close(pipefd[0]);
 
     /* Revoke ptrace permission */
@@ -360,3 +563,23 @@ int corex_dump_self(const corex_options_t *opts)
 
     return result;
 }
+
+int corex_rebuild(const char *delta_path, const char *output_path)
+{
+    if (!delta_path || !output_path) {
+        corex_set_error("Invalid arguments: delta_path and output_path are required");
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    int fd = open(delta_path, O_RDONLY);
+    if (fd < 0) {
+        corex_set_error("Failed to open %s: %s", delta_path, strerror(errno));
+        return COREX_ERR_OPEN_FAILED;
+    }
+    int compressed = cxz_probe(fd);
+    close(fd);
+
+    if (compressed)
+        return cxz_expand(delta_path, output_path);
+    return delta_rebuild(delta_path, output_path);
+}
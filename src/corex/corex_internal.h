@@ -18,12 +18,6 @@ extern _Thread_local char corex_errbuf[COREX_ERR_BUF_SIZE];
 
 void corex_set_error(const char *fmt, ...);
 
-/* Maximum number of threads we track */
-#define COREX_MAX_THREADS 1024
-
-/* Maximum number of memory mappings */
-#define COREX_MAX_MAPPINGS 4096
-
 /* Chunk size for streaming memory to file (1 MB) */
 #define COREX_MEM_CHUNK_SIZE (1 << 20)
 
@@ -0,0 +1,147 @@
+/*
+ * cxz.h - Chunked, compressed core container (COREX_FLAG_COMPRESS)
+ */
+#ifndef CXZ_H
+#define CXZ_H
+
+#include <pthread.h>
+
+#include "corex_internal.h"
+#include "proc_info.h"
+#include "note_builder.h"
+#include "stats.h"
+#include "corex/corex.h"
+
+/*
+ * File layout (little endian):
+ *
+ *   cxz_header_t
+ *   chunk data, in order
+ *   cxz_chunk_t index[num_chunks]
+ *   cxz_trailer_t
+ *
+ * The container holds a plain ELF core (the "logical" file) cut into
+ * chunks of chunk_size bytes, the last one possibly shorter, each
+ * compressed on its own. The index is written last so the container
+ * can be produced in a single sequential pass; readers locate it
+ * through the trailer at the end of the file.
+ */
+#define CXZ_MAGIC           "CXZCORE1"
+#define CXZ_TRAILER_MAGIC   "CXZINDEX"
+#define CXZ_VERSION         1
+
+/* Logical bytes per chunk */
+#define CXZ_CHUNK_SIZE      COREX_MEM_CHUNK_SIZE
+
+/* zlib level: dumps are written while the target is stopped, so favour speed */
+#define CXZ_LEVEL           1
+
+/* Chunk encodings */
+#define CXZ_CHUNK_ZLIB      0   /* zlib stream (compress2) */
+#define CXZ_CHUNK_STORED    1   /* Raw bytes, data did not compress */
+#define CXZ_CHUNK_ZERO      2   /* All zeros, nothing stored */
+
+typedef struct {
+    char     magic[8];      /* CXZ_MAGIC */
+    uint32_t version;       /* CXZ_VERSION */
+    uint32_t chunk_size;
+    uint32_t level;         /* zlib level used, informational */
+    uint32_t reserved[3];
+} cxz_header_t;
+
+typedef struct {
+    uint64_t offset;        /* File offset of the chunk's data */
+    uint32_t size;          /* Stored bytes */
+    uint32_t type;          /* CXZ_CHUNK_* */
+} cxz_chunk_t;
+
+typedef struct {
+    uint64_t index_offset;  /* File offset of the chunk index */
+    uint64_t num_chunks;
+    uint64_t logical_size;  /* Size of the uncompressed core */
+    char     magic[8];      /* CXZ_TRAILER_MAGIC */
+} cxz_trailer_t;
+
+/*
+ * Container writer. The calling thread appends the logical core in
+ * order; compressor threads compress and append the chunks.
+ */
+
+/* Slot states */
+#define CXZ_SLOT_FREE    0  /* Available to the producer */
+#define CXZ_SLOT_FILLED  1  /* Waiting for a compressor */
+#define CXZ_SLOT_BUSY    2  /* Being compressed */
+#define CXZ_SLOT_DONE    3  /* Compressed, waiting to be written */
+
+typedef struct {
+    uint8_t *in;            /* Logical bytes */
+    size_t   in_len;
+    uint8_t *out;           /* Compressed bytes */
+    size_t   out_len;
+    uint32_t type;          /* CXZ_CHUNK_* */
+    int      state;
+} cxz_slot_t;
+
+typedef struct {
+    int              fd;
+    int              stream;        /* fd cannot seek, see io_is_stream() */
+    uint64_t         out_offset;    /* End of the data written so far */
+    uint64_t         logical_size;
+
+    cxz_slot_t      *slots;
+    size_t           num_slots;
+    size_t           out_cap;       /* compressBound(CXZ_CHUNK_SIZE) */
+    uint64_t         next_fill;     /* Chunk the producer is filling */
+    uint64_t         next_compress; /* Next chunk for a compressor */
+    uint64_t         next_write;    /* Next chunk to append to the file */
+    int              writing;       /* A thread is appending chunks */
+    int              stop;
+
+    cxz_chunk_t     *index;         /* index[0..next_write) */
+    size_t           index_cap;
+
+    pthread_t       *threads;
+    int              num_threads;
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+
+    int              rc;            /* First error, 0 if none */
+    char             errmsg[COREX_ERR_BUF_SIZE];
+    corex_counters_t *counters;     /* Of the thread that started the writer */
+} cxz_writer_t;
+
+/*
+ * Start a container on fd (which may be a stream): write the header and
+ * start num_threads compressors. Returns 0 on success.
+ */
+int cxz_writer_init(cxz_writer_t *w, int fd, int num_threads);
+
+/* Append len logical bytes from buf, or zeros if buf is NULL. Returns 0 on success. */
+int cxz_writer_append(cxz_writer_t *w, const uint8_t *buf, uint64_t len);
+
+/* Flush the last chunk, then write the index and trailer. Returns 0 on success. */
+int cxz_writer_finish(cxz_writer_t *w, uint64_t *file_size);
+
+/* Stop the compressors and release the writer */
+void cxz_writer_free(cxz_writer_t *w);
+
+/*
+ * Write a core dump of pid like elf_write_core(), as a container.
+ * Chunks are compressed by opts->num_writers threads (at least one)
+ * while the calling thread reads the target's memory.
+ *
+ * Returns 0 on success.
+ */
+int cxz_write_core(const char *path,
+                   pid_t pid,
+                   const corex_proc_info_t *proc,
+                   const corex_note_buf_t *notes,
+                   const corex_options_t *opts);
+
+/* Non-zero if the file at fd starts with CXZ_MAGIC */
+int cxz_probe(int fd);
+
+/* See corex_rebuild(): expand a container into a plain (sparse) ELF core */
+int cxz_expand(const char *path, const char *output_path);
+
+#endif /* CXZ_H */
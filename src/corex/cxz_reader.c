@@ -0,0 +1,365 @@
+/*
+ * cxz_reader.c - Random access to compressed core containers
+ *
+ * The trailer locates the chunk index, so any logical offset maps to
+ * one chunk that is decompressed on its own. The most recently used
+ * chunk is kept, which makes sequential reads of small objects (as a
+ * debugger walking a heap does) cost one decompression per chunk.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <elf.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "corex_internal.h"
+#include "cxz.h"
+#include "io_util.h"
+#include "corex/corex.h"
+
+struct corex_cxz {
+    int          fd;
+    uint32_t     chunk_size;
+    uint64_t     logical_size;
+    cxz_chunk_t *index;
+    uint64_t     num_chunks;
+
+    uint8_t     *cache;         /* Decompressed chunk cached_chunk */
+    uint64_t     cached_chunk;  /* UINT64_MAX if none */
+    uint8_t     *zbuf;          /* Compressed bytes of one chunk */
+
+    Elf64_Phdr  *loads;         /* PT_LOADs by address, read on first use */
+    size_t       num_loads;
+    int          loads_read;
+};
+
+int cxz_probe(int fd)
+{
+    char magic[8];
+    return pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) &&
+           memcmp(magic, CXZ_MAGIC, sizeof(magic)) == 0;
+}
+
+corex_cxz_t *corex_cxz_open(const char *path)
+{
+    if (!path) {
+        corex_set_error("Invalid arguments: path is required");
+        return NULL;
+    }
+
+    corex_cxz_t *cxz = calloc(1, sizeof(*cxz));
+    if (!cxz) {
+        corex_set_error("Failed to allocate container reader");
+        return NULL;
+    }
+    cxz->cached_chunk = UINT64_MAX;
+
+    cxz->fd = open(path, O_RDONLY);
+    if (cxz->fd < 0) {
+        corex_set_error("Failed to open %s: %s", path, strerror(errno));
+        free(cxz);
+        return NULL;
+    }
+
+    struct stat st;
+    cxz_header_t hdr;
+    cxz_trailer_t trailer;
+    if (fstat(cxz->fd, &st) < 0 || (uint64_t)st.st_size < sizeof(hdr) + sizeof(trailer) ||
+        pread(cxz->fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        pread(cxz->fd, &trailer, sizeof(trailer), st.st_size - (off_t)sizeof(trailer)) !=
+            (ssize_t)sizeof(trailer) ||
+        memcmp(hdr.magic, CXZ_MAGIC, sizeof(hdr.magic)) != 0 ||
+        memcmp(trailer.magic, CXZ_TRAILER_MAGIC, sizeof(trailer.magic)) != 0) {
+        corex_set_error("%s is not a complete compressed core", path);
+        goto fail;
+    }
+
+    uint64_t index_end = (uint64_t)st.st_size - sizeof(trailer);
+    if (hdr.version != CXZ_VERSION || hdr.chunk_size == 0 ||
+        trailer.index_offset > index_end ||
+        trailer.num_chunks != (index_end - trailer.index_offset) / sizeof(cxz_chunk_t) ||
+        trailer.num_chunks != (trailer.logical_size + hdr.chunk_size - 1) / hdr.chunk_size) {
+        corex_set_error("Unsupported compressed core format in %s", path);
+        goto fail;
+    }
+    cxz->chunk_size = hdr.chunk_size;
+    cxz->logical_size = trailer.logical_size;
+    cxz->num_chunks = trailer.num_chunks;
+
+    size_t index_size = (size_t)cxz->num_chunks * sizeof(cxz_chunk_t);
+    cxz->index = malloc(index_size ? index_size : 1);
+    cxz->cache = malloc(cxz->chunk_size);
+    cxz->zbuf = malloc(compressBound(cxz->chunk_size));
+    if (!cxz->index || !cxz->cache || !cxz->zbuf) {
+        corex_set_error("Failed to allocate container buffers");
+        goto fail;
+    }
+    if (pread(cxz->fd, cxz->index, index_size, (off_t)trailer.index_offset) !=
+        (ssize_t)index_size) {
+        corex_set_error("Failed to read chunk index of %s", path);
+        goto fail;
+    }
+
+    for (uint64_t i = 0; i < cxz->num_chunks; i++) {
+        const cxz_chunk_t *c = &cxz->index[i];
+        if (c->type > CXZ_CHUNK_ZERO || c->size > compressBound(cxz->chunk_size) ||
+            c->offset + c->size > trailer.index_offset) {
+            corex_set_error("Corrupt chunk index in %s", path);
+            goto fail;
+        }
+    }
+    return cxz;
+
+fail:
+    corex_cxz_close(cxz);
+    return NULL;
+}
+
+void corex_cxz_close(corex_cxz_t *cxz)
+{
+    if (!cxz)
+        return;
+    if (cxz->fd >= 0)
+        close(cxz->fd);
+    free(cxz->index);
+    free(cxz->cache);
+    free(cxz->zbuf);
+    free(cxz->loads);
+    free(cxz);
+}
+
+uint64_t corex_cxz_size(const corex_cxz_t *cxz)
+{
+    return cxz->logical_size;
+}
+
+/* Logical bytes held by chunk i */
+static size_t chunk_len(const corex_cxz_t *cxz, uint64_t i)
+{
+    uint64_t start = i * cxz->chunk_size;
+    uint64_t left = cxz->logical_size - start;
+    return left < cxz->chunk_size ? (size_t)left : cxz->chunk_size;
+}
+
+/* Decompress chunk i into the cache (zeros included) */
+static int load_chunk(corex_cxz_t *cxz, uint64_t i)
+{
+    if (cxz->cached_chunk == i)
+        return 0;
+
+    const cxz_chunk_t *c = &cxz->index[i];
+    size_t len = chunk_len(cxz, i);
+    cxz->cached_chunk = UINT64_MAX;
+
+    if (c->type == CXZ_CHUNK_ZERO) {
+        memset(cxz->cache, 0, len);
+    } else {
+        uint8_t *dst = c->type == CXZ_CHUNK_STORED ? cxz->cache : cxz->zbuf;
+        if (pread(cxz->fd, dst, c->size, (off_t)c->offset) != (ssize_t)c->size) {
+            corex_set_error("Failed to read chunk %llu: %s", (unsigned long long)i,
+                            strerror(errno));
+            return COREX_ERR_PROC_READ;
+        }
+
+        uLongf out = (uLongf)len;
+        if ((c->type == CXZ_CHUNK_STORED && c->size != len) ||
+            (c->type == CXZ_CHUNK_ZLIB &&
+             (uncompress(cxz->cache, &out, cxz->zbuf, c->size) != Z_OK || out != len))) {
+            corex_set_error("Corrupt chunk %llu", (unsigned long long)i);
+            return COREX_ERR_INVALID_ARG;
+        }
+    }
+
+    cxz->cached_chunk = i;
+    return 0;
+}
+
+ssize_t corex_cxz_read(corex_cxz_t *cxz, uint64_t offset, void *buf, size_t size)
+{
+    if (offset >= cxz->logical_size)
+        return 0;
+    if (size > cxz->logical_size - offset)
+        size = (size_t)(cxz->logical_size - offset);
+
+    uint8_t *p = buf;
+    for (size_t done = 0; done < size; ) {
+        uint64_t pos = offset + done;
+        uint64_t i = pos / cxz->chunk_size;
+        size_t in_chunk = (size_t)(pos % cxz->chunk_size);
+        size_t n = chunk_len(cxz, i) - in_chunk;
+        if (n > size - done)
+            n = size - done;
+
+        /* Zero chunks need no cache slot */
+        if (cxz->index[i].type == CXZ_CHUNK_ZERO) {
+            memset(p + done, 0, n);
+        } else {
+            int rc = load_chunk(cxz, i);
+            if (rc != 0)
+                return rc;
+            memcpy(p + done, cxz->cache + in_chunk, n);
+        }
+        done += n;
+    }
+    return (ssize_t)size;
+}
+
+static int cmp_load_vaddr(const void *a, const void *b)
+{
+    const Elf64_Phdr *x = a, *y = b;
+    return x->p_vaddr < y->p_vaddr ? -1 : x->p_vaddr > y->p_vaddr;
+}
+
+/* Read the PT_LOAD headers of the logical core */
+static int read_loads(corex_cxz_t *cxz)
+{
+    Elf64_Ehdr ehdr;
+    if (corex_cxz_read(cxz, 0, &ehdr, sizeof(ehdr)) != (ssize_t)sizeof(ehdr) ||
+        memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr.e_ident[EI_CLASS] != ELFCLASS64 || ehdr.e_phentsize != sizeof(Elf64_Phdr)) {
+        corex_set_error("Container does not hold a 64-bit ELF core");
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    /* Extended numbering: the real count is in section header 0 */
+    size_t num_phdrs = ehdr.e_phnum;
+    if (ehdr.e_phnum == PN_XNUM) {
+        Elf64_Shdr shdr;
+        if (ehdr.e_shoff == 0 ||
+            corex_cxz_read(cxz, ehdr.e_shoff, &shdr, sizeof(shdr)) != (ssize_t)sizeof(shdr)) {
+            corex_set_error("Failed to read section header 0");
+            return COREX_ERR_INVALID_ARG;
+        }
+        num_phdrs = shdr.sh_info;
+    }
+
+    size_t bytes = num_phdrs * sizeof(Elf64_Phdr);
+    Elf64_Phdr *phdrs = malloc(bytes ? bytes : 1);
+    if (!phdrs) {
+        corex_set_error("Failed to allocate program headers");
+        return COREX_ERR_ALLOC;
+    }
+    if (corex_cxz_read(cxz, ehdr.e_phoff, phdrs, bytes) != (ssize_t)bytes) {
+        corex_set_error("Failed to read program headers");
+        free(phdrs);
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < num_phdrs; i++) {
+        if (phdrs[i].p_type == PT_LOAD)
+            phdrs[n++] = phdrs[i];
+    }
+    qsort(phdrs, n, sizeof(*phdrs), cmp_load_vaddr);
+    cxz->loads = phdrs;
+    cxz->num_loads = n;
+    cxz->loads_read = 1;
+    return 0;
+}
+
+/* PT_LOAD whose range contains addr */
+static const Elf64_Phdr *find_load(const corex_cxz_t *cxz, uint64_t addr)
+{
+    size_t lo = 0, hi = cxz->num_loads;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const Elf64_Phdr *ph = &cxz->loads[mid];
+        if (addr < ph->p_vaddr)
+            hi = mid;
+        else if (addr - ph->p_vaddr >= ph->p_memsz)
+            lo = mid + 1;
+        else
+            return ph;
+    }
+    return NULL;
+}
+
+ssize_t corex_cxz_read_vaddr(corex_cxz_t *cxz, uint64_t vaddr, void *buf, size_t size)
+{
+    if (!cxz->loads_read) {
+        int rc = read_loads(cxz);
+        if (rc != 0)
+            return rc;
+    }
+
+    uint8_t *p = buf;
+    size_t done = 0;
+    while (done < size) {
+        uint64_t addr = vaddr + done;
+        const Elf64_Phdr *ph = find_load(cxz, addr);
+        if (!ph)
+            break;
+
+        uint64_t in_seg = addr - ph->p_vaddr;
+        size_t n = (size_t)(ph->p_memsz - in_seg);
+        if (n > size - done)
+            n = size - done;
+
+        /* Memory past p_filesz was not dumped and reads as zeros */
+        size_t from_file = in_seg < ph->p_filesz ? (size_t)(ph->p_filesz - in_seg) : 0;
+        if (from_file > n)
+            from_file = n;
+        if (from_file > 0) {
+            ssize_t r = corex_cxz_read(cxz, ph->p_offset + in_seg, p + done, from_file);
+            if (r < 0)
+                return r;
+            memset(p + done + r, 0, from_file - (size_t)r);
+        }
+        memset(p + done + from_file, 0, n - from_file);
+        done += n;
+    }
+
+    if (done == 0 && size > 0) {
+        corex_set_error("Address 0x%llx is not in the core", (unsigned long long)vaddr);
+        return COREX_ERR_INVALID_ARG;
+    }
+    return (ssize_t)done;
+}
+
+int cxz_expand(const char *path, const char *output_path)
+{
+    corex_cxz_t *cxz = corex_cxz_open(path);
+    if (!cxz)
+        return COREX_ERR_INVALID_ARG;
+
+    int rc = 0;
+    int out_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (out_fd < 0) {
+        corex_set_error("Failed to create %s: %s", output_path, strerror(errno));
+        rc = COREX_ERR_OPEN_FAILED;
+        goto out;
+    }
+
+    /* Zero chunks and zero runs in the others stay holes */
+    for (uint64_t i = 0; i < cxz->num_chunks && rc == 0; i++) {
+        if (cxz->index[i].type == CXZ_CHUNK_ZERO)
+            continue;
+        rc = load_chunk(cxz, i);
+
+        size_t len = chunk_len(cxz, i), pos = 0, end;
+        uint64_t base = i * cxz->chunk_size;
+        while (rc == 0 && (pos = io_next_data_run(cxz->cache, len, pos, &end)) < len) {
+            rc = io_pwrite_full(out_fd, cxz->cache + pos, end - pos, base + pos);
+            pos = end;
+        }
+    }
+    if (rc == 0 && ftruncate(out_fd, (off_t)cxz->logical_size) < 0) {
+        corex_set_error("Failed to set core file size: %s", strerror(errno));
+        rc = COREX_ERR_WRITE;
+    }
+
+out:
+    if (out_fd >= 0)
+        close(out_fd);
+    if (rc != 0)
+        unlink(output_path);
+    corex_cxz_close(cxz);
+    return rc;
+}
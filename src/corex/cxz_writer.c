@@ -0,0 +1,419 @@
+/*
+ * cxz_writer.c - Write a core dump as a chunked, compressed container
+ *
+ * The calling thread produces the logical core (headers, then PT_LOAD
+ * data read from the target) into a ring of chunk slots. Compressor
+ * threads take filled slots in order, compress them, and whichever
+ * finishes the oldest outstanding slot appends it to the file, so the
+ * output is written sequentially and in chunk order. The producer only
+ * waits when every slot is in use. Since the header comes first and the
+ * index last, the container can be written to a pipe or socket as well.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <zlib.h>
+
+#include "corex_internal.h"
+#include "cxz.h"
+#include "elf_writer.h"
+#include "mem_reader.h"
+#include "io_util.h"
+#include "corex/corex.h"
+
+/*
+ * Record the first failure. corex_set_error() is thread-local, so the
+ * message is kept in the writer and re-raised on the calling thread.
+ * Called with the lock held.
+ */
+static void writer_fail(cxz_writer_t *w, int rc, const char *fmt, ...)
+{
+    if (w->rc != 0)
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(w->errmsg, sizeof(w->errmsg), fmt, ap);
+    va_end(ap);
+    w->rc = rc;
+}
+
+/* Write len bytes at offset off, which is the end of the output so far */
+static int writer_output(const cxz_writer_t *w, const void *buf, size_t len, uint64_t off)
+{
+    if (w->stream)
+        return io_write_full(w->fd, buf, len);
+    return io_pwrite_full(w->fd, buf, len, off);
+}
+
+static void compress_slot(cxz_slot_t *s)
+{
+    int zero = s->in_len == 0 || (s->in[0] == 0 && memcmp(s->in, s->in + 1, s->in_len - 1) == 0);
+    if (zero) {
+        s->type = CXZ_CHUNK_ZERO;
+        s->out_len = 0;
+        return;
+    }
+
+    uLongf len = (uLongf)compressBound((uLong)s->in_len);
+    if (compress2(s->out, &len, s->in, (uLong)s->in_len, CXZ_LEVEL) == Z_OK &&
+        len < s->in_len) {
+        s->type = CXZ_CHUNK_ZLIB;
+        s->out_len = len;
+    } else {
+        s->type = CXZ_CHUNK_STORED;
+        s->out_len = s->in_len;
+    }
+}
+
+/*
+ * Append finished chunks to the file in order. Only one thread does so
+ * at a time; the lock is dropped while writing. Called with the lock held.
+ */
+static void write_done_slots(cxz_writer_t *w)
+{
+    if (w->writing)
+        return;
+    w->writing = 1;
+
+    while (w->next_write < w->next_compress) {
+        cxz_slot_t *s = &w->slots[w->next_write % w->num_slots];
+        if (s->state != CXZ_SLOT_DONE)
+            break;
+
+        if (w->next_write == w->index_cap) {
+            size_t cap = w->index_cap ? w->index_cap * 2 : 1024;
+            cxz_chunk_t *index = realloc(w->index, cap * sizeof(*index));
+            if (!index)
+                writer_fail(w, COREX_ERR_ALLOC, "Failed to allocate chunk index");
+            else {
+                w->index = index;
+                w->index_cap = cap;
+            }
+        }
+
+        if (w->rc == 0) {
+            const void *data = s->type == CXZ_CHUNK_STORED ? s->in : s->out;
+            uint64_t offset = w->out_offset;
+            w->out_offset += s->out_len;
+            w->index[w->next_write].offset = offset;
+            w->index[w->next_write].size = (uint32_t)s->out_len;
+            w->index[w->next_write].type = s->type;
+
+            pthread_mutex_unlock(&w->lock);
+            int rc = s->out_len ? writer_output(w, data, s->out_len, offset) : 0;
+            pthread_mutex_lock(&w->lock);
+            if (rc != 0)
+                writer_fail(w, rc, "%s", corex_strerror());
+        }
+
+        s->in_len = 0;
+        s->state = CXZ_SLOT_FREE;
+        w->next_write++;
+        pthread_cond_broadcast(&w->cond);
+    }
+
+    w->writing = 0;
+}
+
+static void *compressor_thread(void *arg)
+{
+    cxz_writer_t *w = arg;
+    corex_counters = w->counters;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (w->next_compress == w->next_fill && !w->stop)
+            pthread_cond_wait(&w->cond, &w->lock);
+        if (w->next_compress == w->next_fill)
+            break;
+
+        cxz_slot_t *s = &w->slots[w->next_compress % w->num_slots];
+        w->next_compress++;
+        s->state = CXZ_SLOT_BUSY;
+
+        pthread_mutex_unlock(&w->lock);
+        compress_slot(s);
+        pthread_mutex_lock(&w->lock);
+
+        s->state = CXZ_SLOT_DONE;
+        write_done_slots(w);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/* Hand the slot being filled to the compressors. Called with the lock held. */
+static void submit_slot(cxz_writer_t *w)
+{
+    w->slots[w->next_fill % w->num_slots].state = CXZ_SLOT_FILLED;
+    w->next_fill++;
+    pthread_cond_broadcast(&w->cond);
+}
+
+/*
+ * Slot to fill next, waiting until it is free. Returns NULL after an
+ * error. Called with the lock held.
+ */
+static cxz_slot_t *fill_slot(cxz_writer_t *w)
+{
+    cxz_slot_t *s = &w->slots[w->next_fill % w->num_slots];
+    while (s->state != CXZ_SLOT_FREE && w->rc == 0)
+        pthread_cond_wait(&w->cond, &w->lock);
+    return w->rc == 0 ? s : NULL;
+}
+
+/* Append len logical bytes from buf, or zeros if buf is NULL */
+int cxz_writer_append(cxz_writer_t *w, const uint8_t *buf, uint64_t len)
+{
+    pthread_mutex_lock(&w->lock);
+    while (len > 0) {
+        cxz_slot_t *s = fill_slot(w);
+        if (!s)
+            break;
+
+        size_t n = CXZ_CHUNK_SIZE - s->in_len;
+        if (n > len)
+            n = (size_t)len;
+
+        /* The slot belongs to the producer until submitted */
+        pthread_mutex_unlock(&w->lock);
+        if (buf) {
+            memcpy(s->in + s->in_len, buf, n);
+            buf += n;
+        } else {
+            memset(s->in + s->in_len, 0, n);
+        }
+        pthread_mutex_lock(&w->lock);
+
+        s->in_len += n;
+        w->logical_size += n;
+        len -= n;
+        if (s->in_len == CXZ_CHUNK_SIZE)
+            submit_slot(w);
+    }
+    int rc = w->rc;
+    pthread_mutex_unlock(&w->lock);
+    if (rc != 0)
+        corex_set_error("%s", w->errmsg);
+    return rc;
+}
+
+int cxz_writer_init(cxz_writer_t *w, int fd, int num_threads)
+{
+    /* The header is fixed, so it goes first and chunks follow in order */
+    cxz_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CXZ_MAGIC, sizeof(hdr.magic));
+    hdr.version = CXZ_VERSION;
+    hdr.chunk_size = CXZ_CHUNK_SIZE;
+    hdr.level = CXZ_LEVEL;
+    int rc = io_is_stream(fd) ? io_write_full(fd, &hdr, sizeof(hdr))
+                              : io_pwrite_full(fd, &hdr, sizeof(hdr), 0);
+    if (rc != 0)
+        return rc;
+
+    memset(w, 0, sizeof(*w));
+    w->fd = fd;
+    w->stream = io_is_stream(fd);
+    w->out_offset = sizeof(cxz_header_t);
+    w->out_cap = compressBound(CXZ_CHUNK_SIZE);
+    w->counters = corex_counters;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    /* Two slots per compressor keep them busy while chunks are being written */
+    w->num_slots = 2 * (size_t)num_threads + 1;
+    w->slots = calloc(w->num_slots, sizeof(*w->slots));
+    w->threads = calloc((size_t)num_threads, sizeof(*w->threads));
+    if (!w->slots || !w->threads)
+        goto oom;
+    for (size_t i = 0; i < w->num_slots; i++) {
+        w->slots[i].in = malloc(CXZ_CHUNK_SIZE);
+        w->slots[i].out = malloc(w->out_cap);
+        if (!w->slots[i].in || !w->slots[i].out)
+            goto oom;
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&w->threads[i], NULL, compressor_thread, w) != 0)
+            break;
+        w->num_threads++;
+    }
+    if (w->num_threads == 0) {
+        corex_set_error("Failed to start compressor threads");
+        cxz_writer_free(w);
+        return COREX_ERR_ALLOC;
+    }
+    return 0;
+
+oom:
+    corex_set_error("Failed to allocate compression buffers");
+    cxz_writer_free(w);
+    return COREX_ERR_ALLOC;
+}
+
+/* Stop the compressors after the submitted chunks are written */
+static void writer_stop(cxz_writer_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+
+    for (int i = 0; i < w->num_threads; i++)
+        pthread_join(w->threads[i], NULL);
+    w->num_threads = 0;
+}
+
+void cxz_writer_free(cxz_writer_t *w)
+{
+    writer_stop(w);
+    for (size_t i = 0; w->slots && i < w->num_slots; i++) {
+        free(w->slots[i].in);
+        free(w->slots[i].out);
+    }
+    free(w->slots);
+    free(w->threads);
+    free(w->index);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+}
+
+/* Flush the last chunk, then write the index and trailer */
+int cxz_writer_finish(cxz_writer_t *w, uint64_t *file_size)
+{
+    pthread_mutex_lock(&w->lock);
+    if (w->rc == 0 && w->slots[w->next_fill % w->num_slots].in_len > 0)
+        submit_slot(w);
+    pthread_mutex_unlock(&w->lock);
+
+    writer_stop(w);
+    if (w->rc != 0) {
+        corex_set_error("%s", w->errmsg);
+        return w->rc;
+    }
+
+    cxz_trailer_t trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.index_offset = w->out_offset;
+    trailer.num_chunks = w->next_write;
+    trailer.logical_size = w->logical_size;
+    memcpy(trailer.magic, CXZ_TRAILER_MAGIC, sizeof(trailer.magic));
+
+    size_t index_size = (size_t)w->next_write * sizeof(cxz_chunk_t);
+    int rc = index_size ? writer_output(w, w->index, index_size, w->out_offset) : 0;
+    if (rc == 0)
+        rc = writer_output(w, &trailer, sizeof(trailer), w->out_offset + index_size);
+
+    *file_size = w->out_offset + index_size + sizeof(trailer);
+    return rc;
+}
+
+int cxz_write_core(const char *path,
+                   pid_t pid,
+                   const corex_proc_info_t *proc,
+                   const corex_note_buf_t *notes,
+                   const corex_options_t *opts)
+{
+    if (proc->num_mappings < 0) {
+        corex_set_error("Invalid mapping count: %d", proc->num_mappings);
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    size_t *load_offsets = calloc((size_t)proc->num_mappings + 1, sizeof(size_t));
+    uint8_t *chunk = malloc(COREX_MEM_CHUNK_SIZE);
+    if (!load_offsets || !chunk) {
+        corex_set_error("Failed to allocate dump buffers");
+        free(load_offsets);
+        free(chunk);
+        return COREX_ERR_ALLOC;
+    }
+    uint64_t core_size = elf_layout_loads(proc, notes, load_offsets);
+
+    corex_mem_range_t *ranges = NULL;
+    size_t num_ranges = 0;
+    uint8_t *headers = NULL;
+    int mem_fd = -1;
+    int writer_ready = 0;
+    cxz_writer_t w;
+
+    int fd = elf_open_output(path, opts);
+    if (fd < 0) {
+        free(load_offsets);
+        free(chunk);
+        return fd;
+    }
+
+    int rc = cxz_writer_init(&w, fd, opts->num_writers > 1 ? opts->num_writers : 1);
+    if (rc != 0)
+        goto out;
+    writer_ready = 1;
+
+    headers = elf_build_headers(proc, notes, load_offsets);
+    if (!headers) {
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+    rc = cxz_writer_append(&w, headers, elf_headers_size(proc, notes));
+    if (rc != 0)
+        goto out;
+
+    char mem_path[64];
+    snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
+    mem_fd = open(mem_path, O_RDONLY);
+    if (mem_fd < 0) {
+        corex_set_error("Failed to open %s: %s", mem_path, strerror(errno));
+        rc = COREX_ERR_PROC_READ;
+        goto out;
+    }
+
+    /* Untouched anonymous pages are not read; they are zeros in the stream */
+    int sparse = (opts->flags & COREX_FLAG_SPARSE) != 0;
+    rc = mem_ranges_build(pid, proc, load_offsets, sparse, &ranges, &num_ranges);
+    if (rc != 0)
+        goto out;
+
+    for (size_t i = 0; i < num_ranges && rc == 0; ) {
+        size_t n = mem_batch_len(ranges + i, num_ranges - i);
+        mem_read_ranges(pid, mem_fd, ranges + i, n, chunk);
+
+        const uint8_t *p = chunk;
+        for (size_t j = i; j < i + n && rc == 0; j++) {
+            if (ranges[j].file_offset > w.logical_size)
+                rc = cxz_writer_append(&w, NULL, ranges[j].file_offset - w.logical_size);
+            if (rc == 0)
+                rc = cxz_writer_append(&w, p, ranges[j].size);
+            p += ranges[j].size;
+        }
+        i += n;
+    }
+    if (rc == 0 && core_size > w.logical_size)
+        rc = cxz_writer_append(&w, NULL, core_size - w.logical_size);
+    if (rc != 0)
+        goto out;
+
+    uint64_t file_size = 0;
+    rc = cxz_writer_finish(&w, &file_size);
+    if (rc == 0)
+        rc = elf_finish_output(fd, file_size, opts);
+
+out:
+    if (writer_ready)
+        cxz_writer_free(&w);
+    if (mem_fd >= 0)
+        close(mem_fd);
+    elf_close_output(fd, path, rc != 0, opts);
+    free(ranges);
+    free(headers);
+    free(chunk);
+    free(load_offsets);
+    return rc;
+}
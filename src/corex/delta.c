@@ -0,0 +1,774 @@
+/*
+ * delta.c - Differential core dumps (COREX_FLAG_DIFF)
+ *
+ * Successive dumps of the same process mostly contain the same pages.
+ * The first dump of a series is a regular core, written together with an
+ * index of a hash of every page copied (<core>.pgidx). Later dumps name
+ * it as their base: every page is still read and hashed, but only pages
+ * whose hash differs from the base's are written. The others are left
+ * as holes and flagged in an NT_COREX_DELTA note, which also records the
+ * base's path, so that delta_rebuild() can fill them in again.
+ *
+ * The file layout is the one of elf_writer.c. Since the note is only
+ * complete once all pages have been compared, the headers come last.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <elf.h>
+#include <libgen.h>
+
+#include "corex_internal.h"
+#include "delta.h"
+#include "elf_writer.h"
+#include "mem_reader.h"
+#include "io_util.h"
+#include "corex/corex.h"
+
+#define DELTA_INDEX_MAGIC "CXPGIDX1"
+
+/* Header of a page hash index file, followed by num_entries entries */
+typedef struct {
+    char     magic[8];      /* DELTA_INDEX_MAGIC */
+    uint64_t page_size;     /* COREX_DELTA_PAGE_SIZE */
+    uint64_t num_entries;
+} delta_index_hdr_t;
+
+/* One copied page, in ascending address order */
+typedef struct {
+    uint64_t addr;
+    uint64_t hash;
+} delta_index_entry_t;
+
+typedef struct {
+    int fd;
+    int skip_zero;
+
+    /* Differential dump: the base's index and the note's page bitmap */
+    const delta_index_entry_t *base;
+    size_t num_base;
+    size_t cursor;
+    uint8_t *note;
+    uint8_t *bitmap;
+    uint64_t data_offset;
+
+    /* Full dump: the index being built */
+    delta_index_entry_t *index;
+    size_t num_index;
+
+    /* Pages queued for a single write */
+    const uint8_t *run_buf;
+    uint64_t run_off;
+    size_t run_len;
+} delta_writer_t;
+
+static uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/*
+ * 64-bit hash of one page. Four independent multiply-rotate lanes keep
+ * this well above memory bandwidth.
+ */
+static uint64_t page_hash(const uint8_t *page)
+{
+    const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    uint64_t h[4] = { prime1, prime2, prime1 ^ prime2, ~prime1 };
+    uint64_t w[4];
+
+    for (size_t i = 0; i < COREX_DELTA_PAGE_SIZE; i += sizeof(w)) {
+        memcpy(w, page + i, sizeof(w));
+        for (int k = 0; k < 4; k++)
+            h[k] = rotl64((h[k] ^ w[k]) * prime1, 31);
+    }
+
+    uint64_t r = h[0] ^ rotl64(h[1], 17) ^ rotl64(h[2], 29) ^ rotl64(h[3], 43);
+    r ^= r >> 33;
+    r *= prime2;
+    r ^= r >> 29;
+    return r;
+}
+
+static int page_is_zero(const uint8_t *page)
+{
+    size_t end;
+    return io_next_data_run(page, COREX_DELTA_PAGE_SIZE, 0, &end) == COREX_DELTA_PAGE_SIZE;
+}
+
+static char *index_path(const char *core_path)
+{
+    size_t len = strlen(core_path) + sizeof(COREX_DIFF_INDEX_SUFFIX);
+    char *p = malloc(len);
+    if (p)
+        snprintf(p, len, "%s%s", core_path, COREX_DIFF_INDEX_SUFFIX);
+    return p;
+}
+
+/* Load the page hash index of the dump at core_path. Returns 0 on success. */
+static int load_index(const char *core_path, delta_index_entry_t **out, size_t *count)
+{
+    char *path = index_path(core_path);
+    if (!path) {
+        corex_set_error("Failed to allocate index path");
+        return COREX_ERR_ALLOC;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        corex_set_error("Failed to open %s: %s", path, strerror(errno));
+        free(path);
+        return COREX_ERR_OPEN_FAILED;
+    }
+
+    int rc = COREX_ERR_INVALID_ARG;
+    delta_index_hdr_t hdr;
+    delta_index_entry_t *entries = NULL;
+    off_t size = lseek(fd, 0, SEEK_END);
+
+    if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        memcmp(hdr.magic, DELTA_INDEX_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.page_size != COREX_DELTA_PAGE_SIZE ||
+        hdr.num_entries > (uint64_t)(size - (off_t)sizeof(hdr)) / sizeof(*entries)) {
+        corex_set_error("%s is not a valid page index", path);
+        goto out;
+    }
+
+    size_t bytes = (size_t)hdr.num_entries * sizeof(*entries);
+    entries = malloc(bytes ? bytes : 1);
+    if (!entries) {
+        corex_set_error("Failed to allocate page index");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+    if (pread(fd, entries, bytes, sizeof(hdr)) != (ssize_t)bytes) {
+        corex_set_error("Failed to read %s", path);
+        free(entries);
+        goto out;
+    }
+
+    *out = entries;
+    *count = (size_t)hdr.num_entries;
+    rc = 0;
+
+out:
+    close(fd);
+    free(path);
+    return rc;
+}
+
+/* Write the index built during a full dump next to it */
+static int save_index(const char *core_path, const delta_writer_t *w)
+{
+    char *path = index_path(core_path);
+    if (!path) {
+        corex_set_error("Failed to allocate index path");
+        return COREX_ERR_ALLOC;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        corex_set_error("Failed to create %s: %s", path, strerror(errno));
+        free(path);
+        return COREX_ERR_OPEN_FAILED;
+    }
+
+    delta_index_hdr_t hdr;
+    memcpy(hdr.magic, DELTA_INDEX_MAGIC, sizeof(hdr.magic));
+    hdr.page_size = COREX_DELTA_PAGE_SIZE;
+    hdr.num_entries = w->num_index;
+
+    int rc = io_pwrite_full(fd, &hdr, sizeof(hdr), 0);
+    if (rc == 0)
+        rc = io_pwrite_full(fd, w->index, w->num_index * sizeof(*w->index), sizeof(hdr));
+    close(fd);
+    if (rc != 0)
+        unlink(path);
+    free(path);
+    return rc;
+}
+
+/* Non-zero if the base holds a page at addr with the given hash */
+static int base_has_page(delta_writer_t *w, uint64_t addr, uint64_t hash)
+{
+    /* Pages are visited in ascending address order, as is the index */
+    while (w->cursor < w->num_base && w->base[w->cursor].addr < addr)
+        w->cursor++;
+    return w->cursor < w->num_base &&
+           w->base[w->cursor].addr == addr &&
+           w->base[w->cursor].hash == hash;
+}
+
+static int flush_run(delta_writer_t *w)
+{
+    if (w->run_len == 0)
+        return 0;
+    int rc = io_pwrite_full(w->fd, w->run_buf, w->run_len, w->run_off);
+    w->run_len = 0;
+    return rc;
+}
+
+static int queue_page(delta_writer_t *w, const uint8_t *page, uint64_t off)
+{
+    if (w->run_len > 0 &&
+        w->run_buf + w->run_len == page &&
+        w->run_off + w->run_len == off) {
+        w->run_len += COREX_DELTA_PAGE_SIZE;
+        return 0;
+    }
+
+    int rc = flush_run(w);
+    w->run_buf = page;
+    w->run_off = off;
+    w->run_len = COREX_DELTA_PAGE_SIZE;
+    return rc;
+}
+
+/* Hash, compare and write the pages of ranges[0..count), read into buf */
+static int process_batch(delta_writer_t *w, const uint8_t *buf,
+                         const corex_mem_range_t *ranges, size_t count)
+{
+    const uint8_t *page = buf;
+
+    for (size_t i = 0; i < count; i++) {
+        for (uint64_t o = 0; o < ranges[i].size; o += COREX_DELTA_PAGE_SIZE,
+                                                  page += COREX_DELTA_PAGE_SIZE) {
+            uint64_t addr = ranges[i].addr + o;
+            uint64_t off = ranges[i].file_offset + o;
+            uint64_t hash = page_hash(page);
+            int rc;
+
+            if (w->index) {
+                w->index[w->num_index].addr = addr;
+                w->index[w->num_index].hash = hash;
+                w->num_index++;
+            }
+
+            if (w->base && base_has_page(w, addr, hash)) {
+                uint64_t bit = (off - w->data_offset) / COREX_DELTA_PAGE_SIZE;
+                w->bitmap[bit / 8] |= (uint8_t)(1U << (bit % 8));
+                rc = flush_run(w);
+            } else if (w->skip_zero && page_is_zero(page)) {
+                rc = flush_run(w);
+            } else {
+                rc = queue_page(w, page, off);
+            }
+            if (rc != 0)
+                return rc;
+        }
+    }
+
+    return flush_run(w);
+}
+
+/*
+ * Reserve the NT_COREX_DELTA note for num_pages pages and fill in the
+ * base's path. The data offset and bitmap are filled in later. Returns
+ * 0 and sets w->note and w->bitmap.
+ */
+static int reserve_delta_note(delta_writer_t *w, corex_note_buf_t *notes,
+                              const char *base_path, uint64_t num_pages)
+{
+    char resolved[PATH_MAX];
+    const char *path = realpath(base_path, resolved) ? resolved : base_path;
+
+    size_t path_size = (strlen(path) + 1 + 7) & ~(size_t)7;
+    size_t bitmap_size = (size_t)((num_pages + 7) / 8);
+    uint8_t *desc = note_reserve(notes, COREX_NOTE_NAME, NT_COREX_DELTA,
+                                 sizeof(corex_delta_note_t) + path_size + bitmap_size);
+    if (!desc)
+        return COREX_ERR_ALLOC;
+
+    corex_delta_note_t hdr = {0};
+    hdr.version = COREX_DELTA_VERSION;
+    hdr.page_size = COREX_DELTA_PAGE_SIZE;
+    hdr.num_pages = num_pages;
+    hdr.path_size = (uint32_t)path_size;
+    memcpy(desc, &hdr, sizeof(hdr));
+    memcpy(desc + sizeof(hdr), path, strlen(path));
+
+    w->note = desc;
+    w->bitmap = desc + sizeof(hdr) + path_size;
+    return 0;
+}
+
+int delta_write_core(const char *path,
+                     pid_t pid,
+                     const corex_proc_info_t *proc,
+                     corex_note_buf_t *notes,
+                     const corex_options_t *opts)
+{
+    if (proc->num_mappings < 0) {
+        corex_set_error("Invalid mapping count: %d", proc->num_mappings);
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    delta_writer_t w;
+    memset(&w, 0, sizeof(w));
+    w.fd = -1;
+    w.skip_zero = (opts->flags & COREX_FLAG_SPARSE) != 0;
+
+    delta_index_entry_t *base = NULL;
+    size_t *load_offsets = NULL;
+    corex_mem_range_t *ranges = NULL;
+    size_t num_ranges = 0;
+    uint8_t *chunk = NULL;
+    int mem_fd = -1;
+    int rc;
+
+    /* Without a usable base index this becomes the base of a new series */
+    if (opts->base_path && load_index(opts->base_path, &base, &w.num_base) == 0)
+        w.base = base;
+
+    uint64_t data_size = 0;
+    for (int i = 0; i < proc->num_mappings; i++) {
+        if (proc->mappings[i].should_dump)
+            data_size += proc->mappings[i].end - proc->mappings[i].start;
+    }
+    uint64_t num_pages = data_size / COREX_DELTA_PAGE_SIZE;
+
+    if (w.base) {
+        rc = reserve_delta_note(&w, notes, opts->base_path, num_pages);
+        if (rc != 0)
+            goto out;
+    } else {
+        w.index = malloc((size_t)(num_pages ? num_pages : 1) * sizeof(*w.index));
+        if (!w.index) {
+            corex_set_error("Failed to allocate page index");
+            rc = COREX_ERR_ALLOC;
+            goto out;
+        }
+    }
+
+    /* Same layout as elf_write_core() */
+    w.data_offset = elf_headers_size(proc, notes);
+    if (w.note) {
+        uint64_t data_offset = w.data_offset;
+        memcpy(w.note + offsetof(corex_delta_note_t, data_offset),
+               &data_offset, sizeof(data_offset));
+    }
+    load_offsets = calloc((size_t)proc->num_mappings + 1, sizeof(size_t));
+    if (!load_offsets) {
+        corex_set_error("Failed to allocate offset table");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+    size_t current_offset = w.data_offset;
+    for (int i = 0; i < proc->num_mappings; i++) {
+        if (proc->mappings[i].should_dump) {
+            load_offsets[i] = current_offset;
+            current_offset += (size_t)(proc->mappings[i].end - proc->mappings[i].start);
+        }
+    }
+
+    w.fd = elf_open_output(path, opts);
+    if (w.fd < 0) {
+        rc = w.fd;
+        goto out;
+    }
+
+    char mem_path[64];
+    snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
+    mem_fd = open(mem_path, O_RDONLY);
+    if (mem_fd < 0) {
+        corex_set_error("Failed to open %s: %s", mem_path, strerror(errno));
+        rc = COREX_ERR_PROC_READ;
+        goto out;
+    }
+
+    rc = mem_ranges_build(pid, proc, load_offsets, w.skip_zero, &ranges, &num_ranges);
+    if (rc != 0)
+        goto out;
+
+    chunk = io_alloc_huge_buffer(COREX_MEM_CHUNK_SIZE);
+    if (!chunk) {
+        corex_set_error("Failed to allocate memory chunk buffer");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+
+    for (size_t i = 0; i < num_ranges; ) {
+        size_t n = mem_batch_len(ranges + i, num_ranges - i);
+        mem_read_ranges(pid, mem_fd, ranges + i, n, chunk);
+        rc = process_batch(&w, chunk, ranges + i, n);
+        if (rc != 0)
+            goto out;
+        i += n;
+    }
+
+    rc = elf_write_headers(w.fd, proc, notes, load_offsets);
+    if (rc == 0)
+        rc = elf_finish_output(w.fd, current_offset, opts);
+    if (rc == 0 && w.index)
+        rc = save_index(path, &w);
+
+out:
+    if (w.fd >= 0) {
+        close(w.fd);
+        if (rc != 0)
+            unlink(path);
+    }
+    if (mem_fd >= 0)
+        close(mem_fd);
+    free(chunk);
+    free(ranges);
+    free(load_offsets);
+    free(w.index);
+    free(base);
+    return rc;
+}
+
+/* ---- Rebuilding a standalone core ---- */
+
+typedef struct {
+    int fd;
+    Elf64_Phdr *loads;
+    int num_loads;
+    Elf64_Phdr note;
+} delta_core_t;
+
+/* Read the ELF and program headers of a core file */
+static int read_core(const char *path, delta_core_t *core)
+{
+    memset(core, 0, sizeof(*core));
+    core->fd = open(path, O_RDONLY);
+    if (core->fd < 0) {
+        corex_set_error("Failed to open %s: %s", path, strerror(errno));
+        return COREX_ERR_OPEN_FAILED;
+    }
+
+    Elf64_Ehdr ehdr;
+    if (pread(core->fd, &ehdr, sizeof(ehdr), 0) != (ssize_t)sizeof(ehdr) ||
+        memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr.e_ident[EI_CLASS] != ELFCLASS64 || ehdr.e_type != ET_CORE ||
+        ehdr.e_phentsize != sizeof(Elf64_Phdr)) {
+        corex_set_error("%s is not a 64-bit ELF core file", path);
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    /* Extended numbering: the real count is in section header 0 */
+    size_t num_phdrs = ehdr.e_phnum;
+    if (ehdr.e_phnum == PN_XNUM) {
+        Elf64_Shdr shdr;
+        if (ehdr.e_shoff == 0 || ehdr.e_shentsize != sizeof(Elf64_Shdr) ||
+            pread(core->fd, &shdr, sizeof(shdr), (off_t)ehdr.e_shoff) != (ssize_t)sizeof(shdr)) {
+            corex_set_error("Failed to read section header 0 of %s", path);
+            return COREX_ERR_INVALID_ARG;
+        }
+        num_phdrs = shdr.sh_info;
+    }
+
+    size_t bytes = num_phdrs * sizeof(Elf64_Phdr);
+    Elf64_Phdr *phdrs = malloc(bytes ? bytes : 1);
+    if (!phdrs) {
+        corex_set_error("Failed to allocate program headers");
+        return COREX_ERR_ALLOC;
+    }
+    if (pread(core->fd, phdrs, bytes, (off_t)ehdr.e_phoff) != (ssize_t)bytes) {
+        corex_set_error("Failed to read program headers of %s", path);
+        free(phdrs);
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    /* Keep the PT_LOADs (in file and address order) in place */
+    for (size_t i = 0; i < num_phdrs; i++) {
+        if (phdrs[i].p_type == PT_LOAD)
+            phdrs[core->num_loads++] = phdrs[i];
+        else if (phdrs[i].p_type == PT_NOTE)
+            core->note = phdrs[i];
+    }
+    core->loads = phdrs;
+    return 0;
+}
+
+static void free_core(delta_core_t *core)
+{
+    if (core->fd >= 0)
+        close(core->fd);
+    free(core->loads);
+}
+
+/* PT_LOAD whose file data contains off (by_addr == 0) or whose range contains addr */
+static const Elf64_Phdr *find_load(const delta_core_t *core, uint64_t v, int by_addr)
+{
+    int lo = 0, hi = core->num_loads - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        const Elf64_Phdr *ph = &core->loads[mid];
+        uint64_t start = by_addr ? ph->p_vaddr : ph->p_offset;
+        uint64_t size = by_addr ? ph->p_memsz : ph->p_filesz;
+        if (v < start)
+            hi = mid - 1;
+        else if (v - start >= size)
+            lo = mid + 1;
+        else
+            return ph;
+    }
+    return NULL;
+}
+
+/*
+ * Find the NT_COREX_DELTA note. Stores a copy of its descriptor in
+ * *desc and the note's file offset in *note_off. Returns 0 on success.
+ */
+static int find_delta_note(const delta_core_t *core, const char *path,
+                           uint8_t **desc, size_t *descsz, uint64_t *note_off)
+{
+    size_t len = (size_t)core->note.p_filesz;
+    uint8_t *buf = malloc(len ? len : 1);
+    if (!buf) {
+        corex_set_error("Failed to allocate note buffer");
+        return COREX_ERR_ALLOC;
+    }
+    if (pread(core->fd, buf, len, (off_t)core->note.p_offset) != (ssize_t)len) {
+        corex_set_error("Failed to read notes of %s", path);
+        free(buf);
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    size_t pos = 0;
+    while (pos + sizeof(Elf64_Nhdr) <= len) {
+        const Elf64_Nhdr *nhdr = (const Elf64_Nhdr *)(buf + pos);
+        size_t name_off = pos + sizeof(Elf64_Nhdr);
+        size_t desc_off = name_off + (((size_t)nhdr->n_namesz + 3) & ~(size_t)3);
+        size_t next = desc_off + (((size_t)nhdr->n_descsz + 3) & ~(size_t)3);
+        if (next > len)
+            break;
+
+        if (nhdr->n_type == NT_COREX_DELTA &&
+            nhdr->n_namesz == sizeof(COREX_NOTE_NAME) &&
+            memcmp(buf + name_off, COREX_NOTE_NAME, sizeof(COREX_NOTE_NAME)) == 0 &&
+            nhdr->n_descsz >= sizeof(corex_delta_note_t)) {
+            *descsz = nhdr->n_descsz;
+            *desc = malloc(*descsz);
+            if (!*desc) {
+                free(buf);
+                corex_set_error("Failed to allocate note buffer");
+                return COREX_ERR_ALLOC;
+            }
+            memcpy(*desc, buf + desc_off, *descsz);
+            *note_off = core->note.p_offset + pos;
+            free(buf);
+            return 0;
+        }
+        pos = next;
+    }
+
+    free(buf);
+    corex_set_error("%s is not a differential core dump", path);
+    return COREX_ERR_INVALID_ARG;
+}
+
+/* Open the base dump, also looking next to the delta if it was moved */
+static int open_base(const char *recorded, const char *delta_path, delta_core_t *base)
+{
+    int rc = read_core(recorded, base);
+    if (rc != COREX_ERR_OPEN_FAILED)
+        return rc;
+    free_core(base);
+
+    char *dcopy = strdup(delta_path);
+    char *bcopy = strdup(recorded);
+    if (!dcopy || !bcopy) {
+        free(dcopy);
+        free(bcopy);
+        corex_set_error("Failed to allocate base path");
+        return COREX_ERR_ALLOC;
+    }
+    char moved[PATH_MAX];
+    snprintf(moved, sizeof(moved), "%s/%s", dirname(dcopy), basename(bcopy));
+    free(dcopy);
+    free(bcopy);
+
+    rc = read_core(moved, base);
+    if (rc == COREX_ERR_OPEN_FAILED)
+        corex_set_error("Base dump %s not found", recorded);
+    return rc;
+}
+
+/* Copy the data extents of in_fd (size bytes) to out_fd, keeping holes */
+static int copy_sparse(int in_fd, int out_fd, uint64_t size, uint8_t *buf)
+{
+    off_t pos = 0;
+    while ((uint64_t)pos < size) {
+        off_t data = lseek(in_fd, pos, SEEK_DATA);
+        if (data < 0)
+            break;      /* ENXIO: only a hole is left */
+        off_t hole = lseek(in_fd, data, SEEK_HOLE);
+        if (hole < 0)
+            hole = (off_t)size;
+
+        for (off_t off = data; off < hole; ) {
+            size_t n = (size_t)(hole - off);
+            if (n > COREX_MEM_CHUNK_SIZE)
+                n = COREX_MEM_CHUNK_SIZE;
+            ssize_t r = pread(in_fd, buf, n, off);
+            if (r <= 0) {
+                corex_set_error("Failed to read core data: %s",
+                                r < 0 ? strerror(errno) : "unexpected end of file");
+                return COREX_ERR_INVALID_ARG;
+            }
+            int rc = io_pwrite_full(out_fd, buf, (size_t)r, (uint64_t)off);
+            if (rc != 0)
+                return rc;
+            off += r;
+        }
+        pos = hole;
+    }
+    return 0;
+}
+
+/* Copy [addr, addr+len) from the base to file offset off, keeping holes */
+static int copy_from_base(const delta_core_t *base, int out_fd, uint64_t addr,
+                          size_t len, uint64_t off, uint8_t *buf)
+{
+    /* The range may span mappings that were split or merged since */
+    for (size_t done = 0; done < len; ) {
+        const Elf64_Phdr *ph = find_load(base, addr + done, 1);
+        if (!ph || ph->p_filesz < ph->p_memsz) {
+            corex_set_error("Base dump has no data at 0x%llx",
+                            (unsigned long long)(addr + done));
+            return COREX_ERR_INVALID_ARG;
+        }
+        size_t n = (size_t)(ph->p_vaddr + ph->p_memsz - (addr + done));
+        if (n > len - done)
+            n = len - done;
+
+        /* Past the end of the base file is a trailing hole */
+        ssize_t r = pread(base->fd, buf + done, n,
+                          (off_t)(ph->p_offset + (addr + done - ph->p_vaddr)));
+        if (r < 0) {
+            corex_set_error("Failed to read base dump: %s", strerror(errno));
+            return COREX_ERR_INVALID_ARG;
+        }
+        memset(buf + done + r, 0, n - (size_t)r);
+        done += n;
+    }
+
+    size_t pos = 0, end;
+    while ((pos = io_next_data_run(buf, len, pos, &end)) < len) {
+        int rc = io_pwrite_full(out_fd, buf + pos, end - pos, off + pos);
+        if (rc != 0)
+            return rc;
+        pos = end;
+    }
+    return 0;
+}
+
+int delta_rebuild(const char *delta_path, const char *output_path)
+{
+    delta_core_t delta, base;
+    uint8_t *desc = NULL;
+    uint8_t *buf = NULL;
+    size_t descsz = 0;
+    uint64_t note_off = 0;
+    int out_fd = -1;
+
+    memset(&base, 0, sizeof(base));
+    base.fd = -1;
+
+    int rc = read_core(delta_path, &delta);
+    if (rc == 0)
+        rc = find_delta_note(&delta, delta_path, &desc, &descsz, &note_off);
+    if (rc != 0)
+        goto out;
+
+    corex_delta_note_t hdr;
+    memcpy(&hdr, desc, sizeof(hdr));
+    if (hdr.version != COREX_DELTA_VERSION || hdr.page_size == 0 ||
+        hdr.page_size > COREX_MEM_CHUNK_SIZE || hdr.path_size == 0 ||
+        sizeof(hdr) + hdr.path_size + (hdr.num_pages + 7) / 8 > descsz) {
+        corex_set_error("Unsupported differential dump note in %s", delta_path);
+        rc = COREX_ERR_INVALID_ARG;
+        goto out;
+    }
+    char *recorded = (char *)desc + sizeof(hdr);
+    recorded[hdr.path_size - 1] = '\0';
+    const uint8_t *bitmap = desc + sizeof(hdr) + hdr.path_size;
+
+    rc = open_base(recorded, delta_path, &base);
+    if (rc != 0)
+        goto out;
+
+    buf = io_alloc_buffer(COREX_MEM_CHUNK_SIZE);
+    if (!buf) {
+        corex_set_error("Failed to allocate copy buffer");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+
+    out_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (out_fd < 0) {
+        corex_set_error("Failed to create %s: %s", output_path, strerror(errno));
+        rc = COREX_ERR_OPEN_FAILED;
+        goto out;
+    }
+
+    /* Start from the delta as it is, then fill in the flagged pages */
+    off_t size = lseek(delta.fd, 0, SEEK_END);
+    rc = copy_sparse(delta.fd, out_fd, (uint64_t)size, buf);
+    if (rc != 0)
+        goto out;
+    if (ftruncate(out_fd, size) < 0) {
+        corex_set_error("Failed to set core file size: %s", strerror(errno));
+        rc = COREX_ERR_WRITE;
+        goto out;
+    }
+
+    /* Runs of flagged pages within one segment are copied together */
+    uint64_t page = hdr.page_size;
+    const Elf64_Phdr *run_ph = NULL;
+    uint64_t run_addr = 0, run_off = 0;
+    size_t run_len = 0;
+    for (uint64_t i = 0; i <= hdr.num_pages; i++) {
+        int set = i < hdr.num_pages && (bitmap[i / 8] & (1U << (i % 8)));
+        uint64_t off = hdr.data_offset + i * page;
+        const Elf64_Phdr *ph = set ? find_load(&delta, off, 0) : NULL;
+
+        if (run_len > 0 && (ph != run_ph || off != run_off + run_len ||
+                            run_len + page > COREX_MEM_CHUNK_SIZE)) {
+            rc = copy_from_base(&base, out_fd, run_addr, run_len, run_off, buf);
+            if (rc != 0)
+                goto out;
+            run_len = 0;
+        }
+        if (!set)
+            continue;
+        if (!ph) {
+            corex_set_error("Differential dump page %llu is outside all segments",
+                            (unsigned long long)i);
+            rc = COREX_ERR_INVALID_ARG;
+            goto out;
+        }
+        if (run_len == 0) {
+            run_ph = ph;
+            run_addr = ph->p_vaddr + (off - ph->p_offset);
+            run_off = off;
+        }
+        run_len += page;
+    }
+
+    /* The result no longer depends on the base */
+    uint32_t type = NT_COREX_REBUILT;
+    rc = io_pwrite_full(out_fd, &type, sizeof(type), note_off + offsetof(Elf64_Nhdr, n_type));
+
+out:
+    if (out_fd >= 0) {
+        close(out_fd);
+        if (rc != 0)
+            unlink(output_path);
+    }
+    free(buf);
+    free(desc);
+    free_core(&base);
+    free_core(&delta);
+    return rc;
+}
@@ -0,0 +1,51 @@
+/*
+ * delta.h - Differential core dumps (COREX_FLAG_DIFF)
+ */
+#ifndef DELTA_H
+#define DELTA_H
+
+#include "corex_internal.h"
+#include "proc_info.h"
+#include "note_builder.h"
+#include "corex/corex.h"
+
+/* Granularity at which pages are hashed and reused from the base */
+#define COREX_DELTA_PAGE_SIZE 4096
+
+#define COREX_DELTA_VERSION 1
+
+/*
+ * NT_COREX_DELTA descriptor. Followed by the base dump's path (NUL
+ * terminated, padded to 8 bytes) and a bitmap with one bit per page of
+ * PT_LOAD data, starting at data_offset: a set bit means the page is a
+ * hole in this file and its contents are in the base dump at the same
+ * virtual address.
+ */
+typedef struct {
+    uint32_t version;       /* COREX_DELTA_VERSION */
+    uint32_t page_size;     /* COREX_DELTA_PAGE_SIZE */
+    uint64_t data_offset;   /* File offset of the first PT_LOAD */
+    uint64_t num_pages;     /* Bits in the bitmap */
+    uint32_t path_size;     /* Bytes reserved for the path */
+    uint32_t reserved;
+} corex_delta_note_t;
+
+/*
+ * Write a core dump of pid like elf_write_core(). Without
+ * opts->base_path, a full dump is written along with its page hash
+ * index. With it, only pages that differ from the base are written and
+ * an NT_COREX_DELTA note is added to notes. If the base's index cannot
+ * be used, a new full dump (and index) is written instead.
+ *
+ * Returns 0 on success.
+ */
+int delta_write_core(const char *path,
+                     pid_t pid,
+                     const corex_proc_info_t *proc,
+                     corex_note_buf_t *notes,
+                     const corex_options_t *opts);
+
+/* See corex_rebuild(). Returns 0 on success. */
+int delta_rebuild(const char *delta_path, const char *output_path);
+
+#endif /* DELTA_H */
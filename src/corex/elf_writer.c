@@ -9,6 +9,20 @@
  *   [PT_LOAD segment data for mapping 0]
  *   [PT_LOAD segment data for mapping 1]
  *   ...
+ *
+ * Every PT_LOAD offset is known before any data is written, so the
+ * segment data can be copied by several threads (see parallel_writer.c).
+ * Segment data is written at explicit offsets, which lets sparse dumps
+ * (COREX_FLAG_SPARSE) leave holes for pages that are known to be zero.
+ * With COREX_FLAG_IO_URING a single writer queues the copies on an
+ * io_uring instead (see uring_writer.c).
+ *
+ * The steps are exported separately so a live dump (precopy.c) can copy
+ * most of the memory before the headers are known.
+ *
+ * Because the layout is fixed up front, the same file can also be
+ * produced strictly in order, for outputs that cannot seek (a pipe,
+ * FIFO or socket): gaps are then written as zeros instead of holes.
  */
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
@@ -23,6 +37,10 @@
 
 #include "corex_internal.h"
 #include "elf_writer.h"
+#include "mem_reader.h"
+#include "parallel_writer.h"
+#include "uring_writer.h"
+#include "io_util.h"
 #include "arch/arch.h"
 #include "corex/corex.h"
 
@@ -34,51 +52,32 @@ static size_t align_up_page(size_t val)
 }
 
 /*
- * Stream memory from /proc/[pid]/mem to the output file for a given
- * address range. Unreadable pages are written as zeros.
+ * Copy the given memory ranges to the output file. Neighbouring ranges
+ * are gathered into a single read (see mem_read_ranges()) and written
+ * at their file offsets. Unreadable pages are written as zeros.
  */
-static int write_memory_region(int out_fd, int mem_fd,
-                               uint64_t start, uint64_t size)
+static int write_memory_ranges(int out_fd, pid_t pid, int mem_fd,
+                               const corex_mem_range_t *ranges,
+                               size_t count, int skip_zero)
 {
-    uint8_t *chunk = malloc(COREX_MEM_CHUNK_SIZE);
+    uint8_t *chunk = io_alloc_huge_buffer(COREX_MEM_CHUNK_SIZE);
     if (!chunk) {
         corex_set_error("Failed to allocate memory chunk buffer");
         return COREX_ERR_ALLOC;
     }
 
-    uint64_t remaining = size;
-    uint64_t addr = start;
-
-    while (remaining > 0) {
-        size_t to_read = remaining;
-        if (to_read > COREX_MEM_CHUNK_SIZE)
-            to_read = COREX_MEM_CHUNK_SIZE;
-
-        ssize_t n = pread(mem_fd, chunk, to_read, (off_t)addr);
-        if (n <= 0) {
-            /*
-             * If we can't read this region (e.g., guard page, vsyscall),
-             * write zeros. This is what the kernel and GDB do.
-             */
-            memset(chunk, 0, to_read);
-            n = (ssize_t)to_read;
-        }
+    size_t i = 0;
+    while (i < count) {
+        size_t n = mem_batch_len(ranges + i, count - i);
+        mem_read_ranges(pid, mem_fd, ranges + i, n, chunk);
 
-        size_t written = 0;
-        while (written < (size_t)n) {
-            ssize_t w = write(out_fd, chunk + written, (size_t)n - written);
-            if (w < 0) {
-                if (errno == EINTR)
-                    continue;
-                corex_set_error("Write failed: %s", strerror(errno));
-                free(chunk);
-                return COREX_ERR_WRITE;
-            }
-            written += (size_t)w;
+        int rc = io_write_ranges(out_fd, chunk, ranges + i, n, skip_zero);
+        if (rc != 0) {
+            free(chunk);
+            return rc;
         }
 
-        addr += (uint64_t)n;
-        remaining -= (uint64_t)n;
+        i += n;
     }
 
     free(chunk);
@@ -86,72 +85,129 @@ static int write_memory_region(int out_fd, int mem_fd,
 }
 
 /*
- * Write padding zeros to align the file to a given boundary.
+ * Copy the given memory ranges to a stream, in file order, starting at
+ * file offset pos. Gaps between ranges (untouched pages of sparse dumps)
+ * and the tail up to end are written as zeros.
  */
-static int write_padding(int fd, size_t current_offset, size_t target_offset)
+static int stream_memory_ranges(int out_fd, pid_t pid, int mem_fd,
+                                const corex_mem_range_t *ranges,
+                                size_t count, uint64_t pos, uint64_t end)
 {
-    if (target_offset <= current_offset)
-        return 0;
+    uint8_t *chunk = io_alloc_huge_buffer(COREX_MEM_CHUNK_SIZE);
+    if (!chunk) {
+        corex_set_error("Failed to allocate memory chunk buffer");
+        return COREX_ERR_ALLOC;
+    }
 
-    size_t pad_size = target_offset - current_offset;
-    uint8_t zeros[4096];
-    memset(zeros, 0, sizeof(zeros));
-
-    while (pad_size > 0) {
-        size_t chunk = pad_size > sizeof(zeros) ? sizeof(zeros) : pad_size;
-        ssize_t w = write(fd, zeros, chunk);
-        if (w < 0) {
-            if (errno == EINTR)
-                continue;
-            corex_set_error("Write padding failed: %s", strerror(errno));
-            return COREX_ERR_WRITE;
+    int rc = 0;
+    size_t i = 0;
+    while (i < count && rc == 0) {
+        size_t n = mem_batch_len(ranges + i, count - i);
+        mem_read_ranges(pid, mem_fd, ranges + i, n, chunk);
+
+        /* Ranges of a batch are contiguous in the buffer, not always in the file */
+        const uint8_t *p = chunk;
+        for (size_t j = i; j < i + n && rc == 0; j++) {
+            if (ranges[j].file_offset > pos)
+                rc = io_write_zeros(out_fd, ranges[j].file_offset - pos);
+            if (rc == 0)
+                rc = io_write_full(out_fd, p, ranges[j].size);
+            pos = ranges[j].file_offset + ranges[j].size;
+            p += ranges[j].size;
         }
-        pad_size -= (size_t)w;
+
+        i += n;
     }
 
-    return 0;
+    if (rc == 0 && end > pos)
+        rc = io_write_zeros(out_fd, end - pos);
+
+    free(chunk);
+    return rc;
 }
 
-int elf_write_core(const char *path,
-                   pid_t pid,
-                   const corex_proc_info_t *proc,
-                   const corex_note_buf_t *notes)
+int elf_open_output(const char *path, const corex_options_t *opts)
 {
-    if (proc->num_mappings < 0 || proc->num_mappings > COREX_MAX_MAPPINGS) {
-        corex_set_error("Invalid mapping count: %d", proc->num_mappings);
-        return COREX_ERR_INVALID_ARG;
+    if (opts->flags & COREX_FLAG_OUTPUT_FD)
+        return opts->output_fd;
+
+    /*
+     * With COREX_FLAG_DIRECT_IO the dump bypasses the page cache;
+     * filesystems without O_DIRECT support (e.g. tmpfs) get a buffered
+     * file whose pages are dropped once the dump is written.
+     */
+    int fd = -1;
+    if (opts->flags & COREX_FLAG_DIRECT_IO)
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0600);
+    if (fd < 0)
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        corex_set_error("Failed to create %s: %s", path, strerror(errno));
+        return COREX_ERR_OPEN_FAILED;
     }
 
-    size_t num_mappings = (size_t)proc->num_mappings;
-    
-    /* Count only mappings that will be dumped */
+    /* On a FIFO, O_DIRECT would switch the pipe to packet mode */
+    if ((opts->flags & COREX_FLAG_DIRECT_IO) && io_is_stream(fd))
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    return fd;
+}
+
+void elf_close_output(int fd, const char *path, int failed, const corex_options_t *opts)
+{
+    /* The caller owns COREX_FLAG_OUTPUT_FD descriptors */
+    if (opts->flags & COREX_FLAG_OUTPUT_FD)
+        return;
+
+    /* Clean up a partial file on error, but never remove a FIFO */
+    if (failed && !io_is_stream(fd))
+        unlink(path);
+    close(fd);
+}
+
+/* Number of PT_LOAD segments, i.e. mappings that will be dumped */
+static int count_loads(const corex_proc_info_t *proc)
+{
     int num_loads = 0;
     for (int i = 0; i < proc->num_mappings; i++) {
         if (proc->mappings[i].should_dump)
             num_loads++;
     }
-    int num_phdrs = 1 + num_loads;  /* PT_NOTE + PT_LOADs */
+    return num_loads;
+}
+
+/*
+ * File offset of the notes, after the ELF header, the program headers
+ * and, when there are PN_XNUM or more of those, section header 0 which
+ * then holds the real count in sh_info.
+ */
+static size_t notes_offset(size_t num_phdrs)
+{
+    size_t offset = sizeof(Elf64_Ehdr) + num_phdrs * sizeof(Elf64_Phdr);
+    if (num_phdrs >= PN_XNUM)
+        offset += sizeof(Elf64_Shdr);
+    return offset;
+}
 
+size_t elf_headers_size(const corex_proc_info_t *proc,
+                        const corex_note_buf_t *notes)
+{
     /*
      * Compute layout offsets:
      *   ehdr_offset = 0
      *   phdr_offset = sizeof(Elf64_Ehdr)
-     *   note_offset = phdr_offset + num_phdrs * sizeof(Elf64_Phdr)
+     *   shdr_offset = phdr_offset + num_phdrs * sizeof(Elf64_Phdr)
+     *   note_offset = shdr_offset (+ sizeof(Elf64_Shdr) if PN_XNUM)
      *   first PT_LOAD offset = align_up_page(note_offset + notes->len)
      */
-    size_t ehdr_size = sizeof(Elf64_Ehdr);
-    size_t phdrs_size = (size_t)num_phdrs * sizeof(Elf64_Phdr);
-    size_t note_offset = ehdr_size + phdrs_size;
-    size_t first_load_offset = align_up_page(note_offset + notes->len);
-
-    /* Calculate all PT_LOAD file offsets (only for dumped segments) */
-    size_t *load_offsets = calloc((size_t)proc->num_mappings, sizeof(size_t));
-    if (!load_offsets) {
-        corex_set_error("Failed to allocate offset table");
-        return COREX_ERR_ALLOC;
-    }
+    size_t num_phdrs = 1 + (size_t)count_loads(proc);  /* PT_NOTE + PT_LOADs */
+    return align_up_page(notes_offset(num_phdrs) + notes->len);
+}
 
-    size_t current_offset = first_load_offset;
+size_t elf_layout_loads(const corex_proc_info_t *proc,
+                        const corex_note_buf_t *notes,
+                        size_t *load_offsets)
+{
+    size_t current_offset = elf_headers_size(proc, notes);
     for (int i = 0; i < proc->num_mappings; i++) {
         if (proc->mappings[i].should_dump) {
             load_offsets[i] = current_offset;
@@ -161,18 +217,33 @@ int elf_write_core(const char *path,
             load_offsets[i] = 0;
         }
     }
+    return current_offset;
+}
 
-    /* Open output file */
-    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
-    if (fd < 0) {
-        corex_set_error("Failed to create %s: %s", path, strerror(errno));
-        free(load_offsets);
-        return COREX_ERR_OPEN_FAILED;
-    }
+uint8_t *elf_build_headers(const corex_proc_info_t *proc,
+                           const corex_note_buf_t *notes,
+                           const size_t *load_offsets)
+{
+    int num_phdrs = 1 + count_loads(proc);
+    size_t ehdr_size = sizeof(Elf64_Ehdr);
+    size_t shdr_offset = ehdr_size + (size_t)num_phdrs * sizeof(Elf64_Phdr);
+    size_t note_offset = notes_offset((size_t)num_phdrs);
+    size_t headers_size = elf_headers_size(proc, notes);
 
-    int rc = 0;
+    /*
+     * The ELF header, program headers and notes are assembled in one
+     * page-aligned buffer that ends where the PT_LOAD data may start,
+     * so they can be written with a single call. This also keeps every
+     * write aligned for O_DIRECT output.
+     */
+    uint8_t *prefix = io_alloc_buffer(headers_size);
+    if (!prefix) {
+        corex_set_error("Failed to allocate header buffer");
+        return NULL;
+    }
+    memset(prefix, 0, headers_size);
 
-    /* ---- Write ELF Header ---- */
+    /* ---- ELF Header ---- */
     Elf64_Ehdr ehdr;
     memset(&ehdr, 0, sizeof(ehdr));
     ehdr.e_ident[EI_MAG0] = ELFMAG0;
@@ -189,29 +260,35 @@ int elf_write_core(const char *path,
     ehdr.e_phoff = ehdr_size;
     ehdr.e_ehsize = sizeof(Elf64_Ehdr);
     ehdr.e_phentsize = sizeof(Elf64_Phdr);
-    ehdr.e_phnum = (num_phdrs <= PN_XNUM) ? (uint16_t)num_phdrs : PN_XNUM;
-
-    if (write(fd, &ehdr, sizeof(ehdr)) != sizeof(ehdr)) {
-        corex_set_error("Failed to write ELF header: %s", strerror(errno));
-        rc = COREX_ERR_WRITE;
-        goto out;
+    if (num_phdrs < PN_XNUM) {
+        ehdr.e_phnum = (uint16_t)num_phdrs;
+    } else {
+        /* Extended numbering: the count is in section header 0 */
+        ehdr.e_phnum = PN_XNUM;
+        ehdr.e_shoff = shdr_offset;
+        ehdr.e_shentsize = sizeof(Elf64_Shdr);
+        ehdr.e_shnum = 1;
+        ehdr.e_shstrndx = SHN_UNDEF;
+
+        Elf64_Shdr shdr;
+        memset(&shdr, 0, sizeof(shdr));
+        shdr.sh_type = SHT_NULL;
+        shdr.sh_size = 1;               /* e_shnum */
+        shdr.sh_link = SHN_UNDEF;       /* e_shstrndx */
+        shdr.sh_info = (Elf64_Word)num_phdrs;
+        memcpy(prefix + shdr_offset, &shdr, sizeof(shdr));
     }
+    memcpy(prefix, &ehdr, sizeof(ehdr));
 
-    /* ---- Write Program Headers ---- */
+    /* ---- Program Headers ---- */
+    Elf64_Phdr *phdr = (Elf64_Phdr *)(prefix + ehdr_size);
 
     /* PT_NOTE program header */
-    Elf64_Phdr note_phdr;
-    memset(&note_phdr, 0, sizeof(note_phdr));
-    note_phdr.p_type = PT_NOTE;
-    note_phdr.p_offset = note_offset;
-    note_phdr.p_filesz = notes->len;
-    note_phdr.p_align = 4;
-
-    if (write(fd, &note_phdr, sizeof(note_phdr)) != sizeof(note_phdr)) {
-        corex_set_error("Failed to write PT_NOTE phdr: %s", strerror(errno));
-        rc = COREX_ERR_WRITE;
-        goto out;
-    }
+    phdr->p_type = PT_NOTE;
+    phdr->p_offset = note_offset;
+    phdr->p_filesz = notes->len;
+    phdr->p_align = 4;
+    phdr++;
 
     /* PT_LOAD program headers (only for dumped segments) */
     for (int i = 0; i < proc->num_mappings; i++) {
@@ -221,46 +298,114 @@ int elf_write_core(const char *path,
 
         uint64_t region_size = m->end - m->start;
 
-        Elf64_Phdr load_phdr;
-        memset(&load_phdr, 0, sizeof(load_phdr));
-        load_phdr.p_type = PT_LOAD;
-        load_phdr.p_vaddr = m->start;
-        load_phdr.p_paddr = 0;
-        load_phdr.p_memsz = region_size;
-        load_phdr.p_flags = m->flags;
-        load_phdr.p_align = COREX_PAGE_SIZE;
-        load_phdr.p_offset = load_offsets[i];
-        load_phdr.p_filesz = region_size;
-
-        if (write(fd, &load_phdr, sizeof(load_phdr)) != sizeof(load_phdr)) {
-            corex_set_error("Failed to write PT_LOAD phdr: %s", strerror(errno));
-            rc = COREX_ERR_WRITE;
-            goto out;
-        }
+        phdr->p_type = PT_LOAD;
+        phdr->p_vaddr = m->start;
+        phdr->p_paddr = 0;
+        phdr->p_memsz = region_size;
+        phdr->p_flags = m->flags;
+        phdr->p_align = COREX_PAGE_SIZE;
+        phdr->p_offset = load_offsets[i];
+        phdr->p_filesz = region_size;
+        phdr++;
     }
 
-    /* ---- Write PT_NOTE segment data ---- */
-    {
-        size_t written = 0;
-        while (written < notes->len) {
-            ssize_t w = write(fd, notes->data + written, notes->len - written);
-            if (w < 0) {
-                if (errno == EINTR) continue;
-                corex_set_error("Failed to write notes: %s", strerror(errno));
-                rc = COREX_ERR_WRITE;
-                goto out;
-            }
-            written += (size_t)w;
-        }
+    /* ---- PT_NOTE segment data, zero-padded to a page boundary ---- */
+    memcpy(prefix + note_offset, notes->data, notes->len);
+
+    return prefix;
+}
+
+int elf_write_headers(int fd,
+                      const corex_proc_info_t *proc,
+                      const corex_note_buf_t *notes,
+                      const size_t *load_offsets)
+{
+    uint8_t *prefix = elf_build_headers(proc, notes, load_offsets);
+    if (!prefix)
+        return COREX_ERR_ALLOC;
+
+    size_t size = elf_headers_size(proc, notes);
+    int rc = io_is_stream(fd) ? io_write_full(fd, prefix, size)
+                              : io_pwrite_full(fd, prefix, size, 0);
+    free(prefix);
+    return rc;
+}
+
+int elf_write_ranges(int fd, pid_t pid, int mem_fd,
+                     const corex_mem_range_t *ranges,
+                     size_t num_ranges,
+                     int skip_zero,
+                     const corex_options_t *opts)
+{
+    int rc = COREX_URING_UNAVAILABLE;
+    if (opts->num_writers <= 1 && (opts->flags & COREX_FLAG_IO_URING))
+        rc = uring_write_ranges(fd, pid, mem_fd, ranges, num_ranges, skip_zero);
+    if (rc != COREX_URING_UNAVAILABLE)
+        return rc;
+
+    /*
+     * O_DIRECT writes block until they reach the device. A single
+     * synchronous writer would leave the target idle meanwhile, so
+     * two writers are used instead (double buffering).
+     */
+    int num_writers = opts->num_writers;
+    if ((opts->flags & COREX_FLAG_DIRECT_IO) && num_writers <= 1)
+        num_writers = 2;
+
+    if (num_writers > 1)
+        return parallel_write_regions(fd, pid, mem_fd, ranges, num_ranges,
+                                      num_writers, skip_zero);
+    return write_memory_ranges(fd, pid, mem_fd, ranges, num_ranges, skip_zero);
+}
+
+int elf_finish_output(int fd, uint64_t size, const corex_options_t *opts)
+{
+    /* A stream has been written to its full size */
+    if (io_is_stream(fd))
+        return 0;
+
+    /* Trailing holes are not written; give the file its full size */
+    if (ftruncate(fd, (off_t)size) < 0) {
+        corex_set_error("Failed to set core file size: %s", strerror(errno));
+        return COREX_ERR_WRITE;
     }
 
-    /* Pad to page boundary before PT_LOAD data */
-    {
-        size_t cur = note_offset + notes->len;
-        rc = write_padding(fd, cur, first_load_offset);
-        if (rc != 0) goto out;
+    if (opts->flags & COREX_FLAG_DIRECT_IO)
+        io_drop_cache(fd);
+
+    return 0;
+}
+
+int elf_write_core(const char *path,
+                   pid_t pid,
+                   const corex_proc_info_t *proc,
+                   const corex_note_buf_t *notes,
+                   const corex_options_t *opts)
+{
+    if (proc->num_mappings < 0) {
+        corex_set_error("Invalid mapping count: %d", proc->num_mappings);
+        return COREX_ERR_INVALID_ARG;
+    }
+
+    /* Calculate all PT_LOAD file offsets (only for dumped segments) */
+    size_t *load_offsets = calloc((size_t)proc->num_mappings + 1, sizeof(size_t));
+    if (!load_offsets) {
+        corex_set_error("Failed to allocate offset table");
+        return COREX_ERR_ALLOC;
+    }
+
+    size_t current_offset = elf_layout_loads(proc, notes, load_offsets);
+
+    int fd = elf_open_output(path, opts);
+    if (fd < 0) {
+        free(load_offsets);
+        return fd;
     }
 
+    int rc = elf_write_headers(fd, proc, notes, load_offsets);
+    if (rc != 0)
+        goto out;
+
     /* ---- Write PT_LOAD segment data ---- */
     {
         char mem_path[64];
@@ -272,33 +417,36 @@ int elf_write_core(const char *path,
             goto out;
         }
 
-        for (int i = 0; i < proc->num_mappings; i++) {
-            const corex_mapping_t *m = &proc->mappings[i];
-            if (!m->should_dump)
-                continue;
-
-            uint64_t region_size = m->end - m->start;
-
-            rc = write_memory_region(fd, mem_fd, m->start, region_size);
-            if (rc != 0) {
-                close(mem_fd);
-                goto out;
-            }
+        /*
+         * Sparse dumps never read untouched anonymous pages and leave
+         * all-zero pages unwritten; both become holes in the file.
+         */
+        int sparse = (opts->flags & COREX_FLAG_SPARSE) != 0;
+
+        corex_mem_range_t *ranges = NULL;
+        size_t num_ranges = 0;
+        rc = mem_ranges_build(pid, proc, load_offsets, sparse, &ranges, &num_ranges);
+        if (rc != 0) {
+            close(mem_fd);
+            goto out;
         }
 
+        if (io_is_stream(fd))
+            rc = stream_memory_ranges(fd, pid, mem_fd, ranges, num_ranges,
+                                      elf_headers_size(proc, notes), current_offset);
+        else
+            rc = elf_write_ranges(fd, pid, mem_fd, ranges, num_ranges, sparse, opts);
+
+        free(ranges);
         close(mem_fd);
+        if (rc != 0)
+            goto out;
     }
 
-    rc = 0;
+    rc = elf_finish_output(fd, current_offset, opts);
 
 out:
-    close(fd);
+    elf_close_output(fd, path, rc != 0, opts);
     free(load_offsets);
-
-    if (rc != 0) {
-        /* Clean up partial file on error */
-        unlink(path);
-    }
-
     return rc;
 }
@@ -7,6 +7,8 @@
 #include "corex_internal.h"
 #include "proc_info.h"
 #include "note_builder.h"
+#include "mem_reader.h"
+#include "corex/corex.h"
 
 /*
  * Write a complete ELF core dump file.
@@ -15,13 +17,75 @@
  *   1. Write ELF header
  *   2. Write program headers (PT_NOTE + PT_LOAD per mapping)
  *   3. Write the PT_NOTE segment data
- *   4. Stream PT_LOAD data from /proc/[pid]/mem
+ *   4. Stream PT_LOAD data from /proc/[pid]/mem, using
+ *      opts->num_writers threads when more than one is requested
+ *
+ * If the output cannot seek (COREX_FLAG_OUTPUT_FD or a FIFO at path),
+ * the file is written sequentially by the calling thread.
  *
  * Returns 0 on success.
  */
 int elf_write_core(const char *path,
                    pid_t pid,
                    const corex_proc_info_t *proc,
-                   const corex_note_buf_t *notes);
+                   const corex_note_buf_t *notes,
+                   const corex_options_t *opts);
+
+/*
+ * The steps of elf_write_core(), for writers that lay out PT_LOAD data
+ * themselves.
+ */
+
+/*
+ * Create the output file (honouring COREX_FLAG_DIRECT_IO), or return
+ * opts->output_fd with COREX_FLAG_OUTPUT_FD. The result may be a stream
+ * (see io_is_stream()). Returns an fd or a COREX_ERR_* code.
+ */
+int elf_open_output(const char *path, const corex_options_t *opts);
+
+/* Close the output of elf_open_output(), removing a partial file if failed */
+void elf_close_output(int fd, const char *path, int failed, const corex_options_t *opts);
+
+/* Page-aligned size of the ELF header, program headers and notes */
+size_t elf_headers_size(const corex_proc_info_t *proc,
+                        const corex_note_buf_t *notes);
+
+/*
+ * Lay out the PT_LOAD data after the headers: store the file offset of
+ * each dumped mapping i in load_offsets[i] (0 for the others) and
+ * return the size of the core file.
+ */
+size_t elf_layout_loads(const corex_proc_info_t *proc,
+                        const corex_note_buf_t *notes,
+                        size_t *load_offsets);
+
+/*
+ * Assemble the headers and notes as written by elf_write_headers() in
+ * a buffer of elf_headers_size() bytes. The caller frees it. Returns
+ * NULL if out of memory.
+ */
+uint8_t *elf_build_headers(const corex_proc_info_t *proc,
+                           const corex_note_buf_t *notes,
+                           const size_t *load_offsets);
+
+/*
+ * Write the headers and notes at offset 0 (or to a stream), using
+ * load_offsets[i] as the p_offset of dumped mapping i. Writes
+ * elf_headers_size() bytes.
+ */
+int elf_write_headers(int fd,
+                      const corex_proc_info_t *proc,
+                      const corex_note_buf_t *notes,
+                      const size_t *load_offsets);
+
+/* Copy ranges from the target with the engine selected by opts */
+int elf_write_ranges(int fd, pid_t pid, int mem_fd,
+                     const corex_mem_range_t *ranges,
+                     size_t num_ranges,
+                     int skip_zero,
+                     const corex_options_t *opts);
+
+/* Set the final file size and apply COREX_FLAG_DIRECT_IO cache handling */
+int elf_finish_output(int fd, uint64_t size, const corex_options_t *opts);
 
 #endif /* ELF_WRITER_H */
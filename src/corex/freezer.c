@@ -0,0 +1,218 @@
+/*
+ * freezer.c - Stop the target with the cgroup v2 freezer
+ *
+ * Writing 1 to cgroup.freeze stops every thread in the cgroup in one
+ * kernel operation, and cgroup.events reports "frozen 1" once all of
+ * them are. Threads cannot be created while the cgroup is frozen, so
+ * the following ptrace attach sees a fixed set of threads that no
+ * longer change memory, however long the attach takes. ptrace stops
+ * count as frozen, so the threads can still be seized and interrupted
+ * to read their registers.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include "corex_internal.h"
+#include "freezer.h"
+#include "corex/corex.h"
+
+/* Path of the cgroup v2 of a process ("/proc/self/cgroup" or "/proc/<pid>/cgroup") */
+static int read_cgroup(const char *proc_file, char *buf, size_t size)
+{
+    FILE *f = fopen(proc_file, "r");
+    if (!f)
+        return -1;
+
+    char line[PATH_MAX + 16];
+    int rc = -1;
+    while (fgets(line, sizeof(line), f)) {
+        /* The unified hierarchy is the "0::<path>" line */
+        if (strncmp(line, "0::", 3) != 0)
+            continue;
+        line[strcspn(line, "\n")] = '\0';
+        if (snprintf(buf, size, "%s", line + 3) < (int)size)
+            rc = 0;
+        break;
+    }
+
+    fclose(f);
+    return rc;
+}
+
+/* Mount point of the cgroup2 file system (/sys/fs/cgroup, or .../unified on hybrid systems) */
+static int find_cgroup2_mount(char *buf, size_t size)
+{
+    FILE *f = fopen("/proc/self/mountinfo", "r");
+    if (!f)
+        return -1;
+
+    char line[PATH_MAX * 2];
+    int rc = -1;
+    while (fgets(line, sizeof(line), f)) {
+        /* "<id> <parent> <dev> <root> <mount point> <options> ... - <fstype> ..." */
+        char mnt[PATH_MAX];
+        const char *sep = strstr(line, " - ");
+        if (!sep || strncmp(sep + 3, "cgroup2 ", 8) != 0)
+            continue;
+        if (sscanf(line, "%*s %*s %*s %*s %4095s", mnt) != 1)
+            continue;
+        if (snprintf(buf, size, "%s", mnt) < (int)size)
+            rc = 0;
+        break;
+    }
+
+    fclose(f);
+    return rc;
+}
+
+/* Read cgroup.freeze: 0 or 1, or -1 if the cgroup has none (the root) */
+static int read_freeze(const char *dir)
+{
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/cgroup.freeze", dir);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    char val[8] = {0};
+    ssize_t n = read(fd, val, sizeof(val) - 1);
+    close(fd);
+    if (n <= 0)
+        return -1;
+    return val[0] == '1';
+}
+
+static int write_freeze(const char *dir, int freeze)
+{
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/cgroup.freeze", dir);
+
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        corex_set_error("Failed to open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    ssize_t n = write(fd, freeze ? "1" : "0", 1);
+    if (n != 1)
+        corex_set_error("Failed to write %s: %s", path, strerror(errno));
+    close(fd);
+    return n == 1 ? 0 : -1;
+}
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Wait until cgroup.events reports "frozen 1". Changes to the file are
+ * signalled as POLLPRI. Returns 0 once frozen, -1 on timeout or error.
+ */
+static int wait_frozen(const char *dir, int timeout_ms)
+{
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/cgroup.events", dir);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        corex_set_error("Failed to open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    int64_t deadline = now_ms() + timeout_ms;
+    int rc = -1;
+    for (;;) {
+        char events[256];
+        ssize_t n = pread(fd, events, sizeof(events) - 1, 0);
+        if (n < 0) {
+            corex_set_error("Failed to read %s: %s", path, strerror(errno));
+            break;
+        }
+        events[n] = '\0';
+        if (strstr(events, "frozen 1")) {
+            rc = 0;
+            break;
+        }
+
+        int64_t left = deadline - now_ms();
+        if (left <= 0) {
+            corex_set_error("Timed out waiting for %s to freeze", dir);
+            break;
+        }
+        struct pollfd pfd = { .fd = fd, .events = POLLPRI };
+        if (poll(&pfd, 1, (int)left) < 0 && errno != EINTR) {
+            corex_set_error("Failed to poll %s: %s", path, strerror(errno));
+            break;
+        }
+    }
+
+    close(fd);
+    return rc;
+}
+
+int freezer_freeze(pid_t pid, corex_freezer_t *fz)
+{
+    memset(fz, 0, sizeof(*fz));
+
+    char proc_file[64], target[PATH_MAX], self[PATH_MAX], mnt[PATH_MAX];
+    snprintf(proc_file, sizeof(proc_file), "/proc/%d/cgroup", (int)pid);
+    if (read_cgroup(proc_file, target, sizeof(target)) != 0 ||
+        read_cgroup("/proc/self/cgroup", self, sizeof(self)) != 0 ||
+        find_cgroup2_mount(mnt, sizeof(mnt)) != 0) {
+        corex_set_error("No cgroup v2 found for PID %d", (int)pid);
+        return COREX_FREEZE_UNAVAILABLE;
+    }
+
+    /* Freezing a cgroup we are in (or below) would freeze us as well */
+    size_t len = strlen(target);
+    if (strcmp(target, "/") == 0 ||
+        (strncmp(self, target, len) == 0 && (self[len] == '\0' || self[len] == '/'))) {
+        corex_set_error("PID %d shares our cgroup %s", (int)pid, target);
+        return COREX_FREEZE_UNAVAILABLE;
+    }
+
+    if (snprintf(fz->path, sizeof(fz->path), "%s%s", mnt, target) >= (int)sizeof(fz->path)) {
+        corex_set_error("cgroup path of PID %d is too long", (int)pid);
+        return COREX_FREEZE_UNAVAILABLE;
+    }
+
+    int frozen = read_freeze(fz->path);
+    if (frozen < 0) {
+        corex_set_error("cgroup %s cannot be frozen", fz->path);
+        return COREX_FREEZE_UNAVAILABLE;
+    }
+
+    /* Leave a cgroup frozen by someone else frozen */
+    if (!frozen) {
+        if (write_freeze(fz->path, 1) != 0)
+            return COREX_FREEZE_UNAVAILABLE;
+        fz->thaw = 1;
+    }
+
+    if (wait_frozen(fz->path, COREX_FREEZE_TIMEOUT_MS) != 0) {
+        freezer_thaw(fz);
+        return COREX_FREEZE_UNAVAILABLE;
+    }
+
+    return 0;
+}
+
+void freezer_thaw(corex_freezer_t *fz)
+{
+    if (fz->thaw)
+        write_freeze(fz->path, 0);
+    fz->thaw = 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * freezer.h - Stop the target with the cgroup v2 freezer (COREX_FLAG_FREEZE)
+ */
+#ifndef FREEZER_H
+#define FREEZER_H
+
+#include <limits.h>
+
+#include "corex_internal.h"
+
+/* Returned when the cgroup cannot be frozen and ptrace alone must stop the target */
+#define COREX_FREEZE_UNAVAILABLE 1
+
+/* How long to wait for cgroup.events to report "frozen 1" (ms) */
+#define COREX_FREEZE_TIMEOUT_MS 5000
+
+typedef struct {
+    char path[PATH_MAX];    /* Directory of the frozen cgroup */
+    int  thaw;              /* Non-zero if we froze it and must thaw it */
+} corex_freezer_t;
+
+/*
+ * Freeze the cgroup v2 of pid, which stops all of its threads (and any
+ * other process in the cgroup) at once, and wait until the freeze is
+ * complete.
+ *
+ * Returns 0 on success, or COREX_FREEZE_UNAVAILABLE (with the cgroup
+ * left as it was) if there is no cgroup v2, the target is in the root
+ * cgroup or in ours, we may not freeze it, or it does not freeze in
+ * time.
+ */
+int freezer_freeze(pid_t pid, corex_freezer_t *fz);
+
+/* Thaw the cgroup unless it was already frozen before freezer_freeze(). */
+void freezer_thaw(corex_freezer_t *fz);
+
+#endif /* FREEZER_H */
@@ -0,0 +1,301 @@
+/*
+ * inject.c - Run system calls inside a ptrace-stopped target
+ *
+ * A system call is injected by pointing a stopped thread's instruction
+ * pointer at an existing system call instruction, loading the syscall
+ * number and arguments into its registers and single-stepping it. The
+ * original registers are put back afterwards. Since nothing is written
+ * into the target's code, threads that keep running are unaffected.
+ *
+ * This is used to fork the target (COREX_FLAG_FORK): the child is a
+ * copy-on-write image of the process that can be dumped at leisure
+ * while the parent runs on. It is not exact: MADV_DONTFORK mappings are
+ * missing from it and MADV_WIPEONFORK ones read back as zeros, so those
+ * are left out of the dump (see proc_info_omit_unforked()).
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include "corex_internal.h"
+#include "inject.h"
+#include "arch/arch.h"
+#include "corex/corex.h"
+
+/* Bytes searched per executable mapping for a system call instruction */
+#define COREX_INJECT_SCAN_SIZE (1 << 20)
+
+/* Signals blocked while a system call is injected: all but SIGTRAP,
+ * which single-stepping raises (SIGKILL and SIGSTOP cannot be blocked).
+ * The kernel's signal mask is 64 bits on every supported architecture. */
+#define COREX_INJECT_BLOCK_MASK (~(uint64_t)0 & ~(1ULL << (SIGTRAP - 1)))
+
+/* Search [start, start+len) of the target for the syscall instruction */
+static int scan_mapping(int mem_fd, uint64_t start, uint64_t len,
+                        uint8_t *buf, uint64_t *addr)
+{
+    uint8_t insn[8];
+    size_t align;
+    size_t insn_len = arch_syscall_insn(insn, &align);
+
+    if (len > COREX_INJECT_SCAN_SIZE)
+        len = COREX_INJECT_SCAN_SIZE;
+
+    ssize_t r = pread(mem_fd, buf, (size_t)len, (off_t)start);
+    if (r < (ssize_t)insn_len)
+        return -1;
+
+    for (size_t off = 0; off + insn_len <= (size_t)r; off += align) {
+        if (memcmp(buf + off, insn, insn_len) == 0) {
+            *addr = start + off;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int inject_find_syscall_insn(pid_t pid, const corex_proc_info_t *proc,
+                             uint64_t *addr)
+{
+    char mem_path[64];
+    snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
+    int mem_fd = open(mem_path, O_RDONLY);
+    if (mem_fd < 0) {
+        corex_set_error("Failed to open %s: %s", mem_path, strerror(errno));
+        return COREX_ERR_PROC_READ;
+    }
+
+    uint8_t *buf = malloc(COREX_INJECT_SCAN_SIZE);
+    if (!buf) {
+        close(mem_fd);
+        corex_set_error("Failed to allocate scan buffer");
+        return COREX_ERR_ALLOC;
+    }
+
+    /* [vdso] first: small, always present, and has syscall fallbacks */
+    int found = -1;
+    for (int pass = 0; pass < 2 && found != 0; pass++) {
+        for (int i = 0; i < proc->num_mappings && found != 0; i++) {
+            const corex_mapping_t *m = &proc->mappings[i];
+            int is_vdso = strcmp(m->path, "[vdso]") == 0;
+            if (!(m->flags & PF_X) || is_vdso != (pass == 0))
+                continue;
+            found = scan_mapping(mem_fd, m->start, m->end - m->start, buf, addr);
+        }
+    }
+
+    free(buf);
+    close(mem_fd);
+
+    if (found != 0) {
+        corex_set_error("No system call instruction found in PID %d", (int)pid);
+        return COREX_ERR_PTRACE;
+    }
+    return 0;
+}
+
+int inject_syscall(pid_t tid, uint64_t insn_addr, long nr,
+                   const uint64_t args[6], int64_t *result, int *stop_sig)
+{
+    corex_gp_regs_t saved, regs;
+    siginfo_t stop_info;
+    uint64_t saved_mask, mask = COREX_INJECT_BLOCK_MASK;
+
+    /* Stepping resumes the thread, which discards its stop signal; keep
+     * the siginfo so the signal can be handed back unchanged */
+    if (*stop_sig && ptrace(PTRACE_GETSIGINFO, tid, NULL, &stop_info) < 0) {
+        corex_set_error("PTRACE_GETSIGINFO on tid %d failed: %s",
+                        (int)tid, strerror(errno));
+        return COREX_ERR_PTRACE;
+    }
+
+    if (ptrace(PTRACE_GETSIGMASK, tid, (void *)sizeof(saved_mask), &saved_mask) < 0) {
+        corex_set_error("PTRACE_GETSIGMASK on tid %d failed: %s",
+                        (int)tid, strerror(errno));
+        return COREX_ERR_PTRACE;
+    }
+
+    if (arch_read_gp_regs(tid, &saved) != 0) {
+        corex_set_error("Failed to read GP regs for tid %d: %s",
+                        (int)tid, strerror(errno));
+        return COREX_ERR_PTRACE;
+    }
+
+    regs = saved;
+    arch_setup_syscall(&regs, insn_addr, nr, args);
+    if (arch_write_gp_regs(tid, &regs) != 0) {
+        corex_set_error("Failed to set GP regs for tid %d: %s",
+                        (int)tid, strerror(errno));
+        return COREX_ERR_PTRACE;
+    }
+
+    /*
+     * Step over the instruction with signals blocked, so that signals
+     * arriving meanwhile stay queued with their siginfo and are taken
+     * once the thread runs on. Event stops (e.g. PTRACE_EVENT_CLONE)
+     * come first. An unblockable SIGSTOP is held like the stop signal;
+     * if there already is one, it is sent again, which loses nothing as
+     * a SIGSTOP never reaches a handler. The final SIGTRAP stop is a
+     * signal-delivery stop, so a system call the thread was interrupted
+     * in is still restarted by the kernel on resume.
+     */
+    int rc = 0;
+    int resend_stop = 0;
+    if (ptrace(PTRACE_SETSIGMASK, tid, (void *)sizeof(mask), &mask) < 0) {
+        corex_set_error("PTRACE_SETSIGMASK on tid %d failed: %s",
+                        (int)tid, strerror(errno));
+        rc = COREX_ERR_PTRACE;
+    }
+    while (rc == 0) {
+        if (ptrace(PTRACE_SINGLESTEP, tid, NULL, NULL) < 0) {
+            corex_set_error("PTRACE_SINGLESTEP on tid %d failed: %s",
+                            (int)tid, strerror(errno));
+            rc = COREX_ERR_PTRACE;
+            break;
+        }
+
+        int status;
+        if (waitpid(tid, &status, __WALL) < 0 || !WIFSTOPPED(status)) {
+            corex_set_error("tid %d did not stop after system call injection", (int)tid);
+            return COREX_ERR_PTRACE;
+        }
+
+        if (status >> 16)
+            continue;
+        if (WSTOPSIG(status) == SIGTRAP)
+            break;
+        if (*stop_sig == 0 &&
+            ptrace(PTRACE_GETSIGINFO, tid, NULL, &stop_info) == 0)
+            *stop_sig = WSTOPSIG(status);
+        else if (WSTOPSIG(status) == SIGSTOP)
+            resend_stop = 1;
+    }
+
+    if (rc == 0) {
+        if (arch_read_gp_regs(tid, &regs) != 0) {
+            corex_set_error("Failed to read GP regs for tid %d: %s",
+                            (int)tid, strerror(errno));
+            rc = COREX_ERR_PTRACE;
+        } else {
+            *result = arch_syscall_result(&regs);
+        }
+    }
+
+    if (arch_write_gp_regs(tid, &saved) != 0 && rc == 0) {
+        corex_set_error("Failed to restore GP regs for tid %d: %s",
+                        (int)tid, strerror(errno));
+        rc = COREX_ERR_PTRACE;
+    }
+
+    if (ptrace(PTRACE_SETSIGMASK, tid, (void *)sizeof(saved_mask), &saved_mask) < 0 &&
+        rc == 0) {
+        corex_set_error("Failed to restore the signal mask of tid %d: %s",
+                        (int)tid, strerror(errno));
+        rc = COREX_ERR_PTRACE;
+    }
+
+    /* The thread now stops for the SIGTRAP; make that stop carry the
+     * held signal, to be delivered by the caller's resume or detach */
+    if (*stop_sig)
+        ptrace(PTRACE_SETSIGINFO, tid, NULL, &stop_info);
+    if (resend_stop)
+        syscall(SYS_tkill, tid, SIGSTOP);
+
+    return rc;
+}
+
+int inject_fork(pid_t tid, uint64_t insn_addr, int *stop_sig, pid_t *child)
+{
+    /*
+     * Trace the child from its first instruction, so that it never runs:
+     * it would return from the injected clone() into the target's code.
+     */
+    if (ptrace(PTRACE_SETOPTIONS, tid, NULL, (void *)(uintptr_t)PTRACE_O_TRACECLONE) < 0) {
+        corex_set_error("PTRACE_SETOPTIONS on tid %d failed: %s",
+                        (int)tid, strerror(errno));
+        return COREX_ERR_PTRACE;
+    }
+
+    /*
+     * clone() with no flags: a new process sharing nothing, with an exit
+     * signal of 0 so the target is not sent SIGCHLD for it.
+     */
+    uint64_t args[6] = {0};
+    int64_t ret = 0;
+    int rc = inject_syscall(tid, insn_addr, __NR_clone, args, &ret, stop_sig);
+
+    ptrace(PTRACE_SETOPTIONS, tid, NULL, NULL);
+
+    if (rc != 0)
+        return rc;
+    if (ret <= 0) {
+        corex_set_error("Injected fork failed in tid %d: %s",
+                        (int)tid, strerror((int)-ret));
+        return COREX_ERR_FORK;
+    }
+
+    /* Wait for the child's initial stop */
+    pid_t pid = (pid_t)ret;
+    int status;
+    if (waitpid(pid, &status, __WALL) < 0 || !WIFSTOPPED(status)) {
+        corex_set_error("Forked child %d did not stop", (int)pid);
+        kill(pid, SIGKILL);
+        return COREX_ERR_FORK;
+    }
+
+    *child = pid;
+    return 0;
+}
+
+void inject_release_child(pid_t tid, uint64_t insn_addr, pid_t child)
+{
+    int status;
+
+    kill(child, SIGKILL);
+    while (waitpid(child, &status, __WALL) >= 0 &&
+           !WIFEXITED(status) && !WIFSIGNALED(status))
+        ;
+
+    /*
+     * The child has no exit signal, so it stays a zombie of the target
+     * until someone waits for it. Have the target do that. The thread is
+     * seized and interrupted as in ptrace_utils.c, so no SIGSTOP is
+     * queued for it.
+     */
+    if (ptrace(PTRACE_SEIZE, tid, NULL, NULL) < 0)
+        return;
+    ptrace(PTRACE_INTERRUPT, tid, NULL, NULL);
+
+    pid_t r;
+    do {
+        r = waitpid(tid, &status, __WALL);
+    } while (r < 0 && errno == EINTR);
+
+    /*
+     * A signal that was already on its way is reported before our
+     * interrupt; the thread is stopped either way. Detaching with signal
+     * 0 would discard it, so it is handed back to PTRACE_DETACH, which
+     * delivers it with its original siginfo.
+     */
+    int stop_sig = 0;
+    if (r >= 0 && WIFSTOPPED(status)) {
+        if ((status >> 16) == 0)
+            stop_sig = WSTOPSIG(status);
+
+        uint64_t args[6] = { (uint64_t)child, 0, __WALL | WNOHANG, 0, 0, 0 };
+        int64_t ret;
+        inject_syscall(tid, insn_addr, __NR_wait4, args, &ret, &stop_sig);
+    }
+
+    ptrace(PTRACE_DETACH, tid, NULL, (void *)(uintptr_t)stop_sig);
+}
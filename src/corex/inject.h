@@ -0,0 +1,46 @@
+/*
+ * inject.h - Run system calls inside a ptrace-stopped target
+ */
+#ifndef INJECT_H
+#define INJECT_H
+
+#include "corex_internal.h"
+#include "proc_info.h"
+
+/*
+ * Find an existing system call instruction in an executable mapping of
+ * the target ([vdso] is preferred), so that no code has to be written
+ * into the target. Returns 0 and stores its address in *addr.
+ */
+int inject_find_syscall_insn(pid_t pid, const corex_proc_info_t *proc,
+                             uint64_t *addr);
+
+/*
+ * Execute system call nr(args) in the ptrace-stopped thread tid, using
+ * the instruction at insn_addr. The thread's registers are restored
+ * afterwards. *stop_sig is the signal the thread is stopped with (0 for
+ * none); it is updated if one arrives meanwhile, and the thread is left
+ * stopped with that signal and its siginfo, for the caller to deliver
+ * with PTRACE_DETACH. Returns 0 and stores the syscall's return value
+ * (or -errno) in *result.
+ */
+int inject_syscall(pid_t tid, uint64_t insn_addr, long nr,
+                   const uint64_t args[6], int64_t *result, int *stop_sig);
+
+/*
+ * Make the ptrace-stopped thread tid fork its process. The child is a
+ * copy-on-write image of the process at this instant, without its
+ * MADV_DONTFORK mappings and with MADV_WIPEONFORK ones zeroed. It is traced by
+ * the caller and held stopped before it executes any instruction.
+ * stop_sig is passed to inject_syscall().
+ * Returns 0 and stores the child's PID in *child.
+ */
+int inject_fork(pid_t tid, uint64_t insn_addr, int *stop_sig, pid_t *child);
+
+/*
+ * Kill a child made by inject_fork() and have the target reap it, so
+ * no zombie is left behind. tid is briefly stopped for this.
+ */
+void inject_release_child(pid_t tid, uint64_t insn_addr, pid_t child);
+
+#endif /* INJECT_H */
@@ -0,0 +1,294 @@
+/*
+ * io_util.c - Output file helpers shared by the corex writers
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "corex_internal.h"
+#include "io_util.h"
+#include "stats.h"
+#include "corex/corex.h"
+
+/* Granularity at which all-zero data is turned into file holes */
+#define COREX_ZERO_BLOCK_SIZE 4096
+
+void *io_alloc_buffer(size_t size)
+{
+    void *p = NULL;
+    if (posix_memalign(&p, COREX_IO_ALIGN, size) != 0)
+        return NULL;
+    return p;
+}
+
+/*
+ * A copy buffer is reused for every chunk of the dump; in a huge page it
+ * takes one fault and one TLB entry instead of one per page.
+ * MADV_HUGEPAGE gets it one also when THP is only enabled on request.
+ */
+void *io_alloc_huge_buffer(size_t size)
+{
+    size = (size + COREX_HUGE_PAGE_SIZE - 1) & ~(COREX_HUGE_PAGE_SIZE - 1);
+
+    void *p = NULL;
+    if (posix_memalign(&p, COREX_HUGE_PAGE_SIZE, size) != 0)
+        return NULL;
+    madvise(p, size, MADV_HUGEPAGE);
+    return p;
+}
+
+/*
+ * O_DIRECT rejects writes whose buffer, offset or length is not aligned
+ * to the device's logical block size, which may be larger than
+ * COREX_IO_ALIGN. Drop O_DIRECT so the write can be retried buffered.
+ * Returns 1 if O_DIRECT was set.
+ */
+static int clear_direct(int fd)
+{
+    int fl = fcntl(fd, F_GETFL);
+    if (fl < 0 || !(fl & O_DIRECT))
+        return 0;
+    return fcntl(fd, F_SETFL, fl & ~O_DIRECT) == 0;
+}
+
+int io_pwrite_full(int fd, const void *buf, size_t len, uint64_t off)
+{
+    const uint8_t *p = buf;
+    size_t written = 0;
+
+    while (written < len) {
+        ssize_t w = pwrite(fd, p + written, len - written, (off_t)(off + written));
+        COREX_COUNT(syscalls, 1);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EINVAL && clear_direct(fd))
+                continue;
+            corex_set_error("Write failed: %s", strerror(errno));
+            return COREX_ERR_WRITE;
+        }
+        written += (size_t)w;
+        COREX_COUNT(bytes_written, w);
+    }
+
+    return 0;
+}
+
+static int block_is_zero(const uint8_t *p, size_t len)
+{
+    return p[0] == 0 && memcmp(p, p + 1, len - 1) == 0;
+}
+
+size_t io_next_data_run(const uint8_t *buf, size_t len, size_t pos,
+                        size_t *run_end)
+{
+    while (pos < len) {
+        size_t blk = len - pos;
+        if (blk > COREX_ZERO_BLOCK_SIZE)
+            blk = COREX_ZERO_BLOCK_SIZE;
+        if (!block_is_zero(buf + pos, blk))
+            break;
+        pos += blk;
+    }
+
+    size_t end = pos;
+    while (end < len) {
+        size_t blk = len - end;
+        if (blk > COREX_ZERO_BLOCK_SIZE)
+            blk = COREX_ZERO_BLOCK_SIZE;
+        if (block_is_zero(buf + end, blk))
+            break;
+        end += blk;
+    }
+
+    *run_end = end;
+    return pos;
+}
+
+/*
+ * Write buf at off, skipping blocks that are entirely zero. Runs of
+ * non-zero blocks are written with a single pwrite().
+ */
+static int write_skip_zero(int fd, const uint8_t *buf, size_t len, uint64_t off)
+{
+    size_t pos = 0;
+    size_t data = 0;
+
+    while (pos < len) {
+        size_t end;
+        pos = io_next_data_run(buf, len, pos, &end);
+        if (pos == len)
+            break;
+
+        int rc = io_pwrite_full(fd, buf + pos, end - pos, off + pos);
+        if (rc != 0)
+            return rc;
+        data += end - pos;
+        pos = end;
+    }
+
+    COREX_COUNT(bytes_skipped, len - data);
+    return 0;
+}
+
+int io_write_ranges(int fd, const uint8_t *buf,
+                    const corex_mem_range_t *ranges, size_t count,
+                    int skip_zero)
+{
+    size_t i = 0;
+
+    while (i < count) {
+        uint64_t off = ranges[i].file_offset;
+        size_t len = ranges[i].size;
+        size_t j = i + 1;
+        while (j < count && ranges[j].file_offset == off + len) {
+            len += ranges[j].size;
+            j++;
+        }
+
+        int rc = skip_zero ? write_skip_zero(fd, buf, len, off)
+                           : io_pwrite_full(fd, buf, len, off);
+        if (rc != 0)
+            return rc;
+
+        buf += len;
+        i = j;
+    }
+
+    return 0;
+}
+
+int io_zero_range(int fd, uint64_t off, uint64_t len)
+{
+    COREX_COUNT(syscalls, 1);
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  (off_t)off, (off_t)len) == 0)
+        return 0;
+
+    /* Filesystem cannot punch holes; write the zeros */
+    uint8_t *zeros = io_alloc_buffer(COREX_MEM_CHUNK_SIZE);
+    if (!zeros) {
+        corex_set_error("Failed to allocate zero buffer");
+        return COREX_ERR_ALLOC;
+    }
+    memset(zeros, 0, COREX_MEM_CHUNK_SIZE);
+
+    int rc = 0;
+    while (len > 0 && rc == 0) {
+        size_t n = len > COREX_MEM_CHUNK_SIZE ? COREX_MEM_CHUNK_SIZE : (size_t)len;
+        rc = io_pwrite_full(fd, zeros, n, off);
+        off += n;
+        len -= n;
+    }
+
+    free(zeros);
+    return rc;
+}
+
+int io_is_stream(int fd)
+{
+    return lseek(fd, 0, SEEK_CUR) < 0 && errno == ESPIPE;
+}
+
+int io_write_full(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    size_t written = 0;
+    int rc = 0;
+
+    /*
+     * Writing to a pipe or socket whose reader has exited raises SIGPIPE,
+     * which would kill the host process. Block it while writing and
+     * discard one we caused, unless it was already pending.
+     */
+    sigset_t pipe_set, old_set, pending;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+    sigpending(&pending);
+    int was_pending = sigismember(&pending, SIGPIPE);
+
+    while (written < len) {
+        ssize_t w = write(fd, p + written, len - written);
+        COREX_COUNT(syscalls, 1);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+                if (poll(&pfd, 1, -1) >= 0 || errno == EINTR)
+                    continue;
+            }
+            if (errno == EPIPE && !was_pending) {
+                static const struct timespec no_wait = { 0, 0 };
+                sigtimedwait(&pipe_set, NULL, &no_wait);
+                errno = EPIPE;
+            }
+            corex_set_error("Write failed: %s", strerror(errno));
+            rc = COREX_ERR_WRITE;
+            break;
+        }
+        written += (size_t)w;
+        COREX_COUNT(bytes_written, w);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    return rc;
+}
+
+int io_write_zeros(int fd, uint64_t len)
+{
+    static const uint8_t zeros[COREX_MEM_CHUNK_SIZE];
+
+    int rc = 0;
+    while (len > 0 && rc == 0) {
+        size_t n = len > sizeof(zeros) ? sizeof(zeros) : (size_t)len;
+        rc = io_write_full(fd, zeros, n);
+        len -= n;
+    }
+    return rc;
+}
+
+ssize_t io_read_full(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t r = read(fd, p + done, len - done);
+        COREX_COUNT(syscalls, 1);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                struct pollfd pfd = { .fd = fd, .events = POLLIN };
+                if (poll(&pfd, 1, -1) >= 0 || errno == EINTR)
+                    continue;
+            }
+            corex_set_error("Read failed: %s", strerror(errno));
+            return COREX_ERR_PROC_READ;
+        }
+        if (r == 0)
+            break;
+        done += (size_t)r;
+        COREX_COUNT(bytes_read, r);
+    }
+    return (ssize_t)done;
+}
+
+void io_drop_cache(int fd)
+{
+    /* Pages must be clean before they can be dropped */
+    if (fdatasync(fd) == 0)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
@@ -0,0 +1,84 @@
+/*
+ * io_util.h - Output file helpers shared by the corex writers
+ */
+#ifndef IO_UTIL_H
+#define IO_UTIL_H
+
+#include "corex_internal.h"
+#include "mem_reader.h"
+
+/* Alignment of buffers, offsets and lengths used with O_DIRECT */
+#define COREX_IO_ALIGN 4096
+
+/* Allocate a COREX_IO_ALIGN aligned buffer; release it with free(). */
+void *io_alloc_buffer(size_t size);
+
+/* Size of the transparent huge pages asked for by io_alloc_huge_buffer() */
+#define COREX_HUGE_PAGE_SIZE (2UL << 20)
+
+/*
+ * Allocate a buffer for copying memory, rounded up to and aligned on
+ * COREX_HUGE_PAGE_SIZE and backed by transparent huge pages if the
+ * kernel allows. Release it with free().
+ */
+void *io_alloc_huge_buffer(size_t size);
+
+/*
+ * Write len bytes at file offset off, retrying on EINTR / short writes.
+ * If an O_DIRECT write is rejected as misaligned, O_DIRECT is cleared on
+ * fd and the write is retried through the page cache.
+ */
+int io_pwrite_full(int fd, const void *buf, size_t len, uint64_t off);
+
+/*
+ * Find the next run of non-zero blocks in buf[pos..len). Returns the
+ * start of the run (len if there is none) and stores its end in *run_end.
+ */
+size_t io_next_data_run(const uint8_t *buf, size_t len, size_t pos,
+                        size_t *run_end);
+
+/*
+ * Write the contents of ranges[0..count), stored back to back in buf as
+ * produced by mem_read_ranges(), at each range's file offset. Adjacent
+ * ranges are merged into a single write.
+ *
+ * With skip_zero set, pages that are entirely zero are not written at
+ * all, leaving holes in the (freshly truncated) output file.
+ *
+ * Returns 0 on success.
+ */
+int io_write_ranges(int fd, const uint8_t *buf,
+                    const corex_mem_range_t *ranges, size_t count,
+                    int skip_zero);
+
+/* Make [off, off+len) of fd read as zeros, as a hole if possible. Returns 0 on success. */
+int io_zero_range(int fd, uint64_t off, uint64_t len);
+
+/* Non-zero if fd cannot seek (pipe, FIFO, socket, terminal) and must be written in order */
+int io_is_stream(int fd);
+
+/*
+ * Write len bytes at the current position of a stream, retrying on
+ * EINTR / short writes and waiting if fd is non-blocking. A reader that
+ * has gone away is reported as a write error instead of raising SIGPIPE.
+ */
+int io_write_full(int fd, const void *buf, size_t len);
+
+/* Write len zero bytes at the current position of a stream. Returns 0 on success. */
+int io_write_zeros(int fd, uint64_t len);
+
+/*
+ * Read up to len bytes from the current position of fd, retrying on
+ * EINTR / short reads and waiting if fd is non-blocking. Returns the
+ * number of bytes read, less than len only at end of file, or
+ * COREX_ERR_PROC_READ.
+ */
+ssize_t io_read_full(int fd, void *buf, size_t len);
+
+/*
+ * Flush fd and drop its pages from the page cache, so that writing a
+ * large dump without O_DIRECT does not evict other processes' data.
+ */
+void io_drop_cache(int fd);
+
+#endif /* IO_UTIL_H */
@@ -0,0 +1,416 @@
+/*
+ * mem_reader.c - Batched reads of target process memory
+ *
+ * Reading /proc/[pid]/mem costs one pread() per chunk, which adds up to
+ * at least one syscall per mapping. process_vm_readv() instead accepts
+ * an array of remote iovecs, so many small mappings can be gathered into
+ * a single call. It cannot read pages the target has no access to
+ * (PROT_NONE, vsyscall, ...), so ranges that fail are read again through
+ * /proc/[pid]/mem, which uses FOLL_FORCE, and zero-filled if that fails.
+ *
+ * When building the range table for a sparse dump, /proc/[pid]/pagemap
+ * is consulted so never-touched anonymous pages are not read at all. The
+ * same table lets a live dump (precopy.c) pick only soft-dirty pages.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+#include "corex_internal.h"
+#include "mem_reader.h"
+#include "stats.h"
+#include "corex/corex.h"
+
+/* /proc/[pid]/pagemap entry bits (Documentation/admin-guide/mm/pagemap.rst) */
+#define PM_PRESENT    (1ULL << 63)
+#define PM_SWAPPED    (1ULL << 62)
+#define PM_SOFT_DIRTY (1ULL << 55)
+
+/* Number of pagemap entries read per pread() */
+#define COREX_PAGEMAP_BATCH 4096
+
+/* What to do with one page, see classify_page() */
+enum { PAGE_SKIP, PAGE_DATA, PAGE_HOLE };
+
+/* Growable range table used while building */
+typedef struct {
+    corex_mem_range_t *v;
+    size_t             n;
+    size_t             cap;
+} range_vec_t;
+
+/*
+ * Append [addr, addr+size) at file offset off, split into ranges of at
+ * most max_len bytes. With aligned set, ranges end at multiples of
+ * max_len, so that none spans two huge pages.
+ */
+static int range_push(range_vec_t *rv, uint64_t addr, uint64_t size, uint64_t off,
+                      uint64_t max_len, int aligned)
+{
+    while (size > 0) {
+        if (rv->n == rv->cap) {
+            size_t cap = rv->cap ? rv->cap * 2 : 256;
+            corex_mem_range_t *v = realloc(rv->v, cap * sizeof(*v));
+            if (!v) {
+                corex_set_error("Failed to allocate memory range table");
+                return COREX_ERR_ALLOC;
+            }
+            rv->v = v;
+            rv->cap = cap;
+        }
+
+        uint64_t len = aligned ? max_len - addr % max_len : max_len;
+        if (len > size)
+            len = size;
+        rv->v[rv->n].addr = addr;
+        rv->v[rv->n].size = len;
+        rv->v[rv->n].file_offset = off;
+        rv->n++;
+
+        addr += len;
+        off += len;
+        size -= len;
+    }
+    return 0;
+}
+
+/*
+ * Private anonymous memory that is neither resident nor swapped out has
+ * never been written and reads back as zeros. File-backed and shared
+ * mappings are excluded: their absent pages still have contents in the
+ * page cache or shmem. [vdso]/[vvar] are special mappings. Anonymous
+ * hugetlb mappings count as files, but reading their absent pages would
+ * take huge pages from the pool just to copy zeros.
+ */
+static int can_skip_absent(const corex_mapping_t *m)
+{
+    if (m->hugetlb_page_size)
+        return !m->is_shared && strncmp(m->path, "/anon_hugepage", 14) == 0;
+    return !m->is_file_backed && !m->is_shared && strncmp(m->path, "[v", 2) != 0;
+}
+
+/* Huge pages are read in chunks that do not straddle them */
+static int is_huge(const corex_mapping_t *m)
+{
+    return m->hugetlb_page_size != 0 || m->is_thp;
+}
+
+/*
+ * Decide what to do with a page from its pagemap entry. Absent pages in
+ * COREX_SELECT_DIRTY mode become holes (anonymous memory) or are copied
+ * again (file-backed memory), unless want_holes is 0, in which case they
+ * are skipped and left for the final pass.
+ */
+static int classify_page(uint64_t entry, int mode, int anon, int want_holes)
+{
+    int present = (entry & (PM_PRESENT | PM_SWAPPED)) != 0;
+
+    if (mode == COREX_SELECT_PRESENT)
+        return present ? PAGE_DATA : PAGE_SKIP;
+
+    /* COREX_SELECT_DIRTY */
+    if (present)
+        return (entry & PM_SOFT_DIRTY) ? PAGE_DATA : PAGE_SKIP;
+    if (!want_holes)
+        return PAGE_SKIP;
+    return anon ? PAGE_HOLE : PAGE_DATA;
+}
+
+/*
+ * Push the pages of m selected by mode according to /proc/[pid]/pagemap.
+ * If pagemap cannot be read, the rest of the mapping is copied.
+ */
+static int push_selected_runs(range_vec_t *rv, range_vec_t *holes, int pagemap_fd,
+                              const corex_mapping_t *m, uint64_t file_off, int mode)
+{
+    uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t entries[COREX_PAGEMAP_BATCH];
+    int anon = can_skip_absent(m);
+    uint64_t run_start = m->start;
+    int run_kind = PAGE_SKIP;
+    uint64_t addr = m->start;
+    int rc = 0;
+
+    while (addr < m->end) {
+        uint64_t npages = (m->end - addr) / page_size;
+        if (npages > COREX_PAGEMAP_BATCH)
+            npages = COREX_PAGEMAP_BATCH;
+
+        ssize_t r = pread(pagemap_fd, entries, npages * sizeof(uint64_t),
+                          (off_t)((addr / page_size) * sizeof(uint64_t)));
+        COREX_COUNT(syscalls, 1);
+        if (r <= 0 || (size_t)r % sizeof(uint64_t) != 0)
+            break;
+        npages = (uint64_t)r / sizeof(uint64_t);
+
+        for (uint64_t k = 0; k < npages; k++, addr += page_size) {
+            int kind = classify_page(entries[k], mode, anon, holes != NULL);
+            if (kind == run_kind)
+                continue;
+
+            if (run_kind == PAGE_DATA)
+                rc = range_push(rv, run_start, addr - run_start,
+                                file_off + (run_start - m->start), COREX_MEM_CHUNK_SIZE,
+                                is_huge(m));
+            else if (run_kind == PAGE_HOLE)
+                rc = range_push(holes, run_start, addr - run_start,
+                                file_off + (run_start - m->start), UINT64_MAX, 0);
+            if (rc != 0)
+                return rc;
+
+            run_start = addr;
+            run_kind = kind;
+        }
+    }
+
+    /* Unknown residency: keep the rest of the mapping */
+    if (addr < m->end && run_kind != PAGE_DATA) {
+        if (run_kind == PAGE_HOLE)
+            rc = range_push(holes, run_start, addr - run_start,
+                            file_off + (run_start - m->start), UINT64_MAX, 0);
+        if (rc != 0)
+            return rc;
+        run_start = addr;
+        run_kind = PAGE_DATA;
+    }
+
+    if (run_kind == PAGE_DATA)
+        return range_push(rv, run_start, m->end - run_start,
+                          file_off + (run_start - m->start), COREX_MEM_CHUNK_SIZE,
+                          is_huge(m));
+    if (run_kind == PAGE_HOLE)
+        return range_push(holes, run_start, m->end - run_start,
+                          file_off + (run_start - m->start), UINT64_MAX, 0);
+    return 0;
+}
+
+int mem_ranges_select(pid_t pid,
+                      const corex_proc_info_t *proc,
+                      const size_t *load_offsets,
+                      const uint8_t *select,
+                      corex_mem_range_t **out,
+                      size_t *count,
+                      corex_mem_range_t **holes,
+                      size_t *num_holes)
+{
+    range_vec_t rv = {0};
+    range_vec_t hv = {0};
+    int pagemap_fd = -1;
+    int rc = 0;
+
+    for (int i = 0; i < proc->num_mappings && rc == 0; i++) {
+        const corex_mapping_t *m = &proc->mappings[i];
+        int mode = select[i];
+
+        if (mode == COREX_SELECT_PRESENT && !can_skip_absent(m))
+            mode = COREX_SELECT_ALL;
+
+        if (mode == COREX_SELECT_NONE)
+            continue;
+
+        if (mode != COREX_SELECT_ALL && pagemap_fd < 0) {
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+            pagemap_fd = open(path, O_RDONLY);
+            /* Without pagemap every page has to be copied */
+            if (pagemap_fd < 0)
+                mode = COREX_SELECT_ALL;
+        }
+
+        if (mode == COREX_SELECT_ALL)
+            rc = range_push(&rv, m->start, m->end - m->start, load_offsets[i],
+                            COREX_MEM_CHUNK_SIZE, is_huge(m));
+        else
+            rc = push_selected_runs(&rv, holes ? &hv : NULL, pagemap_fd, m,
+                                    load_offsets[i], mode);
+    }
+
+    if (pagemap_fd >= 0)
+        close(pagemap_fd);
+
+    if (rc != 0) {
+        free(rv.v);
+        free(hv.v);
+        *out = NULL;
+        *count = 0;
+        if (holes) {
+            *holes = NULL;
+            *num_holes = 0;
+        }
+        return rc;
+    }
+
+    *out = rv.v;
+    *count = rv.n;
+    if (holes) {
+        *holes = hv.v;
+        *num_holes = hv.n;
+    }
+    return 0;
+}
+
+int mem_ranges_build(pid_t pid,
+                     const corex_proc_info_t *proc,
+                     const size_t *load_offsets,
+                     int skip_absent,
+                     corex_mem_range_t **out,
+                     size_t *count)
+{
+    uint8_t *select = calloc((size_t)proc->num_mappings + 1, 1);
+    if (!select) {
+        corex_set_error("Failed to allocate memory range table");
+        return COREX_ERR_ALLOC;
+    }
+
+    for (int i = 0; i < proc->num_mappings; i++) {
+        if (proc->mappings[i].should_dump)
+            select[i] = skip_absent ? COREX_SELECT_PRESENT : COREX_SELECT_ALL;
+    }
+
+    int rc = mem_ranges_select(pid, proc, load_offsets, select, out, count, NULL, NULL);
+    free(select);
+
+    /* Never-touched pages are not read; they end up as holes */
+    if (rc == 0 && skip_absent) {
+        uint64_t skipped = 0;
+        for (int i = 0; i < proc->num_mappings; i++) {
+            if (proc->mappings[i].should_dump)
+                skipped += proc->mappings[i].end - proc->mappings[i].start;
+        }
+        for (size_t k = 0; k < *count; k++)
+            skipped -= (*out)[k].size;
+        COREX_COUNT(bytes_skipped, skipped);
+    }
+    return rc;
+}
+
+int mem_soft_dirty_supported(void)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *p = mmap(NULL, (size_t)page_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return 0;
+
+    /* The kernel marks new mappings soft-dirty if it tracks the bit at all */
+    *(volatile uint8_t *)p = 1;
+
+    uint64_t entry = 0;
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd >= 0) {
+        if (pread(fd, &entry, sizeof(entry),
+                  (off_t)(((uintptr_t)p / (uintptr_t)page_size) * sizeof(entry))) != sizeof(entry))
+            entry = 0;
+        close(fd);
+    }
+
+    munmap(p, (size_t)page_size);
+    return (entry & PM_SOFT_DIRTY) != 0;
+}
+
+size_t mem_batch_len(const corex_mem_range_t *ranges, size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    size_t n = 1;
+    uint64_t bytes = ranges[0].size;
+    while (n < count && n < COREX_MAX_IOV) {
+        if (bytes + ranges[n].size > COREX_MEM_CHUNK_SIZE)
+            break;
+        bytes += ranges[n].size;
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Read [addr, addr+size) through /proc/[pid]/mem. If a read fails, the
+ * rest of the range is written as zeros. This is what the kernel and
+ * GDB do for unreadable pages (guard pages, vsyscall, ...).
+ */
+static void pread_fill(int mem_fd, uint8_t *buf, uint64_t addr, uint64_t size)
+{
+    while (size > 0) {
+        ssize_t n = pread(mem_fd, buf, size, (off_t)addr);
+        COREX_COUNT(syscalls, 1);
+        if (n <= 0) {
+            memset(buf, 0, size);
+            return;
+        }
+        COREX_COUNT(bytes_read, n);
+        buf += n;
+        addr += (uint64_t)n;
+        size -= (uint64_t)n;
+    }
+}
+
+size_t mem_read_ranges(pid_t pid, int mem_fd,
+                       const corex_mem_range_t *ranges, size_t count,
+                       uint8_t *buf)
+{
+    struct iovec remote[COREX_MAX_IOV];
+    size_t done = 0;
+    size_t i = 0;
+    int use_vm = 1;
+
+    while (i < count) {
+        if (!use_vm) {
+            pread_fill(mem_fd, buf + done, ranges[i].addr, ranges[i].size);
+            done += ranges[i].size;
+            i++;
+            continue;
+        }
+
+        size_t n = count - i;
+        if (n > COREX_MAX_IOV)
+            n = COREX_MAX_IOV;
+
+        size_t total = 0;
+        for (size_t k = 0; k < n; k++) {
+            remote[k].iov_base = (void *)(uintptr_t)ranges[i + k].addr;
+            remote[k].iov_len = ranges[i + k].size;
+            total += ranges[i + k].size;
+        }
+
+        struct iovec local = { .iov_base = buf + done, .iov_len = total };
+        ssize_t r = process_vm_readv(pid, &local, 1, remote, (unsigned long)n, 0);
+        COREX_COUNT(syscalls, 1);
+        if (r > 0)
+            COREX_COUNT(bytes_read, r);
+        if (r < 0) {
+            /* Anything but EFAULT (ENOSYS, EPERM, ...) means the syscall
+             * is unusable for this target; stick with pread from here. */
+            if (errno != EFAULT)
+                use_vm = 0;
+            r = 0;
+        }
+
+        /* Skip past the ranges that were read completely */
+        size_t got = (size_t)r;
+        while (i < count && got >= ranges[i].size && got > 0) {
+            got -= ranges[i].size;
+            done += ranges[i].size;
+            i++;
+        }
+
+        if ((size_t)r == total || !use_vm)
+            continue;
+
+        /* ranges[i] faulted after 'got' bytes: finish it with pread */
+        pread_fill(mem_fd, buf + done + got, ranges[i].addr + got,
+                   ranges[i].size - got);
+        done += ranges[i].size;
+        i++;
+    }
+
+    return done;
+}
@@ -0,0 +1,86 @@
+/*
+ * mem_reader.h - Batched reads of target process memory
+ */
+#ifndef MEM_READER_H
+#define MEM_READER_H
+
+#include "corex_internal.h"
+#include "proc_info.h"
+
+/* Maximum number of remote iovecs handed to one process_vm_readv() call */
+#define COREX_MAX_IOV 1024
+
+/* A piece of target memory and where it goes in the core file */
+typedef struct {
+    uint64_t addr;          /* Target virtual address */
+    uint64_t size;          /* At most COREX_MEM_CHUNK_SIZE bytes */
+    uint64_t file_offset;   /* Destination offset in the core file */
+} corex_mem_range_t;
+
+/*
+ * Split every dumped mapping into ranges of at most COREX_MEM_CHUNK_SIZE
+ * bytes, in file order. load_offsets[i] is mapping i's PT_LOAD offset.
+ * Ranges of mappings backed by huge pages do not cross a multiple of
+ * COREX_MEM_CHUNK_SIZE, so each read stays within one huge page.
+ *
+ * With skip_absent set, pages of private anonymous mappings that are
+ * neither present nor swapped (per /proc/[pid]/pagemap) are left out;
+ * they read back as zeros and become holes in the output file.
+ *
+ * The caller frees *out. Returns 0 on success.
+ */
+int mem_ranges_build(pid_t pid,
+                     const corex_proc_info_t *proc,
+                     const size_t *load_offsets,
+                     int skip_absent,
+                     corex_mem_range_t **out,
+                     size_t *count);
+
+/* Page selection modes for mem_ranges_select(), one per mapping */
+#define COREX_SELECT_NONE    0  /* Mapping is not copied */
+#define COREX_SELECT_ALL     1  /* Every page */
+#define COREX_SELECT_PRESENT 2  /* Skip never-touched anonymous pages */
+#define COREX_SELECT_DIRTY   3  /* Only pages whose soft-dirty bit is set */
+
+/*
+ * Like mem_ranges_build(), with the page selection given per mapping in
+ * select[0..proc->num_mappings).
+ *
+ * In COREX_SELECT_DIRTY mode, pages that are no longer present may have
+ * been discarded (e.g. MADV_DONTNEED) without being marked soft-dirty.
+ * If holes is non-NULL, such anonymous pages are returned in *holes (not
+ * split into chunks) for the caller to zero, and file-backed ones are
+ * copied again. If holes is NULL they are skipped.
+ *
+ * The caller frees *out and *holes. Returns 0 on success.
+ */
+int mem_ranges_select(pid_t pid,
+                      const corex_proc_info_t *proc,
+                      const size_t *load_offsets,
+                      const uint8_t *select,
+                      corex_mem_range_t **out,
+                      size_t *count,
+                      corex_mem_range_t **holes,
+                      size_t *num_holes);
+
+/* Non-zero if the kernel maintains soft-dirty bits (CONFIG_MEM_SOFT_DIRTY) */
+int mem_soft_dirty_supported(void);
+
+/*
+ * Return how many ranges, starting at ranges[0], fit together in one
+ * COREX_MEM_CHUNK_SIZE buffer. Always at least 1 when count > 0.
+ */
+size_t mem_batch_len(const corex_mem_range_t *ranges, size_t count);
+
+/*
+ * Read ranges[0..count) back to back into buf with process_vm_readv().
+ * Ranges (or their tails) that fail with EFAULT are retried with pread()
+ * on mem_fd, and zero-filled if that fails as well.
+ *
+ * Returns the number of bytes placed in buf.
+ */
+size_t mem_read_ranges(pid_t pid, int mem_fd,
+                       const corex_mem_range_t *ranges, size_t count,
+                       uint8_t *buf);
+
+#endif /* MEM_READER_H */
@@ -72,24 +72,20 @@ static int note_buf_grow(corex_note_buf_t *buf, size_t needed)
     return 0;
 }
 
-/*
- * Append a single note entry to the buffer.
- *   name: note name string (e.g. "CORE" or "LINUX")
- *   type: note type (e.g. NT_PRSTATUS)
- *   desc: pointer to note data
- *   descsz: size of note data
- */
-static int note_append(corex_note_buf_t *buf, const char *name,
-                       uint32_t type, const void *desc, size_t descsz)
+uint8_t *note_reserve(corex_note_buf_t *buf, const char *name,
+                      uint32_t type, size_t descsz)
 {
     uint32_t namesz = (uint32_t)strlen(name) + 1;  /* includes NUL */
     size_t name_padded = align_up(namesz, NOTE_ALIGN);
     size_t desc_padded = align_up(descsz, NOTE_ALIGN);
     size_t total = sizeof(Elf64_Nhdr) + name_padded + desc_padded;
 
-    int rc = note_buf_grow(buf, total);
-    if (rc != 0)
-        return rc;
+    if (descsz > UINT32_MAX) {
+        corex_set_error("Note descriptor too large: %zu bytes", descsz);
+        return NULL;
+    }
+    if (note_buf_grow(buf, total) != 0)
+        return NULL;
 
     uint8_t *p = buf->data + buf->len;
     memset(p, 0, total);
@@ -103,10 +99,25 @@ static int note_append(corex_note_buf_t *buf, const char *name,
     /* Write the name */
     memcpy(p + sizeof(Elf64_Nhdr), name, namesz);
 
-    /* Write the descriptor */
-    memcpy(p + sizeof(Elf64_Nhdr) + name_padded, desc, descsz);
-
     buf->len += total;
+    return p + sizeof(Elf64_Nhdr) + name_padded;
+}
+
+/*
+ * Append a single note entry to the buffer.
+ *   name: note name string (e.g. "CORE" or "LINUX")
+ *   type: note type (e.g. NT_PRSTATUS)
+ *   desc: pointer to note data
+ *   descsz: size of note data
+ */
+static int note_append(corex_note_buf_t *buf, const char *name,
+                       uint32_t type, const void *desc, size_t descsz)
+{
+    uint8_t *p = note_reserve(buf, name, type, descsz);
+    if (!p)
+        return COREX_ERR_ALLOC;
+
+    memcpy(p, desc, descsz);
     return 0;
 }
 
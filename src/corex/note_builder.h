@@ -8,6 +8,12 @@
 #include "proc_info.h"
 #include "ptrace_utils.h"
 
+/* Notes added by corex itself (owner "COREX") */
+#define COREX_NOTE_NAME    "COREX"
+#define NT_COREX_DELTA     0x43580001  /* Pages still to be taken from the base (delta.h) */
+#define NT_COREX_REBUILT   0x43580002  /* Former NT_COREX_DELTA, base filled in */
+#define NT_COREX_OMITTED   0x43580003  /* Regions left out of a size-limited or fork dump (budget.h) */
+
 /* Opaque note buffer */
 typedef struct {
     uint8_t    *data;
@@ -21,6 +27,14 @@ int note_buf_init(corex_note_buf_t *buf);
 /* Free note buffer. */
 void note_buf_free(corex_note_buf_t *buf);
 
+/*
+ * Append a note entry with a zeroed descriptor of descsz bytes and
+ * return a pointer to the descriptor, for the caller to fill in. The
+ * pointer is valid until the next note is added. Returns NULL on error.
+ */
+uint8_t *note_reserve(corex_note_buf_t *buf, const char *name,
+                      uint32_t type, size_t descsz);
+
 /* Build all note entries for the core dump.
  * This writes NT_PRSTATUS (per thread), NT_FPREGSET (per thread),
  * NT_PRPSINFO, NT_SIGINFO, NT_AUXV, NT_FILE into the buffer.
@@ -0,0 +1,150 @@
+/*
+ * parallel_writer.c - Multi-threaded PT_LOAD segment writer
+ *
+ * elf_write_core() fixes the file offset of every PT_LOAD segment before
+ * any memory is copied, so segments are independent of each other.
+ * Worker threads repeatedly claim the next batch of memory ranges (see
+ * mem_batch_len()), read it from the target and pwrite() it at the
+ * ranges' file offsets.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "corex_internal.h"
+#include "parallel_writer.h"
+#include "io_util.h"
+#include "stats.h"
+#include "corex/corex.h"
+
+typedef struct {
+    int                      out_fd;
+    int                      mem_fd;
+    pid_t                    pid;
+    const corex_mem_range_t *ranges;
+    size_t                   num_ranges;
+    int                      skip_zero;
+    size_t                   next_range;    /* Protected by lock */
+    int                      rc;            /* First error, 0 if none */
+    char                     errmsg[COREX_ERR_BUF_SIZE];
+    pthread_mutex_t          lock;
+    corex_counters_t        *counters;      /* Of the calling thread */
+} corex_writer_pool_t;
+
+/*
+ * Record the first failure. corex_set_error() is thread-local, so the
+ * message is kept in the pool and re-raised on the calling thread.
+ */
+static void pool_fail(corex_writer_pool_t *pool, int rc, const char *fmt, ...)
+{
+    pthread_mutex_lock(&pool->lock);
+    if (pool->rc == 0) {
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(pool->errmsg, sizeof(pool->errmsg), fmt, ap);
+        va_end(ap);
+        __atomic_store_n(&pool->rc, rc, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Claim the next batch of ranges. Returns the number of ranges claimed
+ * (0 when the work is exhausted) and stores the first index in *first.
+ */
+static size_t pool_claim(corex_writer_pool_t *pool, size_t *first)
+{
+    pthread_mutex_lock(&pool->lock);
+    size_t start = pool->next_range;
+    size_t n = mem_batch_len(pool->ranges + start, pool->num_ranges - start);
+    pool->next_range = start + n;
+    pthread_mutex_unlock(&pool->lock);
+
+    *first = start;
+    return n;
+}
+
+static void *writer_thread(void *arg)
+{
+    corex_writer_pool_t *pool = arg;
+    corex_counters = pool->counters;
+
+    uint8_t *chunk = io_alloc_huge_buffer(COREX_MEM_CHUNK_SIZE);
+    if (!chunk) {
+        pool_fail(pool, COREX_ERR_ALLOC, "Failed to allocate memory chunk buffer");
+        return NULL;
+    }
+
+    while (__atomic_load_n(&pool->rc, __ATOMIC_ACQUIRE) == 0) {
+        size_t first;
+        size_t n = pool_claim(pool, &first);
+        if (n == 0)
+            break;
+
+        const corex_mem_range_t *batch = pool->ranges + first;
+        mem_read_ranges(pool->pid, pool->mem_fd, batch, n, chunk);
+
+        int rc = io_write_ranges(pool->out_fd, chunk, batch, n, pool->skip_zero);
+        if (rc != 0) {
+            pool_fail(pool, rc, "%s", corex_strerror());
+            break;
+        }
+    }
+
+    free(chunk);
+    return NULL;
+}
+
+int parallel_write_regions(int out_fd, pid_t pid, int mem_fd,
+                           const corex_mem_range_t *ranges,
+                           size_t num_ranges,
+                           int num_workers,
+                           int skip_zero)
+{
+    if (num_ranges == 0)
+        return 0;
+
+    corex_writer_pool_t pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.out_fd = out_fd;
+    pool.mem_fd = mem_fd;
+    pool.pid = pid;
+    pool.ranges = ranges;
+    pool.num_ranges = num_ranges;
+    pool.skip_zero = skip_zero;
+    pool.counters = corex_counters;
+    pthread_mutex_init(&pool.lock, NULL);
+
+    if ((size_t)num_workers > num_ranges)
+        num_workers = (int)num_ranges;
+
+    /*
+     * The calling thread acts as the first worker. If some threads
+     * cannot be created, the remaining ones simply pick up more work.
+     */
+    pthread_t workers[COREX_MAX_WRITERS];
+    int started = 0;
+    for (int i = 1; i < num_workers; i++) {
+        if (pthread_create(&workers[started], NULL, writer_thread, &pool) != 0)
+            break;
+        started++;
+    }
+
+    writer_thread(&pool);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    int rc = pool.rc;
+    if (rc != 0)
+        corex_set_error("%s", pool.errmsg);
+
+    pthread_mutex_destroy(&pool.lock);
+    return rc;
+}
@@ -0,0 +1,26 @@
+/*
+ * parallel_writer.h - Multi-threaded PT_LOAD segment writer
+ */
+#ifndef PARALLEL_WRITER_H
+#define PARALLEL_WRITER_H
+
+#include "corex_internal.h"
+#include "mem_reader.h"
+
+/*
+ * Copy ranges[0..num_ranges) from the target into out_fd using a pool
+ * of num_workers threads (the calling thread is one of them). Each
+ * range carries its own destination file offset.
+ *
+ * Unreadable ranges are written as zeros, matching the serial writer.
+ * With skip_zero set, all-zero pages are left as holes in out_fd.
+ *
+ * Returns 0 on success.
+ */
+int parallel_write_regions(int out_fd, pid_t pid, int mem_fd,
+                           const corex_mem_range_t *ranges,
+                           size_t num_ranges,
+                           int num_workers,
+                           int skip_zero);
+
+#endif /* PARALLEL_WRITER_H */
@@ -0,0 +1,394 @@
+/*
+ * precopy.c - Live (pre-copy) dump mode using soft-dirty tracking
+ *
+ * A regular dump keeps every thread stopped while all memory is copied.
+ * In live mode memory is copied while the target keeps running, the way
+ * VM live migration works:
+ *
+ *   1. Reset the soft-dirty bits (/proc/[pid]/clear_refs) and copy every
+ *      dumped private mapping to a provisional file offset.
+ *   2. Stop the threads, collect the soft-dirty pages and reset the bits,
+ *      resume the threads and copy the collected pages. Repeat while the
+ *      delta keeps shrinking and is still large.
+ *   3. corex.c attaches for good. precopy_finish() copies the pages that
+ *      are still dirty plus any mapping that is new, changed or shared,
+ *      and writes the headers and notes into the space reserved at the
+ *      start of the file.
+ *
+ * The dirty set is read and reset with the threads stopped (step 2) so
+ * that no write can slip in between the two. Shared mappings are always
+ * copied in step 3, since writes through other processes' page tables do
+ * not set soft-dirty bits in ours.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "corex_internal.h"
+#include "precopy.h"
+#include "mem_reader.h"
+#include "elf_writer.h"
+#include "ptrace_utils.h"
+#include "io_util.h"
+#include "corex/corex.h"
+
+/* Maximum number of dirty-page passes before the final, stopped one */
+#define COREX_PRECOPY_MAX_PASSES 8
+
+/* Stop iterating once a pass has less than this much dirty memory */
+#define COREX_PRECOPY_DELTA_BYTES (32ULL << 20)
+
+/* Estimated note bytes per thread (prstatus, fpregs, xstate, ...) */
+#define COREX_PRECOPY_NOTE_PER_THREAD 4096
+
+struct corex_precopy {
+    pid_t              pid;
+    int                fd;
+    int                mem_fd;
+    char              *path;
+    int                done;            /* Dump complete; keep the file */
+    corex_proc_info_t *pre;             /* Mappings as of the first pass */
+    size_t            *pre_offsets;     /* File offset of each copied mapping */
+    size_t             headers_space;   /* Bytes reserved for headers and notes */
+    uint64_t           end_offset;      /* End of the copied data */
+    corex_proc_info_t *stopped;         /* Threads stopped during a pass */
+};
+
+static size_t align_up_page(size_t val)
+{
+    return (val + COREX_IO_ALIGN - 1) & ~(size_t)(COREX_IO_ALIGN - 1);
+}
+
+/*
+ * Space to reserve for the headers and notes, which are only written at
+ * the end. Mappings and threads may be added while the target runs, so
+ * the estimate is doubled; the unused part stays a hole in the file.
+ */
+static size_t estimate_headers_space(const corex_proc_info_t *proc)
+{
+    size_t notes = (size_t)proc->num_threads * COREX_PRECOPY_NOTE_PER_THREAD;
+    notes += proc->auxv_len + sizeof(proc->cmdline) + 4096;
+    for (int i = 0; i < proc->num_mappings; i++)
+        notes += 3 * sizeof(uint64_t) + strlen(proc->mappings[i].path) + 1;
+
+    size_t phdrs = (2 * (size_t)proc->num_mappings + 64) * sizeof(Elf64_Phdr);
+    return align_up_page(sizeof(Elf64_Ehdr) + phdrs + 2 * notes);
+}
+
+/* Reset the soft-dirty bits of every page of the target */
+static int clear_soft_dirty(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/clear_refs", (int)pid);
+
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        corex_set_error("Failed to open %s: %s", path, strerror(errno));
+        return COREX_ERR_PROC_READ;
+    }
+
+    int rc = 0;
+    if (write(fd, "4", 1) != 1) {
+        corex_set_error("Failed to clear soft-dirty bits of PID %d: %s",
+                        (int)pid, strerror(errno));
+        rc = COREX_ERR_PROC_READ;
+    }
+
+    close(fd);
+    return rc;
+}
+
+static uint64_t ranges_bytes(const corex_mem_range_t *ranges, size_t count)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += ranges[i].size;
+    return total;
+}
+
+/*
+ * One pass over the pages dirtied since the previous one. Returns the
+ * number of dirty bytes copied in *dirty.
+ */
+static int copy_dirty_pass(corex_precopy_t *pc, const corex_options_t *opts,
+                           const uint8_t *select, uint64_t *dirty)
+{
+    int rc = ptrace_attach_all(pc->pid, pc->stopped);
+    if (rc != 0)
+        return rc;
+
+    corex_mem_range_t *ranges = NULL;
+    size_t num_ranges = 0;
+    rc = mem_ranges_select(pc->pid, pc->pre, pc->pre_offsets, select,
+                           &ranges, &num_ranges, NULL, NULL);
+    if (rc == 0)
+        rc = clear_soft_dirty(pc->pid);
+
+    ptrace_detach_all(pc->stopped);
+
+    /* Overwrite in full: a page may have become zero since it was copied */
+    if (rc == 0) {
+        *dirty = ranges_bytes(ranges, num_ranges);
+        rc = elf_write_ranges(pc->fd, pc->pid, pc->mem_fd, ranges, num_ranges, 0, opts);
+    }
+
+    free(ranges);
+    return rc;
+}
+
+int precopy_start(pid_t pid,
+                  const corex_proc_info_t *proc,
+                  const corex_options_t *opts,
+                  corex_precopy_t **out)
+{
+    *out = NULL;
+
+    if (!mem_soft_dirty_supported())
+        return COREX_PRECOPY_UNAVAILABLE;
+
+    int rc = 0;
+    uint8_t *select = NULL;
+    corex_mem_range_t *ranges = NULL;
+    size_t num_ranges = 0;
+
+    corex_precopy_t *pc = calloc(1, sizeof(*pc));
+    if (!pc) {
+        corex_set_error("Failed to allocate pre-copy state");
+        return COREX_ERR_ALLOC;
+    }
+    pc->pid = pid;
+    pc->fd = -1;
+    pc->mem_fd = -1;
+
+    pc->path = strdup(opts->output_path);
+    pc->pre = calloc(1, sizeof(*pc->pre));
+    pc->stopped = calloc(1, sizeof(*pc->stopped));
+    pc->pre_offsets = calloc((size_t)proc->num_mappings + 1, sizeof(size_t));
+    select = calloc((size_t)proc->num_mappings + 1, 1);
+    if (!pc->path || !pc->pre || !pc->stopped || !pc->pre_offsets || !select) {
+        corex_set_error("Failed to allocate pre-copy state");
+        rc = COREX_ERR_ALLOC;
+        goto fail;
+    }
+    rc = proc_info_copy(pc->pre, proc);
+    if (rc != 0)
+        goto fail;
+
+    /* Lay out the private mappings after the reserved header space */
+    pc->headers_space = estimate_headers_space(proc);
+    pc->end_offset = pc->headers_space;
+    for (int i = 0; i < pc->pre->num_mappings; i++) {
+        corex_mapping_t *m = &pc->pre->mappings[i];
+        if (m->is_shared)
+            m->should_dump = 0;
+        if (!m->should_dump)
+            continue;
+
+        pc->pre_offsets[i] = pc->end_offset;
+        pc->end_offset += m->end - m->start;
+        select[i] = COREX_SELECT_DIRTY;
+    }
+
+    rc = elf_open_output(pc->path, opts);
+    if (rc < 0)
+        goto fail;
+    pc->fd = rc;
+
+    char mem_path[64];
+    snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
+    pc->mem_fd = open(mem_path, O_RDONLY);
+    if (pc->mem_fd < 0) {
+        corex_set_error("Failed to open %s: %s", mem_path, strerror(errno));
+        rc = COREX_ERR_PROC_READ;
+        goto fail;
+    }
+
+    /*
+     * First pass: everything. Pages written after the bits are reset are
+     * marked dirty, so copying afterwards cannot miss a write.
+     */
+    if (clear_soft_dirty(pid) != 0) {
+        rc = COREX_PRECOPY_UNAVAILABLE;
+        goto fail;
+    }
+
+    int sparse = (opts->flags & COREX_FLAG_SPARSE) != 0;
+    rc = mem_ranges_build(pid, pc->pre, pc->pre_offsets, sparse, &ranges, &num_ranges);
+    if (rc == 0)
+        rc = elf_write_ranges(pc->fd, pid, pc->mem_fd, ranges, num_ranges, sparse, opts);
+    free(ranges);
+    if (rc != 0)
+        goto fail;
+
+    /* Further passes: only what changed, until the delta is small */
+    uint64_t prev = UINT64_MAX;
+    for (int pass = 0; pass < COREX_PRECOPY_MAX_PASSES; pass++) {
+        uint64_t dirty = 0;
+        rc = copy_dirty_pass(pc, opts, select, &dirty);
+        if (rc == COREX_ERR_PTRACE) {
+            /* Threads came or went; the dirty bits are intact for the final pass */
+            rc = 0;
+            break;
+        }
+        if (rc != 0)
+            goto fail;
+
+        /* Small enough, or the target dirties memory faster than we copy */
+        if (dirty <= COREX_PRECOPY_DELTA_BYTES || dirty >= prev)
+            break;
+        prev = dirty;
+    }
+
+    free(select);
+    *out = pc;
+    return 0;
+
+fail:
+    free(select);
+    precopy_free(pc);
+    return rc;
+}
+
+/*
+ * Find the pre-copied mapping that contains m with the same backing, so
+ * its copy can be reused. pre->mappings are sorted by address. Returns
+ * the index, or -1.
+ */
+static int find_precopied(const corex_proc_info_t *pre, const corex_mapping_t *m)
+{
+    int lo = 0, hi = pre->num_mappings - 1, found = -1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (pre->mappings[mid].start <= m->start) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if (found < 0)
+        return -1;
+
+    const corex_mapping_t *p = &pre->mappings[found];
+    if (!p->should_dump || m->is_shared || m->end > p->end)
+        return -1;
+    if (p->is_file_backed != m->is_file_backed || strcmp(p->path, m->path) != 0)
+        return -1;
+    if (m->is_file_backed && m->offset != p->offset + (m->start - p->start))
+        return -1;
+
+    return found;
+}
+
+int precopy_finish(corex_precopy_t *pc,
+                   const corex_proc_info_t *proc,
+                   const corex_note_buf_t *notes,
+                   const corex_options_t *opts)
+{
+    if (elf_headers_size(proc, notes) > pc->headers_space)
+        return COREX_PRECOPY_UNAVAILABLE;
+
+    int rc = 0;
+    int sparse = (opts->flags & COREX_FLAG_SPARSE) != 0;
+    corex_mem_range_t *delta = NULL, *holes = NULL, *fresh = NULL;
+    size_t num_delta = 0, num_holes = 0, num_fresh = 0;
+
+    size_t *load_offsets = calloc((size_t)proc->num_mappings + 1, sizeof(size_t));
+    uint8_t *delta_select = calloc((size_t)proc->num_mappings + 1, 1);
+    uint8_t *fresh_select = calloc((size_t)proc->num_mappings + 1, 1);
+    uint8_t *reused = calloc((size_t)pc->pre->num_mappings + 1, 1);
+    if (!load_offsets || !delta_select || !fresh_select || !reused) {
+        corex_set_error("Failed to allocate offset table");
+        rc = COREX_ERR_ALLOC;
+        goto out;
+    }
+
+    /* Reuse the copy of unchanged mappings; append everything else */
+    for (int i = 0; i < proc->num_mappings; i++) {
+        const corex_mapping_t *m = &proc->mappings[i];
+        if (!m->should_dump)
+            continue;
+
+        int j = find_precopied(pc->pre, m);
+        if (j >= 0) {
+            load_offsets[i] = pc->pre_offsets[j] + (m->start - pc->pre->mappings[j].start);
+            delta_select[i] = COREX_SELECT_DIRTY;
+            reused[j] = 1;
+        } else {
+            load_offsets[i] = pc->end_offset;
+            pc->end_offset += m->end - m->start;
+            fresh_select[i] = sparse ? COREX_SELECT_PRESENT : COREX_SELECT_ALL;
+        }
+    }
+
+    /* Mappings that went away in the meantime are not referenced; free their space */
+    for (int j = 0; j < pc->pre->num_mappings && rc == 0; j++) {
+        const corex_mapping_t *p = &pc->pre->mappings[j];
+        if (p->should_dump && !reused[j])
+            rc = io_zero_range(pc->fd, pc->pre_offsets[j], p->end - p->start);
+    }
+    if (rc != 0)
+        goto out;
+
+    rc = mem_ranges_select(pc->pid, proc, load_offsets, delta_select,
+                           &delta, &num_delta, &holes, &num_holes);
+    if (rc == 0)
+        rc = mem_ranges_select(pc->pid, proc, load_offsets, fresh_select,
+                               &fresh, &num_fresh, NULL, NULL);
+    if (rc != 0)
+        goto out;
+
+    /* Discarded anonymous pages read as zero now */
+    for (size_t k = 0; k < num_holes && rc == 0; k++)
+        rc = io_zero_range(pc->fd, holes[k].file_offset, holes[k].size);
+    if (rc == 0)
+        rc = elf_write_ranges(pc->fd, pc->pid, pc->mem_fd, delta, num_delta, 0, opts);
+    if (rc == 0)
+        rc = elf_write_ranges(pc->fd, pc->pid, pc->mem_fd, fresh, num_fresh, sparse, opts);
+    if (rc == 0)
+        rc = elf_write_headers(pc->fd, proc, notes, load_offsets);
+    if (rc == 0)
+        rc = elf_finish_output(pc->fd, pc->end_offset, opts);
+    if (rc == 0)
+        pc->done = 1;
+
+out:
+    free(delta);
+    free(holes);
+    free(fresh);
+    free(reused);
+    free(fresh_select);
+    free(delta_select);
+    free(load_offsets);
+    return rc;
+}
+
+void precopy_free(corex_precopy_t *pc)
+{
+    if (!pc)
+        return;
+
+    if (pc->mem_fd >= 0)
+        close(pc->mem_fd);
+    if (pc->fd >= 0) {
+        close(pc->fd);
+        if (!pc->done)
+            unlink(pc->path);
+    }
+
+    if (pc->stopped)
+        proc_info_free(pc->stopped);
+    free(pc->stopped);
+    free(pc->pre_offsets);
+    if (pc->pre)
+        proc_info_free(pc->pre);
+    free(pc->pre);
+    free(pc->path);
+    free(pc);
+}
@@ -0,0 +1,46 @@
+/*
+ * precopy.h - Live (pre-copy) dump mode using soft-dirty tracking
+ */
+#ifndef PRECOPY_H
+#define PRECOPY_H
+
+#include "corex_internal.h"
+#include "proc_info.h"
+#include "note_builder.h"
+#include "corex/corex.h"
+
+/* Returned when the live mode cannot be used and a regular dump is needed */
+#define COREX_PRECOPY_UNAVAILABLE 1
+
+typedef struct corex_precopy corex_precopy_t;
+
+/*
+ * Copy the memory of a running process into opts->output_path, repeating
+ * over the pages dirtied in the meantime until the remaining delta is
+ * small. proc is a snapshot of the running process with should_dump set.
+ * Threads are only stopped briefly to collect and reset the dirty bits.
+ *
+ * Returns 0 and stores the state in *out, COREX_PRECOPY_UNAVAILABLE if
+ * the kernel lacks soft-dirty tracking, or a negative COREX_ERR_* code.
+ */
+int precopy_start(pid_t pid,
+                  const corex_proc_info_t *proc,
+                  const corex_options_t *opts,
+                  corex_precopy_t **out);
+
+/*
+ * Complete the dump while the target is stopped: copy the pages dirtied
+ * since the last pass and any new mappings, then write the headers and
+ * notes. Returns COREX_PRECOPY_UNAVAILABLE (leaving the file for a
+ * regular dump to overwrite) if the headers no longer fit the space
+ * reserved for them.
+ */
+int precopy_finish(corex_precopy_t *pc,
+                   const corex_proc_info_t *proc,
+                   const corex_note_buf_t *notes,
+                   const corex_options_t *opts);
+
+/* Release the state. Removes the output file unless the dump completed. */
+void precopy_free(corex_precopy_t *pc);
+
+#endif /* PRECOPY_H */
@@ -10,74 +10,400 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <dirent.h>
+#include <pthread.h>
 #include <errno.h>
+#include <limits.h>
 #include <elf.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 
 #include "corex_internal.h"
 #include "proc_info.h"
 #include "corex/corex.h"
 
-static int read_maps(pid_t pid, corex_proc_info_t *info)
+#ifndef PROCMAP_QUERY
+/* From <linux/fs.h> of Linux 6.11 for older headers */
+struct procmap_query {
+    uint64_t size;
+    uint64_t query_flags;
+    uint64_t query_addr;
+    uint64_t vma_start;
+    uint64_t vma_end;
+    uint64_t vma_flags;
+    uint64_t vma_page_size;
+    uint64_t vma_offset;
+    uint64_t inode;
+    uint32_t dev_major;
+    uint32_t dev_minor;
+    uint32_t vma_name_size;
+    uint32_t build_id_size;
+    uint64_t vma_name_addr;
+    uint64_t build_id_addr;
+};
+#define PROCMAP_QUERY _IOWR('f', 17, struct procmap_query)
+#define PROCMAP_QUERY_VMA_READABLE          0x01
+#define PROCMAP_QUERY_VMA_WRITABLE          0x02
+#define PROCMAP_QUERY_VMA_EXECUTABLE        0x04
+#define PROCMAP_QUERY_VMA_SHARED            0x08
+#define PROCMAP_QUERY_COVERING_OR_NEXT_VMA  0x10
+#endif
+
+/* Returned by read_maps_query() when the kernel lacks PROCMAP_QUERY */
+#define COREX_MAPS_QUERY_UNAVAILABLE 1
+
+/* Mapping names are paths, possibly with " (deleted)" appended */
+#define COREX_MAPS_QUERY_NAME_SIZE (PATH_MAX + 64)
+
+/* Grow *table (of *cap elements of elem_size) to hold at least need. */
+static int grow_table(void **table, int *cap, int need, size_t elem_size)
+{
+    if (need <= *cap)
+        return 0;
+
+    int new_cap = *cap ? *cap : 64;
+    while (new_cap < need)
+        new_cap *= 2;
+
+    void *p = realloc(*table, (size_t)new_cap * elem_size);
+    if (!p) {
+        corex_set_error("Failed to allocate table of %d entries", new_cap);
+        return COREX_ERR_ALLOC;
+    }
+    *table = p;
+    *cap = new_cap;
+    return 0;
+}
+
+/* Append a mapping; path[0..path_len) is its name ("" if none) */
+static int add_mapping(corex_proc_info_t *info, uint64_t start, uint64_t end,
+                       uint32_t flags, uint64_t offset, int is_shared,
+                       uint64_t inode, const char *path, size_t path_len)
+{
+    int rc = grow_table((void **)&info->mappings, &info->cap_mappings,
+                        info->num_mappings + 1, sizeof(corex_mapping_t));
+    if (rc != 0)
+        return rc;
+
+    corex_mapping_t *m = &info->mappings[info->num_mappings];
+    memset(m, 0, sizeof(*m));
+    m->start = start;
+    m->end = end;
+    m->offset = offset;
+    m->flags = flags;
+    m->is_shared = is_shared ? 1 : 0;
+    m->is_file_backed = (inode > 0) ? 1 : 0;
+    m->should_dump = 1;  /* default: dump everything */
+
+    m->path = str_pool_intern(&info->paths, path, path_len);
+    if (!m->path)
+        return COREX_ERR_ALLOC;
+
+    info->num_mappings++;
+    return 0;
+}
+
+int proc_info_split_mapping(corex_proc_info_t *info, int i, uint64_t addr)
+{
+    int rc = grow_table((void **)&info->mappings, &info->cap_mappings,
+                        info->num_mappings + 1, sizeof(corex_mapping_t));
+    if (rc != 0)
+        return rc;
+
+    corex_mapping_t *m = &info->mappings[i];
+    memmove(m + 1, m, (size_t)(info->num_mappings - i) * sizeof(*m));
+    m[0].end = addr;
+    m[1].start = addr;
+    if (m[1].is_file_backed)
+        m[1].offset += addr - m[0].start;
+    info->num_mappings++;
+    return 0;
+}
+
+/* Parse a hex number at p. Returns the end of it, or NULL if there is none. */
+static const char *parse_hex(const char *p, const char *end, uint64_t *val)
+{
+    const char *start = p;
+    uint64_t v = 0;
+    for (; p < end; p++) {
+        unsigned int c = (unsigned char)*p, d;
+        if (c - '0' < 10)
+            d = c - '0';
+        else if ((c | 0x20) - 'a' < 6)
+            d = (c | 0x20) - 'a' + 10;
+        else
+            break;
+        v = (v << 4) | d;
+    }
+    *val = v;
+    return p == start ? NULL : p;
+}
+
+static const char *parse_dec(const char *p, const char *end, uint64_t *val)
+{
+    const char *start = p;
+    uint64_t v = 0;
+    for (; p < end && (unsigned int)(*p - '0') < 10; p++)
+        v = v * 10 + (uint64_t)(*p - '0');
+    *val = v;
+    return p == start ? NULL : p;
+}
+
+/* Expect character c at p */
+static const char *expect(const char *p, const char *end, char c)
+{
+    return (p && p < end && *p == c) ? p + 1 : NULL;
+}
+
+/*
+ * Parse one line of maps:
+ *   "start-end perms offset major:minor inode   [path]"
+ * Malformed lines are skipped like the kernel never writes them.
+ */
+static int parse_maps_line(const char *p, const char *end, corex_proc_info_t *info)
+{
+    uint64_t start, stop, offset, dev, inode;
+
+    p = parse_hex(p, end, &start);
+    p = expect(p, end, '-');
+    if (p)
+        p = parse_hex(p, end, &stop);
+    p = expect(p, end, ' ');
+    if (!p || end - p < 5 || p[4] != ' ')
+        return 0;
+
+    const char *perms = p;
+    p = parse_hex(p + 5, end, &offset);
+    p = expect(p, end, ' ');
+    if (p)
+        p = parse_hex(p, end, &dev);
+    p = expect(p, end, ':');
+    if (p)
+        p = parse_hex(p, end, &dev);
+    p = expect(p, end, ' ');
+    if (p)
+        p = parse_dec(p, end, &inode);
+    if (!p)
+        return 0;
+
+    /* The path (if any) follows the padding after the inode */
+    while (p < end && *p == ' ')
+        p++;
+
+    uint32_t flags = 0;
+    if (perms[0] == 'r') flags |= PF_R;
+    if (perms[1] == 'w') flags |= PF_W;
+    if (perms[2] == 'x') flags |= PF_X;
+
+    return add_mapping(info, start, stop, flags, offset, perms[3] == 's',
+                       inode, p, (size_t)(end - p));
+}
+
+int proc_info_parse_maps(const char *buf, size_t len, corex_proc_info_t *info)
+{
+    const char *p = buf, *buf_end = buf + len;
+    info->num_mappings = 0;
+
+    while (p < buf_end) {
+        const char *nl = memchr(p, '\n', (size_t)(buf_end - p));
+        const char *end = nl ? nl : buf_end;
+
+        int rc = parse_maps_line(p, end, info);
+        if (rc != 0)
+            return rc;
+        p = end + 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Read all of /proc/[pid]/<name> with as few read() calls as the kernel
+ * allows. The caller frees *out.
+ */
+static int read_proc_text(pid_t pid, const char *name, char **out, size_t *out_len)
 {
     char path[64];
-    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    snprintf(path, sizeof(path), "/proc/%d/%s", (int)pid, name);
 
-    FILE *f = fopen(path, "r");
-    if (!f) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
         corex_set_error("Failed to open %s: %s", path, strerror(errno));
         return COREX_ERR_PROC_READ;
     }
 
-    info->num_mappings = 0;
-    char line[1024];
+    size_t size = 64 * 1024, len = 0;
+    char *buf = malloc(size);
+    int rc = 0;
 
-    while (fgets(line, sizeof(line), f)) {
-        if (info->num_mappings >= COREX_MAX_MAPPINGS)
+    for (;;) {
+        if (!buf) {
+            corex_set_error("Failed to allocate buffer for %s", path);
+            rc = COREX_ERR_ALLOC;
+            break;
+        }
+        ssize_t n = read(fd, buf + len, size - len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            corex_set_error("Failed to read %s: %s", path, strerror(errno));
+            rc = COREX_ERR_PROC_READ;
+            break;
+        }
+        if (n == 0)
             break;
 
-        corex_mapping_t *m = &info->mappings[info->num_mappings];
-        memset(m, 0, sizeof(*m));
+        len += (size_t)n;
+        if (len == size) {
+            char *bigger = realloc(buf, size * 2);
+            if (!bigger)
+                free(buf);
+            buf = bigger;
+            size *= 2;
+        }
+    }
+    close(fd);
 
-        uint64_t start, end, offset;
-        unsigned int dev_major, dev_minor;
-        uint64_t inode;
-        char perms[5] = {0};
+    if (rc != 0) {
+        free(buf);
+        return rc;
+    }
+    *out = buf;
+    *out_len = len;
+    return 0;
+}
 
-        int n = sscanf(line, "%lx-%lx %4s %lx %x:%x %lu",
-                       &start, &end, perms, &offset,
-                       &dev_major, &dev_minor, &inode);
-        if (n < 7)
-            continue;
+static int read_maps_text(pid_t pid, corex_proc_info_t *info)
+{
+    char *buf;
+    size_t len;
+    int rc = read_proc_text(pid, "maps", &buf, &len);
+    if (rc != 0)
+        return rc;
+
+    rc = proc_info_parse_maps(buf, len, info);
+    free(buf);
+    return rc;
+}
+
+/*
+ * Read the mappings with the PROCMAP_QUERY ioctl on the maps file
+ * (Linux 6.11+), one binary record per mapping instead of text.
+ * Returns COREX_MAPS_QUERY_UNAVAILABLE if the kernel lacks it.
+ */
+static int read_maps_query(pid_t pid, corex_proc_info_t *info)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
 
-        m->start = start;
-        m->end = end;
-        m->offset = offset;
-        m->flags = 0;
-
-        if (perms[0] == 'r') m->flags |= PF_R;
-        if (perms[1] == 'w') m->flags |= PF_W;
-        if (perms[2] == 'x') m->flags |= PF_X;
-
-        m->is_shared = (perms[3] == 's') ? 1 : 0;
-        m->is_file_backed = (inode > 0) ? 1 : 0;
-        m->should_dump = 1;  /* default: dump everything */
-
-        /* Extract the file path (skip whitespace after inode) */
-        char *p = strchr(line, '/');
-        if (!p)
-            p = strchr(line, '[');
-        if (p) {
-            size_t len = strlen(p);
-            if (len > 0 && p[len - 1] == '\n')
-                p[len - 1] = '\0';
-            snprintf(m->path, sizeof(m->path), "%s", p);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        corex_set_error("Failed to open %s: %s", path, strerror(errno));
+        return COREX_ERR_PROC_READ;
+    }
+
+    char *name = malloc(COREX_MAPS_QUERY_NAME_SIZE);
+    if (!name) {
+        close(fd);
+        corex_set_error("Failed to allocate mapping name buffer");
+        return COREX_ERR_ALLOC;
+    }
+
+    info->num_mappings = 0;
+    uint64_t addr = 0;
+    int rc = 0;
+
+    for (;;) {
+        struct procmap_query q;
+        memset(&q, 0, sizeof(q));
+        q.size = sizeof(q);
+        q.query_flags = PROCMAP_QUERY_COVERING_OR_NEXT_VMA;
+        q.query_addr = addr;
+        q.vma_name_addr = (uint64_t)(uintptr_t)name;
+        q.vma_name_size = COREX_MAPS_QUERY_NAME_SIZE;
+
+        if (ioctl(fd, PROCMAP_QUERY, &q) < 0) {
+            if (errno == ENOENT)
+                break;      /* No mapping at or above addr */
+            if (errno == ENOTTY || errno == EINVAL || errno == ENAMETOOLONG)
+                rc = COREX_MAPS_QUERY_UNAVAILABLE;
+            else {
+                corex_set_error("PROCMAP_QUERY on %s failed: %s", path, strerror(errno));
+                rc = COREX_ERR_PROC_READ;
+            }
+            break;
         }
 
-        info->num_mappings++;
+        uint32_t flags = 0;
+        if (q.vma_flags & PROCMAP_QUERY_VMA_READABLE)   flags |= PF_R;
+        if (q.vma_flags & PROCMAP_QUERY_VMA_WRITABLE)   flags |= PF_W;
+        if (q.vma_flags & PROCMAP_QUERY_VMA_EXECUTABLE) flags |= PF_X;
+
+        /* vma_name_size counts the terminating NUL, 0 if unnamed */
+        size_t name_len = q.vma_name_size ? q.vma_name_size - 1 : 0;
+        rc = add_mapping(info, q.vma_start, q.vma_end, flags, q.vma_offset,
+                         (q.vma_flags & PROCMAP_QUERY_VMA_SHARED) != 0,
+                         q.inode, name, name_len);
+        if (rc != 0)
+            break;
+        /* Only hugetlb mappings have pages larger than the base page */
+        if (q.vma_page_size > (uint64_t)sysconf(_SC_PAGESIZE))
+            info->mappings[info->num_mappings - 1].hugetlb_page_size = q.vma_page_size;
+        addr = q.vma_end;
     }
 
-    fclose(f);
-    return 0;
+    free(name);
+    close(fd);
+    return rc;
+}
+
+/*
+ * PROCMAP_QUERY does not report the gate area (the x86-64 [vsyscall]
+ * page), which maps lists last. It is the same in every 64-bit
+ * process, so it is taken once from our own maps.
+ */
+static corex_mapping_t gate_mapping;
+static char gate_name[32];
+static pthread_once_t gate_once = PTHREAD_ONCE_INIT;
+
+static void find_gate_mapping(void)
+{
+    corex_proc_info_t *self = calloc(1, sizeof(*self));
+    if (!self)
+        return;
+
+    if (read_maps_text(getpid(), self) == 0 && self->num_mappings > 0) {
+        const corex_mapping_t *m = &self->mappings[self->num_mappings - 1];
+        if (m->start >= (1ULL << 63) &&
+            snprintf(gate_name, sizeof(gate_name), "%s", m->path) < (int)sizeof(gate_name))
+            gate_mapping = *m;
+    }
+
+    proc_info_free(self);
+    free(self);
+}
+
+/*
+ * The text is the default: it comes in a few large read() calls, while
+ * PROCMAP_QUERY takes one ioctl per mapping, which usually costs more
+ * than parsing the line (see tests/benchmark/maps_parser_bench.c).
+ */
+static int read_maps(pid_t pid, corex_proc_info_t *info, int flags)
+{
+    int rc = COREX_MAPS_QUERY_UNAVAILABLE;
+    if (flags & COREX_FLAG_MAPS_QUERY)
+        rc = read_maps_query(pid, info);
+    if (rc == COREX_MAPS_QUERY_UNAVAILABLE)
+        return read_maps_text(pid, info);
+    if (rc != 0)
+        return rc;
+
+    pthread_once(&gate_once, find_gate_mapping);
+    if (gate_mapping.end == 0)
+        return 0;
+
+    const corex_mapping_t *g = &gate_mapping;
+    return add_mapping(info, g->start, g->end, g->flags, g->offset, g->is_shared,
+                       0, gate_name, strlen(gate_name));
 }
 
 static int read_auxv(pid_t pid, corex_proc_info_t *info)
@@ -126,6 +452,8 @@ static int read_status(pid_t pid, corex_proc_info_t *info)
             info->pgrp = (pid_t)atoi(line + 7);
         } else if (strncmp(line, "NSsid:", 6) == 0) {
             info->sid = (pid_t)atoi(line + 6);
+        } else if (strncmp(line, "HugetlbPages:", 13) == 0) {
+            info->hugetlb_kb = strtoull(line + 13, NULL, 10);
         }
     }
 
@@ -158,6 +486,200 @@ static int read_status(pid_t pid, corex_proc_info_t *info)
     return 0;
 }
 
+/* PMD size of transparent huge pages, 0 if THP is disabled */
+static uint64_t thp_size;
+static pthread_once_t thp_once = PTHREAD_ONCE_INIT;
+
+static void find_thp_size(void)
+{
+    char buf[64];
+    FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (!f)
+        return;
+    int enabled = fgets(buf, sizeof(buf), f) && !strstr(buf, "[never]");
+    fclose(f);
+    if (!enabled)
+        return;
+
+    thp_size = 2ULL << 20;
+    f = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+    if (f) {
+        if (fgets(buf, sizeof(buf), f) && strtoull(buf, NULL, 10) > 0)
+            thp_size = strtoull(buf, NULL, 10);
+        fclose(f);
+    }
+}
+
+/* Value in kB of an smaps line "Key:   <n> kB" */
+static uint64_t smaps_kb(const char *p, const char *end, size_t key_len)
+{
+    uint64_t val = 0;
+    p += key_len;
+    while (p < end && *p == ' ')
+        p++;
+    if (!parse_dec(p, end, &val))
+        return 0;
+    return val;
+}
+
+/* Non-zero if the VmFlags line p..end holds the two-letter flag */
+static int smaps_has_flag(const char *p, const char *end, const char *flag)
+{
+    for (p += 8; p + 2 <= end; p++) {
+        if (p[-1] == ' ' && p[0] == flag[0] && p[1] == flag[1] &&
+            (p + 2 == end || p[2] == ' '))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Take the hugetlb page size (KernelPageSize with the "ht" VmFlag) and
+ * transparent huge page use (AnonHugePages, or the "hg" VmFlag without
+ * "nh") of each mapping from /proc/[pid]/smaps. Mappings that changed
+ * since the maps were read are left alone.
+ */
+static void read_smaps(pid_t pid, corex_proc_info_t *info)
+{
+    char *buf;
+    size_t len;
+    if (read_proc_text(pid, "smaps", &buf, &len) != 0)
+        return;     /* Without smaps, hugetlb memory is dumped as file memory */
+
+    uint64_t base_kb = (uint64_t)sysconf(_SC_PAGESIZE) / 1024;
+    const char *p = buf, *buf_end = buf + len;
+    corex_mapping_t *m = NULL;
+    uint64_t page_kb = 0;
+    int next = 0;
+
+    while (p < buf_end) {
+        const char *nl = memchr(p, '\n', (size_t)(buf_end - p));
+        const char *end = nl ? nl : buf_end;
+        uint64_t start;
+
+        if (*p >= 'A' && *p <= 'Z') {
+            /* Key lines start with a capital, mapping lines with a hex digit */
+            if (!m) {
+                /* Not a mapping we know of */
+            } else if (end - p > 15 && strncmp(p, "KernelPageSize:", 15) == 0) {
+                page_kb = smaps_kb(p, end, 15);
+            } else if (end - p > 14 && strncmp(p, "AnonHugePages:", 14) == 0) {
+                if (smaps_kb(p, end, 14) > 0)
+                    m->is_thp = 1;
+            } else if (end - p > 8 && strncmp(p, "VmFlags:", 8) == 0) {
+                if (smaps_has_flag(p, end, "ht") && page_kb > base_kb)
+                    m->hugetlb_page_size = page_kb * 1024;
+                if (smaps_has_flag(p, end, "hg") && !smaps_has_flag(p, end, "nh"))
+                    m->is_thp = 1;
+                if (m->hugetlb_page_size)
+                    m->is_thp = 0;
+            }
+        } else if (parse_hex(p, end, &start)) {
+            while (next < info->num_mappings && info->mappings[next].start < start)
+                next++;
+            m = NULL;
+            if (next < info->num_mappings && info->mappings[next].start == start)
+                m = &info->mappings[next++];
+            page_kb = 0;
+        }
+        p = end + 1;
+    }
+
+    free(buf);
+}
+
+int proc_info_omit_unforked(pid_t child, corex_proc_info_t *info)
+{
+    char *buf;
+    size_t len;
+    int rc = read_proc_text(child, "smaps", &buf, &len);
+    if (rc != 0)
+        return rc;
+
+    /* Every mapping is missing until a mapping of the child holds it */
+    uint8_t *found = calloc((size_t)info->num_mappings + 1, 1);
+    if (!found) {
+        free(buf);
+        corex_set_error("Failed to allocate mapping flags");
+        return COREX_ERR_ALLOC;
+    }
+
+    const char *p = buf, *buf_end = buf + len;
+    int next = 0, first = 0;
+
+    while (p < buf_end) {
+        const char *nl = memchr(p, '\n', (size_t)(buf_end - p));
+        const char *end = nl ? nl : buf_end;
+        uint64_t start, stop;
+        const char *q;
+
+        if (*p >= 'A' && *p <= 'Z') {
+            /* The child's mapping [first, next) was wiped by the fork */
+            if (end - p > 8 && strncmp(p, "VmFlags:", 8) == 0 &&
+                smaps_has_flag(p, end, "wf")) {
+                for (int i = first; i < next; i++)
+                    found[i] = 0;
+            }
+        } else if ((q = parse_hex(p, end, &start)) && q < end && *q == '-' &&
+                   parse_hex(q + 1, end, &stop)) {
+            /* Mappings may have been split since, so match by containment */
+            while (next < info->num_mappings && info->mappings[next].start < start)
+                next++;
+            first = next;
+            while (next < info->num_mappings && info->mappings[next].end <= stop)
+                found[next++] = 1;
+        }
+        p = end + 1;
+    }
+
+    for (int i = 0; i < info->num_mappings; i++) {
+        corex_mapping_t *m = &info->mappings[i];
+        if (m->should_dump && !found[i]) {
+            m->should_dump = 0;
+            m->not_forked = 1;
+        }
+    }
+
+    free(found);
+    free(buf);
+    return 0;
+}
+
+/*
+ * Find the mappings backed by huge pages (see proc_info_read()). hugetlb
+ * memory shows in HugetlbPages once touched, and anonymous hugetlb
+ * mappings are named "/anon_hugepage" from the start. PROCMAP_QUERY
+ * reports their page size itself.
+ */
+static void read_huge_pages(pid_t pid, corex_proc_info_t *info)
+{
+    int hugetlb = info->hugetlb_kb > 0, known = 0;
+    for (int i = 0; i < info->num_mappings; i++) {
+        const corex_mapping_t *m = &info->mappings[i];
+        if (m->hugetlb_page_size)
+            known = 1;
+        if (strncmp(m->path, "/anon_hugepage", 14) == 0)
+            hugetlb = 1;
+    }
+
+    if (hugetlb && !known) {
+        read_smaps(pid, info);
+        return;
+    }
+
+    pthread_once(&thp_once, find_thp_size);
+    if (thp_size == 0)
+        return;
+
+    for (int i = 0; i < info->num_mappings; i++) {
+        corex_mapping_t *m = &info->mappings[i];
+        uint64_t first = (m->start + thp_size - 1) & ~(thp_size - 1);
+        if (!m->is_file_backed && !m->is_shared && !m->hugetlb_page_size &&
+            strncmp(m->path, "[v", 2) != 0 && first + thp_size <= m->end)
+            m->is_thp = 1;
+    }
+}
+
 static int read_comm(pid_t pid, corex_proc_info_t *info)
 {
     char path[64];
@@ -236,7 +758,7 @@ static int read_coredump_filter(pid_t pid, corex_proc_info_t *info)
     return 0;
 }
 
-static int read_threads(pid_t pid, corex_proc_info_t *info)
+int proc_info_read_threads(pid_t pid, corex_proc_info_t *info)
 {
     char path[64];
     snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
@@ -253,11 +775,15 @@ static int read_threads(pid_t pid, corex_proc_info_t *info)
     while ((ent = readdir(d))) {
         if (ent->d_name[0] == '.')
             continue;
-        if (info->num_threads >= COREX_MAX_THREADS)
-            break;
 
         pid_t tid = (pid_t)atoi(ent->d_name);
         if (tid > 0) {
+            int rc = grow_table((void **)&info->tids, &info->cap_threads,
+                                info->num_threads + 1, sizeof(pid_t));
+            if (rc != 0) {
+                closedir(d);
+                return rc;
+            }
             info->tids[info->num_threads++] = tid;
         }
     }
@@ -272,21 +798,103 @@ static int read_threads(pid_t pid, corex_proc_info_t *info)
     return 0;
 }
 
-int proc_info_read(pid_t pid, corex_proc_info_t *info)
+int proc_info_read(pid_t pid, corex_proc_info_t *info, int flags)
+{
+    corex_proc_info_t *tmp = calloc(1, sizeof(*tmp));
+    if (!tmp) {
+        corex_set_error("Failed to allocate process info");
+        return COREX_ERR_ALLOC;
+    }
+    tmp->pid = pid;
+
+    int rc;
+
+    if ((rc = read_maps(pid, tmp, flags)) != 0) goto out;
+    if ((rc = read_auxv(pid, tmp)) != 0)    goto out;
+    if ((rc = read_status(pid, tmp)) != 0)  goto out;
+    read_huge_pages(pid, tmp);
+    if ((rc = read_comm(pid, tmp)) != 0)    goto out;
+    if ((rc = read_exe(pid, tmp)) != 0)     goto out;
+    if ((rc = read_cmdline(pid, tmp)) != 0) goto out;
+    if ((rc = read_coredump_filter(pid, tmp)) != 0) goto out;
+    if (!(flags & COREX_PROC_KEEP_THREADS) &&
+        (rc = proc_info_read_threads(pid, tmp)) != 0) goto out;
+
+    /* Success: hand the new tables to info, the old ones to tmp */
+    corex_proc_info_t old = *info;
+    *info = *tmp;
+    *tmp = old;
+
+    /* The kept thread list stays with info */
+    if (flags & COREX_PROC_KEEP_THREADS) {
+        info->num_threads = tmp->num_threads;
+        info->cap_threads = tmp->cap_threads;
+        info->tids = tmp->tids;
+        info->stop_sigs = tmp->stop_sigs;
+        tmp->num_threads = 0;
+        tmp->cap_threads = 0;
+        tmp->tids = NULL;
+        tmp->stop_sigs = NULL;
+    }
+
+out:
+    proc_info_free(tmp);
+    free(tmp);
+    return rc;
+}
+
+int proc_info_copy(corex_proc_info_t *dst, const corex_proc_info_t *src)
 {
-    memset(info, 0, sizeof(*info));
-    info->pid = pid;
+    *dst = *src;
+    dst->mappings = NULL;
+    dst->cap_mappings = 0;
+    dst->tids = NULL;
+    dst->cap_threads = 0;
+    dst->stop_sigs = NULL;
+    memset(&dst->paths, 0, sizeof(dst->paths));
 
     int rc;
 
-    if ((rc = read_maps(pid, info)) != 0)   return rc;
-    if ((rc = read_auxv(pid, info)) != 0)    return rc;
-    if ((rc = read_status(pid, info)) != 0)  return rc;
-    if ((rc = read_comm(pid, info)) != 0)    return rc;
-    if ((rc = read_exe(pid, info)) != 0)     return rc;
-    if ((rc = read_cmdline(pid, info)) != 0) return rc;
-    if ((rc = read_coredump_filter(pid, info)) != 0) return rc;
-    if ((rc = read_threads(pid, info)) != 0) return rc;
+    if ((rc = grow_table((void **)&dst->mappings, &dst->cap_mappings,
+                         src->num_mappings, sizeof(corex_mapping_t))) != 0)
+        goto fail;
+    if ((rc = grow_table((void **)&dst->tids, &dst->cap_threads,
+                         src->num_threads, sizeof(pid_t))) != 0)
+        goto fail;
+
+    for (int i = 0; i < src->num_mappings; i++) {
+        const corex_mapping_t *m = &src->mappings[i];
+        dst->mappings[i] = *m;
+        dst->mappings[i].path = str_pool_intern(&dst->paths, m->path, strlen(m->path));
+        if (!dst->mappings[i].path) {
+            rc = COREX_ERR_ALLOC;
+            goto fail;
+        }
+    }
+    if (src->num_threads > 0)
+        memcpy(dst->tids, src->tids, (size_t)src->num_threads * sizeof(pid_t));
 
     return 0;
+
+fail:
+    proc_info_free(dst);
+    return rc;
+}
+
+void proc_info_free(corex_proc_info_t *info)
+{
+    free(info->mappings);
+    info->mappings = NULL;
+    info->num_mappings = 0;
+    info->cap_mappings = 0;
+
+    free(info->tids);
+    info->tids = NULL;
+    info->num_threads = 0;
+    info->cap_threads = 0;
+
+    free(info->stop_sigs);
+    info->stop_sigs = NULL;
+
+    str_pool_free(&info->paths);
 }
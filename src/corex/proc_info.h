@@ -5,6 +5,7 @@
 #define PROC_INFO_H
 
 #include "corex_internal.h"
+#include "str_pool.h"
 
 /* A single memory mapping from /proc/[pid]/maps */
 typedef struct {
@@ -15,7 +16,11 @@ typedef struct {
     uint8_t     is_shared;      /* 's' in perms (vs 'p' for private) */
     uint8_t     is_file_backed; /* has a real file path (inode > 0) */
     uint8_t     should_dump;    /* set after applying coredump_filter */
-    char        path[512];
+    uint8_t     is_thp;         /* May hold transparent huge pages */
+    uint64_t    hugetlb_page_size; /* hugetlbfs mapping: its page size, else 0 */
+    uint8_t     not_forked;     /* Left out as a fork lacks its contents
+                                   (see proc_info_omit_unforked()) */
+    const char *path;           /* Interned in corex_proc_info_t.paths, "" if none */
 } corex_mapping_t;
 
 /* Process-level information */
@@ -32,9 +37,11 @@ typedef struct {
     char        cmdline[4096];  /* From /proc/[pid]/cmdline */
     int         cmdline_len;
 
-    /* Memory mappings */
+    /* Memory mappings, grown as needed */
     int             num_mappings;
-    corex_mapping_t mappings[COREX_MAX_MAPPINGS];
+    int             cap_mappings;
+    corex_mapping_t *mappings;
+    corex_str_pool_t paths;
 
     /* Auxiliary vector */
     uint8_t     auxv[4096];
@@ -43,12 +50,62 @@ typedef struct {
     /* Coredump filter from /proc/[pid]/coredump_filter */
     uint32_t    coredump_filter;
 
-    /* Thread IDs */
-    pid_t       tids[COREX_MAX_THREADS];
+    /* Resident hugetlb memory in kB (HugetlbPages in /proc/[pid]/status) */
+    uint64_t    hugetlb_kb;
+
+    /* Thread IDs, grown as needed */
+    int         cap_threads;
+    pid_t      *tids;
+
+    /* Set by ptrace_attach_all(): per thread in tids, the signal it is
+     * stopped with (0 for none), to be delivered when it is detached */
+    int        *stop_sigs;
 } corex_proc_info_t;
 
-/* Read all process information for the given PID.
+/* proc_info_read() flag, outside the COREX_FLAG_* range: keep the thread
+ * list (and stop signals) info already holds instead of rescanning
+ * /proc/[pid]/task, e.g. the threads ptrace_attach_all() stopped. */
+#define COREX_PROC_KEEP_THREADS (1 << 30)
+
+/* Read all process information for the given PID. Any tables info
+ * already holds are released on success; on failure info is unchanged.
+ * flags: COREX_FLAG_MAPS_QUERY to read the mappings with PROCMAP_QUERY,
+ * COREX_PROC_KEEP_THREADS to keep info->tids.
+ *
+ * hugetlb mappings are found in /proc/[pid]/smaps, which is only read
+ * when the process uses hugetlb memory: it walks the page tables of
+ * every mapping. Mappings that may hold transparent huge pages are
+ * taken from smaps as well when it is read, and otherwise guessed
+ * (large private anonymous mappings while THP is enabled).
  * Returns 0 on success, negative COREX_ERR_* on failure. */
-int proc_info_read(pid_t pid, corex_proc_info_t *info);
+int proc_info_read(pid_t pid, corex_proc_info_t *info, int flags);
+
+/* Deep copy src into dst (which holds no tables). Stop signals are
+ * not copied: they belong to the attach that recorded them.
+ * Returns 0 on success, negative COREX_ERR_* on failure. */
+int proc_info_copy(corex_proc_info_t *dst, const corex_proc_info_t *src);
+
+/* Release the tables of info (but not info itself). */
+void proc_info_free(corex_proc_info_t *info);
+
+/* Parse the text of a /proc/[pid]/maps file into info->mappings.
+ * Returns 0 on success, negative COREX_ERR_* on failure. */
+int proc_info_parse_maps(const char *buf, size_t len, corex_proc_info_t *info);
+
+/* Split mapping i at addr (start < addr < end) into two entries that
+ * differ only in their range, so they can be dumped differently.
+ * Returns 0 on success, negative COREX_ERR_* on failure. */
+int proc_info_split_mapping(corex_proc_info_t *info, int i, uint64_t addr);
+
+/* Refresh only info->tids / info->num_threads from /proc/[pid]/task.
+ * Returns 0 on success, negative COREX_ERR_* on failure. */
+int proc_info_read_threads(pid_t pid, corex_proc_info_t *info);
+
+/* Compare the mappings of a child forked from info->pid (COREX_FLAG_FORK)
+ * with /proc/[child]/smaps. Dumped mappings the child lacks, as they are
+ * MADV_DONTFORK, or that read back as zeros there, as they are
+ * MADV_WIPEONFORK ("wf" VmFlag), get should_dump cleared and not_forked
+ * set. Returns 0 on success, negative COREX_ERR_* on failure. */
+int proc_info_omit_unforked(pid_t child, corex_proc_info_t *info);
 
 #endif /* PROC_INFO_H */
@@ -5,8 +5,10 @@
 #define _GNU_SOURCE
 #endif
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include <sys/ptrace.h>
 #include <sys/wait.h>
 
@@ -14,41 +16,218 @@
 #include "ptrace_utils.h"
 #include "corex/corex.h"
 
-int ptrace_attach_all(const corex_proc_info_t *info)
+/* Upper bound on /proc/<pid>/task rescans while threads keep appearing */
+#define COREX_ATTACH_MAX_PASSES 32
+
+/* A stopped thread and the signal it is stopped with (0 for none) */
+typedef struct {
+    pid_t   tid;
+    int     sig;
+} stopped_tid_t;
+
+/* Set of stopped threads, sorted by TID */
+typedef struct {
+    stopped_tid_t *tids;
+    size_t         count;
+    size_t         cap;
+} tid_set_t;
+
+static int cmp_tid(const void *a, const void *b)
 {
-    for (int i = 0; i < info->num_threads; i++) {
-        pid_t tid = info->tids[i];
+    pid_t x = *(const pid_t *)a, y = *(const pid_t *)b;
+    return (x > y) - (x < y);
+}
+
+static stopped_tid_t *tid_set_find(const tid_set_t *set, pid_t tid)
+{
+    if (set->count == 0)
+        return NULL;
+    return bsearch(&tid, set->tids, set->count, sizeof(stopped_tid_t), cmp_tid);
+}
+
+/*
+ * Wait for a seized and interrupted thread to stop. Returns 1 once it
+ * is stopped, 0 if it exited meanwhile, negative on error. *sig is set
+ * to the signal the thread is stopped with, 0 for our interrupt.
+ */
+static int reap_stop(pid_t tid, int *sig)
+{
+    int status;
+    pid_t r;
+    *sig = 0;
+    do {
+        r = waitpid(tid, &status, __WALL);
+    } while (r < 0 && errno == EINTR);
+
+    if (r < 0) {
+        if (errno == ECHILD)
+            return 0;
+        corex_set_error("waitpid for tid %d failed: %s", (int)tid, strerror(errno));
+        return COREX_ERR_PTRACE;
+    }
+    if (!WIFSTOPPED(status))
+        return 0;
+
+    /*
+     * A signal that was already on its way is reported before our
+     * interrupt. The thread is stopped either way, in signal-delivery
+     * stop: the signal is handed back when we detach, which delivers it
+     * with its original siginfo.
+     */
+    if ((status >> 16) == 0)
+        *sig = WSTOPSIG(status);
+    return 1;
+}
+
+/*
+ * Stop the threads of batch that are not in stopped yet, add them to it
+ * and count them in *num_new. All of them are seized and interrupted first, then the stops are
+ * collected, so the threads stop at nearly the same time.
+ */
+static int stop_new_threads(const corex_proc_info_t *batch, tid_set_t *stopped,
+                            int *num_new)
+{
+    pid_t *seized = malloc(((size_t)batch->num_threads + 1) * sizeof(pid_t));
+    if (!seized) {
+        corex_set_error("Failed to allocate thread list");
+        return COREX_ERR_ALLOC;
+    }
+
+    size_t num_seized = 0;
+    int rc = 0;
+    *num_new = 0;
+
+    for (int i = 0; i < batch->num_threads; i++) {
+        pid_t tid = batch->tids[i];
+        if (tid_set_find(stopped, tid))
+            continue;
 
-        if (ptrace(PTRACE_ATTACH, tid, NULL, NULL) < 0) {
-            corex_set_error("PTRACE_ATTACH to tid %d failed: %s",
+        if (ptrace(PTRACE_SEIZE, tid, NULL, NULL) < 0) {
+            if (errno == ESRCH)
+                continue;   /* Exited since the scan */
+            corex_set_error("PTRACE_SEIZE of tid %d failed: %s",
                             (int)tid, strerror(errno));
-            /* Detach from threads we already attached to */
-            for (int j = 0; j < i; j++) {
-                ptrace(PTRACE_DETACH, info->tids[j], NULL, NULL);
-            }
-            return COREX_ERR_PTRACE;
+            rc = COREX_ERR_PTRACE;
+            break;
         }
+        seized[num_seized++] = tid;
+    }
 
-        /* Wait for the thread to stop */
-        int status;
-        if (waitpid(tid, &status, __WALL) < 0) {
-            corex_set_error("waitpid for tid %d failed: %s",
-                            (int)tid, strerror(errno));
-            /* Detach from all attached threads */
-            for (int j = 0; j <= i; j++) {
-                ptrace(PTRACE_DETACH, info->tids[j], NULL, NULL);
-            }
-            return COREX_ERR_PTRACE;
+    for (size_t i = 0; i < num_seized; i++)
+        ptrace(PTRACE_INTERRUPT, seized[i], NULL, NULL);
+
+    size_t need = stopped->count + num_seized;
+    if (rc == 0 && need > stopped->cap) {
+        stopped_tid_t *tids = realloc(stopped->tids, need * sizeof(stopped_tid_t));
+        if (!tids) {
+            corex_set_error("Failed to allocate thread list");
+            rc = COREX_ERR_ALLOC;
+        } else {
+            stopped->tids = tids;
+            stopped->cap = need;
+        }
+    }
+
+    /* Every seized thread is reaped, even on error, so it can be detached */
+    for (size_t i = 0; i < num_seized; i++) {
+        int sig;
+        int r = reap_stop(seized[i], &sig);
+        if (r < 0 && rc == 0)
+            rc = r;
+        if (r == 1 && rc == 0) {
+            stopped->tids[stopped->count].tid = seized[i];
+            stopped->tids[stopped->count].sig = sig;
+            stopped->count++;
+            (*num_new)++;
         }
+        else if (r == 1)
+            ptrace(PTRACE_DETACH, seized[i], NULL, (void *)(uintptr_t)sig);
     }
 
+    qsort(stopped->tids, stopped->count, sizeof(stopped_tid_t), cmp_tid);
+    free(seized);
+    return rc;
+}
+
+int ptrace_attach_all(pid_t pid, corex_proc_info_t *info)
+{
+    corex_proc_info_t scan;
+    memset(&scan, 0, sizeof(scan));
+    tid_set_t stopped = {0};
+    int rc;
+
+    /*
+     * Threads may be created while we attach. Rescan the task list
+     * until a pass finds no thread that is not stopped already.
+     */
+    for (int pass = 0; ; pass++) {
+        rc = proc_info_read_threads(pid, &scan);
+        if (rc != 0)
+            goto fail;
+        if (pass == COREX_ATTACH_MAX_PASSES)
+            break;
+
+        int num_new = 0;
+        rc = stop_new_threads(&scan, &stopped, &num_new);
+        if (rc != 0)
+            goto fail;
+        if (num_new == 0)
+            break;
+    }
+
+    scan.stop_sigs = malloc(((size_t)scan.num_threads + 1) * sizeof(int));
+    if (!scan.stop_sigs) {
+        corex_set_error("Failed to allocate thread list");
+        rc = COREX_ERR_ALLOC;
+        goto fail;
+    }
+
+    /* Keep the scan order (main thread first), minus threads that were not stopped */
+    int n = 0;
+    for (int i = 0; i < scan.num_threads; i++) {
+        const stopped_tid_t *st = tid_set_find(&stopped, scan.tids[i]);
+        if (st) {
+            scan.tids[n] = st->tid;
+            scan.stop_sigs[n++] = st->sig;
+        }
+    }
+    scan.num_threads = n;
+    if (n == 0) {
+        corex_set_error("No threads of PID %d could be attached", (int)pid);
+        rc = COREX_ERR_NO_THREADS;
+        goto fail;
+    }
+
+    /* Hand the new list to info and free its old one with scan */
+    pid_t *tids = info->tids;
+    int *stop_sigs = info->stop_sigs;
+    int cap_threads = info->cap_threads;
+    info->tids = scan.tids;
+    info->stop_sigs = scan.stop_sigs;
+    info->num_threads = scan.num_threads;
+    info->cap_threads = scan.cap_threads;
+    scan.tids = tids;
+    scan.stop_sigs = stop_sigs;
+    scan.cap_threads = cap_threads;
+
+    proc_info_free(&scan);
+    free(stopped.tids);
     return 0;
+
+fail:
+    for (size_t i = 0; i < stopped.count; i++)
+        ptrace(PTRACE_DETACH, stopped.tids[i].tid, NULL,
+               (void *)(uintptr_t)stopped.tids[i].sig);
+    proc_info_free(&scan);
+    free(stopped.tids);
+    return rc;
 }
 
 void ptrace_detach_all(const corex_proc_info_t *info)
 {
     for (int i = 0; i < info->num_threads; i++) {
-        ptrace(PTRACE_DETACH, info->tids[i], NULL, NULL);
+        int sig = info->stop_sigs ? info->stop_sigs[i] : 0;
+        ptrace(PTRACE_DETACH, info->tids[i], NULL, (void *)(uintptr_t)sig);
     }
 }
 
@@ -18,11 +18,15 @@ typedef struct {
     int                 has_pac_mask;  /* Non-zero if pac_mask is valid */
 } corex_thread_state_t;
 
-/* Attach to all threads of a process. Stops all threads.
+/* Attach to and stop all threads of pid, including threads created
+ * meanwhile, and store their TIDs in info->tids / info->num_threads.
+ * A signal a thread stopped with instead of our interrupt is kept in
+ * info->stop_sigs. On failure no thread is left attached.
  * Returns 0 on success. */
-int ptrace_attach_all(const corex_proc_info_t *info);
+int ptrace_attach_all(pid_t pid, corex_proc_info_t *info);
 
-/* Detach from all threads. Resumes all threads. */
+/* Detach from all threads. Resumes all threads, delivering the signals
+ * in info->stop_sigs with their original siginfo. */
 void ptrace_detach_all(const corex_proc_info_t *info);
 
 /* Read registers for all threads.
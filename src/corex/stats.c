@@ -0,0 +1,72 @@
+/*
+ * stats.c - Per-dump statistics (corex_options_t.stats)
+ *
+ * The readers and writers count what they move with COREX_COUNT() into
+ * the counters of the dump running on their thread; the entry points
+ * time their steps and hand everything to the caller at the end.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "corex_internal.h"
+#include "stats.h"
+#include "corex/corex.h"
+
+_Thread_local corex_counters_t *corex_counters = NULL;
+
+uint64_t stats_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void stats_phase(uint64_t *since, uint64_t *phase)
+{
+    uint64_t now = stats_now_ns();
+    *phase += now - *since;
+    *since = now;
+}
+
+void stats_begin(corex_stats_scope_t *scope)
+{
+    memset(scope, 0, sizeof(*scope));
+
+    /* Page faults are only known for the process as a whole */
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        scope->minor_faults = ru.ru_minflt;
+        scope->major_faults = ru.ru_majflt;
+    }
+
+    scope->prev = corex_counters;
+    corex_counters = &scope->counters;
+    scope->start_ns = stats_now_ns();
+}
+
+void stats_end(corex_stats_scope_t *scope, corex_stats_t *out)
+{
+    uint64_t end_ns = stats_now_ns();
+    corex_counters = scope->prev;
+
+    out->total_ns = end_ns - scope->start_ns;
+    out->bytes_read = __atomic_load_n(&scope->counters.bytes_read, __ATOMIC_RELAXED);
+    out->bytes_skipped = __atomic_load_n(&scope->counters.bytes_skipped, __ATOMIC_RELAXED);
+    out->bytes_written = __atomic_load_n(&scope->counters.bytes_written, __ATOMIC_RELAXED);
+    out->syscalls = __atomic_load_n(&scope->counters.syscalls, __ATOMIC_RELAXED);
+
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        out->minor_faults = (uint64_t)(ru.ru_minflt - scope->minor_faults);
+        out->major_faults = (uint64_t)(ru.ru_majflt - scope->major_faults);
+    }
+
+    /* Memory is copied while pre-copying and while writing */
+    uint64_t copy_ns = out->precopy_ns + out->write_ns;
+    if (copy_ns > 0)
+        out->throughput = (uint64_t)((double)out->bytes_read * 1e9 / (double)copy_ns);
+}
@@ -0,0 +1,57 @@
+/*
+ * stats.h - Per-dump statistics (corex_options_t.stats)
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include "corex_internal.h"
+#include "corex/corex.h"
+
+/*
+ * Byte and syscall counters of one dump, updated by every thread taking
+ * part in it (writer pool, compressors).
+ */
+typedef struct {
+    uint64_t bytes_read;
+    uint64_t bytes_skipped;
+    uint64_t bytes_written;
+    uint64_t syscalls;
+} corex_counters_t;
+
+/*
+ * Counters of the dump the calling thread works for, or NULL. Set by the
+ * entry points; threads started for a dump take over their creator's.
+ */
+extern _Thread_local corex_counters_t *corex_counters;
+
+#define COREX_COUNT(field, n)                                                   \
+    do {                                                                        \
+        if (corex_counters)                                                     \
+            __atomic_fetch_add(&corex_counters->field, (uint64_t)(n),          \
+                               __ATOMIC_RELAXED);                               \
+    } while (0)
+
+/* CLOCK_MONOTONIC in nanoseconds */
+uint64_t stats_now_ns(void);
+
+/* Add the time since *since to *phase and move *since to now */
+void stats_phase(uint64_t *since, uint64_t *phase);
+
+/*
+ * Per-dump bookkeeping of an entry point: stats_begin() installs counters
+ * on the calling thread, stats_end() removes them and adds the total
+ * time, the counters, the page faults and the throughput to out, whose
+ * phase times the caller has filled in.
+ */
+typedef struct {
+    corex_counters_t  counters;
+    corex_counters_t *prev;
+    uint64_t          start_ns;
+    long              minor_faults;
+    long              major_faults;
+} corex_stats_scope_t;
+
+void stats_begin(corex_stats_scope_t *scope);
+void stats_end(corex_stats_scope_t *scope, corex_stats_t *out);
+
+#endif /* STATS_H */
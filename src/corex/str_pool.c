@@ -0,0 +1,127 @@
+/*
+ * str_pool.c - Interned strings (mapping paths)
+ *
+ * A process typically has a handful of mappings per shared library, all
+ * with the same path. Interning keeps one copy of each, packed into
+ * large chunks instead of one allocation per string.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "corex_internal.h"
+#include "str_pool.h"
+#include "corex/corex.h"
+
+/* Arena chunk size; longer strings get a chunk of their own */
+#define STR_POOL_CHUNK_SIZE (64 * 1024)
+
+/* Initial number of hash slots (power of two) */
+#define STR_POOL_INITIAL_SLOTS 256
+
+struct corex_str_chunk {
+    corex_str_chunk_t *next;
+    size_t             used;
+    size_t             size;
+    char               data[];
+};
+
+/* FNV-1a */
+static uint64_t str_hash(const char *s, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static char *arena_alloc(corex_str_pool_t *pool, size_t size)
+{
+    corex_str_chunk_t *c = pool->chunks;
+    if (!c || c->size - c->used < size) {
+        size_t chunk_size = size > STR_POOL_CHUNK_SIZE ? size : STR_POOL_CHUNK_SIZE;
+        c = malloc(sizeof(*c) + chunk_size);
+        if (!c)
+            return NULL;
+        c->used = 0;
+        c->size = chunk_size;
+        c->next = pool->chunks;
+        pool->chunks = c;
+    }
+
+    char *p = c->data + c->used;
+    c->used += size;
+    return p;
+}
+
+/* Slot holding s[0..len), or the empty slot where it belongs */
+static const char **find_slot(const char **slots, size_t num_slots,
+                              const char *s, size_t len)
+{
+    size_t mask = num_slots - 1;
+    for (size_t i = (size_t)str_hash(s, len) & mask; ; i = (i + 1) & mask) {
+        const char *cur = slots[i];
+        if (!cur || (strncmp(cur, s, len) == 0 && cur[len] == '\0'))
+            return &slots[i];
+    }
+}
+
+static int grow_slots(corex_str_pool_t *pool)
+{
+    size_t num_slots = pool->num_slots ? pool->num_slots * 2 : STR_POOL_INITIAL_SLOTS;
+    const char **slots = calloc(num_slots, sizeof(*slots));
+    if (!slots)
+        return COREX_ERR_ALLOC;
+
+    for (size_t i = 0; i < pool->num_slots; i++) {
+        const char *s = pool->slots[i];
+        if (s)
+            *find_slot(slots, num_slots, s, strlen(s)) = s;
+    }
+
+    free(pool->slots);
+    pool->slots = slots;
+    pool->num_slots = num_slots;
+    return 0;
+}
+
+const char *str_pool_intern(corex_str_pool_t *pool, const char *s, size_t len)
+{
+    /* Keep the load factor at or below 1/2 */
+    if (pool->count * 2 >= pool->num_slots && grow_slots(pool) != 0)
+        goto oom;
+
+    const char **slot = find_slot(pool->slots, pool->num_slots, s, len);
+    if (*slot)
+        return *slot;
+
+    char *copy = arena_alloc(pool, len + 1);
+    if (!copy)
+        goto oom;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+
+    *slot = copy;
+    pool->count++;
+    return copy;
+
+oom:
+    corex_set_error("Failed to allocate string pool");
+    return NULL;
+}
+
+void str_pool_free(corex_str_pool_t *pool)
+{
+    corex_str_chunk_t *c = pool->chunks;
+    while (c) {
+        corex_str_chunk_t *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(pool->slots);
+    memset(pool, 0, sizeof(*pool));
+}
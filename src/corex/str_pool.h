@@ -0,0 +1,31 @@
+/*
+ * str_pool.h - Interned strings (mapping paths)
+ */
+#ifndef STR_POOL_H
+#define STR_POOL_H
+
+#include "corex_internal.h"
+
+typedef struct corex_str_chunk corex_str_chunk_t;
+
+/*
+ * Strings are stored once each in an arena of chunks and stay valid
+ * until the pool is freed. A zeroed pool is empty and ready for use.
+ */
+typedef struct {
+    corex_str_chunk_t *chunks;      /* Arena, most recent chunk first */
+    const char       **slots;       /* Open-addressing set of the strings */
+    size_t             num_slots;   /* Power of two, or 0 */
+    size_t             count;
+} corex_str_pool_t;
+
+/*
+ * Return the pool's copy of s[0..len), adding it if needed. Equal
+ * strings always return the same pointer. Returns NULL if out of memory.
+ */
+const char *str_pool_intern(corex_str_pool_t *pool, const char *s, size_t len);
+
+/* Release all strings of the pool and reset it to empty. */
+void str_pool_free(corex_str_pool_t *pool);
+
+#endif /* STR_POOL_H */
@@ -0,0 +1,549 @@
+/*
+ * uring_writer.c - io_uring based PT_LOAD segment writer
+ *
+ * The synchronous writer alternates between reading the target and
+ * writing the file, so only one of the two devices is ever busy. This
+ * engine keeps COREX_URING_DEPTH buffers in flight. Each buffer holds a
+ * batch of memory ranges. Every range is read from /proc/[pid]/mem with
+ * IORING_OP_READ_FIXED, which is linked (IOSQE_IO_LINK) to the
+ * IORING_OP_WRITE_FIXED that stores it at its file offset. Buffers are
+ * registered with the ring once, up front.
+ *
+ * A read that fails or comes back short breaks its link, so the kernel
+ * cancels the write. Such ranges are redone with the synchronous reader
+ * (process_vm_readv / pread / zero-fill) once their buffer is idle.
+ *
+ * For sparse dumps the write depends on the data, so reads are not
+ * linked. When a read completes, one write is queued for each run of
+ * non-zero blocks. Those writes are queued between rounds of reaping,
+ * and only while the completion queue has room for them: a CQ that
+ * overflows makes io_uring_enter() fail with EBUSY until it is drained.
+ *
+ * liburing is not required; the ring is driven with raw syscalls.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "corex_internal.h"
+#include "uring_writer.h"
+#include "io_util.h"
+#include "stats.h"
+#include "corex/corex.h"
+
+/* Number of buffers (of COREX_MEM_CHUNK_SIZE bytes) in flight */
+#define COREX_URING_DEPTH 16
+
+/* Maximum number of ranges placed in one buffer */
+#define COREX_URING_SLOT_RANGES 32
+
+/* Most reads in flight */
+#define COREX_URING_MAX_READS (COREX_URING_DEPTH * COREX_URING_SLOT_RANGES)
+
+/* One read and one write per range */
+#define COREX_URING_ENTRIES (COREX_URING_MAX_READS * 2)
+
+typedef struct {
+    int                  fd;
+    unsigned             sq_entries;
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned            *sq_mask;
+    unsigned            *sq_array;
+    unsigned             sq_local_tail;     /* Includes unsubmitted SQEs */
+    unsigned             in_flight;         /* SQEs queued whose CQE is not reaped */
+    struct io_uring_sqe *sqes;
+    unsigned             cq_entries;
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned            *cq_mask;
+    struct io_uring_cqe *cqes;
+    void                *ring_ptr;
+    size_t               ring_size;
+    size_t               sqes_size;
+} corex_uring_t;
+
+typedef struct {
+    uint8_t  *buf;
+    size_t    first;        /* Index of the first range in this slot */
+    size_t    count;        /* Number of ranges, 0 if idle */
+    size_t    offsets[COREX_URING_SLOT_RANGES];
+    uint64_t  queued[COREX_URING_SLOT_RANGES];   /* Bytes submitted for writing */
+    uint64_t  written[COREX_URING_SLOT_RANGES];  /* Bytes reported written */
+    size_t    scan[COREX_URING_SLOT_RANGES];     /* Sparse: where the writes left to queue start */
+    uint32_t  ready;        /* Sparse: bitmask of ranges read, with writes left to queue */
+    uint32_t  failed;       /* Bitmask of ranges to redo synchronously */
+    int       pending;      /* Outstanding CQEs */
+} corex_uring_slot_t;
+
+/* user_data layout: slot << 32 | range << 1 | is_write */
+#define URING_DATA(slot, k, w) (((uint64_t)(slot) << 32) | ((uint64_t)(k) << 1) | (uint64_t)(w))
+#define URING_SLOT(d)          ((size_t)((d) >> 32))
+#define URING_RANGE(d)         ((size_t)(((d) & 0xffffffffULL) >> 1))
+#define URING_IS_WRITE(d)      ((int)((d) & 1))
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_exit(corex_uring_t *r)
+{
+    if (r->sqes && r->sqes != MAP_FAILED)
+        munmap(r->sqes, r->sqes_size);
+    if (r->ring_ptr && r->ring_ptr != MAP_FAILED)
+        munmap(r->ring_ptr, r->ring_size);
+    if (r->fd >= 0)
+        close(r->fd);
+    r->fd = -1;
+}
+
+/*
+ * Check that the kernel implements the fixed-buffer read/write opcodes.
+ */
+static int ring_supports_fixed_rw(int fd)
+{
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe)
+        return 0;
+
+    int ok = 0;
+    if (sys_io_uring_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+        probe->last_op >= IORING_OP_WRITE_FIXED &&
+        (probe->ops[IORING_OP_READ_FIXED].flags & IO_URING_OP_SUPPORTED) &&
+        (probe->ops[IORING_OP_WRITE_FIXED].flags & IO_URING_OP_SUPPORTED))
+        ok = 1;
+
+    free(probe);
+    return ok;
+}
+
+/*
+ * Create the ring. Returns 0 on success, or COREX_URING_UNAVAILABLE if
+ * io_uring is missing, disabled, or lacks the features we rely on.
+ */
+static int ring_init(corex_uring_t *r, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    r->fd = sys_io_uring_setup(entries, &p);
+    if (r->fd < 0)
+        return COREX_URING_UNAVAILABLE;
+
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(p.features & IORING_FEAT_NODROP) ||
+        !ring_supports_fixed_rw(r->fd))
+        goto unavailable;
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    r->ring_ptr = mmap(NULL, r->ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->ring_ptr == MAP_FAILED)
+        goto unavailable;
+
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED)
+        goto unavailable;
+
+    uint8_t *base = r->ring_ptr;
+    r->sq_entries = p.sq_entries;
+    r->sq_head = (unsigned *)(base + p.sq_off.head);
+    r->sq_tail = (unsigned *)(base + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(base + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(base + p.sq_off.array);
+    r->cq_entries = p.cq_entries;
+    r->cq_head = (unsigned *)(base + p.cq_off.head);
+    r->cq_tail = (unsigned *)(base + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(base + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(base + p.cq_off.cqes);
+    r->sq_local_tail = *r->sq_tail;
+    return 0;
+
+unavailable:
+    ring_exit(r);
+    return COREX_URING_UNAVAILABLE;
+}
+
+/*
+ * Publish queued SQEs and optionally wait for at least wait_nr
+ * completions. Returns 0 on success.
+ */
+static int ring_submit(corex_uring_t *r, unsigned wait_nr)
+{
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+
+    for (;;) {
+        unsigned to_submit = r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+        if (to_submit == 0 && wait_nr == 0)
+            return 0;
+
+        int ret = sys_io_uring_enter(r->fd, to_submit, wait_nr,
+                                     wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        COREX_COUNT(syscalls, 1);
+        if (ret >= 0)
+            return 0;
+        if (errno == EINTR)
+            continue;
+        /* CQ is backed up; the caller has to reap before submitting more */
+        if (errno == EBUSY || errno == EAGAIN)
+            return 0;
+        corex_set_error("io_uring_enter failed: %s", strerror(errno));
+        return COREX_ERR_WRITE;
+    }
+}
+
+/* Number of SQEs that can be queued without submitting first */
+static unsigned ring_sq_space(corex_uring_t *r)
+{
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    return r->sq_entries - (r->sq_local_tail - head);
+}
+
+static struct io_uring_sqe *ring_get_sqe(corex_uring_t *r)
+{
+    unsigned idx = r->sq_local_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sq_local_tail++;
+    r->in_flight++;
+    return sqe;
+}
+
+/* Make room for n SQEs. Returns 0 on success. */
+static int ring_reserve(corex_uring_t *r, unsigned n)
+{
+    while (ring_sq_space(r) < n) {
+        int rc = ring_submit(r, 0);
+        if (rc != 0)
+            return rc;
+    }
+    return 0;
+}
+
+static void prep_rw(struct io_uring_sqe *sqe, int op, int fd, void *addr,
+                    unsigned len, uint64_t off, unsigned buf_index, uint64_t data)
+{
+    sqe->opcode = (uint8_t)op;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->buf_index = (uint16_t)buf_index;
+    sqe->user_data = data;
+}
+
+typedef struct {
+    corex_uring_t            ring;
+    int                      out_fd;
+    int                      mem_fd;
+    pid_t                    pid;
+    int                      skip_zero;
+    const corex_mem_range_t *ranges;
+    size_t                   num_ranges;
+    size_t                   next_range;
+    corex_uring_slot_t       slots[COREX_URING_DEPTH];
+    int                      rc;
+} corex_uring_ctx_t;
+
+/* Queue the reads (and linked writes) for the next batch of ranges */
+static int slot_start(corex_uring_ctx_t *ctx, size_t s)
+{
+    corex_uring_slot_t *slot = &ctx->slots[s];
+    size_t n = mem_batch_len(ctx->ranges + ctx->next_range,
+                             ctx->num_ranges - ctx->next_range);
+    if (n > COREX_URING_SLOT_RANGES)
+        n = COREX_URING_SLOT_RANGES;
+
+    slot->first = ctx->next_range;
+    slot->count = n;
+    slot->ready = 0;
+    slot->failed = 0;
+    slot->pending = 0;
+    ctx->next_range += n;
+
+    size_t off = 0;
+    for (size_t k = 0; k < n; k++) {
+        const corex_mem_range_t *range = &ctx->ranges[slot->first + k];
+        slot->offsets[k] = off;
+        slot->queued[k] = 0;
+        slot->written[k] = 0;
+        slot->scan[k] = 0;
+
+        /* A read and its linked write must go out in the same submission */
+        int rc = ring_reserve(&ctx->ring, 2);
+        if (rc != 0)
+            return rc;
+
+        struct io_uring_sqe *sqe = ring_get_sqe(&ctx->ring);
+        prep_rw(sqe, IORING_OP_READ_FIXED, ctx->mem_fd, slot->buf + off,
+                (unsigned)range->size, range->addr, (unsigned)s, URING_DATA(s, k, 0));
+        slot->pending++;
+
+        if (!ctx->skip_zero) {
+            sqe->flags |= IOSQE_IO_LINK;
+            sqe = ring_get_sqe(&ctx->ring);
+            prep_rw(sqe, IORING_OP_WRITE_FIXED, ctx->out_fd, slot->buf + off,
+                    (unsigned)range->size, range->file_offset, (unsigned)s,
+                    URING_DATA(s, k, 1));
+            slot->queued[k] = range->size;
+            slot->pending++;
+        }
+
+        off += range->size;
+    }
+
+    return 0;
+}
+
+/*
+ * Sparse mode: queue one write per run of non-zero blocks of range k.
+ * Stops early, to be called again, when the CQ could not take the
+ * completions of more writes next to those of every possible read.
+ */
+static int slot_queue_data_writes(corex_uring_ctx_t *ctx, size_t s, size_t k)
+{
+    corex_uring_slot_t *slot = &ctx->slots[s];
+    const corex_mem_range_t *range = &ctx->ranges[slot->first + k];
+    const uint8_t *data = slot->buf + slot->offsets[k];
+    size_t pos = slot->scan[k];
+
+    while (pos < range->size) {
+        size_t end;
+        pos = io_next_data_run(data, range->size, pos, &end);
+        if (pos == range->size)
+            break;
+
+        if (ctx->ring.in_flight > 0 &&
+            ctx->ring.in_flight + COREX_URING_MAX_READS >= ctx->ring.cq_entries) {
+            slot->scan[k] = pos;
+            return 0;
+        }
+
+        int rc = ring_reserve(&ctx->ring, 1);
+        if (rc != 0)
+            return rc;
+
+        struct io_uring_sqe *sqe = ring_get_sqe(&ctx->ring);
+        prep_rw(sqe, IORING_OP_WRITE_FIXED, ctx->out_fd, (void *)(data + pos),
+                (unsigned)(end - pos), range->file_offset + pos, (unsigned)s,
+                URING_DATA(s, k, 1));
+        slot->queued[k] += end - pos;
+        slot->pending++;
+        pos = end;
+    }
+
+    slot->scan[k] = range->size;
+    slot->ready &= ~(1U << k);
+    COREX_COUNT(bytes_skipped, range->size - slot->queued[k]);
+    return 0;
+}
+
+/*
+ * Redo ranges whose asynchronous read failed, or whose data was not
+ * completely written, using the synchronous path
+ */
+static int slot_finish(corex_uring_ctx_t *ctx, size_t s)
+{
+    corex_uring_slot_t *slot = &ctx->slots[s];
+
+    for (size_t k = 0; k < slot->count; k++) {
+        if (!(slot->failed & (1U << k)) && slot->written[k] == slot->queued[k])
+            continue;
+
+        const corex_mem_range_t *range = &ctx->ranges[slot->first + k];
+        uint8_t *data = slot->buf + slot->offsets[k];
+        mem_read_ranges(ctx->pid, ctx->mem_fd, range, 1, data);
+        int rc = io_write_ranges(ctx->out_fd, data, range, 1, ctx->skip_zero);
+        if (rc != 0)
+            return rc;
+    }
+
+    slot->count = 0;
+    return 0;
+}
+
+static int handle_cqe(corex_uring_ctx_t *ctx, const struct io_uring_cqe *cqe)
+{
+    size_t s = URING_SLOT(cqe->user_data);
+    size_t k = URING_RANGE(cqe->user_data);
+    corex_uring_slot_t *slot = &ctx->slots[s];
+    const corex_mem_range_t *range = &ctx->ranges[slot->first + k];
+
+    slot->pending--;
+
+    if (!URING_IS_WRITE(cqe->user_data)) {
+        if (cqe->res != (int32_t)range->size) {
+            /* Short or failed read; a linked write gets -ECANCELED */
+            slot->failed |= 1U << k;
+            return 0;
+        }
+        COREX_COUNT(bytes_read, cqe->res);
+        if (ctx->skip_zero)
+            slot->ready |= 1U << k;
+        return 0;
+    }
+
+    if (cqe->res == -ECANCELED)
+        return 0;
+    if (cqe->res == -EINVAL) {
+        /* Misaligned for O_DIRECT; io_pwrite_full() handles the retry */
+        slot->failed |= 1U << k;
+        return 0;
+    }
+    if (cqe->res < 0) {
+        corex_set_error("Write failed: %s", strerror(-cqe->res));
+        return COREX_ERR_WRITE;
+    }
+
+    /* Short writes (e.g. nearly full disk) are finished in slot_finish() */
+    slot->written[k] += (uint64_t)cqe->res;
+    COREX_COUNT(bytes_written, cqe->res);
+    return 0;
+}
+
+/* Consume every available CQE. Returns 0 on success. */
+static int reap_cqes(corex_uring_ctx_t *ctx)
+{
+    corex_uring_t *r = &ctx->ring;
+    unsigned head = *r->cq_head;
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    int rc = 0;
+
+    while (head != tail) {
+        struct io_uring_cqe cqe = r->cqes[head & *r->cq_mask];
+        head++;
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+        r->in_flight--;
+
+        int err = handle_cqe(ctx, &cqe);
+        if (err != 0 && rc == 0)
+            rc = err;
+
+        tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    return rc;
+}
+
+int uring_write_ranges(int out_fd, pid_t pid, int mem_fd,
+                       const corex_mem_range_t *ranges,
+                       size_t num_ranges,
+                       int skip_zero)
+{
+    corex_uring_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        corex_set_error("Failed to allocate io_uring context");
+        return COREX_ERR_ALLOC;
+    }
+
+    if (ring_init(&ctx->ring, COREX_URING_ENTRIES) != 0) {
+        free(ctx);
+        return COREX_URING_UNAVAILABLE;
+    }
+
+    size_t buf_size = (size_t)COREX_URING_DEPTH * COREX_MEM_CHUNK_SIZE;
+    uint8_t *bufs = mmap(NULL, buf_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufs == MAP_FAILED) {
+        ring_exit(&ctx->ring);
+        free(ctx);
+        corex_set_error("Failed to allocate io_uring buffers");
+        return COREX_ERR_ALLOC;
+    }
+    madvise(bufs, buf_size, MADV_HUGEPAGE);   /* See io_alloc_huge_buffer() */
+
+    struct iovec iov[COREX_URING_DEPTH];
+    for (int s = 0; s < COREX_URING_DEPTH; s++) {
+        ctx->slots[s].buf = bufs + (size_t)s * COREX_MEM_CHUNK_SIZE;
+        iov[s].iov_base = ctx->slots[s].buf;
+        iov[s].iov_len = COREX_MEM_CHUNK_SIZE;
+    }
+
+    /* Registration can fail on RLIMIT_MEMLOCK; the plain writer still works */
+    if (sys_io_uring_register(ctx->ring.fd, IORING_REGISTER_BUFFERS, iov, COREX_URING_DEPTH) < 0) {
+        munmap(bufs, buf_size);
+        ring_exit(&ctx->ring);
+        free(ctx);
+        return COREX_URING_UNAVAILABLE;
+    }
+
+    ctx->out_fd = out_fd;
+    ctx->mem_fd = mem_fd;
+    ctx->pid = pid;
+    ctx->skip_zero = skip_zero;
+    ctx->ranges = ranges;
+    ctx->num_ranges = num_ranges;
+
+    int rc = 0;
+    for (;;) {
+        /* Refill idle slots while there is work and nothing has failed */
+        int busy = 0;
+        for (size_t s = 0; s < COREX_URING_DEPTH; s++) {
+            corex_uring_slot_t *slot = &ctx->slots[s];
+
+            for (size_t k = 0; slot->ready != 0 && rc == 0 && k < slot->count; k++) {
+                if (slot->ready & (1U << k))
+                    rc = slot_queue_data_writes(ctx, s, k);
+            }
+
+            if (slot->count > 0 && slot->pending == 0 && (slot->ready == 0 || rc != 0)) {
+                int err = slot_finish(ctx, s);
+                if (err != 0 && rc == 0)
+                    rc = err;
+            }
+
+            if (slot->count == 0 && rc == 0 && ctx->next_range < ctx->num_ranges) {
+                int err = slot_start(ctx, s);
+                if (err != 0 && rc == 0)
+                    rc = err;
+            }
+
+            if (slot->pending > 0)
+                busy = 1;
+        }
+
+        if (!busy)
+            break;
+
+        /* Submit and wait; on error keep draining so buffers are not in use */
+        if (ring_submit(&ctx->ring, 1) != 0 && rc == 0)
+            rc = COREX_ERR_WRITE;
+
+        int err = reap_cqes(ctx);
+        if (err != 0 && rc == 0)
+            rc = err;
+    }
+
+    sys_io_uring_register(ctx->ring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    munmap(bufs, buf_size);
+    ring_exit(&ctx->ring);
+    free(ctx);
+    return rc;
+}
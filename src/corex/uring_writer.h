@@ -0,0 +1,27 @@
+/*
+ * uring_writer.h - io_uring based PT_LOAD segment writer
+ */
+#ifndef URING_WRITER_H
+#define URING_WRITER_H
+
+#include "corex_internal.h"
+#include "mem_reader.h"
+
+/* Returned by uring_write_ranges() when io_uring cannot be used */
+#define COREX_URING_UNAVAILABLE 1
+
+/*
+ * Copy ranges[0..num_ranges) from mem_fd (/proc/[pid]/mem) into out_fd
+ * with io_uring, keeping many reads and writes in flight at once.
+ *
+ * Returns 0 on success, a negative COREX_ERR_* code on failure, or
+ * COREX_URING_UNAVAILABLE (before anything is written) if the kernel
+ * does not provide the required io_uring features. The caller then
+ * falls back to the synchronous writer.
+ */
+int uring_write_ranges(int out_fd, pid_t pid, int mem_fd,
+                       const corex_mem_range_t *ranges,
+                       size_t num_ranges,
+                       int skip_zero);
+
+#endif /* URING_WRITER_H */
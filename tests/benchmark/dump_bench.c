@@ -0,0 +1,452 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// Benchmark of corex_dump_pid() against a synthetic target process.
+//
+// Usage: corex_dump_bench [options]
+//
+//   --rss MB            Memory the target fills (default 1024)
+//   --mappings N        Number of mappings it is spread over (default 64)
+//   --threads N         Target threads (default 4)
+//   --hugepages MODE    none, thp (MADV_HUGEPAGE) or hugetlb (MAP_HUGETLB;
+//                       needs vm.nr_hugepages) (default none)
+//   --write-rate MB     MB/s the target threads keep writing during the
+//                       dumps, 0 to only wake up every millisecond
+//                       (default 0)
+//   --untouched PCT     Percentage of the pages never written, so that
+//                       sparse dumps can skip them (default 0)
+//   --modes LIST        Comma separated dump modes: plain, sparse, uring
+//                       (sparse with io_uring, as procdump dumps), direct,
+//                       compress, fork, live, freeze, stacks
+//                       (default plain,sparse,uring)
+//   --writers N         corex_options_t.num_writers (default 1)
+//   --iterations N      Dumps per mode (default 5)
+//   --dir DIR           Where the dumps are written and removed (default /tmp)
+//
+// Every dump prints one JSON object per line on stdout with the
+// target's configuration, the corex statistics (corex_stats_t), the
+// longest time a target thread went without making progress, the dump
+// rate and the benchmark's own peak RSS while dumping.
+//
+//--------------------------------------------------------------------
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "corex/corex.h"
+
+#define PAGE_SIZE_4K 4096UL
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+typedef struct {
+    uint64_t rss_mb;
+    int mappings;
+    int threads;
+    const char *hugepages;
+    uint64_t write_rate_mb;
+    int untouched_pct;
+    const char *modes;
+    int writers;
+    int iterations;
+    const char *dir;
+} bench_config_t;
+
+// Shared between the target and the benchmark
+typedef struct {
+    uint64_t max_stall_ns;      // Longest gap between two steps of a target thread
+} bench_shared_t;
+
+typedef struct {
+    uint8_t *start;
+    size_t size;
+} region_t;
+
+typedef struct {
+    const bench_config_t *config;
+    bench_shared_t *shared;
+    region_t *regions;
+    int num_regions;
+    int index;
+} target_thread_t;
+
+static const struct {
+    const char *name;
+    int flags;
+} modes[] = {
+    { "plain",    0 },
+    { "sparse",   COREX_FLAG_SPARSE },
+    { "uring",    COREX_FLAG_SPARSE | COREX_FLAG_IO_URING },
+    { "direct",   COREX_FLAG_DIRECT_IO },
+    { "compress", COREX_FLAG_COMPRESS },
+    { "fork",     COREX_FLAG_SPARSE | COREX_FLAG_FORK },
+    { "live",     COREX_FLAG_SPARSE | COREX_FLAG_LIVE },
+    { "freeze",   COREX_FLAG_SPARSE | COREX_FLAG_FREEZE },
+    { "stacks",   COREX_FLAG_STACKS },
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Fill a page with data that neither compresses nor reads as zeros
+static void fill_page(uint8_t *page, uint64_t seed)
+{
+    uint64_t x = seed * 0x9e3779b97f4a7c15ULL + 1;
+    for (size_t i = 0; i < PAGE_SIZE_4K; i += sizeof(x)) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        memcpy(page + i, &x, sizeof(x));
+    }
+}
+
+//--------------------------------------------------------------------
+// Target process
+//--------------------------------------------------------------------
+
+static void record_stall(bench_shared_t *shared, uint64_t gap)
+{
+    uint64_t max = __atomic_load_n(&shared->max_stall_ns, __ATOMIC_RELAXED);
+    while (gap > max &&
+           !__atomic_compare_exchange_n(&shared->max_stall_ns, &max, gap, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// Write at the configured rate, one millisecond step at a time, and note
+// how long the thread was kept from running between two steps
+static void *target_thread(void *arg)
+{
+    target_thread_t *t = arg;
+    uint64_t bytes_per_ms = t->config->write_rate_mb * (1 << 20) / 1000 / (uint64_t)t->config->threads;
+    int r = t->index % t->num_regions;
+    size_t off = 0;
+    uint64_t seed = (uint64_t)t->index << 32;
+    uint64_t last = now_ns();
+
+    for (;;) {
+        for (uint64_t done = 0; done < bytes_per_ms; done += PAGE_SIZE_4K) {
+            if (off + PAGE_SIZE_4K > t->regions[r].size) {
+                r = (r + 1) % t->num_regions;
+                off = 0;
+            }
+            // Only rewrite pages that were filled, untouched ones stay absent
+            if (t->regions[r].start[off])
+                fill_page(t->regions[r].start + off, seed++);
+            off += PAGE_SIZE_4K;
+        }
+
+        struct timespec step = { 0, 1000000 };
+        nanosleep(&step, NULL);
+
+        uint64_t now = now_ns();
+        record_stall(t->shared, now - last);
+        last = now;
+    }
+    return NULL;
+}
+
+static int map_regions(const bench_config_t *config, region_t *regions)
+{
+    int hugetlb = strcmp(config->hugepages, "hugetlb") == 0;
+    int thp = strcmp(config->hugepages, "thp") == 0;
+    size_t align = hugetlb || thp ? HUGE_PAGE_SIZE : PAGE_SIZE_4K;
+    size_t size = (size_t)(config->rss_mb << 20) / (size_t)config->mappings;
+    size = (size + align - 1) & ~(align - 1);
+
+    for (int i = 0; i < config->mappings; i++) {
+        // One more unit, unmapped again, keeps neighbouring mappings apart
+        size_t span = size + align;
+        uint8_t *p = mmap(NULL, span + (thp ? align : 0), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | (hugetlb ? MAP_HUGETLB : 0), -1, 0);
+        if (p == MAP_FAILED) {
+            fprintf(stderr, "Failed to map %zu bytes%s\n", span,
+                    hugetlb ? " of huge pages (see vm.nr_hugepages)" : "");
+            return -1;
+        }
+        if (thp) {
+            uint8_t *aligned = (uint8_t *)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+            if (aligned > p)
+                munmap(p, (size_t)(aligned - p));
+            munmap(aligned + span, align - (size_t)(aligned - p));
+            p = aligned;
+            madvise(p, size, MADV_HUGEPAGE);
+        }
+        munmap(p + size, align);
+
+        regions[i].start = p;
+        regions[i].size = size;
+
+        // Untouched pages are spread evenly through every mapping
+        for (size_t off = 0, page = 0; off < size; off += PAGE_SIZE_4K, page++) {
+            if ((int)(page % 100) >= config->untouched_pct)
+                fill_page(p + off, ((uint64_t)i << 32) | page);
+        }
+    }
+    return 0;
+}
+
+static void run_target(const bench_config_t *config, bench_shared_t *shared, int ready_fd)
+{
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    region_t *regions = calloc((size_t)config->mappings, sizeof(*regions));
+    target_thread_t *threads = calloc((size_t)config->threads, sizeof(*threads));
+    if (!regions || !threads || map_regions(config, regions) != 0)
+        _exit(1);
+
+    for (int i = 0; i < config->threads; i++) {
+        threads[i].config = config;
+        threads[i].shared = shared;
+        threads[i].regions = regions;
+        threads[i].num_regions = config->mappings;
+        threads[i].index = i;
+
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, target_thread, &threads[i]) != 0)
+            _exit(1);
+    }
+
+    char ready = 1;
+    if (write(ready_fd, &ready, 1) != 1)
+        _exit(1);
+    close(ready_fd);
+
+    for (;;)
+        pause();
+}
+
+//--------------------------------------------------------------------
+// Benchmark
+//--------------------------------------------------------------------
+
+// Reset the peak RSS of this process (VmHWM); needs Linux 4.0
+static void reset_peak_rss(void)
+{
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd >= 0) {
+        if (write(fd, "5", 1) != 1) {
+            // Older kernels: the peak then covers the whole run
+        }
+        close(fd);
+    }
+}
+
+static long peak_rss_kb(void)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f)
+        return -1;
+
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmHWM: %ld kB", &kb) == 1)
+            break;
+    }
+    fclose(f);
+    return kb;
+}
+
+static void print_result(const bench_config_t *config, const char *mode, int iteration, int rc,
+                         const corex_stats_t *st, uint64_t max_stall_ns,
+                         const struct stat *core, long peak_kb)
+{
+    const double ms = 1e6, mb = 1 << 20;
+    printf("{\"mode\": \"%s\", \"iteration\": %d, \"rc\": %d, "
+           "\"rss_mb\": %llu, \"mappings\": %d, \"threads\": %d, \"hugepages\": \"%s\", "
+           "\"write_rate_mb_s\": %llu, \"untouched_pct\": %d, \"writers\": %d, "
+           "\"total_ms\": %.3f, \"stopped_ms\": %.3f, \"target_max_stall_ms\": %.3f, "
+           "\"attach_ms\": %.3f, \"proc_info_ms\": %.3f, \"filter_ms\": %.3f, \"regs_ms\": %.3f, "
+           "\"fork_ms\": %.3f, \"notes_ms\": %.3f, \"precopy_ms\": %.3f, \"write_ms\": %.3f, "
+           "\"bytes_read\": %llu, \"bytes_skipped\": %llu, \"bytes_written\": %llu, "
+           "\"core_size\": %lld, \"core_disk_bytes\": %lld, \"syscalls\": %llu, "
+           "\"minor_faults\": %llu, \"major_faults\": %llu, "
+           "\"dump_mb_s\": %.1f, \"copy_mb_s\": %.1f, \"peak_rss_kb\": %ld}\n",
+           mode, iteration, rc,
+           (unsigned long long)config->rss_mb, config->mappings, config->threads, config->hugepages,
+           (unsigned long long)config->write_rate_mb, config->untouched_pct, config->writers,
+           st->total_ns / ms, st->stopped_ns / ms, max_stall_ns / ms,
+           st->attach_ns / ms, st->proc_info_ns / ms, st->filter_ns / ms, st->regs_ns / ms,
+           st->fork_ns / ms, st->notes_ns / ms, st->precopy_ns / ms, st->write_ns / ms,
+           (unsigned long long)st->bytes_read, (unsigned long long)st->bytes_skipped,
+           (unsigned long long)st->bytes_written,
+           (long long)core->st_size, (long long)core->st_blocks * 512,
+           (unsigned long long)st->syscalls,
+           (unsigned long long)st->minor_faults, (unsigned long long)st->major_faults,
+           st->total_ns ? st->bytes_read / mb / (st->total_ns / 1e9) : 0.0,
+           st->throughput / mb, peak_kb);
+    fflush(stdout);
+}
+
+static int run_mode(const bench_config_t *config, pid_t target, bench_shared_t *shared,
+                    const char *mode, int flags)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/corex_dump_bench.%d.core", config->dir, (int)getpid());
+
+    for (int i = 0; i < config->iterations; i++) {
+        corex_options_t opts;
+        corex_stats_t st;
+        memset(&opts, 0, sizeof(opts));
+        memset(&st, 0, sizeof(st));
+        opts.output_path = path;
+        opts.flags = flags;
+        opts.num_writers = config->writers;
+        opts.stats = &st;
+
+        // Let the target settle, then measure only this dump
+        struct timespec settle = { 0, 50000000 };
+        nanosleep(&settle, NULL);
+        __atomic_store_n(&shared->max_stall_ns, 0, __ATOMIC_RELAXED);
+        reset_peak_rss();
+
+        int rc = corex_dump_pid(target, &opts);
+        long peak_kb = peak_rss_kb();
+
+        // A stopped thread notices the gap on its first step after resuming
+        nanosleep(&settle, NULL);
+        uint64_t max_stall = __atomic_load_n(&shared->max_stall_ns, __ATOMIC_RELAXED);
+
+        struct stat core;
+        memset(&core, 0, sizeof(core));
+        stat(path, &core);
+        print_result(config, mode, i, rc, &st, max_stall, &core, peak_kb);
+        if (rc != COREX_OK)
+            fprintf(stderr, "%s: %s\n", mode, corex_strerror());
+
+        unlink(path);
+        char index[4096 + sizeof(COREX_DIFF_INDEX_SUFFIX)];
+        snprintf(index, sizeof(index), "%s%s", path, COREX_DIFF_INDEX_SUFFIX);
+        unlink(index);
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: corex_dump_bench [--rss MB] [--mappings N] [--threads N]\n"
+                    "                        [--hugepages none|thp|hugetlb] [--write-rate MB]\n"
+                    "                        [--untouched PCT] [--modes LIST] [--writers N]\n"
+                    "                        [--iterations N] [--dir DIR]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bench_config_t config = {
+        .rss_mb = 1024,
+        .mappings = 64,
+        .threads = 4,
+        .hugepages = "none",
+        .write_rate_mb = 0,
+        .untouched_pct = 0,
+        .modes = "plain,sparse,uring",
+        .writers = 1,
+        .iterations = 5,
+        .dir = "/tmp",
+    };
+
+    static const struct option options[] = {
+        { "rss",        required_argument, NULL, 'r' },
+        { "mappings",   required_argument, NULL, 'm' },
+        { "threads",    required_argument, NULL, 't' },
+        { "hugepages",  required_argument, NULL, 'h' },
+        { "write-rate", required_argument, NULL, 'w' },
+        { "untouched",  required_argument, NULL, 'u' },
+        { "modes",      required_argument, NULL, 'M' },
+        { "writers",    required_argument, NULL, 'W' },
+        { "iterations", required_argument, NULL, 'i' },
+        { "dir",        required_argument, NULL, 'd' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (c) {
+        case 'r': config.rss_mb = strtoull(optarg, NULL, 0); break;
+        case 'm': config.mappings = atoi(optarg); break;
+        case 't': config.threads = atoi(optarg); break;
+        case 'h': config.hugepages = optarg; break;
+        case 'w': config.write_rate_mb = strtoull(optarg, NULL, 0); break;
+        case 'u': config.untouched_pct = atoi(optarg); break;
+        case 'M': config.modes = optarg; break;
+        case 'W': config.writers = atoi(optarg); break;
+        case 'i': config.iterations = atoi(optarg); break;
+        case 'd': config.dir = optarg; break;
+        default: usage(); return 1;
+        }
+    }
+
+    if (config.rss_mb == 0 || config.mappings < 1 || config.threads < 1 ||
+        config.untouched_pct < 0 || config.untouched_pct > 100 || config.iterations < 1 ||
+        (strcmp(config.hugepages, "none") != 0 && strcmp(config.hugepages, "thp") != 0 &&
+         strcmp(config.hugepages, "hugetlb") != 0)) {
+        usage();
+        return 1;
+    }
+
+    bench_shared_t *shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    int ready[2];
+    if (shared == MAP_FAILED || pipe(ready) != 0) {
+        perror("corex_dump_bench");
+        return 1;
+    }
+
+    pid_t target = fork();
+    if (target < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (target == 0) {
+        close(ready[0]);
+        run_target(&config, shared, ready[1]);
+    }
+    close(ready[1]);
+
+    char byte;
+    if (read(ready[0], &byte, 1) != 1) {
+        fprintf(stderr, "The target process failed to start\n");
+        waitpid(target, NULL, 0);
+        return 1;
+    }
+    close(ready[0]);
+
+    int rc = 0;
+    char *list = strdup(config.modes);
+    for (char *save = NULL, *mode = strtok_r(list, ",", &save); mode; mode = strtok_r(NULL, ",", &save)) {
+        size_t m = 0;
+        while (m < sizeof(modes) / sizeof(modes[0]) && strcmp(modes[m].name, mode) != 0)
+            m++;
+        if (m == sizeof(modes) / sizeof(modes[0])) {
+            fprintf(stderr, "Unknown mode: %s\n", mode);
+            rc = 1;
+            break;
+        }
+        run_mode(&config, target, shared, modes[m].name, modes[m].flags);
+    }
+    free(list);
+
+    kill(target, SIGKILL);
+    waitpid(target, NULL, 0);
+    return rc;
+}
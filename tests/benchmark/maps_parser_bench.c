@@ -0,0 +1,218 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// Micro-benchmark of the corex /proc/[pid]/maps parsers.
+//
+// Usage: corex_maps_bench [lines] [live_mappings]
+//
+// 1. A synthetic maps file with <lines> lines (default 100000) is
+//    parsed with the former fgets()/sscanf() parser and with
+//    proc_info_parse_maps().
+// 2. This process maps <live_mappings> (default 20000) extra regions
+//    and reads its own mappings as text and with proc_info_read(),
+//    with and without COREX_FLAG_MAPS_QUERY (the PROCMAP_QUERY ioctl,
+//    Linux 6.11+; proc_info_read() falls back to the text otherwise).
+//
+//--------------------------------------------------------------------
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "proc_info.h"
+#include "corex/corex.h"
+
+#define ITERATIONS 10
+
+typedef struct {
+    uint64_t start, end, offset, inode;
+    char perms[5];
+    char path[512];
+} old_mapping_t;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// The parser proc_info_read() used before: one fgets() and sscanf() per line
+static int parse_old(const char *path, old_mapping_t *out, int max)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+
+    int n = 0;
+    char line[1024];
+    while (n < max && fgets(line, sizeof(line), f)) {
+        old_mapping_t *m = &out[n];
+        unsigned int dev_major, dev_minor;
+        if (sscanf(line, "%lx-%lx %4s %lx %x:%x %lu", &m->start, &m->end, m->perms,
+                   &m->offset, &dev_major, &dev_minor, &m->inode) < 7)
+            continue;
+
+        char *p = strchr(line, '/');
+        if (!p)
+            p = strchr(line, '[');
+        m->path[0] = '\0';
+        if (p) {
+            p[strcspn(p, "\n")] = '\0';
+            snprintf(m->path, sizeof(m->path), "%s", p);
+        }
+        n++;
+    }
+
+    fclose(f);
+    return n;
+}
+
+// The current text parser: the whole file in one buffer
+static int parse_new(const char *path, corex_proc_info_t *info)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    size_t size = 1 << 20, len = 0;
+    char *buf = malloc(size);
+    ssize_t n;
+    while (buf && (n = read(fd, buf + len, size - len)) > 0) {
+        len += (size_t)n;
+        if (len == size)
+            buf = realloc(buf, size *= 2);
+    }
+    close(fd);
+    if (!buf)
+        return -1;
+
+    int rc = proc_info_parse_maps(buf, len, info);
+    free(buf);
+    return rc == 0 ? info->num_mappings : -1;
+}
+
+static int write_synthetic_maps(const char *path, int lines)
+{
+    static const char *libs[] = {
+        "/usr/lib/x86_64-linux-gnu/libc.so.6",
+        "/usr/lib/x86_64-linux-gnu/libstdc++.so.6.0.30",
+        "/opt/service/lib/libservice-core.so",
+        "/usr/lib/locale/C.utf8/LC_CTYPE",
+    };
+
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return -1;
+
+    uint64_t addr = 0x7f0000000000ULL;
+    for (int i = 0; i < lines; i++) {
+        uint64_t size = (uint64_t)(1 + i % 16) << 12;
+        if (i % 3 == 0)
+            fprintf(f, "%lx-%lx rw-p 00000000 00:00 0 \n", addr, addr + size);
+        else
+            fprintf(f, "%lx-%lx r-xp %08lx fd:01 %d                       %s\n",
+                    addr, addr + size, (uint64_t)(i % 64) << 12, 1000000 + i % 4,
+                    libs[i % 4]);
+        addr += size + 0x1000;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static void report(const char *name, int lines, double best_ms)
+{
+    printf("%-32s %8d lines %9.3f ms %8.1f ns/line\n",
+           name, lines, best_ms, best_ms * 1e6 / (lines ? lines : 1));
+}
+
+int main(int argc, char *argv[])
+{
+    int lines = argc > 1 ? atoi(argv[1]) : 100000;
+    int live = argc > 2 ? atoi(argv[2]) : 20000;
+
+    char path[] = "/tmp/corex_maps_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write_synthetic_maps(path, lines) != 0) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return 1;
+    }
+    close(fd);
+
+    old_mapping_t *old = malloc((size_t)lines * sizeof(*old));
+    corex_proc_info_t *info = calloc(1, sizeof(*info));
+    if (!old || !info)
+        return 1;
+
+    double best_old = 1e30, best_new = 1e30;
+    int n_old = 0, n_new = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        double t = now_ms();
+        n_old = parse_old(path, old, lines);
+        double t_old = now_ms() - t;
+
+        t = now_ms();
+        n_new = parse_new(path, info);
+        double t_new = now_ms() - t;
+
+        if (t_old < best_old) best_old = t_old;
+        if (t_new < best_new) best_new = t_new;
+    }
+    unlink(path);
+
+    if (n_old != lines || n_new != lines) {
+        fprintf(stderr, "Parsed %d (fgets/sscanf) and %d (single read) of %d lines\n",
+                n_old, n_new, lines);
+        return 1;
+    }
+    report("synthetic: fgets/sscanf", lines, best_old);
+    report("synthetic: single read", lines, best_new);
+
+    // Alternate protections so the kernel cannot merge neighbouring mappings
+    for (int i = 0; i < live; i++) {
+        mmap(NULL, 4096, (i & 1) ? PROT_READ : PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+    double best_text = 1e30, best_read = 1e30, best_query = 1e30;
+    for (int i = 0; i < ITERATIONS; i++) {
+        double t = now_ms();
+        n_new = parse_new("/proc/self/maps", info);
+        double t_text = now_ms() - t;
+
+        t = now_ms();
+        int rc = proc_info_read(getpid(), info, 0);
+        double t_read = now_ms() - t;
+
+        t = now_ms();
+        if (rc == 0)
+            rc = proc_info_read(getpid(), info, COREX_FLAG_MAPS_QUERY);
+        double t_query = now_ms() - t;
+
+        if (rc != 0) {
+            fprintf(stderr, "proc_info_read failed: %s\n", corex_strerror());
+            return 1;
+        }
+        if (t_text < best_text) best_text = t_text;
+        if (t_read < best_read) best_read = t_read;
+        if (t_query < best_query) best_query = t_query;
+    }
+    report("self: maps text, single read", n_new, best_text);
+    report("self: proc_info_read", n_new, best_read);
+    report("self: proc_info_read, MAPS_QUERY", info->num_mappings, best_query);
+
+    proc_info_free(info);
+    free(info);
+    free(old);
+    return 0;
+}
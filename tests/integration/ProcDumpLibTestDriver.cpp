@@ -4,7 +4,8 @@
 //--------------------------------------------------------------------
 //
 // ProcDumpLibTestDriver - Thin CLI used by the integration tests to
-// exercise the public on-demand dump API (pdWriteDump / pdFreeError)
+// exercise the public on-demand dump API (pdWriteDump / pdWriteDumpEx /
+// pdFreeError)
 // declared in lib/ProcDumpLib.h.
 //
 // The driver performs no validation of its own; it simply forwards the
@@ -13,7 +14,7 @@
 // logic in the existing shell-based framework.
 //
 // Usage:
-//   ProcDumpLibTestDriver <pid> <path> [mask] [overwrite] [stack-size]
+//   ProcDumpLibTestDriver <pid> <path> [mask] [overwrite] [stack-size] [flags]
 //
 //   pid        Target process id.
 //   path       Full dump path prefix. Two sentinels are recognised:
@@ -25,6 +26,8 @@
 //              dump file already exists.
 //   stack-size Optional. When non-zero, invoke pdWriteDump on a worker
 //              thread with this stack size in bytes.
+//   flags      Optional. PD_DUMP_FLAG_* bitmask; when non-zero the dump
+//              is written with pdWriteDumpEx. Defaults to 0.
 //
 // Exit codes:
 //   0   pdWriteDump returned success
@@ -51,6 +54,7 @@ struct DumpArguments
     const char* path;
     int mask;
     bool overwrite;
+    int flags;
     int result;
 };
 
@@ -58,11 +62,23 @@ static void* writeDump(void* context)
 {
     DumpArguments* arguments = static_cast<DumpArguments*>(context);
     char* error = NULL;
-    arguments->result = pdWriteDump(arguments->pid,
-                                    arguments->path,
-                                    arguments->mask,
-                                    arguments->overwrite,
-                                    &error);
+    if(arguments->flags == 0)
+    {
+        arguments->result = pdWriteDump(arguments->pid,
+                                        arguments->path,
+                                        arguments->mask,
+                                        arguments->overwrite,
+                                        &error);
+    }
+    else
+    {
+        arguments->result = pdWriteDumpEx(arguments->pid,
+                                          arguments->path,
+                                          arguments->mask,
+                                          arguments->overwrite,
+                                          arguments->flags,
+                                          &error);
+    }
 
     if(arguments->result != 0)
     {
@@ -85,7 +101,7 @@ int main(int argc, char* argv[])
     if(argc < 3)
     {
         fprintf(stderr,
-            "Usage: %s <pid> <path> [mask] [overwrite] [stack-size]\n",
+            "Usage: %s <pid> <path> [mask] [overwrite] [stack-size] [flags]\n",
                 argv[0]);
         return 2;
     }
@@ -124,7 +140,13 @@ int main(int argc, char* argv[])
         stackSize = (size_t)strtoull(argv[5], NULL, 10);
     }
 
-    DumpArguments arguments = {pid, path, mask, overwrite, -1};
+    int flags = PD_DUMP_FLAG_NONE;
+    if(argc >= 7)
+    {
+        flags = (int)strtol(argv[6], NULL, 0);
+    }
+
+    DumpArguments arguments = {pid, path, mask, overwrite, flags, -1};
     if(stackSize == 0)
     {
         writeDump(&arguments);
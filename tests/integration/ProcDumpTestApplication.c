@@ -17,6 +17,11 @@
 /* Marker for core dump content validation: GDB reads this to confirm the dump is valid */
 volatile int procdump_test_marker = 0xDEADBEEF;
 
+/* Page that a fork of the process reads back as zeros (MADV_WIPEONFORK), filled with
+ * WIPEONFORK_MARKER; NULL where the kernel does not support it */
+#define WIPEONFORK_MARKER 0xCAFEF00D
+volatile unsigned int *procdump_test_wipeonfork = NULL;
+
 
 void* dFunc(int type)
 {
@@ -83,6 +88,12 @@ void* ThreadProc(void *input)
     return NULL;
 };
 
+void* BurnThreadProc(void *input)
+{
+    while(1);
+    return NULL;
+};
+
 // CPU stress function - consumes CPU.
 // For targets >= 95%, runs a pure busy loop (100% of one core).
 // For lower targets, alternates between busy and sleep periods using 1-second cycles.
@@ -130,6 +141,25 @@ void stress_cpu(int target_cpu_percentage) {
     }
 }
 
+// Map the procdump_test_wipeonfork page, so that -fork dumps can be checked for it
+void map_wipeonfork_marker(void) {
+#ifdef MADV_WIPEONFORK
+    long page_size = sysconf(_SC_PAGESIZE);
+    unsigned int *page = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        return;
+    }
+    if (madvise(page, page_size, MADV_WIPEONFORK) != 0) {
+        munmap(page, page_size);
+        return;
+    }
+    for (size_t i = 0; i < page_size / sizeof(*page); i++) {
+        page[i] = WIPEONFORK_MARKER;
+    }
+    procdump_test_wipeonfork = page;
+#endif
+}
+
 // Memory stress function - allocates specified amount of memory
 void stress_memory(size_t target_bytes) {
     void **memory_blocks = NULL;
@@ -202,6 +232,13 @@ int main(int argc, char *argv[])
         {
             while(1);
         }
+        else if (strcmp("threadburn", argv[1]) == 0)
+        {
+            // One thread other than the main thread burns a CPU
+            pthread_t thread;
+            pthread_create(&thread, NULL, BurnThreadProc, NULL);
+            sleep(UINT_MAX);
+        }
         else if (strcmp("fc", argv[1]) == 0)
         {
           FILE* fd[FILE_DESC_COUNT];
@@ -223,6 +260,8 @@ int main(int argc, char *argv[])
         }
         else if (strcmp("mem", argv[1]) == 0)
         {
+            map_wipeonfork_marker();
+
             if (argc < 3)
             {
                 // if no extra argument, allocate memory using different allocation methods (malloc, calloc, realloc, reallocarray)
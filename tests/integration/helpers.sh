@@ -232,3 +232,358 @@ function validatedumpcontent {
   return 0
 }
 
+#
+# Print the TID of the thread of a process that has used the most CPU time.
+# Usage: hottestthread <pid>
+#
+function hottestthread {
+  local pid=$1
+  local hot_tid=""
+  local hot_ticks=-1
+
+  local stat
+  for stat in /proc/$pid/task/*/stat; do
+    # Fields after the comm's ')' start with the state (field 3); utime and stime are 14 and 15
+    local fields
+    read -r -a fields <<< "$(sed 's/.*) //' "$stat" 2>/dev/null)"
+    local ticks=$(( ${fields[11]:-0} + ${fields[12]:-0} ))
+    if [ "$ticks" -gt "$hot_ticks" ]; then
+      hot_ticks=$ticks
+      hot_tid=$(basename "$(dirname "$stat")")
+    fi
+  done
+
+  echo "$hot_tid"
+}
+
+#
+# Validate a dump taken by a thread CPU trigger (-ct): it is named after
+# the trigger, and the thread that exceeded the threshold is the one a
+# debugger selects.
+# Usage: validatethreadcpudump <dump_file> <executable_path> <hot_tid>
+# Returns 0 on success, 1 on failure.
+#
+function validatethreadcpudump {
+  local dump_file=$1
+  local exec_path=$2
+  local hot_tid=$3
+
+  if [[ "$(basename "$dump_file")" != *_threadcpu_* ]]; then
+    echo "[validate] FAIL: dump name $(basename "$dump_file") does not name the threadcpu trigger"
+    return 1
+  fi
+  echo "[validate] PASS: dump is named after the threadcpu trigger"
+
+  if [ -z "$hot_tid" ]; then
+    echo "[validate] FAIL: the thread burning CPU is not known"
+    return 1
+  fi
+
+  local current
+  current=$(gdb -batch -ex "thread" -c "$dump_file" "$exec_path" 2>&1 | grep "Current thread")
+  echo "[validate] Selected thread: $current, burning thread: $hot_tid"
+
+  if [[ "$current" != *"LWP $hot_tid)"* ]]; then
+    echo "[validate] FAIL: the selected thread is not the burning thread $hot_tid"
+    return 1
+  fi
+
+  echo "[validate] PASS: the burning thread is selected"
+  return 0
+}
+
+#
+# Validate that a -fork dump does not hold the MADV_WIPEONFORK page of the
+# test program (procdump_test_wipeonfork) as zeros: the fork only has
+# zeros for it, so the page must be left out or hold the marker.
+# Usage: validateunforkedpage <dump_file> <executable_path>
+# Returns 0 on success, 1 on failure.
+#
+function validateunforkedpage {
+  local dump_file=$1
+  local exec_path=$2
+
+  local gdb_output
+  gdb_output=$(gdb -batch -ex "print procdump_test_wipeonfork" -ex "x/4xw procdump_test_wipeonfork" \
+                   -c "$dump_file" "$exec_path" 2>&1)
+
+  if echo "$gdb_output" | grep -q "= (volatile unsigned int \*) 0x0$"; then
+    echo "[validate] SKIP: the kernel does not support MADV_WIPEONFORK"
+    return 0
+  fi
+
+  if echo "$gdb_output" | grep -q "Cannot access memory"; then
+    echo "[validate] PASS: the MADV_WIPEONFORK page is left out"
+    return 0
+  fi
+
+  if echo "$gdb_output" | grep -qi "0xcafef00d"; then
+    echo "[validate] PASS: the MADV_WIPEONFORK page holds its contents"
+    return 0
+  fi
+
+  echo "[validate] FAIL: the MADV_WIPEONFORK page is dumped without its contents"
+  echo "[validate] GDB output: $gdb_output"
+  return 1
+}
+
+#
+# Validate that a core dump is a sparse file: untouched and all-zero pages
+# of the target are left as holes, so fewer blocks are allocated than the
+# apparent size needs.
+# Usage: validatesparsedump <dump_file>
+# Returns 0 on success, 1 on failure.
+#
+function validatesparsedump {
+  local dump_file=$1
+
+  local size=$(stat -c%s "$dump_file")
+  local allocated=$(( $(stat -c%b "$dump_file") * $(stat -c%B "$dump_file") ))
+
+  echo "[validate] Sparse check: size=${size} allocated=${allocated}"
+
+  if [ "$allocated" -ge "$size" ]; then
+    echo "[validate] FAIL: dump has no holes"
+    return 1
+  fi
+
+  echo "[validate] PASS: dump is sparse"
+  return 0
+}
+
+#
+# Validate that a core dump written with direct I/O (-dio) was kept out of
+# the page cache. tmpfs has no O_DIRECT and keeps files in the page cache,
+# so the check is skipped there.
+# Usage: validatedirectio <dump_file>
+# Returns 0 on success, 1 on failure.
+#
+function validatedirectio {
+  local dump_file=$1
+
+  if [ "$(stat -f -c%T "$dump_file")" == "tmpfs" ]; then
+    echo "[validate] SKIP: dump is on tmpfs"
+    return 0
+  fi
+  if ! command -v fincore > /dev/null; then
+    echo "[validate] SKIP: fincore not available"
+    return 0
+  fi
+
+  local resident=$(fincore --bytes --noheadings --output RES "$dump_file" | tr -d ' ')
+  local allocated=$(( $(stat -c%b "$dump_file") * $(stat -c%B "$dump_file") ))
+
+  echo "[validate] Page cache check: resident=${resident} allocated=${allocated}"
+
+  # A buffered write leaves all of the dump in the page cache
+  if [ $(( resident * 10 )) -gt "$allocated" ]; then
+    echo "[validate] FAIL: dump is in the page cache"
+    return 1
+  fi
+
+  echo "[validate] PASS: dump bypassed the page cache"
+  return 0
+}
+
+#
+# Validate that a core dump written with -maxsize fits in the limit and
+# lists what it left out in an NT_COREX_OMITTED note.
+# Usage: validatemaxsize <dump_file> <max_size_mb>
+# Returns 0 on success, 1 on failure.
+#
+function validatemaxsize {
+  local dump_file=$1
+  local max_mb=$2
+
+  local size=$(stat -c%s "$dump_file")
+  echo "[validate] Size limit check: size=${size} limit=$(( max_mb << 20 ))"
+
+  if [ "$size" -gt $(( max_mb << 20 )) ]; then
+    echo "[validate] FAIL: dump is larger than ${max_mb} MB"
+    return 1
+  fi
+  echo "[validate] PASS: dump fits in ${max_mb} MB"
+
+  # NT_COREX_OMITTED is 0x43580003, owned by "COREX"
+  if ! readelf -nW "$dump_file" | grep -q "COREX.*0x43580003"; then
+    echo "[validate] FAIL: dump has no NT_COREX_OMITTED note"
+    return 1
+  fi
+  echo "[validate] PASS: dump lists the regions left out"
+  return 0
+}
+
+#
+# Validate that a -stacks core dump is much smaller than a full dump of
+# the same process: less than half of it.
+# Usage: validatestacksdump <dump_file> <full_dump_file>
+# Returns 0 on success, 1 on failure.
+#
+function validatestacksdump {
+  local dump_file=$1
+  local full_dump=$2
+
+  local size=$(stat -c%s "$dump_file")
+  local full_size=$(stat -c%s "$full_dump")
+  echo "[validate] Stacks size check: stacks=${size} full=${full_size}"
+
+  if [ $(( size * 2 )) -ge "$full_size" ]; then
+    echo "[validate] FAIL: -stacks dump is not much smaller than a full dump"
+    return 1
+  fi
+
+  echo "[validate] PASS: -stacks dump is much smaller than a full dump"
+  return 0
+}
+
+#
+# Does the kernel track soft-dirty pages (needed by -live)? Every page of
+# a mapping is reported soft-dirty until the bits are first cleared, so the
+# top page of our stack tells.
+# Returns 0 if it does, 1 otherwise.
+#
+function softdirtysupported {
+  local stack_end=$(awk '/\[stack\]/ { split($1, r, "-"); print r[2] }' /proc/$$/maps)
+  local page_size=$(getconf PAGESIZE)
+
+  if [ -z "$stack_end" ]; then
+    return 1
+  fi
+
+  local index=$(( 16#$stack_end / page_size - 1 ))
+  local entry=$(dd if=/proc/$$/pagemap bs=8 skip=$index count=1 status=none | od -An -tx8 | tr -d ' ')
+  if [ -z "$entry" ]; then
+    return 1
+  fi
+
+  # Bit 55 of a pagemap entry is the soft-dirty bit
+  if [ $(( (16#$entry >> 55) & 1 )) -eq 1 ]; then
+    return 0
+  fi
+  return 1
+}
+
+#
+# Validate that the target was stopped for less than half of the dump,
+# from the statistics (-stats) written next to it. -live and -fork copy
+# most of the memory while the target runs.
+# Usage: validatestoppedtime <stats_file>
+# Returns 0 on success, 1 on failure.
+#
+function validatestoppedtime {
+  local stats_file=$1
+
+  local stopped=$(sed -n 's/.*"stopped_ns": *\([0-9]*\).*/\1/p' "$stats_file" 2>/dev/null)
+  local total=$(sed -n 's/.*"total_ns": *\([0-9]*\).*/\1/p' "$stats_file" 2>/dev/null)
+  if [ -z "$stopped" ] || [ -z "$total" ]; then
+    echo "[validate] ERROR: no dump statistics in $stats_file"
+    return 1
+  fi
+
+  echo "[validate] Stopped time check: stopped=$(( stopped / 1000000 ))ms total=$(( total / 1000000 ))ms"
+
+  if [ $(( stopped * 2 )) -ge "$total" ]; then
+    echo "[validate] FAIL: target was stopped for most of the dump"
+    return 1
+  fi
+
+  echo "[validate] PASS: target ran during most of the dump"
+  return 0
+}
+
+#
+# Move a process to a new cgroup v2 below ours, so that -freeze can freeze
+# it without freezing ProcDump.
+# Usage: createfreezercgroup <pid> <result_var>
+# Returns 0 and the cgroup directory in result_var on success, 1 otherwise.
+#
+function createfreezercgroup {
+  local pid=$1
+  local -n result=$2
+
+  local mnt=$(awk '$3 == "cgroup2" { print $2; exit }' /proc/mounts)
+  local self=$(sed -n 's/^0:://p' /proc/self/cgroup)
+  if [ -z "$mnt" ] || [ -z "$self" ]; then
+    echo "[script] No cgroup v2 found"
+    return 1
+  fi
+
+  local cgroup="$mnt${self%/}/procdump_freeze_$pid"
+  if ! mkdir "$cgroup" 2>/dev/null; then
+    echo "[script] Could not create $cgroup"
+    return 1
+  fi
+  if [ ! -f "$cgroup/cgroup.freeze" ] || ! echo $pid > "$cgroup/cgroup.procs" 2>/dev/null; then
+    echo "[script] Could not move $pid to $cgroup"
+    rmdir "$cgroup"
+    return 1
+  fi
+
+  echo "[script] Moved $pid to $cgroup"
+  result=$cgroup
+  return 0
+}
+
+#
+# Record in a file whether a cgroup gets frozen. Runs until it does, or
+# until the cgroup is removed.
+# Usage: watchcgroupfrozen <cgroup_dir> <log_file>
+#
+function watchcgroupfrozen {
+  local cgroup=$1
+  local log_file=$2
+  local events
+
+  while [ -d "$cgroup" ]; do
+    read -r -d '' events < "$cgroup/cgroup.events"
+    if [[ "$events" == *"frozen 1"* ]]; then
+      echo "frozen" > "$log_file"
+      return
+    fi
+  done
+}
+
+#
+# Validate that -freeze froze the cgroup of the target during the dump
+# (as recorded by watchcgroupfrozen) and thawed it afterwards.
+# Usage: validatefreeze <cgroup_dir> <log_file> <pid>
+# Returns 0 on success, 1 on failure.
+#
+function validatefreeze {
+  local cgroup=$1
+  local log_file=$2
+  local pid=$3
+
+  if [ ! -s "$log_file" ]; then
+    echo "[validate] FAIL: cgroup of the target was not frozen during the dump"
+    return 1
+  fi
+  echo "[validate] PASS: cgroup of the target was frozen during the dump"
+
+  if [ "$(cat "$cgroup/cgroup.freeze")" != "0" ]; then
+    echo "[validate] FAIL: cgroup of the target was left frozen"
+    return 1
+  fi
+  if [[ "$(ps -o stat= -p $pid)" == [Tt]* ]]; then
+    echo "[validate] FAIL: target is still stopped"
+    return 1
+  fi
+  echo "[validate] PASS: target was thawed after the dump"
+  return 0
+}
+
+#
+# Remove a cgroup made by createfreezercgroup once its process has exited.
+# Usage: removefreezercgroup <cgroup_dir>
+#
+function removefreezercgroup {
+  local cgroup=$1
+
+  for i in {1..50}; do
+    if grep -q "populated 0" "$cgroup/cgroup.events"; then
+      break
+    fi
+    sleep 0.1
+  done
+  rmdir "$cgroup"
+}
@@ -24,6 +24,7 @@
 #   LIBTEST_OVERWRITE  1 (default) or 0
 #   LIBTEST_STACK_SIZE  0 (default) to use the main thread, or the worker
 #                       thread stack size in bytes
+#   LIBTEST_FLAGS      0 (default) for pdWriteDump, or PD_DUMP_FLAG_* bits for pdWriteDumpEx
 #   PRECREATE_DUMP     true to create the dump file before running (overwrite tests)
 #
 #   EXPECTSUCCESS      true (default) - expect pdWriteDump to return 0
@@ -46,6 +47,7 @@ function runLibTestAndValidate {
 	LIBTEST_MASK="${LIBTEST_MASK:-default}"
 	LIBTEST_OVERWRITE="${LIBTEST_OVERWRITE:-1}"
 	LIBTEST_STACK_SIZE="${LIBTEST_STACK_SIZE:-0}"
+	LIBTEST_FLAGS="${LIBTEST_FLAGS:-0}"
 	EXPECTSUCCESS="${EXPECTSUCCESS:-true}"
 	SHOULDDUMP="${SHOULDDUMP:-$EXPECTSUCCESS}"
 	VALIDATE_SIZE="${VALIDATE_SIZE:-false}"
@@ -120,8 +122,8 @@ function runLibTestAndValidate {
 	fi
 
 	# Run the driver.
-	echo [`date +"%T.%3N"`] Running: "$DRIVERPATH" "$pidArg" "$pathArg" "$LIBTEST_MASK" "$LIBTEST_OVERWRITE" "$LIBTEST_STACK_SIZE"
-	"$DRIVERPATH" "$pidArg" "$pathArg" "$LIBTEST_MASK" "$LIBTEST_OVERWRITE" "$LIBTEST_STACK_SIZE"
+	echo [`date +"%T.%3N"`] Running: "$DRIVERPATH" "$pidArg" "$pathArg" "$LIBTEST_MASK" "$LIBTEST_OVERWRITE" "$LIBTEST_STACK_SIZE" "$LIBTEST_FLAGS"
+	"$DRIVERPATH" "$pidArg" "$pathArg" "$LIBTEST_MASK" "$LIBTEST_OVERWRITE" "$LIBTEST_STACK_SIZE" "$LIBTEST_FLAGS"
 	rc=$?
 	echo "[libtest] driver exit code: $rc"
 
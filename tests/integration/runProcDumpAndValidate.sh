@@ -1,7 +1,14 @@
 #!/bin/bash
 source "$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)/helpers.sh"
 
+#
+# Runs ProcDump against the test program and validates the dump.
+# Usage: runProcDumpAndValidate [switch]
+# The optional switch (e.g. -dio) is passed to ProcDump, and the dump is
+# checked for what it does on top of the common validation.
+#
 function runProcDumpAndValidate {
+	local dumpSwitch=$1
 	DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
 	PROCDUMPPATH="${PROCDUMPPATH:-$DIR/../../procdump}";
 	GDBSCRIPT="$DIR/validate_dump.gdb"
@@ -45,6 +52,18 @@ function runProcDumpAndValidate {
 		sleep 1
 	fi
 	
+	# -freeze only freezes a cgroup that ProcDump is not in, so the target gets one
+	freezeCgroup=""
+	if [[ "$dumpSwitch" == "-freeze" ]]; then
+		if createfreezercgroup $pid freezeCgroup; then
+			frozenLog=$(mktemp -t frozen_XXXXXX)
+			watchcgroupfrozen "$freezeCgroup" "$frozenLog" &
+			pidWatch=$!
+		else
+			echo "[validate] SKIP: the target cannot be frozen without ProcDump"
+		fi
+	fi
+
 	# Launch procdump in background using either wait by name or target PID
 	echo [`date +"%T.%3N"`] Starting ProcDump
 	if [[ "$PROCDUMPWAITBYNAME" == "true" ]]; then
@@ -52,8 +71,13 @@ function runProcDumpAndValidate {
 	else
 		launchMode=$pid
 	fi
-	echo "$PROCDUMPPATH -log stdout $PREFIX $launchMode $POSTFIX $dumpParam"
-	$PROCDUMPPATH -log stdout $PREFIX $launchMode $POSTFIX $dumpParam&
+	# How long the target was stopped is taken from the dump statistics
+	dumpArgs=$dumpSwitch
+	if [[ "$dumpSwitch" == "-live" || "$dumpSwitch" == "-fork" ]]; then
+		dumpArgs="$dumpSwitch -stats"
+	fi
+	echo "$PROCDUMPPATH -log stdout $PREFIX $dumpArgs $launchMode $POSTFIX $dumpParam"
+	$PROCDUMPPATH -log stdout $PREFIX $dumpArgs $launchMode $POSTFIX $dumpParam&
 	pidPD=$!
 	echo "ProcDump PID: $pidPD"
 
@@ -78,12 +102,26 @@ function runProcDumpAndValidate {
 		kill -9 $pidPD > /dev/null
 	fi
 
+	# The target must run again once the dump is written
+	freezeResult=0
+	if [ -n "$freezeCgroup" ]; then
+		kill $pidWatch 2>/dev/null
+		validatefreeze "$freezeCgroup" "$frozenLog" $pid
+		freezeResult=$?
+	fi
+
 	# Determine if this is a native (non-.NET) test that expects dumps
 	isNativeTest=false
 	if [[ "$TESTPROGNAME" == "ProcDumpTestApplication" ]] && $SHOULDDUMP && [[ "$OS" != "Darwin" ]]; then
 		isNativeTest=true
 	fi
 
+	# The thread a -ct dump is taken for is the one burning CPU
+	hotTid=""
+	if [[ $PREFIX == *"-ct "* ]] && ps -p $pid > /dev/null 2>&1; then
+		hotTid=$(hottestthread $pid)
+	fi
+
 	# Generate gcore reference dump while the test process is still alive
 	gcoreRefDump=""
 	if $isNativeTest && ps -p $pid > /dev/null 2>&1; then
@@ -103,6 +141,11 @@ function runProcDumpAndValidate {
 		kill -9 $pid > /dev/null
 	fi
 
+	if [ -n "$freezeCgroup" ]; then
+		removefreezercgroup "$freezeCgroup"
+		rm -f "$frozenLog"
+	fi
+
 	# If we are checking restrack results
 	if [[ $PREFIX == *"-restrack"* ]]; then
 		foundFile=$(find "$dumpDir" -mindepth 1 -name "*.restrack" -print -quit)
@@ -127,11 +170,93 @@ function runProcDumpAndValidate {
 			# Dump validation for native (non-.NET) tests
 			if $isNativeTest; then
 				# Find the first dump file
-				corexDump=$(find "$dumpDir" -mindepth 1 -maxdepth 1 -type f ! -name "*.restrack" -print -quit)
+				corexDump=$(find "$dumpDir" -mindepth 1 -maxdepth 1 -type f ! -name "*.restrack" ! -name "*.stats.json" -print -quit)
+
+				# Statistics (-stats) are written next to the dump
+				if [[ $PREFIX == *"-stats"* ]]; then
+					if ! grep -q '"bytes_written"' "$corexDump.stats.json" 2>/dev/null; then
+						echo "[validate] FAIL: no dump statistics in $corexDump.stats.json"
+						exit 1
+					fi
+				fi
+
+				# Compressed dumps (-compress) are validated once expanded
+				if [[ "$corexDump" == *.cxz ]]; then
+					if ! $PROCDUMPPATH -rebuild "$corexDump" "${corexDump%.cxz}" > /dev/null; then
+						echo "[validate] FAIL: could not expand $corexDump"
+						exit 1
+					fi
+					corexDump="${corexDump%.cxz}"
+				fi
 
 				if [ -n "$corexDump" ]; then
-					# 1. Size comparison against gcore reference
-					if [ -n "$gcoreRefDump" ] && [ -f "$gcoreRefDump" ]; then
+					# 0. What the switch under test does (checked before gdb reads the dump)
+					case "$dumpSwitch" in
+						"")
+							# corex leaves untouched and zero pages as holes by default
+							if [[ $PREFIX != *"-usegcore"* && $PREFIX != *"-stacks"* && $PREFIX != *"-maxsize"* && $PREFIX != *"-compress"* ]]; then
+								if ! validatesparsedump "$corexDump"; then
+									echo "[validate] FAIL: dump sparseness validation failed"
+									exit 1
+								fi
+							fi
+							;;
+						-dio)
+							if ! validatedirectio "$corexDump"; then
+								echo "[validate] FAIL: direct I/O validation failed"
+								exit 1
+							fi
+							;;
+						-live)
+							# Without soft-dirty tracking -live falls back to a regular dump
+							if ! softdirtysupported; then
+								echo "[validate] SKIP: kernel does not track soft-dirty pages"
+							elif ! validatestoppedtime "$corexDump.stats.json"; then
+								echo "[validate] FAIL: stopped time validation failed"
+								exit 1
+							fi
+							;;
+						-fork)
+							if ! validatestoppedtime "$corexDump.stats.json"; then
+								echo "[validate] FAIL: stopped time validation failed"
+								exit 1
+							fi
+							if [[ "$TESTPROGMODE" == mem* ]] && ! validateunforkedpage "$corexDump" "$TESTPROGPATH"; then
+								echo "[validate] FAIL: MADV_WIPEONFORK validation failed"
+								exit 1
+							fi
+							;;
+						-freeze)
+							if [ "$freezeResult" -ne 0 ]; then
+								echo "[validate] FAIL: freeze validation failed"
+								exit 1
+							fi
+							;;
+					esac
+
+					# -ct lists the thread over the threshold first, so debuggers select it
+					if [[ $PREFIX == *"-ct "* ]]; then
+						if ! validatethreadcpudump "$corexDump" "$TESTPROGPATH" "$hotTid"; then
+							echo "[validate] FAIL: thread CPU dump validation failed"
+							exit 1
+						fi
+					fi
+
+					# 1. Size comparison against gcore reference (-stacks and -maxsize leave memory out)
+					if [[ $PREFIX == *"-maxsize"* ]]; then
+						maxSize=$(sed -n 's/.*-maxsize \([0-9]*\).*/\1/p' <<< "$PREFIX")
+						if ! validatemaxsize "$corexDump" "$maxSize"; then
+							echo "[validate] FAIL: size limit validation failed"
+							exit 1
+						fi
+					elif [[ $PREFIX == *"-stacks"* ]]; then
+						if [ -z "$gcoreRefDump" ] || [ ! -f "$gcoreRefDump" ]; then
+							echo "[validate] SKIP: no gcore reference dump available for size comparison"
+						elif ! validatestacksdump "$corexDump" "$gcoreRefDump"; then
+							echo "[validate] FAIL: stacks dump size validation failed"
+							exit 1
+						fi
+					elif [ -n "$gcoreRefDump" ] && [ -f "$gcoreRefDump" ]; then
 						if ! validatedumpsize "$corexDump" "$gcoreRefDump" 20; then
 							echo "[validate] FAIL: dump size validation failed"
 							exit 1
@@ -0,0 +1,74 @@
+#!/bin/bash
+# Test: --core-handler copies a core piped in on standard input, as the kernel does for a
+# core_pattern handler, and keeps no more dumps than -n, with or without -stats
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
+PROCDUMPPATH="$DIR/../../../procdump";
+TESTPROGPATH="$DIR/../../../ProcDumpTestApplication";
+
+dumpDir=$(mktemp -d -t dump_XXXXXX)
+
+$TESTPROGPATH "sleep" &
+target_pid=$!
+sleep 1
+
+# A core of the target stands in for the one the kernel would write
+$PROCDUMPPATH $target_pid $dumpDir/source
+source=$(find "$dumpDir" -maxdepth 1 -name "source*" -print -quit)
+if [[ -z "$source" ]]; then
+    echo "TEST FAILED: No core dump to pipe in"
+    kill -9 $target_pid
+    rm -rf $dumpDir
+    exit 1
+fi
+
+mkdir $dumpDir/crash
+for i in 1 2; do
+    echo "[`date +"%T.%3N"`] $PROCDUMPPATH --core-handler $target_pid 11 -n 1 $dumpDir/crash < $source"
+    $PROCDUMPPATH --core-handler $target_pid 11 -n 1 $dumpDir/crash < $source
+    rc=$?
+    if [[ $rc -ne 0 ]]; then
+        echo "TEST FAILED: --core-handler returned $rc"
+        kill -9 $target_pid
+        rm -rf $dumpDir
+        exit 1
+    fi
+done
+
+# With -stats, the statistics written next to each dump do not count as dumps
+mkdir $dumpDir/stats
+for i in 1 2 3; do
+    echo "[`date +"%T.%3N"`] $PROCDUMPPATH --core-handler $target_pid 11 -stats -n 2 $dumpDir/stats < $source"
+    $PROCDUMPPATH --core-handler $target_pid 11 -stats -n 2 $dumpDir/stats < $source
+    rc=$?
+    if [[ $rc -ne 0 ]]; then
+        echo "TEST FAILED: --core-handler -stats returned $rc"
+        kill -9 $target_pid
+        rm -rf $dumpDir
+        exit 1
+    fi
+    # The dump names have a one second resolution
+    sleep 1
+done
+
+kill -9 $target_pid
+
+# The second crash is over the limit of one dump per process
+count=$(find "$dumpDir/crash" -maxdepth 1 -name "ProcDumpTestApplication_crash_*.$target_pid" | wc -l)
+handled=$(find "$dumpDir/crash" -maxdepth 1 -name "ProcDumpTestApplication_crash_*" -print -quit)
+if [[ "$count" -ne 1 ]] || ! cmp -s $source $handled; then
+    echo "TEST FAILED: Expected one copy of the core, found $count"
+    rm -rf $dumpDir
+    exit 1
+fi
+
+# The third is over the limit of two
+count=$(find "$dumpDir/stats" -maxdepth 1 -name "ProcDumpTestApplication_crash_*.$target_pid" | wc -l)
+if [[ "$count" -eq 2 ]]; then
+    echo "TEST PASSED: Core copied once, and twice with -stats -n 2"
+    rm -rf $dumpDir
+    exit 0
+else
+    echo "TEST FAILED: Expected two copies of the core with -stats -n 2, found $count"
+    rm -rf $dumpDir
+    exit 1
+fi
@@ -0,0 +1,68 @@
+#!/bin/bash
+# Test: -diff writes the second dump as a delta that -rebuild turns back into a full core
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
+PROCDUMPPATH="$DIR/../../../procdump";
+TESTPROGPATH="$DIR/../../../ProcDumpTestApplication";
+source "$DIR/../helpers.sh"
+
+dumpDir=$(mktemp -d -t dump_XXXXXX)
+
+# cpu 100 spins in stress_cpu, so its frame is on the stack of both dumps
+$TESTPROGPATH cpu 100 &
+target_pid=$!
+sleep 1
+
+echo "[`date +"%T.%3N"`] $PROCDUMPPATH -log stdout -c 25 -n 2 -s 1 -diff $target_pid $dumpDir"
+$PROCDUMPPATH -log stdout -c 25 -n 2 -s 1 -diff $target_pid $dumpDir &
+pd_pid=$!
+
+for i in $(seq 1 30); do
+    count=$(find "$dumpDir" -maxdepth 1 -name "ProcDumpTestApplication_*" ! -name "*.pgidx" | wc -l)
+    if [[ "$count" -ge 2 ]]; then
+        break
+    fi
+    sleep 1
+done
+wait $pd_pid 2>/dev/null
+kill -9 $target_pid 2>/dev/null
+
+# The first dump of the series has a page index, the second is the delta
+base=$(find "$dumpDir" -maxdepth 1 -name "ProcDumpTestApplication_*.pgidx" | head -1)
+base=${base%.pgidx}
+delta=$(find "$dumpDir" -maxdepth 1 -name "ProcDumpTestApplication_*" ! -name "*.pgidx" ! -path "$base" | head -1)
+if [[ -z "$base" || -z "$delta" ]]; then
+    echo "TEST FAILED: Expected a base and a differential dump"
+    rm -rf $dumpDir
+    exit 1
+fi
+
+# The delta only holds the pages that changed since the base, so it cannot be rebuilt without it
+mv $base $base.moved
+if $PROCDUMPPATH -rebuild $delta $dumpDir/rebuilt > /dev/null 2>&1; then
+    echo "TEST FAILED: -rebuild succeeded without the base dump"
+    rm -rf $dumpDir
+    exit 1
+fi
+mv $base.moved $base
+rm -f $dumpDir/rebuilt
+
+$PROCDUMPPATH -rebuild $delta $dumpDir/rebuilt
+rc=$?
+if [[ $rc -ne 0 ]]; then
+    echo "TEST FAILED: -rebuild returned $rc"
+    rm -rf $dumpDir
+    exit 1
+fi
+
+# The ELF headers and the loader's link map behind gdb's shared library list don't change
+# while the target spins, so they are only in the rebuilt core if -rebuild took them from
+# the base. The stress_cpu frame needs the stack pages that changed, which come from the delta.
+if validatedumpcontent $dumpDir/rebuilt $TESTPROGPATH "$DIR/../validate_dump.gdb" stress_cpu; then
+    echo "TEST PASSED: Differential dump rebuilt"
+    rm -rf $dumpDir
+    exit 0
+else
+    echo "TEST FAILED: The rebuilt dump does not hold the memory of the process"
+    rm -rf $dumpDir
+    exit 1
+fi
@@ -0,0 +1,22 @@
+#!/bin/bash
+# Test: -dio writes the core dump with direct I/O
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
+runProcDumpAndValidate=$(readlink -m "$DIR/../runProcDumpAndValidate.sh");
+source $runProcDumpAndValidate
+
+TESTPROGNAME="ProcDumpTestApplication"
+TESTPROGMODE="burn"
+
+# These are all the ProcDump switches preceeding the PID
+PREFIX="-c 25"
+
+# This are all the ProcDump switches after the PID
+POSTFIX=""
+
+# Indicates whether the test should result in a dump or not
+SHOULDDUMP=true
+
+# The dump target
+DUMPTARGET=""
+
+runProcDumpAndValidate -dio
@@ -0,0 +1,24 @@
+#!/bin/bash
+# Test: -fork dumps a copy-on-write fork of the target, so a large target is
+# only stopped for the fork, and leaves out the MADV_WIPEONFORK page of the
+# target rather than dumping the fork's zeros for it
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
+runProcDumpAndValidate=$(readlink -m "$DIR/../runProcDumpAndValidate.sh");
+source $runProcDumpAndValidate
+
+TESTPROGNAME="ProcDumpTestApplication"
+TESTPROGMODE="mem 200M"
+
+# These are all the ProcDump switches preceeding the PID
+PREFIX="-m 150"
+
+# This are all the ProcDump switches after the PID
+POSTFIX=""
+
+# Indicates whether the test should result in a dump or not
+SHOULDDUMP=true
+
+# The dump target
+DUMPTARGET=""
+
+runProcDumpAndValidate -fork
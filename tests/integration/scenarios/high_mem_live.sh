@@ -0,0 +1,23 @@
+#!/bin/bash
+# Test: -live pre-copies memory before pausing the target, so a large target
+# is only stopped for a short part of the dump
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
+runProcDumpAndValidate=$(readlink -m "$DIR/../runProcDumpAndValidate.sh");
+source $runProcDumpAndValidate
+
+TESTPROGNAME="ProcDumpTestApplication"
+TESTPROGMODE="mem 200M"
+
+# These are all the ProcDump switches preceeding the PID
+PREFIX="-m 150"
+
+# This are all the ProcDump switches after the PID
+POSTFIX=""
+
+# Indicates whether the test should result in a dump or not
+SHOULDDUMP=true
+
+# The dump target
+DUMPTARGET=""
+
+runProcDumpAndValidate -live
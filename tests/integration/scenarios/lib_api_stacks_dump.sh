@@ -0,0 +1,17 @@
+#!/bin/bash
+#
+# Library API: stacks-only dump via pdWriteDumpEx (PD_DUMP_FLAG_STACKS_ONLY).
+# The dump must still load in GDB with the backtraces of all threads.
+#
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
+runLibTestAndValidate=$(readlink -m "$DIR/../runLibTestAndValidate.sh");
+source $runLibTestAndValidate
+
+LIBTEST_PID="target"
+LIBTEST_PATH="dump"
+LIBTEST_FLAGS=1
+EXPECTSUCCESS=true
+SHOULDDUMP=true
+VALIDATE_CONTENT=true
+
+runLibTestAndValidate
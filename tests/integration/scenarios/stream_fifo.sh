@@ -0,0 +1,74 @@
+#!/bin/bash
+# Test: -stream writes a core dump into a FIFO that a reader drains into a valid core,
+# and reports a failure (instead of dying of SIGPIPE) when the reader goes away early
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
+source "$DIR/../helpers.sh"
+PROCDUMPPATH="$DIR/../../../procdump";
+TESTPROGPATH="$DIR/../../../ProcDumpTestApplication";
+GDBSCRIPT="$DIR/../validate_dump.gdb"
+
+dumpDir=$(mktemp -d -t dump_XXXXXX)
+fifo=$dumpDir/fifo
+mkfifo $fifo
+
+$TESTPROGPATH "sleep" &
+target_pid=$!
+sleep 1
+
+function cleanup {
+    kill -9 $target_pid 2>/dev/null
+    rm -rf $dumpDir
+}
+
+# The whole core is read from the FIFO into a file
+cat $fifo > $dumpDir/streamed.core &
+pidReader=$!
+echo "[`date +"%T.%3N"`] $PROCDUMPPATH -stream $fifo $target_pid $dumpDir/streamed"
+output=$($PROCDUMPPATH -stream $fifo $target_pid $dumpDir/streamed)
+rc=$?
+echo "$output"
+wait $pidReader
+
+if [[ $rc -ne 0 ]] || ! grep -q "streamed to $fifo" <<< "$output"; then
+    echo "TEST FAILED: -stream returned $rc"
+    cleanup
+    exit 1
+fi
+if ! validatedumpcontent $dumpDir/streamed.core $TESTPROGPATH $GDBSCRIPT; then
+    echo "TEST FAILED: The streamed core is not valid"
+    cleanup
+    exit 1
+fi
+
+# The reader exits after the first few KB; the rest of the core cannot be written
+head -c 4096 $fifo > /dev/null &
+pidReader=$!
+echo "[`date +"%T.%3N"`] $PROCDUMPPATH -stream $fifo $target_pid $dumpDir/broken"
+output=$($PROCDUMPPATH -stream $fifo $target_pid $dumpDir/broken)
+rc=$?
+echo "$output"
+wait $pidReader
+
+if [[ $rc -ge 128 ]]; then
+    echo "TEST FAILED: ProcDump was killed by signal $((rc - 128))"
+    cleanup
+    exit 1
+fi
+if ! grep -q "An error occurred while generating the core dump" <<< "$output" ||
+   grep -q "streamed to $fifo" <<< "$output"; then
+    echo "TEST FAILED: The broken stream was not reported"
+    cleanup
+    exit 1
+fi
+
+# The target must be left running
+state=$(sed 's/.*) \(.\).*/\1/' /proc/$target_pid/stat)
+if [[ "$state" == "T" || "$state" == "t" ]]; then
+    echo "TEST FAILED: The target was left stopped ($state)"
+    cleanup
+    exit 1
+fi
+
+echo "TEST PASSED: Core streamed through a FIFO, and the early end of the reader reported"
+cleanup
+exit 0
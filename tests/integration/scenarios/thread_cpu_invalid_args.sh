@@ -0,0 +1,42 @@
+#!/bin/bash
+# Test: -ct rejects thresholds outside 1-100%, sample counts below 1 and malformed values
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
+PROCDUMPPATH="$DIR/../../../procdump";
+
+# A PID that no longer exists: valid options get past parsing and fail the process lookup
+sleep 0 &
+deadPid=$!
+wait $deadPid
+
+failed=0
+
+for value in "0" "-5" "101" "150,2" "50,0" "abc" "50,2,3"; do
+    output=$($PROCDUMPPATH -ct $value $deadPid 2>&1)
+    rc=$?
+    if [[ $rc -eq 0 || "$output" == *"No process matching"* ]]; then
+        echo "TEST FAILED: -ct $value was accepted"
+        failed=1
+    fi
+done
+
+for value in "0" "101" "50,0"; do
+    output=$($PROCDUMPPATH -ct $value $deadPid 2>&1)
+    if [[ "$output" != *"Invalid thread CPU threshold or sample count specified."* ]]; then
+        echo "TEST FAILED: -ct $value did not report an invalid threshold"
+        failed=1
+    fi
+done
+
+for value in "1" "100" "50,2"; do
+    output=$($PROCDUMPPATH -ct $value $deadPid 2>&1)
+    if [[ "$output" != *"No process matching"* ]]; then
+        echo "TEST FAILED: -ct $value was rejected"
+        failed=1
+    fi
+done
+
+if [[ $failed -eq 0 ]]; then
+    echo "TEST PASSED: -ct arguments are validated"
+    exit 0
+fi
+exit 1